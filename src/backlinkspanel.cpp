@@ -0,0 +1,77 @@
+#include "backlinkspanel.h"
+#include "linkgraph.h"
+#include "vaultindex.h"
+
+BacklinksPanel::BacklinksPanel(VaultIndex *index, LinkGraph *graph, QWidget *parent)
+    : QWidget(parent), m_index(index), m_graph(graph)
+{
+    setupUI();
+
+    connect(m_graph, &LinkGraph::changed, this, &BacklinksPanel::refresh);
+    connect(m_list, &QListWidget::itemActivated, this, &BacklinksPanel::onItemActivated);
+
+    refresh();
+}
+
+void BacklinksPanel::setupUI()
+{
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_titleLabel = new QLabel("Backlinks");
+    m_list = new QListWidget;
+    m_list->setUniformItemSizes(true);
+
+    m_unresolvedLabel = new QLabel;
+    m_unresolvedLabel->setWordWrap(true);
+    m_unresolvedLabel->setVisible(false);
+
+    layout->addWidget(m_titleLabel);
+    layout->addWidget(m_list);
+    layout->addWidget(m_unresolvedLabel);
+}
+
+void BacklinksPanel::setCurrentFile(const QString &filePath)
+{
+    m_currentFilePath = filePath;
+    refresh();
+}
+
+void BacklinksPanel::refresh()
+{
+    m_list->clear();
+    m_unresolvedLabel->setVisible(false);
+
+    int noteId = m_currentFilePath.isEmpty() ? -1 : m_index->noteId(m_currentFilePath);
+    if (noteId < 0) {
+        m_titleLabel->setText("Backlinks");
+        return;
+    }
+    if (!m_graph->isReady()) {
+        m_titleLabel->setText("Backlinks (scanning vault...)");
+        return;
+    }
+
+    const QVector<quint32> backlinks = m_graph->backlinks(noteId);
+    for (quint32 source : backlinks) {
+        const VaultIndex::Note &note = m_index->note(source);
+        auto *item = new QListWidgetItem(note.title, m_list);
+        item->setData(Qt::UserRole, source);
+        item->setToolTip(note.path);
+    }
+    m_titleLabel->setText(QString("Backlinks (%1)").arg(backlinks.size()));
+
+    const QStringList unresolved = m_graph->unresolvedLinks(noteId);
+    if (!unresolved.isEmpty()) {
+        m_unresolvedLabel->setText("Not yet created: [[" + unresolved.join("]], [[") + "]]");
+        m_unresolvedLabel->setVisible(true);
+    }
+}
+
+void BacklinksPanel::onItemActivated(QListWidgetItem *item)
+{
+    const QString filePath = m_index->absolutePath(item->data(Qt::UserRole).toUInt());
+    if (!filePath.isEmpty()) {
+        emit fileSelected(filePath);
+    }
+}
\ No newline at end of file
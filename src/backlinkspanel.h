@@ -0,0 +1,44 @@
+#ifndef BACKLINKSPANEL_H
+#define BACKLINKSPANEL_H
+
+#include <QWidget>
+#include <QListWidget>
+#include <QLabel>
+#include <QVBoxLayout>
+
+class LinkGraph;
+class VaultIndex;
+
+// Notes linking to the note in the editor, plus the links of that note
+// that do not lead anywhere yet. Answered from the link graph, so it is
+// refreshed on every change without reading files.
+class BacklinksPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    BacklinksPanel(VaultIndex *index, LinkGraph *graph, QWidget *parent = nullptr);
+
+public slots:
+    void setCurrentFile(const QString &filePath);
+
+signals:
+    void fileSelected(const QString &filePath);
+
+private slots:
+    void refresh();
+    void onItemActivated(QListWidgetItem *item);
+
+private:
+    void setupUI();
+
+    VaultIndex *m_index;
+    LinkGraph *m_graph;
+    QString m_currentFilePath;
+
+    QLabel *m_titleLabel;
+    QListWidget *m_list;
+    QLabel *m_unresolvedLabel;
+};
+
+#endif // BACKLINKSPANEL_H
\ No newline at end of file
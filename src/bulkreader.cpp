@@ -0,0 +1,530 @@
+#include "bulkreader.h"
+#include <QFile>
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// Headers from before 5.7 lack the probe and the open/read operations
+#if defined(IORING_FEAT_FAST_POLL) && defined(__NR_io_uring_setup)
+#define FORMICA_IO_URING
+#endif
+#endif
+
+namespace {
+
+// Whole file into buffer, reusing its capacity; false if it cannot be read
+bool readFile(const QByteArray &path, QByteArray *buffer)
+{
+#ifdef Q_OS_UNIX
+    const int fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        buffer->resize(0);
+        return false;
+    }
+
+    struct stat st;
+    qsizetype size = ::fstat(fd, &st) == 0 ? qsizetype(st.st_size) : 0;
+    buffer->resize(size);
+    qsizetype filled = 0;
+    bool ok = true;
+    while (filled < size) {
+        const ssize_t count = ::pread(fd, buffer->data() + filled, size_t(size - filled), filled);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            ok = count == 0;    // Shorter than fstat() said
+            break;
+        }
+        filled += count;
+    }
+    ::close(fd);
+    buffer->resize(ok ? filled : 0);
+    return ok;
+#else
+    QFile file(QFile::decodeName(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        buffer->resize(0);
+        return false;
+    }
+    *buffer = file.readAll();
+    return true;
+#endif
+}
+
+#ifdef FORMICA_IO_URING
+
+// Minimal io_uring over the raw system calls, so liburing is not needed.
+// One thread owns the ring.
+class Ring
+{
+public:
+    Ring() = default;
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    ~Ring()
+    {
+        if (m_sqes) {
+            ::munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cq && m_cq != m_sq) {
+            ::munmap(m_cq, m_cqSize);
+        }
+        if (m_sq) {
+            ::munmap(m_sq, m_sqSize);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    bool init(unsigned entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_fd = int(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0) {
+            return false;
+        }
+
+        m_sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            m_sqSize = m_cqSize = std::max(m_sqSize, m_cqSize);
+        }
+
+        m_sq = map(m_sqSize, IORING_OFF_SQ_RING);
+        m_cq = singleMap ? m_sq : map(m_cqSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe *>(map(m_sqesSize, IORING_OFF_SQES));
+        if (!m_sq || !m_cq || !m_sqes) {
+            return false;
+        }
+
+        char *sq = static_cast<char *>(m_sq);
+        m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        char *cq = static_cast<char *>(m_cq);
+        m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        m_localTail = *m_sqTail;
+        m_entries = params.sq_entries;
+        return true;
+    }
+
+    // Whether the kernel knows all of these operations
+    bool supports(std::initializer_list<int> ops) const
+    {
+        const size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        alignas(io_uring_probe) char buffer[size];
+        std::memset(buffer, 0, size);
+        auto *probe = reinterpret_cast<io_uring_probe *>(buffer);
+        if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            return false;
+        }
+        for (int op : ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    unsigned entries() const { return m_entries; }
+
+    // A cleared submission entry; at most entries() may be outstanding
+    io_uring_sqe *nextSqe()
+    {
+        const unsigned slot = m_localTail++ & m_sqMask;
+        io_uring_sqe *sqe = &m_sqes[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        m_sqArray[slot] = slot;
+        return sqe;
+    }
+
+    // Submit what was prepared and wait for at least one completion
+    bool submitAndWait()
+    {
+        const unsigned count = m_localTail - *m_sqTail;
+        __atomic_store_n(m_sqTail, m_localTail, __ATOMIC_RELEASE);
+        for (;;) {
+            if (::syscall(__NR_io_uring_enter, m_fd, count, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0) {
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+            if (errno != EINTR) {
+                QThread::usleep(100);   // Out of kernel resources for a moment
+            }
+        }
+    }
+
+    // Calls fn(userData, result) for each completion that arrived
+    template <typename Fn>
+    void reap(Fn fn)
+    {
+        unsigned head = *m_cqHead;
+        const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+            fn(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    void *map(size_t size, off_t offset) const
+    {
+        void *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+
+    int m_fd = -1;
+    void *m_sq = nullptr;
+    void *m_cq = nullptr;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqSize = 0;
+    size_t m_cqSize = 0;
+    size_t m_sqesSize = 0;
+    unsigned *m_sqTail = nullptr;
+    unsigned *m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_localTail = 0;
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe *m_cqes = nullptr;
+    unsigned m_entries = 0;
+};
+
+#endif // FORMICA_IO_URING
+
+} // namespace
+
+BulkReader::BulkReader(Backend backend)
+    : m_backend(backend)
+{
+}
+
+BulkReader::~BulkReader()
+{
+    cancel();
+}
+
+void BulkReader::start(const QStringList &filePaths)
+{
+    m_paths.reserve(filePaths.size());
+    for (const QString &filePath : filePaths) {
+        m_paths.append(QFile::encodeName(filePath));
+    }
+
+    if (m_backend != Threads) {
+        m_backend = hasIoUring() ? IoUring : Threads;
+    }
+
+    // A thread costs more than reading a handful of notes; next() reads those
+    if (m_paths.size() <= InlineLimit) {
+        return;
+    }
+
+    const int threadCount = m_backend == IoUring ? 1 : qMin(ReaderThreads, int(m_paths.size()));
+    for (int i = 0; i < threadCount; ++i) {
+        QThread *thread = QThread::create([this]() {
+            if (m_backend == IoUring) {
+                readWithRing();
+            } else {
+                readWithThreads();
+            }
+        });
+        m_threads.append(thread);
+        thread->start();
+    }
+}
+
+bool BulkReader::next(File *file)
+{
+    if (m_threads.isEmpty()) {
+        const int index = m_nextPath++;
+        if (index >= m_paths.size() || m_cancelled) {
+            return false;
+        }
+        file->index = index;
+        file->ok = readFile(m_paths[index], &file->data);
+        return true;
+    }
+
+    QMutexLocker locker(&m_queueLock);
+    while (m_queue.empty() && m_returned < m_paths.size() && !m_cancelled) {
+        m_notEmpty.wait(&m_queueLock);
+    }
+    if (m_queue.empty() || m_cancelled) {
+        return false;
+    }
+    *file = std::move(m_queue.front());
+    m_queue.pop_front();
+    if (++m_returned == m_paths.size()) {
+        m_notEmpty.wakeAll();   // Other consumers are waiting for nothing
+    }
+    m_notFull.wakeOne();
+    return true;
+}
+
+void BulkReader::recycle(QByteArray &&buffer)
+{
+    // Huge buffers would pin memory for the rest of the run
+    if (buffer.capacity() == 0 || buffer.capacity() > MaxPooledSize) {
+        return;
+    }
+    buffer.resize(0);   // Keeps the capacity
+
+    QMutexLocker locker(&m_poolLock);
+    if (m_pool.size() < PoolSize) {
+        m_pool.append(std::move(buffer));
+    }
+}
+
+void BulkReader::cancel()
+{
+    {
+        QMutexLocker locker(&m_queueLock);
+        m_cancelled = true;
+        m_notFull.wakeAll();
+        m_notEmpty.wakeAll();
+    }
+    for (QThread *thread : std::as_const(m_threads)) {
+        thread->wait();
+        delete thread;
+    }
+    m_threads.clear();
+}
+
+bool BulkReader::hasIoUring()
+{
+#ifdef FORMICA_IO_URING
+    static const bool available = []() {
+        Ring ring;
+        return ring.init(4) && ring.supports({IORING_OP_OPENAT, IORING_OP_READ});
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+QString BulkReader::backendName(Backend backend)
+{
+    switch (backend) {
+    case IoUring:
+        return "io_uring";
+    case Threads:
+        return "threads";
+    default:
+        return "auto";
+    }
+}
+
+void BulkReader::readWithRing()
+{
+#ifdef FORMICA_IO_URING
+    struct Slot {
+        int index = -1;         // File being read, -1 if free
+        int fd = -1;
+        QByteArray buffer;
+        qsizetype filled = 0;
+    };
+    // Declared before the ring so buffers outlive any read still in flight
+    QVector<Slot> inFlight(RingDepth);
+
+    Ring ring;
+    if (!ring.init(RingDepth)) {
+        readWithThreads();      // Out of locked memory, say
+        return;
+    }
+    QVector<int> freeSlots;
+    for (int i = qMin(int(ring.entries()), RingDepth) - 1; i >= 0; --i) {
+        freeSlots.append(i);
+    }
+    int active = 0;
+
+    auto finish = [&](int slotIndex, bool ok) {
+        Slot &slot = inFlight[slotIndex];
+        if (slot.fd >= 0) {
+            ::close(slot.fd);
+        }
+        File file;
+        file.index = slot.index;
+        file.ok = ok;
+        slot.buffer.resize(ok ? slot.filled : 0);
+        file.data = std::move(slot.buffer);
+        slot = Slot();
+        freeSlots.append(slotIndex);
+        --active;
+        deliver(std::move(file));
+    };
+
+    auto queueRead = [&](int slotIndex) {
+        // The size is not known up front; a full buffer means read on
+        Slot &slot = inFlight[slotIndex];
+        if (slot.filled == slot.buffer.size()) {
+            qsizetype size = qMax(InitialReadSize, slot.buffer.size() * 2);
+            if (slot.buffer.isEmpty()) {
+                size = qMax(size, slot.buffer.capacity());
+            }
+            slot.buffer.resize(size);
+        }
+        io_uring_sqe *sqe = ring.nextSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot.fd;
+        sqe->addr = quintptr(slot.buffer.data() + slot.filled);
+        sqe->len = unsigned(slot.buffer.size() - slot.filled);
+        sqe->off = quint64(slot.filled);
+        sqe->user_data = quint64(slotIndex);
+    };
+
+    for (;;) {
+        // Keep every slot busy while there are files left
+        while (!m_cancelled && !freeSlots.isEmpty()) {
+            const int index = m_nextPath++;
+            if (index >= m_paths.size()) {
+                break;
+            }
+            const int slotIndex = freeSlots.takeLast();
+            Slot &slot = inFlight[slotIndex];
+            slot.index = index;
+            slot.buffer = takeBuffer();
+
+            io_uring_sqe *sqe = ring.nextSqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = quintptr(m_paths[index].constData());
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = quint64(slotIndex);
+            ++active;
+        }
+        if (active == 0) {
+            break;
+        }
+
+        if (!ring.submitAndWait()) {
+            // Not expected past the probe. Opens that completed hand back
+            // descriptors to close; the files in flight are read again
+            // without the ring, then the ones not started yet. Slot buffers
+            // are left alone, a read may still be writing to them.
+            ring.reap([&](quint64 userData, int result) {
+                Slot &slot = inFlight[int(userData)];
+                if (slot.fd < 0 && result >= 0) {
+                    slot.fd = result;
+                }
+            });
+            for (Slot &slot : inFlight) {
+                if (slot.index < 0) {
+                    continue;
+                }
+                if (slot.fd >= 0) {
+                    ::close(slot.fd);
+                    slot.fd = -1;
+                }
+                if (m_cancelled) {
+                    return;
+                }
+                File file;
+                file.index = slot.index;
+                file.data = takeBuffer();
+                file.ok = readFile(m_paths[slot.index], &file.data);
+                slot.index = -1;
+                if (!deliver(std::move(file))) {
+                    return;
+                }
+            }
+            readWithThreads();
+            return;
+        }
+
+        ring.reap([&](quint64 userData, int result) {
+            const int slotIndex = int(userData);
+            Slot &slot = inFlight[slotIndex];
+            if (slot.fd < 0) {
+                // An open finished
+                if (result < 0 || m_cancelled) {
+                    slot.fd = result;
+                    finish(slotIndex, false);
+                } else {
+                    slot.fd = result;
+                    queueRead(slotIndex);
+                }
+                return;
+            }
+
+            if (result == -EINTR || result == -EAGAIN) {
+                queueRead(slotIndex);
+            } else if (result < 0) {
+                finish(slotIndex, false);
+            } else {
+                slot.filled += result;
+                // A short read is the end of a regular file
+                if (slot.filled == slot.buffer.size() && result > 0 && !m_cancelled) {
+                    queueRead(slotIndex);
+                } else {
+                    finish(slotIndex, !m_cancelled);
+                }
+            }
+        });
+    }
+#else
+    readWithThreads();
+#endif
+}
+
+void BulkReader::readWithThreads()
+{
+    while (!m_cancelled) {
+        const int index = m_nextPath++;
+        if (index >= m_paths.size()) {
+            return;
+        }
+        File file;
+        file.index = index;
+        file.data = takeBuffer();
+        file.ok = readFile(m_paths[index], &file.data);
+        if (!deliver(std::move(file))) {
+            return;
+        }
+    }
+}
+
+bool BulkReader::deliver(File &&file)
+{
+    QMutexLocker locker(&m_queueLock);
+    while (int(m_queue.size()) >= QueueDepth && !m_cancelled) {
+        m_notFull.wait(&m_queueLock);
+    }
+    if (m_cancelled) {
+        return false;
+    }
+    m_queue.push_back(std::move(file));
+    m_notEmpty.wakeOne();
+    return true;
+}
+
+QByteArray BulkReader::takeBuffer()
+{
+    QMutexLocker locker(&m_poolLock);
+    return m_pool.isEmpty() ? QByteArray() : m_pool.takeLast();
+}
\ No newline at end of file
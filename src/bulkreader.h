@@ -0,0 +1,90 @@
+#ifndef BULKREADER_H
+#define BULKREADER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+
+class QThread;
+
+// Reads many whole files ahead of the code that parses them, for
+// operations that touch every note (vault scans, index builds, the scan
+// search).
+//
+// With io_uring, one thread keeps up to RingDepth opens and reads in
+// flight and submits each round of them with a single system call.
+// Without it (old kernels, other platforms, containers that filter the
+// system call) ReaderThreads threads open and pread() one file at a time
+// each. Either way finished files wait in a queue of at most QueueDepth,
+// so reading never runs far ahead of parsing, and buffers handed back
+// through recycle() are reused for later files.
+class BulkReader
+{
+public:
+    enum Backend {
+        Auto,           // io_uring if the kernel has it, else threads
+        IoUring,
+        Threads
+    };
+
+    struct File {
+        int index = -1;         // Position in the list given to start()
+        QByteArray data;
+        bool ok = false;        // False if it could not be opened or read
+    };
+
+    explicit BulkReader(Backend backend = Auto);
+    ~BulkReader();
+
+    // Start reading filePaths; a reader reads one list
+    void start(const QStringList &filePaths);
+    // Wait for the next file, in the order reads finish (close to the
+    // order of the list); false once every file was returned
+    bool next(File *file);
+    // Hand a buffer back for reuse once its content is parsed
+    void recycle(QByteArray &&buffer);
+    // Stop reading; next() returns false from now on
+    void cancel();
+
+    // The backend in use; Auto until start()
+    Backend backend() const { return m_backend; }
+    // Reading threads; 0 when next() reads
+    int threadCount() const { return m_threads.size(); }
+    static bool hasIoUring();
+    static QString backendName(Backend backend);
+
+    static const int QueueDepth = 64;
+    static const int RingDepth = 64;
+    static const int ReaderThreads = 8;
+    static const int InlineLimit = 4;     // Lists this short are read by next()
+    static const int PoolSize = QueueDepth + RingDepth;
+    static const qsizetype MaxPooledSize = 1024 * 1024;
+    static const qsizetype InitialReadSize = 64 * 1024;
+
+private:
+    void readWithRing();
+    void readWithThreads();
+    bool deliver(File &&file);
+    QByteArray takeBuffer();
+
+    Backend m_backend;
+    QVector<QByteArray> m_paths;        // Encoded for open()
+    QVector<QThread *> m_threads;
+    std::atomic<int> m_nextPath{0};
+    std::atomic<bool> m_cancelled{false};
+
+    QMutex m_queueLock;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    std::deque<File> m_queue;
+    int m_returned = 0;
+
+    QMutex m_poolLock;
+    QVector<QByteArray> m_pool;
+};
+
+#endif // BULKREADER_H
\ No newline at end of file
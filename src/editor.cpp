@@ -1,5 +1,7 @@
 #include "editor.h"
+#include "indexpipeline.h"
 #include "linkparser.h"
+#include "markdownpreview.h"
 #include "settings.h"
 #include <QFile>
 #include <QTextStream>
@@ -7,9 +9,9 @@
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFont>
-#include <QSyntaxHighlighter>
+#include <QScrollBar>
+#include <QElapsedTimer>
 #include <QTextCharFormat>
-#include <QRegularExpression>
 #include <QApplication>
 #include <QMouseEvent>
 #include <QEvent>
@@ -18,6 +20,16 @@
 #include <QProcess>
 #include <QStandardPaths>
 
+namespace {
+
+// Background index builds yield the CPU this long after each keystroke
+const int TypingPauseMs = 750;
+
+// Longest the highlighter holds the event loop while catching up
+const int HighlightSliceMs = 4;
+
+} // namespace
+
 Editor::Editor(QWidget *parent)
     : QWidget(parent), m_isModified(false), m_previewVisible(false)
 {
@@ -30,6 +42,7 @@ Editor::Editor(QWidget *parent)
 
     // Connect to settings changes
     connect(Settings::instance(), &Settings::fontChanged, this, &Editor::onFontChanged);
+    connect(Settings::instance(), &Settings::previewDelayChanged, m_preview, &MarkdownPreview::setDelay);
 }
 
 void Editor::setupUI()
@@ -60,12 +73,13 @@ void Editor::setupUI()
     m_textEdit->setFont(font);
 
     // Syntax highlighter
-    m_highlighter = new MarkdownHighlighter(m_textEdit->document());
+    m_highlighter = new MarkdownHighlighter(m_textEdit);
 
     // Preview area (initially hidden)
     m_previewEdit = new QTextEdit;
     m_previewEdit->setReadOnly(true);
     m_previewEdit->hide();
+    m_preview = new MarkdownPreview(m_textEdit->document(), m_previewEdit->document(), this);
 
     m_splitter->addWidget(m_textEdit);
     m_splitter->addWidget(m_previewEdit);
@@ -99,7 +113,6 @@ bool Editor::loadFile(const QString &filePath)
 
     setCurrentFile(filePath);
     m_isModified = false;
-    updatePreview();
 
     return true;
 }
@@ -125,7 +138,6 @@ bool Editor::saveFile()
     out << m_textEdit->toPlainText();
 
     m_isModified = false;
-    updatePreview();
 
     return true;
 }
@@ -144,8 +156,8 @@ bool Editor::isModified() const
 
 void Editor::onTextChanged()
 {
+    IndexPipeline::pauseFor(TypingPauseMs);
     m_isModified = true;
-    updatePreview();
 }
 
 void Editor::togglePreview()
@@ -156,43 +168,11 @@ void Editor::togglePreview()
         m_previewEdit->show();
         m_previewButton->setText("Hide Preview");
         m_splitter->setSizes({600, 600});
-        updatePreview();
     } else {
         m_previewEdit->hide();
         m_previewButton->setText("Show Preview");
     }
-}
-
-void Editor::updatePreview()
-{
-    if (!m_previewVisible) {
-        return;
-    }
-
-    // Simple markdown to HTML conversion
-    QString text = m_textEdit->toPlainText();
-    QString html = text;
-
-    // Convert headers
-    html.replace(QRegularExpression("^### (.+)$", QRegularExpression::MultilineOption), "<h3>\\1</h3>");
-    html.replace(QRegularExpression("^## (.+)$", QRegularExpression::MultilineOption), "<h2>\\1</h2>");
-    html.replace(QRegularExpression("^# (.+)$", QRegularExpression::MultilineOption), "<h1>\\1</h1>");
-
-    // Convert bold and italic
-    html.replace(QRegularExpression("\\*\\*(.+?)\\*\\*"), "<strong>\\1</strong>");
-    html.replace(QRegularExpression("\\*(.+?)\\*"), "<em>\\1</em>");
-
-    // Convert code blocks
-    html.replace(QRegularExpression("```([\\s\\S]*?)```"), "<pre><code>\\1</code></pre>");
-    html.replace(QRegularExpression("`(.+?)`"), "<code>\\1</code>");
-
-    // Convert links
-    html.replace(QRegularExpression("\\[(.+?)\\]\\((.+?)\\)"), "<a href=\"\\2\">\\1</a>");
-
-    // Convert line breaks
-    html.replace("\n", "<br>");
-
-    m_previewEdit->setHtml(html);
+    m_preview->setEnabled(m_previewVisible);
 }
 
 void Editor::setCurrentFile(const QString &filePath)
@@ -205,6 +185,8 @@ void Editor::setCurrentFile(const QString &filePath)
         QFileInfo fileInfo(filePath);
         m_fileLabel->setText(fileInfo.fileName());
     }
+
+    emit currentFileChanged(filePath);
 }
 
 bool Editor::eventFilter(QObject *obj, QEvent *event)
@@ -233,8 +215,9 @@ QString Editor::getLinkAtPosition(const QPoint &pos)
     lineCursor.movePosition(QTextCursor::EndOfLine, QTextCursor::KeepAnchor);
     QString lineText = lineCursor.selectedText();
 
-    // Parse wiki links in this line
-    auto links = m_linkParser->parseWikiLinks(lineText, m_workspacePath);
+    // Parse wiki links in this line; only their positions are needed here,
+    // MainWindow resolves the clicked one
+    auto links = m_linkParser->parseWikiLinks(lineText);
 
     // Find which link was clicked
     int positionInLine = cursor.position() - lineCursor.anchor();
@@ -340,71 +323,187 @@ void Editor::applyCurrentSettings()
     // Apply line wrapping
     m_textEdit->setLineWrapMode(settings->lineWrapping() ? QTextEdit::WidgetWidth : QTextEdit::NoWrap);
 
+    m_preview->setDelay(settings->previewDelay());
+
     // Update highlighter colors for current theme
     if (m_highlighter) {
         // The highlighter will need to be updated for different themes
-        // For now, we'll just trigger a rehighlight
+        // For now, we'll just trigger a rehighlight (on screen now, the
+        // rest when idle)
         m_highlighter->rehighlight();
     }
 }
 
 // MarkdownHighlighter implementation
 
-MarkdownHighlighter::MarkdownHighlighter(QTextDocument *parent)
-    : QSyntaxHighlighter(parent)
+MarkdownHighlighter::MarkdownHighlighter(QTextEdit *editor)
+    : QObject(editor), m_editor(editor), m_document(editor->document())
+{
+    m_formats[MarkdownTokenizer::Header].setForeground(QColor(0, 0, 255));
+    m_formats[MarkdownTokenizer::Header].setFontWeight(QFont::Bold);
+
+    m_formats[MarkdownTokenizer::Bold].setFontWeight(QFont::Bold);
+    m_formats[MarkdownTokenizer::Italic].setFontItalic(true);
+
+    m_formats[MarkdownTokenizer::Code].setForeground(QColor(200, 100, 0));
+    m_formats[MarkdownTokenizer::Code].setFontFamilies({"Courier"});
+    m_formats[MarkdownTokenizer::CodeBlock] = m_formats[MarkdownTokenizer::Code];
+
+    m_formats[MarkdownTokenizer::Link].setForeground(QColor(0, 100, 200));
+    m_formats[MarkdownTokenizer::Link].setFontUnderline(true);
+
+    m_formats[MarkdownTokenizer::WikiLink].setForeground(QColor(0, 150, 0));
+    m_formats[MarkdownTokenizer::WikiLink].setFontUnderline(true);
+    m_formats[MarkdownTokenizer::WikiLink].setFontWeight(QFont::Bold);
+
+    // Markup around the text stays in the background
+    m_formats[MarkdownTokenizer::Fence].setForeground(QColor(128, 128, 128));
+    m_formats[MarkdownTokenizer::FrontMatter].setForeground(QColor(128, 128, 128));
+    m_formats[MarkdownTokenizer::FrontMatter].setFontItalic(true);
+    m_formats[MarkdownTokenizer::ListMarker].setForeground(QColor(0, 0, 255));
+    m_formats[MarkdownTokenizer::ListMarker].setFontWeight(QFont::Bold);
+    m_formats[MarkdownTokenizer::QuoteMarker].setForeground(QColor(128, 128, 128));
+    m_formats[MarkdownTokenizer::QuoteMarker].setFontWeight(QFont::Bold);
+
+    m_blockCount = m_document->blockCount();
+    m_idleTimer.setSingleShot(true);
+    connect(&m_idleTimer, &QTimer::timeout, this, &MarkdownHighlighter::highlightSlice);
+    connect(m_document, &QTextDocument::contentsChange, this, &MarkdownHighlighter::onContentsChange);
+    connect(m_editor->verticalScrollBar(), &QScrollBar::valueChanged, this, &MarkdownHighlighter::highlightViewport);
+    connect(m_editor->verticalScrollBar(), &QScrollBar::rangeChanged, this, &MarkdownHighlighter::highlightViewport);
+    m_idleTimer.start();
+}
+
+void MarkdownHighlighter::rehighlight()
+{
+    m_frontier = 0;
+    highlightVisible(true);
+    m_idleTimer.start();
+}
+
+void MarkdownHighlighter::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    if (m_highlighting) {
+        return;
+    }
+
+    // Changed blocks, in new numbers; those after them moved by delta
+    const int blockCount = m_document->blockCount();
+    const int delta = blockCount - m_blockCount;
+    m_blockCount = blockCount;
+    QTextBlock block = m_document->findBlock(position);
+    if (!block.isValid()) {
+        block = m_document->lastBlock();
+    }
+    const QTextBlock lastChanged = m_document->findBlock(position + charsAdded);
+    const int first = block.blockNumber();
+    const int last = qMax(first, lastChanged.isValid() ? lastChanged.blockNumber() : blockCount - 1);
+
+    // Blocks after the change that were final stay so if the state
+    // entering them comes out the same
+    const int finalEnd = m_frontier > last - delta ? m_frontier + delta : qMin(m_frontier, first);
+    const bool fromFinal = m_frontier >= first;
+    if (fromFinal) {
+        m_frontier = first;
+    }
+
+    // The layout is not updated yet, so the viewport cannot be asked;
+    // a window of blocks from the change covers it when typing, and the
+    // top of a note that was just loaded
+    const int limit = first + windowBlocks();
+    m_highlighting = true;
+    for (int n = first; block.isValid() && n < limit; block = block.next(), ++n) {
+        const int oldState = block.userState();
+        highlightBlock(block);
+        if (fromFinal) {
+            m_frontier = n + 1;
+        }
+        if (n >= last) {
+            if (n + 1 < finalEnd && block.userState() == oldState) {
+                m_frontier = finalEnd;
+                break;
+            }
+            if (n + 1 >= finalEnd) {
+                break;  // The rest is left to the idle slices anyway
+            }
+        }
+    }
+    m_highlighting = false;
+
+    if (m_frontier < blockCount && !m_idleTimer.isActive()) {
+        m_idleTimer.start();
+    }
+}
+
+void MarkdownHighlighter::highlightViewport()
 {
-    HighlightingRule rule;
-
-    // Header format
-    headerFormat.setForeground(QColor(0, 0, 255));
-    headerFormat.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("^#{1,6}\\s.*");
-    rule.format = headerFormat;
-    highlightingRules.append(rule);
-
-    // Bold format
-    boldFormat.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("\\*\\*([^*]+)\\*\\*");
-    rule.format = boldFormat;
-    highlightingRules.append(rule);
-
-    // Italic format
-    italicFormat.setFontItalic(true);
-    rule.pattern = QRegularExpression("\\*([^*]+)\\*");
-    rule.format = italicFormat;
-    highlightingRules.append(rule);
-
-    // Code format
-    codeFormat.setForeground(QColor(200, 100, 0));
-    codeFormat.setFontFamilies({"Courier"});
-    rule.pattern = QRegularExpression("`([^`]+)`");
-    rule.format = codeFormat;
-    highlightingRules.append(rule);
-
-    // Link format
-    linkFormat.setForeground(QColor(0, 100, 200));
-    linkFormat.setFontUnderline(true);
-    rule.pattern = QRegularExpression("\\[([^]]+)\\]\\(([^)]+)\\)");
-    rule.format = linkFormat;
-    highlightingRules.append(rule);
-
-    // Wiki link format
-    wikiLinkFormat.setForeground(QColor(0, 150, 0));
-    wikiLinkFormat.setFontUnderline(true);
-    wikiLinkFormat.setFontWeight(QFont::Bold);
-    rule.pattern = QRegularExpression("\\[\\[([^\\]]+)\\]\\]");
-    rule.format = wikiLinkFormat;
-    highlightingRules.append(rule);
+    highlightVisible(false);
 }
 
-void MarkdownHighlighter::highlightBlock(const QString &text)
+// Blocks on screen past the frontier, from the state of the block before
+// them; force redoes those highlighted before
+void MarkdownHighlighter::highlightVisible(bool force)
 {
-    foreach (const HighlightingRule &rule, highlightingRules) {
-        QRegularExpressionMatchIterator matchIterator = rule.pattern.globalMatch(text);
-        while (matchIterator.hasNext()) {
-            QRegularExpressionMatch match = matchIterator.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
+    if (m_highlighting) {
+        return;     // Formats changing the layout scrolled the view
+    }
+    m_highlighting = true;
+    const QRect rect = m_editor->viewport()->rect();
+    QTextBlock block = m_editor->cursorForPosition(rect.topLeft()).block();
+    const int last = m_editor->cursorForPosition(rect.bottomRight()).block().blockNumber();
+    for (; block.isValid() && block.blockNumber() <= last; block = block.next()) {
+        if (block.blockNumber() >= m_frontier && (force || block.userState() == -1)) {
+            highlightBlock(block);
         }
     }
+    m_highlighting = false;
+}
+
+// Moves the frontier for a few milliseconds, then lets the event loop
+// handle input before the next slice
+void MarkdownHighlighter::highlightSlice()
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_highlighting = true;
+    QTextBlock block = m_document->findBlockByNumber(m_frontier);
+    while (block.isValid() && !timer.hasExpired(HighlightSliceMs)) {
+        highlightBlock(block);
+        ++m_frontier;
+        block = block.next();
+    }
+    m_highlighting = false;
+    if (block.isValid()) {
+        m_idleTimer.start();
+    }
 }
 
+void MarkdownHighlighter::highlightBlock(QTextBlock block)
+{
+    // Before the first block the tokenizer expects -1, after a block not
+    // highlighted yet the start of a plain paragraph
+    const QTextBlock previous = block.previous();
+    const int state = previous.isValid() ? qMax(0, previous.userState()) : -1;
+    block.setUserState(m_tokenizer.tokenize(block.text(), state));
+
+    m_ranges.clear();
+    for (const MarkdownTokenizer::Token &token : m_tokenizer.tokens()) {
+        QTextLayout::FormatRange range;
+        range.start = token.start;
+        range.length = token.length;
+        range.format = m_formats[token.style];
+        m_ranges.append(range);
+    }
+    QTextLayout *layout = block.layout();
+    if (layout->formats() != m_ranges) {
+        layout->setFormats(m_ranges);
+        m_document->markContentsDirty(block.position(), block.length());
+    }
+}
+
+// Blocks that fit on screen, with some to spare
+int MarkdownHighlighter::windowBlocks() const
+{
+    return m_editor->viewport()->height() / qMax(1, m_editor->fontMetrics().lineSpacing()) + 32;
+}
\ No newline at end of file
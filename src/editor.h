@@ -1,6 +1,7 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include "markdowntokenizer.h"
 #include <QWidget>
 #include <QTextEdit>
 #include <QVBoxLayout>
@@ -8,13 +9,15 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QSplitter>
-#include <QSyntaxHighlighter>
+#include <QTextBlock>
 #include <QTextCharFormat>
-#include <QRegularExpression>
+#include <QTextLayout>
+#include <QTimer>
 #include <QMenu>
 
 class MarkdownHighlighter;
 class LinkParser;
+class MarkdownPreview;
 
 class Editor : public QWidget
 {
@@ -34,6 +37,7 @@ public:
 
 signals:
     void linkClicked(const QString &linkTarget);
+    void currentFileChanged(const QString &filePath);
 
 private slots:
     void onTextChanged();
@@ -49,7 +53,6 @@ protected:
 private:
     void setupUI();
     void setupEditorContextMenu();
-    void updatePreview();
     void setCurrentFile(const QString &filePath);
     QString getLinkAtPosition(const QPoint &pos);
     void openFileManagerAndSelect(const QString &filePath);
@@ -58,6 +61,7 @@ private:
     QSplitter *m_splitter;
     QTextEdit *m_textEdit;
     QTextEdit *m_previewEdit;
+    MarkdownPreview *m_preview;
     QPushButton *m_previewButton;
     QLabel *m_fileLabel;
 
@@ -72,31 +76,45 @@ private:
     QMenu *m_editorContextMenu;
 };
 
-// Simple markdown syntax highlighter
-class MarkdownHighlighter : public QSyntaxHighlighter
+// Markdown syntax highlighting, one MarkdownTokenizer pass per block;
+// the block state carries code fences, front matter and lists to the next.
+//
+// QSyntaxHighlighter highlights the whole document whenever it is set or
+// reset, which stalls on multi-megabyte notes. Here only the edited blocks
+// and the ones on screen are highlighted right away; the rest follows in
+// short slices from the event loop. Blocks before the frontier are
+// highlighted from their final state; later ones may have been highlighted
+// from the state of a block before them that was not final yet, and are
+// redone when the frontier passes them.
+class MarkdownHighlighter : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit MarkdownHighlighter(QTextDocument *parent = nullptr);
+    explicit MarkdownHighlighter(QTextEdit *editor);
 
-protected:
-    void highlightBlock(const QString &text) override;
+    // Highlight everything again: what is on screen now, the rest when idle
+    void rehighlight();
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void highlightViewport();
+    void highlightSlice();
 
 private:
-    struct HighlightingRule
-    {
-        QRegularExpression pattern;
-        QTextCharFormat format;
-    };
-    QVector<HighlightingRule> highlightingRules;
-
-    QTextCharFormat headerFormat;
-    QTextCharFormat boldFormat;
-    QTextCharFormat italicFormat;
-    QTextCharFormat codeFormat;
-    QTextCharFormat linkFormat;
-    QTextCharFormat wikiLinkFormat;
+    void highlightVisible(bool force);
+    void highlightBlock(QTextBlock block);
+    int windowBlocks() const;
+
+    QTextEdit *m_editor;
+    QTextDocument *m_document;
+    MarkdownTokenizer m_tokenizer;
+    QTextCharFormat m_formats[MarkdownTokenizer::StyleCount];
+    QVector<QTextLayout::FormatRange> m_ranges;     // Reused from block to block
+    int m_frontier = 0;         // Blocks before it are highlighted in order
+    int m_blockCount = 1;
+    bool m_highlighting = false;
+    QTimer m_idleTimer;
 };
 
 #endif // EDITOR_H
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "filesearcher.h"
+#include "indexpipeline.h"
+#include "vaultwalker.h"
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+std::atomic<bool> &crossCheckFlag()
+{
+    static std::atomic<bool> flag(qEnvironmentVariableIsSet("FORMICA_SEARCH_CROSSCHECK"));
+    return flag;
+}
+
+// Compares the byte scanner's hits with the QTextStream reference
+void crossCheckHits(const QString &filePath, const QString &searchText,
+                    const char *data, qsizetype size, const QVector<TextScanner::Hit> &hits)
+{
+    const QByteArray needle = searchText.toUtf8();
+    if (!TextScanner::hasNonAscii(data, size) && !TextScanner::hasNonAscii(needle.constData(), needle.size())) {
+        return; // Both paths fold plain ASCII the same way
+    }
+
+    auto expected = FileSearcher::searchDecoded(filePath, searchText);
+    bool same = expected.size() == hits.size();
+    for (qsizetype i = 0; same && i < hits.size(); ++i) {
+        same = expected[i].lineNumber == hits[i].lineNumber
+            && expected[i].lineText == QString::fromUtf8(data + hits[i].start, hits[i].length).trimmed();
+    }
+
+    if (!same) {
+        qWarning() << "Search cross-check mismatch for" << searchText << "in" << filePath
+                   << ":" << hits.size() << "hits, expected" << expected.size();
+    }
+}
+
+} // namespace
+
+QList<SearchResult> FileSearcher::searchInFiles(const QString &directory, const QString &searchText)
+{
+    SearchIndex index(directory);
+    index.load();
+    if (index.update()) {
+        index.save();
+    }
+
+    return searchIndex(index, searchText);
+}
+
+QList<SearchResult> FileSearcher::searchIndex(const SearchIndex &index, const QString &searchText)
+{
+    QList<SearchResult> allResults;
+
+    QVector<SearchIndex::Posting> lines;
+    if (!index.candidateLines(searchText, &lines)) {
+        // No whole terms to look up, the trigrams may still narrow the notes
+        QVector<quint32> notes;
+        if (!index.candidateNotes(searchText, &notes)) {
+            return scanFiles(index.vaultPath(), searchText);
+        }
+        for (quint32 noteId : notes) {
+            allResults.append(searchInSingleFile(index.notePath(noteId), searchText));
+        }
+        return allResults;
+    }
+
+    // Candidates are grouped by note, verify each note's lines in one pass
+    qsizetype first = 0;
+    while (first < lines.size()) {
+        qsizetype last = first;
+        while (last < lines.size() && lines[last].noteId == lines[first].noteId) {
+            ++last;
+        }
+
+        QString filePath = index.notePath(lines[first].noteId);
+        QStringList lineTexts;
+        auto hits = matchInLines(filePath, searchText, lines.mid(first, last - first), &lineTexts);
+        allResults.append(makeResults(filePath, hits, lineTexts));
+        first = last;
+    }
+
+    return allResults;
+}
+
+QList<SearchResult> FileSearcher::searchRanked(const SearchIndex &index, const QString &searchText,
+                                                       int limit)
+{
+    QList<SearchResult> allResults;
+
+    const auto ranked = index.rank(searchText, limit);
+    for (const auto &note : ranked) {
+        QString filePath = index.notePath(note.noteId);
+        QStringList lineTexts;
+        auto hits = linesAt(filePath, note.lines, &lineTexts);
+        allResults.append(makeResults(filePath, hits, lineTexts));
+    }
+
+    return allResults;
+}
+
+QList<SearchResult> FileSearcher::searchQuery(const SearchIndex &index, const SearchQuery &query)
+{
+    QList<SearchResult> allResults;
+
+    const auto matches = query.execute(index);
+    for (const auto &match : matches) {
+        QString filePath = index.notePath(match.noteId);
+        QStringList lineTexts;
+        auto hits = linesAt(filePath, match.lines, &lineTexts);
+        allResults.append(makeResults(filePath, hits, lineTexts));
+    }
+
+    return allResults;
+}
+
+QList<SearchResult> FileSearcher::searchRegex(const SearchIndex &index, const QRegularExpression &regex)
+{
+    QList<SearchResult> allResults;
+
+    QStringList paths;
+    QVector<quint32> notes;
+    if (index.candidateNotes(regex, &notes)) {
+        for (quint32 noteId : notes) {
+            paths.append(index.notePath(noteId));
+        }
+    } else {
+        paths = index.notePaths();
+    }
+
+    for (const QString &filePath : paths) {
+        QStringList lineTexts;
+        auto hits = matchRegexInSingleFile(filePath, regex, &lineTexts);
+        allResults.append(makeResults(filePath, hits, lineTexts));
+    }
+
+    return allResults;
+}
+
+QList<SearchResult> FileSearcher::scanFiles(const QString &directory, const QString &searchText)
+{
+    QList<SearchResult> allResults;
+
+    QDir root(directory);
+    VaultWalker walker(directory, VaultWalker::Parallel);
+    const QVector<VaultWalker::Entry> files = walker.walk();
+    QStringList filePaths;
+    filePaths.reserve(files.size());
+    for (const VaultWalker::Entry &file : files) {
+        filePaths.append(root.filePath(file.relPath));
+    }
+
+    // Files are matched on the pipeline's worker threads, in whatever order
+    // they are read; results are kept per file to stay in path order
+    QVector<QList<SearchResult>> fileResults(files.size());
+    QList<SearchResult> *results = fileResults.data();     // No detaching on worker threads
+    IndexPipeline pipeline;
+    pipeline.run(filePaths,
+                 [&](int index, const QByteArray &data, bool ok) {
+                     if (ok && !data.isEmpty()) {
+                         const QString &filePath = filePaths.at(index);
+                         QStringList lineTexts;
+                         auto hits = matchInData(filePath, data.constData(), data.size(), searchText, &lineTexts);
+                         results[index] = makeResults(filePath, hits, lineTexts);
+                     }
+                 },
+                 [](int) {});
+
+    for (const QList<SearchResult> &fileResult : std::as_const(fileResults)) {
+        allResults.append(fileResult);
+    }
+    return allResults;
+}
+
+QList<SearchResult> FileSearcher::searchInSingleFile(const QString &filePath, const QString &searchText)
+{
+    QStringList lineTexts;
+    auto hits = matchInSingleFile(filePath, searchText, &lineTexts);
+    return makeResults(filePath, hits, lineTexts);
+}
+
+QVector<TextScanner::Hit> FileSearcher::matchInSingleFile(const QString &filePath, const QString &searchText,
+                                                          QStringList *lineTexts)
+{
+    QVector<TextScanner::Hit> hits;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return hits;
+    }
+
+    // Map the file; read it only if mapping is not possible
+    QByteArray buffer;
+    uchar *map = file.map(0, file.size());
+    if (!map) {
+        buffer = file.readAll();
+    }
+    const char *data = map ? reinterpret_cast<const char *>(map) : buffer.constData();
+    const qsizetype size = map ? file.size() : buffer.size();
+    hits = matchInData(filePath, data, size, searchText, lineTexts);
+
+    if (map) {
+        file.unmap(map);
+    }
+
+    return hits;
+}
+
+QVector<TextScanner::Hit> FileSearcher::matchInData(const QString &filePath, const char *data, qsizetype size,
+                                                    const QString &searchText, QStringList *lineTexts)
+{
+    QVector<TextScanner::Hit> hits;
+
+    TextScanner scanner(searchText);
+    if (!scanner.scan(data, size, &hits)) {
+        hits.clear();
+        scanner.scanDecoded(data, size, &hits);
+    }
+
+    if (lineTexts) {
+        lineTexts->reserve(hits.size());
+        for (const auto &hit : hits) {
+            lineTexts->append(QString::fromUtf8(data + hit.start, hit.length));
+        }
+    }
+
+    if (crossCheckFlag()) {
+        crossCheckHits(filePath, searchText, data, size, hits);
+    }
+
+    return hits;
+}
+
+QVector<TextScanner::Hit> FileSearcher::matchInLines(const QString &filePath, const QString &searchText,
+                                                     const QVector<SearchIndex::Posting> &lines,
+                                                     QStringList *lineTexts)
+{
+    return readLines(filePath, lines, &searchText, lineTexts);
+}
+
+QVector<TextScanner::Hit> FileSearcher::linesAt(const QString &filePath, const QVector<SearchIndex::Posting> &lines,
+                                                QStringList *lineTexts)
+{
+    return readLines(filePath, lines, nullptr, lineTexts);
+}
+
+QVector<TextScanner::Hit> FileSearcher::matchRegexInSingleFile(const QString &filePath, const QRegularExpression &regex,
+                                                               QStringList *lineTexts)
+{
+    QVector<TextScanner::Hit> hits;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return hits;
+    }
+
+    QByteArray buffer;
+    uchar *map = file.map(0, file.size());
+    if (!map) {
+        buffer = file.readAll();
+    }
+    const char *data = map ? reinterpret_cast<const char *>(map) : buffer.constData();
+    const qsizetype size = map ? file.size() : buffer.size();
+
+    // Skip a UTF-8 byte order mark, like the substring scanner
+    qsizetype start = (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+    int lineNumber = 1;
+    while (start <= size) {
+        const char *newline = static_cast<const char *>(std::memchr(data + start, '\n', size_t(size - start)));
+        qsizetype end = newline ? newline - data : size;
+        qsizetype length = end - start;
+        if (length > 0 && data[end - 1] == '\r') {
+            --length;
+        }
+
+        QString line = QString::fromUtf8(data + start, length);
+        if (regex.match(line).hasMatch()) {
+            hits.append(TextScanner::Hit{lineNumber, start, length});
+            if (lineTexts) {
+                lineTexts->append(line);
+            }
+        }
+
+        if (!newline) {
+            break;
+        }
+        start = end + 1;
+        ++lineNumber;
+    }
+
+    if (map) {
+        file.unmap(map);
+    }
+
+    return hits;
+}
+
+QList<SearchResult> FileSearcher::searchDecoded(const QString &filePath, const QString &searchText)
+{
+    QList<SearchResult> results;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return results;
+    }
+
+    QTextStream in(&file);
+    int lineNumber = 1;
+    QString line;
+
+    while (in.readLineInto(&line)) {
+        if (line.contains(searchText, Qt::CaseInsensitive)) {
+            SearchResult result;
+            result.filePath = filePath;
+            result.lineNumber = lineNumber;
+            result.lineText = line.trimmed();
+            results.append(result);
+        }
+        lineNumber++;
+    }
+
+    return results;
+}
+
+void FileSearcher::setCrossCheck(bool enabled)
+{
+    crossCheckFlag() = enabled;
+}
+
+bool FileSearcher::crossCheck()
+{
+    return crossCheckFlag();
+}
+
+QVector<TextScanner::Hit> FileSearcher::readLines(const QString &filePath, const QVector<SearchIndex::Posting> &lines,
+                                                  const QString *searchText, QStringList *lineTexts)
+{
+    QVector<TextScanner::Hit> hits;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return hits;
+    }
+
+    QByteArray buffer;
+    uchar *map = file.map(0, file.size());
+    if (!map) {
+        buffer = file.readAll();
+    }
+    const char *data = map ? reinterpret_cast<const char *>(map) : buffer.constData();
+    const qsizetype size = map ? file.size() : buffer.size();
+
+    // The index only narrows the candidates, the line itself decides
+    for (const auto &posting : lines) {
+        if (posting.offset >= size) {
+            continue;
+        }
+
+        const char *start = data + posting.offset;
+        const char *newline = static_cast<const char *>(std::memchr(start, '\n', size_t(size - posting.offset)));
+        qsizetype length = newline ? newline - start : size - posting.offset;
+        if (length > 0 && start[length - 1] == '\r') {
+            --length;
+        }
+
+        QString line = QString::fromUtf8(start, length);
+        if (!searchText || line.contains(*searchText, Qt::CaseInsensitive)) {
+            hits.append(TextScanner::Hit{int(posting.line), qsizetype(posting.offset), length});
+            if (lineTexts) {
+                lineTexts->append(line);
+            }
+        }
+    }
+
+    if (map) {
+        file.unmap(map);
+    }
+
+    return hits;
+}
+
+QList<SearchResult> FileSearcher::makeResults(const QString &filePath, const QVector<TextScanner::Hit> &hits,
+                                                      const QStringList &lineTexts)
+{
+    QList<SearchResult> results;
+    results.reserve(hits.size());
+
+    for (qsizetype i = 0; i < hits.size(); ++i) {
+        SearchResult result;
+        result.filePath = filePath;
+        result.lineNumber = hits[i].lineNumber;
+        result.lineText = lineTexts.value(i).trimmed();
+        results.append(result);
+    }
+
+    return results;
+}
\ No newline at end of file
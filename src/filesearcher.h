@@ -0,0 +1,89 @@
+#ifndef FILESEARCHER_H
+#define FILESEARCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QRegularExpression>
+#include "searchindex.h"
+#include "searchquery.h"
+#include "textscanner.h"
+
+struct SearchResult {
+    QString filePath;
+    int lineNumber;
+    QString lineText;
+};
+
+// Matching lines of one file as byte spans; the text is read back on demand.
+// Size and mtime are the file's from before it was searched, so readers can
+// tell when the spans no longer fit it.
+struct SearchHits {
+    QString filePath;
+    qint64 size = -1;
+    qint64 mtime = -1;
+    QVector<TextScanner::Hit> hits;
+};
+
+// File content search over a vault, independent of any UI
+class FileSearcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Refreshes the vault's persistent index and answers from it
+    static QList<SearchResult> searchInFiles(const QString &directory, const QString &searchText);
+    static QList<SearchResult> searchIndex(const SearchIndex &index, const QString &searchText);
+
+    // Notes ordered by relevance (BM25), each with its best matching lines
+    static QList<SearchResult> searchRanked(const SearchIndex &index, const QString &searchText,
+                                                    int limit = RankedLimit);
+
+    // Boolean/phrase/field query, see SearchQuery
+    static QList<SearchResult> searchQuery(const SearchIndex &index, const SearchQuery &query);
+
+    // Regular expression matched line by line against the trigram candidates
+    static QList<SearchResult> searchRegex(const SearchIndex &index, const QRegularExpression &regex);
+
+    // Reads every note, used when the query has no indexable terms
+    static QList<SearchResult> scanFiles(const QString &directory, const QString &searchText);
+
+    // Per-file steps returning byte spans, safe to call from worker threads.
+    // lineTexts, if given, receives the decoded text of every hit.
+    static QVector<TextScanner::Hit> matchInSingleFile(const QString &filePath, const QString &searchText,
+                                                       QStringList *lineTexts = nullptr);
+    // The same over content already in memory; filePath is for diagnostics
+    static QVector<TextScanner::Hit> matchInData(const QString &filePath, const char *data, qsizetype size,
+                                                 const QString &searchText, QStringList *lineTexts = nullptr);
+    static QVector<TextScanner::Hit> matchInLines(const QString &filePath, const QString &searchText,
+                                                  const QVector<SearchIndex::Posting> &lines,
+                                                  QStringList *lineTexts = nullptr);
+
+    // Spans of the given lines, without checking their text
+    static QVector<TextScanner::Hit> linesAt(const QString &filePath, const QVector<SearchIndex::Posting> &lines,
+                                             QStringList *lineTexts = nullptr);
+    static QVector<TextScanner::Hit> matchRegexInSingleFile(const QString &filePath, const QRegularExpression &regex,
+                                                            QStringList *lineTexts = nullptr);
+
+    static QList<SearchResult> searchInSingleFile(const QString &filePath, const QString &searchText);
+
+    // Line-by-line QTextStream reference implementation
+    static QList<SearchResult> searchDecoded(const QString &filePath, const QString &searchText);
+
+    // Re-run non-ASCII scans through searchDecoded() and warn on any
+    // difference. Also enabled by setting FORMICA_SEARCH_CROSSCHECK.
+    static void setCrossCheck(bool enabled);
+    static bool crossCheck();
+
+    static const int RankedLimit = 50;
+
+private:
+    static QVector<TextScanner::Hit> readLines(const QString &filePath, const QVector<SearchIndex::Posting> &lines,
+                                               const QString *searchText, QStringList *lineTexts);
+    static QList<SearchResult> makeResults(const QString &filePath, const QVector<TextScanner::Hit> &hits,
+                                                   const QStringList &lineTexts);
+};
+
+#endif // FILESEARCHER_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "filetree.h"
+#include "vaulttreemodel.h"
 #include <QDir>
 #include <QFileInfo>
 #include <QContextMenuEvent>
@@ -9,35 +10,24 @@
 #include <QMessageBox>
 #include <QInputDialog>
 
-FileTree::FileTree(QWidget *parent)
+FileTree::FileTree(VaultIndex *index, QWidget *parent)
     : QWidget(parent)
 {
-    setupUI();
+    setupUI(index);
     setupContextMenu();
 }
 
-void FileTree::setupUI()
+void FileTree::setupUI(VaultIndex *index)
 {
     auto *layout = new QVBoxLayout(this);
     layout->setContentsMargins(0, 0, 0, 0);
 
     m_treeView = new QTreeView;
-    m_model = new QFileSystemModel;
-
-    // Set up model to show only directories and markdown files
-    m_model->setRootPath(QDir::rootPath());
-    QStringList filters;
-    filters << "*.md" << "*.markdown" << "*.txt";
-    m_model->setNameFilters(filters);
-    m_model->setNameFilterDisables(false);
+    m_model = new VaultTreeModel(index, this);
 
     m_treeView->setModel(m_model);
-
-    // Hide columns we don't need
     m_treeView->setHeaderHidden(true);
-    m_treeView->hideColumn(1); // Size
-    m_treeView->hideColumn(2); // Type
-    m_treeView->hideColumn(3); // Date Modified
+    m_treeView->setUniformRowHeights(true);
 
     // Enable selection
     m_treeView->setSelectionMode(QAbstractItemView::SingleSelection);
@@ -62,34 +52,32 @@ void FileTree::setRootPath(const QString &path)
         dir.mkpath(".");
     }
 
-    QModelIndex rootIndex = m_model->setRootPath(path);
-    m_treeView->setRootIndex(rootIndex);
-    m_treeView->expandAll();
+    // The model follows the vault index, folders load as they are expanded
 }
 
 void FileTree::filterFiles(const QString &filter)
 {
     m_currentFilter = filter;
-    // For now, we'll implement a simple filter
-    // In the future, we can add more sophisticated filtering
-    if (filter.isEmpty()) {
-        QStringList filters;
-        filters << "*.md" << "*.markdown" << "*.txt";
-        m_model->setNameFilters(filters);
-    } else {
-        QStringList filters;
-        filters << QString("*%1*.md").arg(filter)
-                << QString("*%1*.markdown").arg(filter)
-                << QString("*%1*.txt").arg(filter);
-        m_model->setNameFilters(filters);
+    m_model->setFilter(filter);
+
+    // A handful of matches is easier to scan with every folder open
+    if (!filter.isEmpty() && m_model->noteCount() <= ExpandLimit) {
+        m_model->fetchAll();
+        m_treeView->expandAll();
     }
 }
 
-void FileTree::refresh()
+void FileTree::showFile(const QString &filePath)
 {
-    if (!m_rootPath.isEmpty()) {
-        m_model->setRootPath(m_rootPath);
+    const QModelIndex index = m_model->indexOf(filePath);
+    if (!index.isValid()) {
+        return;
+    }
+    for (QModelIndex parent = index.parent(); parent.isValid(); parent = parent.parent()) {
+        m_treeView->expand(parent);
     }
+    m_treeView->setCurrentIndex(index);
+    m_treeView->scrollTo(index);
 }
 
 void FileTree::onItemClicked(const QModelIndex &index)
@@ -197,7 +185,7 @@ void FileTree::deleteFile()
 
     if (reply == QMessageBox::Yes) {
         if (QFile::remove(filePath)) {
-            refresh();
+            emit fileDeleted(filePath);
         } else {
             QMessageBox::warning(this, "Error", "Could not delete the file.");
         }
@@ -222,7 +210,7 @@ void FileTree::renameFile()
         QString newFilePath = fileInfo.dir().filePath(newName + "." + fileInfo.suffix());
 
         if (QFile::rename(filePath, newFilePath)) {
-            refresh();
+            emit fileRenamed(filePath, newFilePath);
         } else {
             QMessageBox::warning(this, "Error", "Could not rename the file.");
         }
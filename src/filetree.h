@@ -3,24 +3,34 @@
 
 #include <QWidget>
 #include <QTreeView>
-#include <QFileSystemModel>
 #include <QVBoxLayout>
 #include <QMenu>
 #include <QAction>
 
+class VaultIndex;
+class VaultTreeModel;
+
+// File browser over the notes of the open vault. The tree comes from the
+// vault index, so it follows file operations and outside changes by itself.
 class FileTree : public QWidget
 {
     Q_OBJECT
 
 public:
-    explicit FileTree(QWidget *parent = nullptr);
+    explicit FileTree(VaultIndex *index, QWidget *parent = nullptr);
 
     void setRootPath(const QString &path);
     void filterFiles(const QString &filter);
-    void refresh();
+    // Expand the folders above filePath and select it
+    void showFile(const QString &filePath);
+
+    // Filters matching at most this many notes are shown fully expanded
+    static const int ExpandLimit = 200;
 
 signals:
     void fileSelected(const QString &filePath);
+    void fileRenamed(const QString &oldPath, const QString &newPath);
+    void fileDeleted(const QString &filePath);
 
 private slots:
     void onItemClicked(const QModelIndex &index);
@@ -30,13 +40,13 @@ private slots:
     void renameFile();
 
 private:
-    void setupUI();
+    void setupUI(VaultIndex *index);
     void setupContextMenu();
     bool isMarkdownFile(const QString &filePath) const;
     QString findFileManager();
 
     QTreeView *m_treeView;
-    QFileSystemModel *m_model;
+    VaultTreeModel *m_model;
     QString m_currentFilter;
     QString m_rootPath;
 
@@ -0,0 +1,79 @@
+#include "filewatcher.h"
+#ifdef Q_OS_LINUX
+#include "inotifywatcher.h"
+#endif
+#include <QDirIterator>
+#include <QFileSystemWatcher>
+#include <QSet>
+
+namespace {
+
+// Portable fallback. QFileSystemWatcher only says that a directory changed,
+// not what in it, so every change asks for a rescan; with the metadata
+// cache that is a stat per note.
+class DirectoryWatcher : public FileWatcher
+{
+public:
+    explicit DirectoryWatcher(QObject *parent)
+        : FileWatcher(parent), m_watcher(new QFileSystemWatcher(this))
+    {
+        connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, [this](const QString &path) {
+            // New subdirectories have to be watched as well
+            addTree(path);
+            emit eventsReady({Event{Event::Overflow, QString()}});
+        });
+    }
+
+    bool watch(const QString &rootPath) override
+    {
+        stop();
+        m_rootPath = rootPath;
+        addTree(rootPath);
+        return !m_watcher->directories().isEmpty();
+    }
+
+    void stop() override
+    {
+        const QStringList directories = m_watcher->directories();
+        if (!directories.isEmpty()) {
+            m_watcher->removePaths(directories);
+        }
+        m_rootPath.clear();
+    }
+
+private:
+    void addTree(const QString &dirPath)
+    {
+        QStringList paths(dirPath);
+        QDirIterator it(dirPath, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            paths.append(it.next());
+        }
+
+        // Paths already watched only produce a warning
+        const QStringList directories = m_watcher->directories();
+        const QSet<QString> watched(directories.cbegin(), directories.cend());
+        paths.removeIf([&watched](const QString &path) { return watched.contains(path); });
+        if (!paths.isEmpty()) {
+            m_watcher->addPaths(paths);
+        }
+    }
+
+    QFileSystemWatcher *m_watcher;
+};
+
+} // namespace
+
+FileWatcher::FileWatcher(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FileWatcher *FileWatcher::create(QObject *parent)
+{
+#ifdef Q_OS_LINUX
+    return new InotifyWatcher(parent);
+#else
+    return new DirectoryWatcher(parent);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+// Change notifications for a directory tree.
+//
+// A backend reports what the platform tells it, in batches and without
+// interpretation; VaultWatcher turns that into index updates. create()
+// picks inotify on Linux and QFileSystemWatcher elsewhere.
+class FileWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Event {
+        enum Kind {
+            Modified,       // Written and closed
+            Created,
+            Removed,
+            MovedFrom,      // Paired with MovedTo by cookie
+            MovedTo,
+            Overflow        // Events were lost, or the backend cannot tell what changed
+        };
+
+        Kind kind;
+        QString path;       // Absolute, empty for Overflow
+        quint32 cookie = 0;
+        bool isDir = false;
+    };
+
+    explicit FileWatcher(QObject *parent = nullptr);
+
+    // Watch rootPath and every directory below it, replacing the previous
+    // root; hidden directories (.git, .formica) are left out
+    virtual bool watch(const QString &rootPath) = 0;
+    virtual void stop() = 0;
+
+    QString rootPath() const { return m_rootPath; }
+    QString errorString() const { return m_errorString; }
+
+    static FileWatcher *create(QObject *parent = nullptr);
+
+signals:
+    void eventsReady(const QVector<FileWatcher::Event> &events);
+
+protected:
+    QString m_rootPath;
+    QString m_errorString;
+};
+
+#endif // FILEWATCHER_H
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "fuzzymatcher.h"
+#include <queue>
+#include <vector>
+
+namespace {
+
+const int ScoreMatch = 16;
+const int BonusSegment = 10;        // First character or right after '/'
+const int BonusBoundary = 8;        // After ' ', '_', '-' or '.'
+const int BonusTransition = 4;      // Digit <-> letter, as in zettel ids like "1a2"
+const int BonusConsecutive = 6;
+const int BonusFileName = 12;       // Whole match within the last path segment
+const int PenaltyGapStart = 3;
+const int PenaltyGapExtension = 1;
+
+int boundaryBonus(const QChar *text, int i)
+{
+    if (i == 0) {
+        return BonusSegment;
+    }
+
+    const QChar prev = text[i - 1];
+    const QChar ch = text[i];
+    if (prev == QLatin1Char('/')) {
+        return BonusSegment;
+    }
+    if (prev == QLatin1Char(' ') || prev == QLatin1Char('_') || prev == QLatin1Char('-')
+        || prev == QLatin1Char('.')) {
+        return BonusBoundary;
+    }
+    if ((prev.isDigit() && ch.isLetter()) || (prev.isLetter() && ch.isDigit())) {
+        return BonusTransition;
+    }
+    return 0;
+}
+
+struct Ranked {
+    int score;
+    int length;
+    quint32 id;
+};
+
+// Higher score first, then shorter text, then lower id
+struct Better {
+    bool operator()(const Ranked &a, const Ranked &b) const
+    {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        if (a.length != b.length) {
+            return a.length < b.length;
+        }
+        return a.id < b.id;
+    }
+};
+
+} // namespace
+
+void FuzzyMatcher::clear()
+{
+    m_entries.clear();
+    m_buffer.clear();
+    m_garbage = 0;
+    m_count = 0;
+}
+
+void FuzzyMatcher::insert(quint32 id, const QString &text)
+{
+    remove(id);
+    if (id >= quint32(m_entries.size())) {
+        m_entries.resize(id + 1);
+    }
+
+    const QString folded = text.toCaseFolded();
+    Entry &entry = m_entries[id];
+    entry.offset = m_buffer.size();
+    entry.length = folded.size();
+    entry.nameStart = folded.lastIndexOf(QLatin1Char('/')) + 1;
+    entry.mask = charMask(folded.constData(), folded.size());
+    m_buffer.append(folded);
+    ++m_count;
+}
+
+void FuzzyMatcher::remove(quint32 id)
+{
+    if (id >= quint32(m_entries.size()) || m_entries[id].length < 0) {
+        return;
+    }
+
+    m_garbage += m_entries[id].length;
+    m_entries[id].length = -1;
+    --m_count;
+
+    if (m_garbage > 4096 && m_garbage > m_buffer.size() / 2) {
+        compact();
+    }
+}
+
+QVector<FuzzyMatcher::Match> FuzzyMatcher::find(const QString &pattern, int limit) const
+{
+    QVector<Match> matches;
+    if (limit <= 0) {
+        return matches;
+    }
+
+    const QString folded = foldPattern(pattern);
+    const QChar *patternData = folded.constData();
+    const int patternLength = folded.size();
+    const quint64 needed = charMask(patternData, patternLength);
+    const QChar *buffer = m_buffer.constData();
+
+    // Bounded heap with the worst kept match on top
+    std::priority_queue<Ranked, std::vector<Ranked>, Better> best;
+    for (qsizetype id = 0; id < m_entries.size(); ++id) {
+        const Entry &entry = m_entries[id];
+        if (entry.length < patternLength || (entry.mask & needed) != needed) {
+            continue;
+        }
+
+        int score = 0;
+        if (patternLength > 0) {
+            score = scoreFolded(patternData, patternLength, buffer + entry.offset,
+                                entry.length, entry.nameStart);
+            if (score < 0) {
+                continue;
+            }
+        }
+
+        const Ranked ranked{score, entry.length, quint32(id)};
+        if (int(best.size()) < limit) {
+            best.push(ranked);
+        } else if (Better()(ranked, best.top())) {
+            best.pop();
+            best.push(ranked);
+        }
+    }
+
+    matches.resize(best.size());
+    for (qsizetype i = matches.size() - 1; i >= 0; --i) {
+        matches[i] = Match{best.top().id, best.top().score};
+        best.pop();
+    }
+    return matches;
+}
+
+int FuzzyMatcher::score(const QString &pattern, const QString &text)
+{
+    const QString foldedPattern = foldPattern(pattern);
+    const QString foldedText = text.toCaseFolded();
+    if (foldedPattern.isEmpty()) {
+        return 0;
+    }
+    return scoreFolded(foldedPattern.constData(), foldedPattern.size(), foldedText.constData(),
+                       foldedText.size(), foldedText.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+QString FuzzyMatcher::foldPattern(const QString &pattern)
+{
+    QString folded;
+    folded.reserve(pattern.size());
+    for (QChar ch : pattern) {
+        if (!ch.isSpace()) {
+            folded.append(ch);
+        }
+    }
+    return folded.toCaseFolded();
+}
+
+quint64 FuzzyMatcher::charMask(const QChar *text, qsizetype length)
+{
+    // One bit per letter and digit, everything else shares the upper bits
+    quint64 mask = 0;
+    for (qsizetype i = 0; i < length; ++i) {
+        const char16_t ch = text[i].unicode();
+        if (ch >= u'a' && ch <= u'z') {
+            mask |= quint64(1) << (ch - u'a');
+        } else if (ch >= u'0' && ch <= u'9') {
+            mask |= quint64(1) << (26 + ch - u'0');
+        } else {
+            mask |= quint64(1) << (36 + ch % 28);
+        }
+    }
+    return mask;
+}
+
+int FuzzyMatcher::scoreFolded(const QChar *pattern, int patternLength,
+                              const QChar *text, int length, int nameStart)
+{
+    // Forward pass: where the earliest complete match ends
+    int end = -1;
+    int j = 0;
+    for (int i = 0; i < length; ++i) {
+        if (text[i] == pattern[j] && ++j == patternLength) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0) {
+        return -1;
+    }
+
+    // Backward pass: the latest start for that end, giving the tightest window
+    int start = end;
+    j = patternLength - 1;
+    for (int i = end; i >= 0; --i) {
+        if (text[i] == pattern[j] && --j < 0) {
+            start = i;
+            break;
+        }
+    }
+
+    int score = 0;
+    bool inRun = false;
+    bool inGap = false;
+    j = 0;
+    for (int i = start; i <= end; ++i) {
+        if (j < patternLength && text[i] == pattern[j]) {
+            int bonus = boundaryBonus(text, i);
+            if (j == 0) {
+                bonus *= 2;
+            }
+            score += ScoreMatch + bonus + (inRun ? BonusConsecutive : 0);
+            inRun = true;
+            inGap = false;
+            ++j;
+        } else {
+            score -= inGap ? PenaltyGapExtension : PenaltyGapStart;
+            inRun = false;
+            inGap = true;
+        }
+    }
+
+    if (start >= nameStart) {
+        score += BonusFileName;
+    }
+    return qMax(score, 0);
+}
+
+void FuzzyMatcher::compact()
+{
+    QString buffer;
+    buffer.reserve(m_buffer.size() - m_garbage);
+    for (Entry &entry : m_entries) {
+        if (entry.length < 0) {
+            continue;
+        }
+        const qsizetype offset = buffer.size();
+        buffer.append(m_buffer.constData() + entry.offset, entry.length);
+        entry.offset = offset;
+    }
+    m_buffer = buffer;
+    m_garbage = 0;
+}
\ No newline at end of file
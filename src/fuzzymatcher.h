@@ -0,0 +1,54 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QString>
+#include <QVector>
+
+// Fuzzy subsequence matcher for quick open.
+//
+// "zkidx" matches "zettelkasten/index" because its characters appear in
+// order. Matches score higher when they start words or path segments, run
+// together, and fall inside the file name. Candidate texts are case-folded
+// into one contiguous buffer with a bitmask of the characters they contain,
+// so most candidates are rejected without looking at their text.
+class FuzzyMatcher
+{
+public:
+    struct Match {
+        quint32 id;
+        int score;
+    };
+
+    void clear();
+    void insert(quint32 id, const QString &text);
+    void remove(quint32 id);
+    int size() const { return m_count; }
+
+    // The limit best matches, best first. An empty pattern matches
+    // everything, shortest texts first.
+    QVector<Match> find(const QString &pattern, int limit) const;
+
+    // Score of a single text, -1 if pattern is not a subsequence of it
+    static int score(const QString &pattern, const QString &text);
+
+private:
+    struct Entry {
+        qsizetype offset = 0;
+        int length = -1;        // -1 if the id is free
+        int nameStart = 0;      // Start of the last path segment
+        quint64 mask = 0;
+    };
+
+    static QString foldPattern(const QString &pattern);
+    static quint64 charMask(const QChar *text, qsizetype length);
+    static int scoreFolded(const QChar *pattern, int patternLength,
+                           const QChar *text, int length, int nameStart);
+    void compact();
+
+    QVector<Entry> m_entries;   // Indexed by id
+    QString m_buffer;           // Folded texts, back to back
+    qsizetype m_garbage = 0;    // Buffer characters of removed texts
+    int m_count = 0;
+};
+
+#endif // FUZZYMATCHER_H
\ No newline at end of file
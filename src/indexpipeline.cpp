@@ -0,0 +1,301 @@
+#include "indexpipeline.h"
+#include "bulkreader.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <chrono>
+#include <memory>
+
+namespace {
+
+qint64 steadyMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Bounded multi-producer queue without locks (Vyukov's ring): each cell
+// carries a sequence number telling producers and consumers whose turn it is
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity)     // A power of two
+        : m_cells(new Cell[capacity]), m_mask(size_t(capacity) - 1)
+    {
+        for (int i = 0; i < capacity; ++i) {
+            m_cells[i].sequence.store(size_t(i), std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(const T &value)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const qptrdiff diff = qptrdiff(sequence) - qptrdiff(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;   // Full
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T *value)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const qptrdiff diff = qptrdiff(sequence) - qptrdiff(pos + 1);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;   // Empty
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        *value = cell->value;
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    const size_t m_mask;
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) std::atomic<size_t> m_head{0};
+};
+
+// Spin briefly, then yield, then sleep; for waits that are usually short
+void backOff(int *round)
+{
+    ++*round;
+    if (*round < 32) {
+        return;
+    }
+    if (*round < 64) {
+        QThread::yieldCurrentThread();
+        return;
+    }
+    QThread::usleep(50);
+}
+
+// Builds on the GUI thread block it anyway; only pause the others
+bool canPause()
+{
+    const QCoreApplication *app = QCoreApplication::instance();
+    return app && QThread::currentThread() != app->thread();
+}
+
+} // namespace
+
+// runInline() relies on the reader reading such lists in order
+static_assert(IndexPipeline::InlineLimit <= BulkReader::InlineLimit, "inline lists must be read in order");
+
+std::atomic<qint64> IndexPipeline::s_resumeAt{0};
+
+IndexPipeline::IndexPipeline(Options options)
+    : m_options(options), m_threadCount(qMax(1, QThread::idealThreadCount() - 1))
+{
+}
+
+void IndexPipeline::run(const QStringList &filePaths, const ParseFn &parse, const MergeFn &merge)
+{
+    m_stats = Stats();
+
+    // Threads cost more than a handful of notes, e.g. a watcher batch
+    if (filePaths.size() <= InlineLimit) {
+        runInline(filePaths, parse, merge);
+        return;
+    }
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    const int count = filePaths.size();
+    const int threadCount = qMin(m_threadCount, count);
+    const bool pausable = canPause();
+
+    BulkReader reader;
+    reader.start(filePaths);
+    BoundedQueue<int> parsed(MergeQueueDepth);
+    std::atomic<int> workersLeft{threadCount};
+    QVector<Stage> workerStats(threadCount);
+    QVector<qint64> workerPaused(threadCount, 0);
+
+    QVector<QThread *> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        workers.append(QThread::create([&, i]() {
+            Stage &stage = workerStats[i];
+            BulkReader::File file;
+            QElapsedTimer timer;
+            for (;;) {
+                timer.start();
+                const bool more = reader.next(&file);
+                stage.waitNs += timer.nsecsElapsed();
+                if (!more) {
+                    break;
+                }
+                if (pausable) {
+                    workerPaused[i] += waitWhilePaused();
+                }
+
+                timer.start();
+                parse(file.index, file.data, file.ok);
+                stage.busyNs += timer.nsecsElapsed();
+                ++stage.items;
+                stage.bytes += file.data.size();
+                reader.recycle(std::move(file.data));
+
+                // A full queue means merging is behind; wait for it
+                timer.start();
+                int round = 0;
+                while (!parsed.tryPush(file.index)) {
+                    backOff(&round);
+                }
+                stage.waitNs += timer.nsecsElapsed();
+            }
+            workersLeft.fetch_sub(1, std::memory_order_release);
+        }));
+        workers.last()->start();
+    }
+
+    // Merge on this thread, which owns the index
+    Stage &mergeStage = m_stats.merge;
+    mergeStage.threads = 1;
+    QVector<bool> ready(m_options & InOrder ? count : 0, false);
+    int nextInOrder = 0;
+    QElapsedTimer timer;
+    while (mergeStage.items < count) {
+        int index;
+        timer.start();
+        int round = 0;
+        bool popped = parsed.tryPop(&index);
+        while (!popped) {
+            // Every file is delivered, this is a safety net
+            if (workersLeft.load(std::memory_order_acquire) == 0) {
+                popped = parsed.tryPop(&index);
+                break;
+            }
+            backOff(&round);
+            popped = parsed.tryPop(&index);
+        }
+        mergeStage.waitNs += timer.nsecsElapsed();
+        if (!popped) {
+            break;
+        }
+        if (pausable) {
+            m_stats.pausedNs += waitWhilePaused();
+        }
+
+        timer.start();
+        if (m_options & InOrder) {
+            ready[index] = true;
+            while (nextInOrder < count && ready[nextInOrder]) {
+                merge(nextInOrder++);
+                ++mergeStage.items;
+            }
+        } else {
+            merge(index);
+            ++mergeStage.items;
+        }
+        mergeStage.busyNs += timer.nsecsElapsed();
+    }
+
+    for (QThread *worker : std::as_const(workers)) {
+        worker->wait();
+        delete worker;
+    }
+
+    Stage &parseStage = m_stats.parse;
+    parseStage.threads = threadCount;
+    for (int i = 0; i < threadCount; ++i) {
+        parseStage.items += workerStats[i].items;
+        parseStage.bytes += workerStats[i].bytes;
+        parseStage.busyNs += workerStats[i].busyNs;
+        parseStage.waitNs += workerStats[i].waitNs;
+        m_stats.pausedNs += workerPaused[i];
+    }
+    m_stats.read.items = parseStage.items;
+    m_stats.read.bytes = parseStage.bytes;
+    m_stats.read.threads = reader.threadCount();
+    m_stats.elapsedNs = elapsed.nsecsElapsed();
+}
+
+void IndexPipeline::pauseFor(int ms)
+{
+    const qint64 resumeAt = steadyMs() + ms;
+    qint64 current = s_resumeAt.load(std::memory_order_relaxed);
+    while (current < resumeAt && !s_resumeAt.compare_exchange_weak(current, resumeAt)) {
+    }
+}
+
+bool IndexPipeline::isPaused()
+{
+    return steadyMs() < s_resumeAt.load(std::memory_order_relaxed);
+}
+
+void IndexPipeline::runInline(const QStringList &filePaths, const ParseFn &parse, const MergeFn &merge)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    BulkReader reader;
+    reader.start(filePaths);
+    BulkReader::File file;
+    QElapsedTimer timer;
+    while (reader.next(&file)) {
+        timer.start();
+        parse(file.index, file.data, file.ok);
+        m_stats.parse.busyNs += timer.nsecsElapsed();
+        ++m_stats.parse.items;
+        m_stats.parse.bytes += file.data.size();
+
+        timer.start();
+        merge(file.index);      // The reader keeps list order when inline
+        m_stats.merge.busyNs += timer.nsecsElapsed();
+        ++m_stats.merge.items;
+        reader.recycle(std::move(file.data));
+    }
+
+    m_stats.read.items = m_stats.parse.items;
+    m_stats.read.bytes = m_stats.parse.bytes;
+    m_stats.parse.threads = m_stats.merge.threads = filePaths.isEmpty() ? 0 : 1;
+    m_stats.elapsedNs = elapsed.nsecsElapsed();
+}
+
+qint64 IndexPipeline::waitWhilePaused()
+{
+    qint64 remaining = s_resumeAt.load(std::memory_order_relaxed) - steadyMs();
+    if (remaining <= 0) {
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (remaining > 0) {
+        QThread::msleep(qMin<qint64>(remaining, 20));
+        remaining = s_resumeAt.load(std::memory_order_relaxed) - steadyMs();
+    }
+    return timer.nsecsElapsed();
+}
\ No newline at end of file
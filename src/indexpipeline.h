@@ -0,0 +1,86 @@
+#ifndef INDEXPIPELINE_H
+#define INDEXPIPELINE_H
+
+#include <QByteArray>
+#include <QFlags>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+
+// Runs an index build as stages on their own threads:
+//
+//   read (BulkReader) -> parse (one thread per spare core) -> merge (caller)
+//
+// Parse workers take files from the reader's bounded queue and hand the
+// index of each parsed file to the merge stage through a bounded lock-free
+// queue; only the calling thread merges, so the index itself needs no
+// locking. The parse function writes its result to a slot of the caller's
+// that the merge function then picks up by index. Full queues block the
+// stage before them, so no stage runs far ahead.
+//
+// Discovery (the vault walk and the comparison with the stored index) runs
+// before the pipeline, since note ids are handed out in path order; callers
+// that time it fill in Stats::discover themselves.
+class IndexPipeline
+{
+public:
+    enum Option {
+        NoOptions = 0x0,
+        InOrder = 0x1           // Merge in list order, e.g. to keep ids stable
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    struct Stage {
+        qint64 items = 0;
+        qint64 bytes = 0;
+        qint64 busyNs = 0;      // Summed over the stage's threads
+        qint64 waitNs = 0;      // Waiting on the stage before or after
+        int threads = 0;
+    };
+
+    struct Stats {
+        Stage discover;
+        Stage read;             // Reads are timed by their consumers, no busyNs
+        Stage parse;
+        Stage merge;
+        qint64 pausedNs = 0;    // Summed over threads, see pauseFor()
+        qint64 elapsedNs = 0;   // Of run()
+    };
+
+    // Called on a parse thread with the content of filePaths[index]; ok is
+    // false if the file could not be read
+    using ParseFn = std::function<void(int index, const QByteArray &data, bool ok)>;
+    // Called on the calling thread once filePaths[index] was parsed
+    using MergeFn = std::function<void(int index)>;
+
+    explicit IndexPipeline(Options options = NoOptions);
+
+    // Parse threads; by default one per core but the merging one
+    void setThreadCount(int count) { m_threadCount = qMax(1, count); }
+
+    void run(const QStringList &filePaths, const ParseFn &parse, const MergeFn &merge);
+
+    const Stats &stats() const { return m_stats; }
+
+    // Hold builds running off the GUI thread for ms, e.g. while the user
+    // types; calls extend the pause
+    static void pauseFor(int ms);
+    static bool isPaused();
+
+    static const int MergeQueueDepth = 256;
+    static const int InlineLimit = 4;   // Lists this short run on the caller
+
+private:
+    void runInline(const QStringList &filePaths, const ParseFn &parse, const MergeFn &merge);
+    static qint64 waitWhilePaused();
+
+    Options m_options;
+    int m_threadCount;
+    Stats m_stats;
+
+    static std::atomic<qint64> s_resumeAt;  // Steady clock, milliseconds
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(IndexPipeline::Options)
+
+#endif // INDEXPIPELINE_H
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "inotifywatcher.h"
+#include <QDirIterator>
+#include <QFile>
+#include <QSocketNotifier>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// Written-and-closed instead of every write(), so a file is reported once
+const quint32 WatchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                          | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+const size_t ReadBufferSize = 64 * 1024;
+
+QString systemError(int error)
+{
+    return QString::fromLocal8Bit(std::strerror(error));
+}
+
+} // namespace
+
+InotifyWatcher::InotifyWatcher(QObject *parent)
+    : FileWatcher(parent)
+{
+}
+
+InotifyWatcher::~InotifyWatcher()
+{
+    stop();
+}
+
+bool InotifyWatcher::watch(const QString &rootPath)
+{
+    stop();
+    m_errorString.clear();
+
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        m_errorString = systemError(errno);
+        return false;
+    }
+
+    m_rootPath = rootPath;
+    m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &InotifyWatcher::readEvents);
+
+    // A tree larger than the watch limit is still watched as far as it goes
+    addTree(rootPath);
+    if (!m_watches.contains(rootPath)) {
+        const QString error = m_errorString;
+        stop();
+        m_errorString = error;
+        return false;
+    }
+    return true;
+}
+
+void InotifyWatcher::stop()
+{
+    delete m_notifier;
+    m_notifier = nullptr;
+    if (m_fd >= 0) {
+        ::close(m_fd);     // Drops every watch with it
+        m_fd = -1;
+    }
+    m_dirs.clear();
+    m_watches.clear();
+    m_rootPath.clear();
+}
+
+void InotifyWatcher::readEvents()
+{
+    alignas(inotify_event) char buffer[ReadBufferSize];
+    QVector<Event> events;
+    QHash<quint32, QString> movedDirs;      // Cookie -> old path, until the other half shows
+
+    for (;;) {
+        const ssize_t length = ::read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;      // EAGAIN once the queue is drained
+        }
+
+        for (const char *pos = buffer; pos < buffer + length;) {
+            const auto *event = reinterpret_cast<const inotify_event *>(pos);
+            pos += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                events.append(Event{Event::Overflow, QString()});
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                // The kernel dropped the watch, the directory is gone
+                m_watches.remove(m_dirs.take(event->wd));
+                continue;
+            }
+
+            const QString dir = m_dirs.value(event->wd);
+            if (dir.isEmpty()) {
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // Parents report their children; only the root needs a word
+                if (dir == m_rootPath) {
+                    events.append(Event{Event::Overflow, QString()});
+                }
+                continue;
+            }
+
+            const bool isDir = event->mask & IN_ISDIR;
+            if (event->len == 0 || (isDir && event->name[0] == '.')) {
+                continue;   // Hidden directories are not watched
+            }
+
+            const QString path = dir + QLatin1Char('/') + QFile::decodeName(event->name);
+            Event change{Event::Modified, path, event->cookie, isDir};
+            if (event->mask & IN_CLOSE_WRITE) {
+                change.kind = Event::Modified;
+            } else if (event->mask & IN_CREATE) {
+                change.kind = Event::Created;
+                if (isDir) {
+                    addTree(path);
+                }
+            } else if (event->mask & IN_DELETE) {
+                change.kind = Event::Removed;
+                if (isDir) {
+                    removeTree(path);
+                }
+            } else if (event->mask & IN_MOVED_FROM) {
+                change.kind = Event::MovedFrom;
+                if (isDir) {
+                    movedDirs.insert(event->cookie, path);
+                }
+            } else if (event->mask & IN_MOVED_TO) {
+                change.kind = Event::MovedTo;
+                if (isDir) {
+                    const QString from = movedDirs.take(event->cookie);
+                    if (from.isEmpty()) {
+                        addTree(path);
+                    } else {
+                        moveTree(from, path);
+                    }
+                }
+            } else {
+                continue;
+            }
+            events.append(change);
+        }
+    }
+
+    // Directories moved out of the tree
+    for (const QString &path : std::as_const(movedDirs)) {
+        removeTree(path);
+    }
+
+    if (!events.isEmpty()) {
+        emit eventsReady(events);
+    }
+}
+
+bool InotifyWatcher::addTree(const QString &dirPath)
+{
+    // The parent is watched before its children are listed, so a directory
+    // created in between still shows up as an event
+    bool ok = addDirectory(dirPath);
+    QDirIterator it(dirPath, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        ok = addDirectory(it.next()) && ok;
+    }
+    return ok;
+}
+
+bool InotifyWatcher::addDirectory(const QString &dirPath)
+{
+    if (m_watches.contains(dirPath)) {
+        return true;
+    }
+
+    const int wd = inotify_add_watch(m_fd, QFile::encodeName(dirPath).constData(), WatchMask);
+    if (wd < 0) {
+        m_errorString = errno == ENOSPC
+            ? QString("inotify watch limit reached, raise fs.inotify.max_user_watches")
+            : systemError(errno);
+        return false;
+    }
+
+    // A directory reached under two names (bind mounts) keeps one descriptor
+    m_watches.remove(m_dirs.value(wd));
+    m_dirs.insert(wd, dirPath);
+    m_watches.insert(dirPath, wd);
+    return true;
+}
+
+void InotifyWatcher::removeTree(const QString &dirPath)
+{
+    const QString prefix = dirPath + QLatin1Char('/');
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (it.key() == dirPath || it.key().startsWith(prefix)) {
+            inotify_rm_watch(m_fd, it.value());
+            m_dirs.remove(it.value());
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void InotifyWatcher::moveTree(const QString &oldPath, const QString &newPath)
+{
+    // The watches move along with the directory, only the names change
+    const QString prefix = oldPath + QLatin1Char('/');
+    QHash<QString, int> moved;
+    for (auto it = m_watches.begin(); it != m_watches.end();) {
+        if (it.key() == oldPath || it.key().startsWith(prefix)) {
+            moved.insert(newPath + it.key().mid(oldPath.size()), it.value());
+            it = m_watches.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = moved.cbegin(); it != moved.cend(); ++it) {
+        m_watches.insert(it.key(), it.value());
+        m_dirs.insert(it.value(), it.key());
+    }
+}
\ No newline at end of file
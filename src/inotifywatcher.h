@@ -0,0 +1,41 @@
+#ifndef INOTIFYWATCHER_H
+#define INOTIFYWATCHER_H
+
+#include "filewatcher.h"
+#include <QHash>
+
+class QSocketNotifier;
+
+// Linux backend. inotify is not recursive, so every directory of the tree
+// gets a watch of its own; directories created, moved or removed later are
+// followed as their events come in. The kernel queue is drained whenever
+// the descriptor becomes readable, one batch per wakeup.
+class InotifyWatcher : public FileWatcher
+{
+    Q_OBJECT
+
+public:
+    explicit InotifyWatcher(QObject *parent = nullptr);
+    ~InotifyWatcher() override;
+
+    bool watch(const QString &rootPath) override;
+    void stop() override;
+
+    int watchCount() const { return m_watches.size(); }
+
+private slots:
+    void readEvents();
+
+private:
+    bool addTree(const QString &dirPath);
+    bool addDirectory(const QString &dirPath);
+    void removeTree(const QString &dirPath);
+    void moveTree(const QString &oldPath, const QString &newPath);
+
+    int m_fd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QHash<int, QString> m_dirs;         // Watch descriptor -> directory
+    QHash<QString, int> m_watches;      // Directory -> watch descriptor
+};
+
+#endif // INOTIFYWATCHER_H
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "linkgraph.h"
+#include "vaultindex.h"
+#include <QMutexLocker>
+#include <QMetaObject>
+#include <QThreadPool>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Overlay size at which it is folded into the compressed arrays
+const int CompactThreshold = 512;
+
+void sortUnique(QVector<quint32> *notes)
+{
+    std::sort(notes->begin(), notes->end());
+    notes->erase(std::unique(notes->begin(), notes->end()), notes->end());
+}
+
+} // namespace
+
+// Workers deliver here; cleared when the graph goes away first
+struct LinkGraph::Receiver {
+    QMutex lock;
+    LinkGraph *graph = nullptr;
+
+    void deliver(const QSharedPointer<const Base> &base, quint64 serial,
+                 const QHash<quint32, quint64> &merged)
+    {
+        QMutexLocker locker(&lock);
+        if (!graph) {
+            return;
+        }
+        LinkGraph *target = graph;
+        QMetaObject::invokeMethod(target, [target, base, serial, merged]() {
+            target->adoptBase(base, serial, merged);
+        }, Qt::QueuedConnection);
+    }
+};
+
+QSharedPointer<const LinkGraph::Base> LinkGraph::Base::build(const QVector<QStringList> &noteKeys)
+{
+    QSharedPointer<Base> base(new Base);
+    QVector<quint32> degree;
+
+    base->forwardOffsets.reserve(noteKeys.size() + 1);
+    base->forwardOffsets.append(0);
+    for (const QStringList &keys : noteKeys) {
+        for (const QString &key : keys) {
+            auto found = base->keyIds.constFind(key);
+            quint32 keyId;
+            if (found != base->keyIds.constEnd()) {
+                keyId = *found;
+            } else {
+                keyId = base->keys.size();
+                base->keys.append(key);
+                base->keyIds.insert(key, keyId);
+                degree.append(0);
+            }
+            base->forwardKeys.append(keyId);
+            ++degree[keyId];
+        }
+        base->forwardOffsets.append(base->forwardKeys.size());
+    }
+
+    // Counting sort by key; notes come out in id order within each key
+    base->reverseOffsets.resize(degree.size() + 1);
+    base->reverseOffsets[0] = 0;
+    for (qsizetype keyId = 0; keyId < degree.size(); ++keyId) {
+        base->reverseOffsets[keyId + 1] = base->reverseOffsets[keyId] + degree[keyId];
+    }
+
+    QVector<quint32> cursor = base->reverseOffsets;
+    base->reverseNotes.resize(base->forwardKeys.size());
+    for (qsizetype noteId = 0; noteId < noteKeys.size(); ++noteId) {
+        for (quint32 i = base->forwardOffsets[noteId]; i < base->forwardOffsets[noteId + 1]; ++i) {
+            base->reverseNotes[cursor[base->forwardKeys[i]]++] = quint32(noteId);
+        }
+    }
+
+    return base;
+}
+
+QStringList LinkGraph::Base::keysOf(quint32 noteId) const
+{
+    QStringList result;
+    if (noteId + 1 >= quint32(forwardOffsets.size())) {
+        return result;
+    }
+    for (quint32 i = forwardOffsets[noteId]; i < forwardOffsets[noteId + 1]; ++i) {
+        result.append(keys[forwardKeys[i]]);
+    }
+    return result;
+}
+
+LinkGraph::LinkGraph(VaultIndex *index, QObject *parent)
+    : QObject(parent), m_index(index), m_base(Base::build({})), m_receiver(new Receiver)
+{
+    m_receiver->graph = this;
+
+    connect(m_index, &VaultIndex::reset, this, &LinkGraph::rebuild);
+    connect(m_index, &VaultIndex::noteAdded, this, &LinkGraph::onNoteChanged);
+    connect(m_index, &VaultIndex::noteChanged, this, &LinkGraph::onNoteChanged);
+    connect(m_index, &VaultIndex::noteRemoved, this, &LinkGraph::onNoteRemoved);
+    // Links are stored by text, a rename only changes what they resolve to
+    connect(m_index, &VaultIndex::noteRenamed, this, &LinkGraph::changed);
+}
+
+LinkGraph::~LinkGraph()
+{
+    QMutexLocker locker(&m_receiver->lock);
+    m_receiver->graph = nullptr;
+}
+
+void LinkGraph::rebuild()
+{
+    ++m_serial;
+    m_overlay.clear();
+    m_overlayReverse.clear();
+    m_base = Base::build({});
+    m_ready = false;
+    m_building = true;
+
+    // The lists are shared with the index, copying them is cheap
+    const QVector<QStringList> keys = noteKeys();
+    const quint64 serial = m_serial;
+    QSharedPointer<Receiver> receiver = m_receiver;
+    QThreadPool::globalInstance()->start([keys, serial, receiver]() {
+        receiver->deliver(Base::build(keys), serial, {});
+    });
+}
+
+void LinkGraph::rebuildNow()
+{
+    ++m_serial;
+    m_overlay.clear();
+    m_overlayReverse.clear();
+    m_base = Base::build(noteKeys());
+    m_building = false;
+    m_ready = true;
+    emit changed();
+}
+
+QVector<quint32> LinkGraph::backlinks(quint32 noteId) const
+{
+    QVector<quint32> result;
+    const QStringList keys = m_index->linkKeys(noteId);
+    for (const QString &key : keys) {
+        // "[[Intro]]" may be answered by another note called Intro first
+        if (m_index->resolveLink(key) != int(noteId)) {
+            continue;
+        }
+
+        auto found = m_base->keyIds.constFind(key);
+        if (found != m_base->keyIds.constEnd()) {
+            for (quint32 i = m_base->reverseOffsets[*found]; i < m_base->reverseOffsets[*found + 1]; ++i) {
+                const quint32 source = m_base->reverseNotes[i];
+                if (!m_overlay.contains(source)) {
+                    result.append(source);
+                }
+            }
+        }
+        result.append(m_overlayReverse.value(key));
+    }
+
+    sortUnique(&result);
+    result.removeOne(noteId);
+    return result;
+}
+
+QVector<quint32> LinkGraph::outgoingLinks(quint32 noteId) const
+{
+    QVector<quint32> result;
+    const QStringList keys = keysOf(noteId);
+    for (const QString &key : keys) {
+        int target = m_index->resolveLink(key);
+        if (target >= 0 && quint32(target) != noteId) {
+            result.append(target);
+        }
+    }
+    sortUnique(&result);
+    return result;
+}
+
+QStringList LinkGraph::unresolvedLinks(quint32 noteId) const
+{
+    QStringList result;
+    const QStringList keys = keysOf(noteId);
+    for (const QString &key : keys) {
+        if (m_index->resolveLink(key) < 0) {
+            result.append(key);
+        }
+    }
+    return result;
+}
+
+QHash<QString, int> LinkGraph::unresolvedTargets() const
+{
+    QHash<QString, int> result;
+    for (qsizetype keyId = 0; keyId < m_base->keys.size(); ++keyId) {
+        int sources = 0;
+        for (quint32 i = m_base->reverseOffsets[keyId]; i < m_base->reverseOffsets[keyId + 1]; ++i) {
+            if (!m_overlay.contains(m_base->reverseNotes[i])) {
+                ++sources;
+            }
+        }
+        if (sources > 0) {
+            result.insert(m_base->keys[keyId], sources);
+        }
+    }
+    for (auto it = m_overlayReverse.cbegin(); it != m_overlayReverse.cend(); ++it) {
+        result[it.key()] += it.value().size();
+    }
+
+    for (auto it = result.begin(); it != result.end();) {
+        if (m_index->resolveLink(it.key()) >= 0) {
+            it = result.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return result;
+}
+
+int LinkGraph::linkCount() const
+{
+    int count = m_base->forwardKeys.size();
+    for (auto it = m_overlay.cbegin(); it != m_overlay.cend(); ++it) {
+        if (it.key() + 1 < quint32(m_base->forwardOffsets.size())) {
+            count -= m_base->forwardOffsets[it.key() + 1] - m_base->forwardOffsets[it.key()];
+        }
+        count += it.value().keys.size();
+    }
+    return count;
+}
+
+void LinkGraph::onNoteChanged(quint32 noteId)
+{
+    setPending(noteId, m_index->note(noteId).content.links);
+}
+
+void LinkGraph::onNoteRemoved(quint32 noteId)
+{
+    setPending(noteId, QStringList());
+}
+
+QVector<QStringList> LinkGraph::noteKeys() const
+{
+    QVector<QStringList> keys(m_index->idCount());
+    for (int noteId = 0; noteId < m_index->idCount(); ++noteId) {
+        if (m_index->isLive(noteId)) {
+            keys[noteId] = m_index->note(noteId).content.links;
+        }
+    }
+    return keys;
+}
+
+void LinkGraph::setPending(quint32 noteId, const QStringList &keys)
+{
+    auto found = m_overlay.find(noteId);
+    if (found != m_overlay.end()) {
+        for (const QString &key : std::as_const(found->keys)) {
+            auto sources = m_overlayReverse.find(key);
+            if (sources != m_overlayReverse.end()) {
+                sources->removeOne(noteId);
+                if (sources->isEmpty()) {
+                    m_overlayReverse.erase(sources);
+                }
+            }
+        }
+    }
+
+    m_overlay.insert(noteId, Pending{keys, ++m_revision});
+    for (const QString &key : keys) {
+        m_overlayReverse[key].append(noteId);
+    }
+
+    emit changed();
+    compact();
+}
+
+void LinkGraph::adoptBase(const QSharedPointer<const Base> &base, quint64 serial,
+                          const QHash<quint32, quint64> &merged)
+{
+    if (serial != m_serial) {
+        return;
+    }
+
+    m_base = base;
+    m_building = false;
+    m_ready = true;
+
+    // Overlay entries that went into the new arrays and did not change since
+    for (auto it = merged.cbegin(); it != merged.cend(); ++it) {
+        auto found = m_overlay.constFind(it.key());
+        if (found == m_overlay.constEnd() || found->revision != it.value()) {
+            continue;
+        }
+        const QStringList keys = found->keys;
+        m_overlay.remove(it.key());
+        for (const QString &key : keys) {
+            auto sources = m_overlayReverse.find(key);
+            if (sources != m_overlayReverse.end()) {
+                sources->removeOne(it.key());
+                if (sources->isEmpty()) {
+                    m_overlayReverse.erase(sources);
+                }
+            }
+        }
+    }
+
+    emit changed();
+    compact();
+}
+
+void LinkGraph::compact()
+{
+    if (m_building || m_overlay.size() < CompactThreshold) {
+        return;
+    }
+    m_building = true;
+
+    // The base is immutable and the overlay is copied, so the merge can run
+    // on a worker while new changes keep coming in
+    QSharedPointer<const Base> base = m_base;
+    QHash<quint32, Pending> overlay = m_overlay;
+    const int idCount = m_index->idCount();
+    const quint64 serial = m_serial;
+    QSharedPointer<Receiver> receiver = m_receiver;
+    QThreadPool::globalInstance()->start([base, overlay, idCount, serial, receiver]() {
+        QVector<QStringList> noteKeys(idCount);
+        QHash<quint32, quint64> merged;
+        for (int noteId = 0; noteId < idCount; ++noteId) {
+            auto found = overlay.constFind(noteId);
+            if (found != overlay.constEnd()) {
+                noteKeys[noteId] = found->keys;
+                merged.insert(noteId, found->revision);
+            } else {
+                noteKeys[noteId] = base->keysOf(noteId);
+            }
+        }
+        receiver->deliver(Base::build(noteKeys), serial, merged);
+    });
+}
+
+QStringList LinkGraph::keysOf(quint32 noteId) const
+{
+    auto found = m_overlay.constFind(noteId);
+    return found != m_overlay.constEnd() ? found->keys : m_base->keysOf(noteId);
+}
\ No newline at end of file
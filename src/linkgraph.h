@@ -0,0 +1,98 @@
+#ifndef LINKGRAPH_H
+#define LINKGRAPH_H
+
+#include <QObject>
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class VaultIndex;
+
+// [[Link]] graph of the notes of a vault, in both directions.
+//
+// Links are stored by target key (the normalized link text) and resolved
+// through the vault index when asked, so adding or renaming a note changes
+// what links point at without touching the graph. The bulk of the graph is
+// a pair of compressed adjacency arrays (note -> keys and key -> notes)
+// built in the background from the links the vault index read (or found in
+// its metadata cache); notes changed since then live in a small overlay
+// that is folded into the arrays once it grows.
+class LinkGraph : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Follows index from its next reset on; call rebuild() if it already
+    // holds a vault
+    explicit LinkGraph(VaultIndex *index, QObject *parent = nullptr);
+    ~LinkGraph() override;
+
+    // Rebuild from the index; in the background, or before returning
+    void rebuild();
+    void rebuildNow();
+    bool isReady() const { return m_ready; }
+
+    // Notes linking to noteId, sorted by id, without noteId itself
+    QVector<quint32> backlinks(quint32 noteId) const;
+    // Notes noteId links to, sorted by id
+    QVector<quint32> outgoingLinks(quint32 noteId) const;
+    // Link keys of noteId that no note answers to
+    QStringList unresolvedLinks(quint32 noteId) const;
+    // All link keys that no note answers to, with the number of linking notes
+    QHash<QString, int> unresolvedTargets() const;
+
+    int linkCount() const;
+
+signals:
+    // Links were added or removed, or a scan finished
+    void changed();
+
+private slots:
+    void onNoteChanged(quint32 noteId);
+    void onNoteRemoved(quint32 noteId);
+
+private:
+    // Immutable once built, so workers can read it while the overlay grows
+    struct Base {
+        QStringList keys;                   // Key id -> normalized link text
+        QHash<QString, quint32> keyIds;
+        QVector<quint32> forwardOffsets;    // Note id -> range in forwardKeys
+        QVector<quint32> forwardKeys;
+        QVector<quint32> reverseOffsets;    // Key id -> range in reverseNotes
+        QVector<quint32> reverseNotes;
+
+        static QSharedPointer<const Base> build(const QVector<QStringList> &noteKeys);
+        QStringList keysOf(quint32 noteId) const;
+    };
+
+    // A note's links as changed after the base was built
+    struct Pending {
+        QStringList keys;
+        quint64 revision;
+    };
+
+    struct Receiver;
+
+    // Link keys of every note id, empty for free ids
+    QVector<QStringList> noteKeys() const;
+    void setPending(quint32 noteId, const QStringList &keys);
+    void adoptBase(const QSharedPointer<const Base> &base, quint64 serial,
+                   const QHash<quint32, quint64> &merged);
+    void compact();
+    QStringList keysOf(quint32 noteId) const;
+
+    VaultIndex *m_index;
+    QSharedPointer<const Base> m_base;
+    QHash<quint32, Pending> m_overlay;
+    QHash<QString, QVector<quint32>> m_overlayReverse;  // Key -> overlay notes
+
+    quint64 m_revision = 0;
+    quint64 m_serial = 0;       // Bumped by rebuild, older results are dropped
+    bool m_building = false;
+    bool m_ready = false;
+    QSharedPointer<Receiver> m_receiver;
+};
+
+#endif // LINKGRAPH_H
\ No newline at end of file
@@ -1,47 +1,82 @@
 #include "linkparser.h"
+#include "indexpipeline.h"
+#include "linktokenizer.h"
+#include "vaultindex.h"
+#include "vaultwalker.h"
 #include <QFileInfo>
-#include <QDirIterator>
-#include <QTextStream>
 #include <QFile>
 #include <QDebug>
 
+namespace {
+
+// The vault open in the application is answered from its index, other
+// workspaces are scanned. The index lives in the GUI thread.
+const VaultIndex *indexFor(const QString &workspacePath)
+{
+    const VaultIndex *index = VaultIndex::instance();
+    return index->covers(workspacePath) ? index : nullptr;
+}
+
+// Zettel id the first line of a file starts with, empty if none
+QString firstLineZettelId(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    const QByteArray firstLine = file.readLine(1024);
+    const LinkTokenizer::Header header = LinkTokenizer::header(firstLine.constData(), firstLine.size());
+    if (!header.zettelId.isValid()) {
+        return QString();
+    }
+    return QString::fromLatin1(firstLine.constData() + header.zettelId.start, header.zettelId.length);
+}
+
+// Absolute paths of the .md and .txt files of a vault, for lookups that
+// have no vault index to ask
+QStringList noteFiles(const QString &workspacePath)
+{
+    VaultWalker walker(workspacePath, VaultWalker::Parallel);
+    walker.setSuffixes({"md", "txt"});
+    const QVector<VaultWalker::Entry> files = walker.walk();
+
+    const QDir root(workspacePath);
+    QStringList filePaths;
+    filePaths.reserve(files.size());
+    for (const VaultWalker::Entry &file : files) {
+        filePaths.append(root.filePath(file.relPath));
+    }
+    return filePaths;
+}
+
+} // namespace
+
 LinkParser::LinkParser(QObject *parent)
     : QObject(parent)
 {
-    // Regex for [[wiki links]] - supports [[title]] or [[id|title]]
-    m_wikiLinkRegex = QRegularExpression(R"(\[\[([^\]]+)\]\])");
-
-    // Regex for zettelkasten IDs: number followed by letters
-    // Matches: 1, 1a, 1a1, 1a1a, 2, 2b3, etc.
-    m_zettelIdRegex = QRegularExpression(R"(^(\d+(?:[a-z]+\d*)*))");
 }
 
 QList<WikiLink> LinkParser::parseWikiLinks(const QString &text, const QString &workspacePath)
 {
     QList<WikiLink> links;
 
-    QRegularExpressionMatchIterator iterator = m_wikiLinkRegex.globalMatch(text);
-    while (iterator.hasNext()) {
-        QRegularExpressionMatch match = iterator.next();
+    // Supports [[title]] or [[id|title]]
+    LinkTokenizer tokenizer(text.constData(), text.size());
+    LinkTokenizer::Link token;
+    while (tokenizer.next(&token)) {
         WikiLink link;
-
-        QString fullMatch = match.captured(1); // Content inside [[]]
-
-        // Check for [[id|title]] format
-        if (fullMatch.contains("|")) {
-            QStringList parts = fullMatch.split("|");
-            link.linkText = parts[0].trimmed();
-            link.displayText = parts[1].trimmed();
-        } else {
-            link.linkText = fullMatch.trimmed();
-            link.displayText = fullMatch.trimmed();
-        }
-
-        link.startPos = match.capturedStart();
-        link.length = match.capturedLength();
+        link.linkText = text.mid(token.target.start, token.target.length);
+        link.displayText = text.mid(token.label.start, token.label.length);
+        link.startPos = token.whole.start;
+        link.length = token.whole.length;
 
         // Find target file
-        if (!workspacePath.isEmpty()) {
+        if (const VaultIndex *index = indexFor(workspacePath)) {
+            int noteId = index->resolveLink(link.linkText);
+            link.targetFile = noteId >= 0 ? index->absolutePath(noteId) : QString();
+            link.exists = noteId >= 0;
+        } else if (!workspacePath.isEmpty()) {
             // First try to find by zettel ID
             link.targetFile = findNoteById(link.linkText, workspacePath);
 
@@ -68,14 +103,14 @@ ZettelId LinkParser::parseZettelId(const QString &text)
 
     QString trimmed = text.trimmed();
 
-    // Try to match zettelkasten ID at the beginning
-    QRegularExpressionMatch match = m_zettelIdRegex.match(trimmed);
-    if (match.hasMatch()) {
-        zettel.id = match.captured(1);
-        zettel.isValid = isValidZettelId(zettel.id);
+    // Zettelkasten ID at the beginning: 1, 1a, 1a1, 1a1a, 2, 2b3, etc.
+    const qsizetype idLength = LinkTokenizer::zettelIdLength(trimmed.constData(), trimmed.size());
+    if (idLength > 0) {
+        zettel.id = trimmed.left(idLength);
+        zettel.isValid = true;
 
         // Extract title (everything after the ID)
-        QString remaining = trimmed.mid(match.capturedEnd()).trimmed();
+        QString remaining = trimmed.mid(idLength).trimmed();
         if (remaining.startsWith("-") || remaining.startsWith(":")) {
             remaining = remaining.mid(1).trimmed();
         }
@@ -88,31 +123,17 @@ ZettelId LinkParser::parseZettelId(const QString &text)
 bool LinkParser::isValidZettelId(const QString &id)
 {
     // Valid zettelkasten IDs: 1, 1a, 1a1, 1a1a, 2b, 2b3c, etc.
-    QRegularExpression validIdRegex(R"(^\d+(?:[a-z]+\d*)*$)");
-    return validIdRegex.match(id).hasMatch();
+    return LinkTokenizer::isZettelId(id);
 }
 
 QString LinkParser::generateNextZettelId(const QString &parentId, const QString &workspacePath)
 {
-    if (parentId.isEmpty()) {
-        // Generate top-level ID (1, 2, 3, ...)
-        QStringList existingIds = getAllZettelIds(workspacePath);
-
-        int maxNum = 0;
-        QRegularExpression topLevelRegex("^(\\d+)$");
-
-        for (const QString &id : existingIds) {
-            QRegularExpressionMatch match = topLevelRegex.match(id);
-            if (match.hasMatch()) {
-                int num = match.captured(1).toInt();
-                maxNum = qMax(maxNum, num);
-            }
-        }
-
-        return QString::number(maxNum + 1);
+    if (!parentId.isEmpty()) {
+        return generateChildZettelId(parentId, workspacePath);
     }
 
-    return generateChildZettelId(parentId, workspacePath);
+    // Top-level IDs count up: 1, 2, 3, ...
+    return zettelIds(workspacePath).nextTopLevel();
 }
 
 QString LinkParser::generateChildZettelId(const QString &parentId, const QString &workspacePath)
@@ -121,56 +142,22 @@ QString LinkParser::generateChildZettelId(const QString &parentId, const QString
         return QString();
     }
 
-    QStringList existingIds = getAllZettelIds(workspacePath);
-
-    // For parent "1", generate "1a", "1b", "1c", etc.
-    // For parent "1a", generate "1a1", "1a2", "1a3", etc.
-    // For parent "1a1", generate "1a1a", "1a1b", "1a1c", etc.
-
-    if (parentId.at(parentId.length() - 1).isDigit()) {
-        // Last character is a number, append letters
-        QString baseId = parentId + "a";
-        if (!existingIds.contains(baseId)) {
-            return baseId;
-        }
-
-        // Find next available letter
-        for (char c = 'a'; c <= 'z'; ++c) {
-            QString candidateId = parentId + c;
-            if (!existingIds.contains(candidateId)) {
-                return candidateId;
-            }
-        }
-    } else {
-        // Last character is a letter, append numbers
-        QString baseId = parentId + "1";
-        if (!existingIds.contains(baseId)) {
-            return baseId;
-        }
-
-        // Find next available number
-        for (int i = 1; i <= 999; ++i) {
-            QString candidateId = parentId + QString::number(i);
-            if (!existingIds.contains(candidateId)) {
-                return candidateId;
-            }
-        }
-    }
-
-    return QString(); // Should rarely happen
+    // "1" -> "1a", "1b", ...; "1a" -> "1a1", "1a2", ...; after the last
+    // existing child
+    return zettelIds(workspacePath).nextChild(parentId);
 }
 
 QString LinkParser::findNoteByTitle(const QString &title, const QString &workspacePath)
 {
-    QString normalizedTitle = normalizeTitle(title);
+    if (const VaultIndex *index = indexFor(workspacePath)) {
+        int noteId = index->findByTitle(title);
+        return noteId >= 0 ? index->absolutePath(noteId) : QString();
+    }
 
-    QDirIterator iterator(workspacePath,
-                          QStringList() << "*.md" << "*.txt",
-                          QDir::Files,
-                          QDirIterator::Subdirectories);
+    QString normalizedTitle = normalizeTitle(title);
 
-    while (iterator.hasNext()) {
-        QString filePath = iterator.next();
+    const QStringList filePaths = noteFiles(workspacePath);
+    for (const QString &filePath : filePaths) {
         QFileInfo fileInfo(filePath);
 
         // Check if filename (without extension) matches
@@ -181,11 +168,13 @@ QString LinkParser::findNoteByTitle(const QString &title, const QString &workspa
 
         // Check if file contains this title as a header
         QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            QString firstLine = in.readLine();
-            if (firstLine.startsWith("#")) {
-                QString headerTitle = firstLine.remove(QRegularExpression("^#+\\s*")).trimmed();
+        if (file.open(QIODevice::ReadOnly)) {
+            const QByteArray firstLine = file.readLine(1024);
+            const LinkTokenizer::Header header =
+                LinkTokenizer::header(firstLine.constData(), firstLine.size());
+            if (header.title.isValid()) {
+                QString headerTitle = QString::fromUtf8(firstLine.constData() + header.title.start,
+                                                        header.title.length);
                 if (normalizeTitle(headerTitle) == normalizedTitle) {
                     return filePath;
                 }
@@ -202,13 +191,13 @@ QString LinkParser::findNoteById(const QString &zettelId, const QString &workspa
         return QString();
     }
 
-    QDirIterator iterator(workspacePath,
-                          QStringList() << "*.md" << "*.txt",
-                          QDir::Files,
-                          QDirIterator::Subdirectories);
+    if (const VaultIndex *index = indexFor(workspacePath)) {
+        int noteId = index->findById(zettelId);
+        return noteId >= 0 ? index->absolutePath(noteId) : QString();
+    }
 
-    while (iterator.hasNext()) {
-        QString filePath = iterator.next();
+    const QStringList filePaths = noteFiles(workspacePath);
+    for (const QString &filePath : filePaths) {
         QFileInfo fileInfo(filePath);
 
         // Check if filename starts with zettel ID
@@ -218,14 +207,8 @@ QString LinkParser::findNoteById(const QString &zettelId, const QString &workspa
         }
 
         // Also check file content for zettel ID at the beginning
-        QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            QString firstLine = in.readLine().trimmed();
-            ZettelId parsedId = parseZettelId(firstLine);
-            if (parsedId.isValid && parsedId.id == zettelId) {
-                return filePath;
-            }
+        if (firstLineZettelId(filePath) == zettelId) {
+            return filePath;
         }
     }
 
@@ -236,13 +219,8 @@ QStringList LinkParser::getAllZettelIds(const QString &workspacePath)
 {
     QStringList zettelIds;
 
-    QDirIterator iterator(workspacePath,
-                          QStringList() << "*.md" << "*.txt",
-                          QDir::Files,
-                          QDirIterator::Subdirectories);
-
-    while (iterator.hasNext()) {
-        QString filePath = iterator.next();
+    const QStringList filePaths = noteFiles(workspacePath);
+    for (const QString &filePath : filePaths) {
         QFileInfo fileInfo(filePath);
         QString fileName = fileInfo.baseName();
 
@@ -254,14 +232,9 @@ QStringList LinkParser::getAllZettelIds(const QString &workspacePath)
         }
 
         // Try to extract from file content
-        QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            QString firstLine = in.readLine().trimmed();
-            ZettelId parsedId = parseZettelId(firstLine);
-            if (parsedId.isValid) {
-                zettelIds.append(parsedId.id);
-            }
+        QString idFromContent = firstLineZettelId(filePath);
+        if (!idFromContent.isEmpty()) {
+            zettelIds.append(idFromContent);
         }
     }
 
@@ -279,36 +252,52 @@ QStringList LinkParser::findBacklinks(const QString &notePath, const QString &wo
     // Extract zettel ID if this note has one
     QString zettelId = extractZettelIdFromFileName(noteTitle);
 
-    QDirIterator iterator(workspacePath,
-                          QStringList() << "*.md" << "*.txt",
-                          QDir::Files,
-                          QDirIterator::Subdirectories);
-
-    while (iterator.hasNext()) {
-        QString filePath = iterator.next();
-        if (filePath == notePath) continue; // Skip self
-
-        QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QString content = QTextStream(&file).readAll();
-
-            // Parse wiki links in this file
-            auto links = parseWikiLinks(content);
-            for (const auto &link : links) {
-                // Check if this link points to our note
-                if ((link.linkText == noteTitle) ||
-                    (link.linkText == zettelId && !zettelId.isEmpty()) ||
-                    (link.targetFile == notePath)) {
-                    backlinks.append(filePath);
-                    break; // Only add once per file
-                }
-            }
+    // Every note is read and tokenized on the pipeline's worker threads
+    const QStringList filePaths = noteFiles(workspacePath);
+    QVector<bool> linking(filePaths.size(), false);
+    bool *results = linking.data();     // No detaching on worker threads
+    IndexPipeline pipeline;
+    pipeline.run(filePaths,
+                 [&](int index, const QByteArray &data, bool ok) {
+                     if (!ok || filePaths.at(index) == notePath) {
+                         return;    // Skip self
+                     }
+                     LinkTokenizer tokenizer(data.constData(), data.size());
+                     LinkTokenizer::Link link;
+                     while (tokenizer.next(&link)) {
+                         const QString linkText =
+                             QString::fromUtf8(data.constData() + link.target.start, link.target.length);
+                         if (linkText == noteTitle || (linkText == zettelId && !zettelId.isEmpty())) {
+                             results[index] = true;
+                             break; // Only add once per file
+                         }
+                     }
+                 },
+                 [](int) {});
+
+    for (int i = 0; i < filePaths.size(); ++i) {
+        if (linking[i]) {
+            backlinks.append(filePaths[i]);
         }
     }
 
     return backlinks;
 }
 
+ZettelIdIndex LinkParser::zettelIds(const QString &workspacePath)
+{
+    if (const VaultIndex *index = indexFor(workspacePath)) {
+        return index->zettelIds();
+    }
+
+    ZettelIdIndex ids;
+    const QStringList allIds = getAllZettelIds(workspacePath);
+    for (const QString &id : allIds) {
+        ids.insert(id);
+    }
+    return ids;
+}
+
 QString LinkParser::normalizeTitle(const QString &title)
 {
     return title.trimmed().toLower().replace(" ", "_");
@@ -324,14 +313,10 @@ QString LinkParser::zettelIdToFileName(const QString &zettelId, const QString &t
 
 bool LinkParser::isZettelFileName(const QString &fileName)
 {
-    return m_zettelIdRegex.match(fileName).hasMatch();
+    return LinkTokenizer::zettelIdLength(fileName.constData(), fileName.size()) > 0;
 }
 
 QString LinkParser::extractZettelIdFromFileName(const QString &fileName)
 {
-    QRegularExpressionMatch match = m_zettelIdRegex.match(fileName);
-    if (match.hasMatch()) {
-        return match.captured(1);
-    }
-    return QString();
+    return fileName.left(LinkTokenizer::zettelIdLength(fileName.constData(), fileName.size()));
 }
\ No newline at end of file
@@ -3,9 +3,9 @@
 
 #include <QObject>
 #include <QString>
-#include <QRegularExpression>
 #include <QStringList>
 #include <QDir>
+#include "zettelidindex.h"
 
 struct WikiLink {
     QString linkText;    // The text inside [[]]
@@ -52,14 +52,15 @@ public:
     // Extract backlinks (notes that link to this note)
     QStringList findBacklinks(const QString &notePath, const QString &workspacePath);
 
+    // Key titles are compared by: lower case, spaces as underscores
+    static QString normalizeTitle(const QString &title);
+
 private:
-    QString normalizeTitle(const QString &title);
+    // Ids of the workspace, from the vault index when it covers it
+    ZettelIdIndex zettelIds(const QString &workspacePath);
     QString zettelIdToFileName(const QString &zettelId, const QString &title = QString());
     bool isZettelFileName(const QString &fileName);
     QString extractZettelIdFromFileName(const QString &fileName);
-
-    QRegularExpression m_wikiLinkRegex;
-    QRegularExpression m_zettelIdRegex;
 };
 
 #endif // LINKPARSER_H
\ No newline at end of file
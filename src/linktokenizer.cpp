@@ -0,0 +1,254 @@
+#include "linktokenizer.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+inline bool isAsciiDigit(char16_t ch)
+{
+    return ch >= u'0' && ch <= u'9';
+}
+
+inline bool isIdChar(char16_t ch)
+{
+    return isAsciiDigit(ch) || (ch >= u'a' && ch <= u'z');
+}
+
+inline bool isSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+inline bool isSpace(char16_t ch)
+{
+    return QChar::isSpace(ch);
+}
+
+// Offset of the next "[[" at or after from, -1 if none
+qsizetype findOpenScalar(const char *data, qsizetype size, qsizetype from)
+{
+    const char *end = data + size;
+    const char *p = data + from;
+    while (end - p >= 2) {
+        p = static_cast<const char *>(std::memchr(p, '[', size_t(end - p - 1)));
+        if (!p) {
+            return -1;
+        }
+        if (p[1] == '[') {
+            return p - data;
+        }
+        p += 2;     // p[1] is not '[', so no pair starts there either
+    }
+    return -1;
+}
+
+qsizetype findOpenScalar(const char16_t *data, qsizetype size, qsizetype from)
+{
+    for (qsizetype i = from; i + 1 < size; ++i) {
+        if (data[i] == u'[' && data[i + 1] == u'[') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+qsizetype findOpen(const char *data, qsizetype size, qsizetype from)
+{
+#if defined(__SSE2__)
+    // A lane hits when it and the next byte are both '['
+    const __m128i bracket = _mm_set1_epi8('[');
+    qsizetype i = from;
+    for (; i + 17 <= size; i += 16) {
+        const __m128i here = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+        const quint32 mask = quint32(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(here, bracket), _mm_cmpeq_epi8(next, bracket))));
+        if (mask) {
+            return i + qCountTrailingZeroBits(mask);
+        }
+    }
+    return findOpenScalar(data, size, i);
+#else
+    return findOpenScalar(data, size, from);
+#endif
+}
+
+qsizetype findOpen(const char16_t *data, qsizetype size, qsizetype from)
+{
+#if defined(__SSE2__)
+    const __m128i bracket = _mm_set1_epi16(u'[');
+    qsizetype i = from;
+    for (; i + 9 <= size; i += 8) {
+        const __m128i here = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + 1));
+        const quint32 mask = quint32(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi16(here, bracket), _mm_cmpeq_epi16(next, bracket))));
+        if (mask) {
+            return i + qCountTrailingZeroBits(mask) / 2;
+        }
+    }
+    return findOpenScalar(data, size, i);
+#else
+    return findOpenScalar(data, size, from);
+#endif
+}
+
+qsizetype findChar(const char *data, qsizetype from, qsizetype to, char ch)
+{
+    const void *p = std::memchr(data + from, ch, size_t(to - from));
+    return p ? static_cast<const char *>(p) - data : to;
+}
+
+qsizetype findChar(const char16_t *data, qsizetype from, qsizetype to, char16_t ch)
+{
+    while (from < to && data[from] != ch) {
+        ++from;
+    }
+    return from;
+}
+
+template <typename Char>
+LinkTokenizer::Span trimmed(const Char *data, qsizetype start, qsizetype end)
+{
+    while (start < end && isSpace(data[start])) {
+        ++start;
+    }
+    while (end > start && isSpace(data[end - 1])) {
+        --end;
+    }
+    return LinkTokenizer::Span{start, end - start};
+}
+
+template <typename Char>
+bool nextLink(const Char *data, qsizetype size, qsizetype *pos, LinkTokenizer::Link *link)
+{
+    qsizetype open = *pos;
+    for (;;) {
+        open = findOpen(data, size, open);
+        if (open < 0) {
+            *pos = size;
+            return false;
+        }
+
+        const qsizetype close = findChar(data, open + 2, size, Char(']'));
+        if (close >= size) {
+            *pos = size;
+            return false;       // No ']' left, so no link either
+        }
+
+        if (close > open + 2 && close + 1 < size && data[close + 1] == Char(']')) {
+            const qsizetype pipe = findChar(data, open + 2, close, Char('|'));
+            link->whole = LinkTokenizer::Span{open, close + 2 - open};
+            link->target = trimmed(data, open + 2, pipe);
+            if (pipe < close) {
+                link->label = trimmed(data, pipe + 1, findChar(data, pipe + 1, close, Char('|')));
+            } else {
+                link->label = link->target;
+            }
+            *pos = close + 2;
+            return true;
+        }
+
+        // Every "[[" before close runs into the same lone ']'
+        open = close;
+    }
+}
+
+template <typename Char>
+qsizetype idLength(const Char *data, qsizetype size)
+{
+    if (size == 0 || !isAsciiDigit(data[0])) {
+        return 0;
+    }
+
+    // \d+(?:[a-z]+\d*)* is a digit followed by any run of digits and letters
+    qsizetype length = 1;
+    while (length < size && isIdChar(data[length])) {
+        ++length;
+    }
+    return length;
+}
+
+template <typename Char>
+LinkTokenizer::Header readHeader(const Char *data, qsizetype size)
+{
+    LinkTokenizer::Header header;
+
+    qsizetype start = 0;
+    if (sizeof(Char) == 1 && size >= 3 && uchar(data[0]) == 0xef && uchar(data[1]) == 0xbb
+        && uchar(data[2]) == 0xbf) {
+        start = 3;      // UTF-8 byte order mark
+    } else if (sizeof(Char) == 2 && size >= 1 && char16_t(data[0]) == 0xfeff) {
+        start = 1;
+    }
+
+    qsizetype end = findChar(data, start, size, Char('\n'));
+    if (end > start && data[end - 1] == Char('\r')) {
+        --end;
+    }
+    header.line = LinkTokenizer::Span{start, end - start};
+
+    const LinkTokenizer::Span content = trimmed(data, start, end);
+    if (content.length > 0 && data[content.start] == Char('#')) {
+        qsizetype titleStart = content.start;
+        while (titleStart < end && data[titleStart] == Char('#')) {
+            ++titleStart;
+        }
+        header.title = trimmed(data, titleStart, end);
+    }
+
+    const qsizetype length = idLength(data + content.start, content.length);
+    if (length > 0) {
+        header.zettelId = LinkTokenizer::Span{content.start, length};
+    }
+    return header;
+}
+
+} // namespace
+
+LinkTokenizer::LinkTokenizer(const char *utf8, qsizetype size)
+    : m_utf8(utf8), m_size(size)
+{
+}
+
+LinkTokenizer::LinkTokenizer(const QChar *utf16, qsizetype size)
+    : m_utf16(reinterpret_cast<const char16_t *>(utf16)), m_size(size)
+{
+}
+
+bool LinkTokenizer::next(Link *link)
+{
+    if (m_utf8) {
+        return nextLink(m_utf8, m_size, &m_pos, link);
+    }
+    return nextLink(m_utf16, m_size, &m_pos, link);
+}
+
+LinkTokenizer::Header LinkTokenizer::header(const char *utf8, qsizetype size)
+{
+    return readHeader(utf8, size);
+}
+
+LinkTokenizer::Header LinkTokenizer::header(const QChar *utf16, qsizetype size)
+{
+    return readHeader(reinterpret_cast<const char16_t *>(utf16), size);
+}
+
+qsizetype LinkTokenizer::zettelIdLength(const char *utf8, qsizetype size)
+{
+    return idLength(utf8, size);
+}
+
+qsizetype LinkTokenizer::zettelIdLength(const QChar *utf16, qsizetype size)
+{
+    return idLength(reinterpret_cast<const char16_t *>(utf16), size);
+}
+
+bool LinkTokenizer::isZettelId(QStringView text)
+{
+    return !text.isEmpty() && zettelIdLength(text.data(), text.size()) == text.size();
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef LINKTOKENIZER_H
+#define LINKTOKENIZER_H
+
+#include <QString>
+#include <QStringView>
+
+// Single-pass scanner for [[wiki links]], zettel ids and first-line headers.
+//
+// Works on UTF-8 bytes (file contents as read) or UTF-16 (QString data) and
+// reports spans into the buffer, so nothing is allocated while scanning.
+// "[[" is located with SSE2 when available. Matches what the regular
+// expressions in LinkParser used to match: a link is "[[", one or more
+// characters other than ']', then "]]"; a zettel id is \d+(?:[a-z]+\d*)*.
+class LinkTokenizer
+{
+public:
+    struct Span {
+        qsizetype start = -1;       // In code units of the buffer, -1 if absent
+        qsizetype length = 0;
+
+        bool isValid() const { return start >= 0; }
+        qsizetype end() const { return start + length; }
+    };
+
+    struct Link {
+        Span whole;     // "[[...]]"
+        Span target;    // Before the first '|', trimmed
+        Span label;     // After the first '|', trimmed; the target without one
+    };
+
+    struct Header {
+        Span line;      // First line without its terminator
+        Span title;     // A "# Title" line's title, trimmed; invalid otherwise
+        Span zettelId;  // Zettel id the trimmed line starts with, invalid if none
+    };
+
+    LinkTokenizer(const char *utf8, qsizetype size);
+    LinkTokenizer(const QChar *utf16, qsizetype size);
+
+    // The next link in the buffer; false once there are no more
+    bool next(Link *link);
+
+    static Header header(const char *utf8, qsizetype size);
+    static Header header(const QChar *utf16, qsizetype size);
+
+    // Length of the zettel id text starts with ("1a2 Title" -> 3), 0 if none
+    static qsizetype zettelIdLength(const char *utf8, qsizetype size);
+    static qsizetype zettelIdLength(const QChar *utf16, qsizetype size);
+
+    // Whether text is exactly one zettel id
+    static bool isZettelId(QStringView text);
+
+private:
+    const char *m_utf8 = nullptr;
+    const char16_t *m_utf16 = nullptr;
+    qsizetype m_size;
+    qsizetype m_pos = 0;
+};
+
+#endif // LINKTOKENIZER_H
\ No newline at end of file
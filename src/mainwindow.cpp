@@ -2,10 +2,16 @@
 #include "filetree.h"
 #include "editor.h"
 #include "search.h"
+#include "searchjob.h"
+#include "quickopen.h"
+#include "backlinkspanel.h"
+#include "linkgraph.h"
 #include "linkparser.h"
 #include "settings.h"
 #include "preferencesdialog.h"
 #include "vaultmanager.h"
+#include "vaultindex.h"
+#include "vaultwatcher.h"
 #include "vaultdialog.h"
 #include <QMenuBar>
 #include <QStatusBar>
@@ -46,6 +52,10 @@ void MainWindow::setupMenuBar()
     auto *openWorkspaceAction = fileMenu->addAction("&Open Workspace...");
     connect(openWorkspaceAction, &QAction::triggered, this, &MainWindow::openWorkspace);
 
+    auto *quickOpenAction = fileMenu->addAction("&Quick Open...");
+    quickOpenAction->setShortcut(QKeySequence("Ctrl+P"));
+    connect(quickOpenAction, &QAction::triggered, this, &MainWindow::openQuickOpen);
+
     fileMenu->addSeparator();
 
     auto *newFileAction = fileMenu->addAction("&New File");
@@ -99,15 +109,30 @@ void MainWindow::setupUI()
     leftLayout->addWidget(m_searchBox);
 
     // File tree
-    m_fileTree = new FileTree;
+    m_fileTree = new FileTree(VaultIndex::instance());
     leftLayout->addWidget(m_fileTree);
 
     // Editor
     m_editor = new Editor;
 
+    // Note switcher, kept around so its matcher follows the vault index
+    m_quickOpen = new QuickOpen(VaultIndex::instance(), this);
+
+    // Backlinks below the editor
+    m_linkGraph = new LinkGraph(VaultIndex::instance(), this);
+    m_backlinksPanel = new BacklinksPanel(VaultIndex::instance(), m_linkGraph);
+
+    // Picks up notes changed by git, sync tools or other editors
+    m_vaultWatcher = new VaultWatcher(VaultIndex::instance(), this);
+
+    m_editorSplitter = new QSplitter(Qt::Vertical);
+    m_editorSplitter->addWidget(m_editor);
+    m_editorSplitter->addWidget(m_backlinksPanel);
+    m_editorSplitter->setSizes({650, 150});
+
     // Add to splitter
     m_mainSplitter->addWidget(m_leftPanel);
-    m_mainSplitter->addWidget(m_editor);
+    m_mainSplitter->addWidget(m_editorSplitter);
 
     // Set splitter proportions
     m_mainSplitter->setSizes({300, 900});
@@ -126,6 +151,31 @@ void MainWindow::setupConnections()
     connect(m_fileTree, &FileTree::fileSelected, this, &MainWindow::onFileSelected);
     connect(m_searchBox, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
     connect(m_editor, &Editor::linkClicked, this, &MainWindow::onLinkClicked);
+    connect(m_quickOpen, &QuickOpen::noteSelected, this, &MainWindow::onFileSelected);
+    connect(m_editor, &Editor::currentFileChanged, m_backlinksPanel, &BacklinksPanel::setCurrentFile);
+
+    // The search index refreshes only what the watcher reported
+    connect(m_vaultWatcher, &VaultWatcher::notesChanged, this, [this](const QStringList &paths) {
+        if (m_searchIndex) {
+            m_searchIndex->touch(paths);
+        }
+    });
+    connect(m_vaultWatcher, &VaultWatcher::rescanned, this, [this]() {
+        if (m_searchIndex) {
+            m_searchIndex->invalidate();
+        }
+    });
+    connect(m_vaultWatcher, &VaultWatcher::batchApplied, this, [this]() {
+        const VaultWatcher::Stats &stats = m_vaultWatcher->stats();
+        statusBar()->showMessage(QString("Reindexed %1 changed notes (%2 ms after the change)")
+                                     .arg(stats.lastBatchSize).arg(stats.lastLagMs), 3000);
+    });
+    connect(m_backlinksPanel, &BacklinksPanel::fileSelected, this, &MainWindow::onFileSelected);
+
+    // Keep the vault index current with the file operations done here
+    VaultIndex *vaultIndex = VaultIndex::instance();
+    connect(m_fileTree, &FileTree::fileRenamed, vaultIndex, &VaultIndex::renameNote);
+    connect(m_fileTree, &FileTree::fileDeleted, vaultIndex, &VaultIndex::removeNote);
 }
 
 void MainWindow::onFileSelected(const QString &filePath)
@@ -148,12 +198,19 @@ void MainWindow::onLinkClicked(const QString &linkTarget)
         return;
     }
 
-    LinkParser linkParser;
-
-    // Try to find the target file
-    QString targetFile = linkParser.findNoteById(linkTarget, m_currentWorkspace);
-    if (targetFile.isEmpty()) {
-        targetFile = linkParser.findNoteByTitle(linkTarget, m_currentWorkspace);
+    // Try to find the target file, by zettel id and then by title; on disk
+    // while the vault is still being walked
+    VaultIndex *vaultIndex = VaultIndex::instance();
+    QString targetFile;
+    if (vaultIndex->covers(m_currentWorkspace)) {
+        int noteId = vaultIndex->resolveLink(linkTarget);
+        targetFile = noteId >= 0 ? vaultIndex->absolutePath(noteId) : QString();
+    } else {
+        LinkParser linkParser;
+        targetFile = linkParser.findNoteById(linkTarget.trimmed(), m_currentWorkspace);
+        if (targetFile.isEmpty()) {
+            targetFile = linkParser.findNoteByTitle(linkTarget, m_currentWorkspace);
+        }
     }
 
     if (!targetFile.isEmpty() && QFileInfo::exists(targetFile)) {
@@ -179,6 +236,8 @@ void MainWindow::openWorkspace()
     QString dir = QFileDialog::getExistingDirectory(this, "Select Workspace Directory");
     if (!dir.isEmpty()) {
         m_currentWorkspace = dir;
+        VaultIndex::instance()->setVaultPath(dir);
+        resetSearchIndex(dir);
         m_fileTree->setRootPath(dir);
         m_editor->setWorkspacePath(dir);
         setWindowTitle("Formica - " + dir);
@@ -229,20 +288,22 @@ void MainWindow::newZettel()
 
         QString filePath = QDir(m_currentWorkspace).filePath(fileName);
 
-        // Create and save the file
+        // Create and save the file, never over an existing one
         QFile file(filePath);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (file.open(QIODevice::WriteOnly | QIODevice::NewOnly | QIODevice::Text)) {
             QTextStream out(&file);
             out << content;
             file.close();
 
+            VaultIndex::instance()->addNote(filePath);
+
             // Load the new file in editor
             if (m_editor->loadFile(filePath)) {
-                m_fileTree->refresh();
+                m_fileTree->showFile(filePath);
                 m_statusLabel->setText("Created Zettel: " + zettelId);
             }
         } else {
-            QMessageBox::warning(this, "Error", "Could not create Zettel: " + fileName);
+            QMessageBox::warning(this, "Error", "Could not create Zettel: " + fileName + "\n" + file.errorString());
         }
     }
 }
@@ -270,18 +331,20 @@ void MainWindow::newDailyNote()
         QString content = QString("# Daily Note - %1\n\n## Today\n\n## Tomorrow\n\n## Notes\n\n").arg(today);
 
         QFile file(filePath);
-        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (file.open(QIODevice::WriteOnly | QIODevice::NewOnly | QIODevice::Text)) {
             QTextStream out(&file);
             out << content;
             file.close();
 
+            VaultIndex::instance()->addNote(filePath);
+
             // Load the new file in editor
             if (m_editor->loadFile(filePath)) {
-                m_fileTree->refresh();
+                m_fileTree->showFile(filePath);
                 m_statusLabel->setText("Created daily note: " + today);
             }
         } else {
-            QMessageBox::warning(this, "Error", "Could not create daily note: " + fileName);
+            QMessageBox::warning(this, "Error", "Could not create daily note: " + fileName + "\n" + file.errorString());
         }
     }
 }
@@ -290,7 +353,7 @@ void MainWindow::saveFile()
 {
     if (m_editor->saveFile()) {
         m_statusLabel->setText("File saved");
-        m_fileTree->refresh();
+        VaultIndex::instance()->addNote(m_editor->currentFilePath());
     } else {
         m_statusLabel->setText("Failed to save file");
     }
@@ -304,6 +367,7 @@ void MainWindow::openSearch()
     }
 
     Search searchDialog(m_currentWorkspace, this);
+    searchDialog.setIndex(m_searchIndex);
     connect(&searchDialog, &Search::fileSelected,
             [this](const QString &filePath, int line) {
                 if (m_editor->loadFile(filePath)) {
@@ -315,6 +379,16 @@ void MainWindow::openSearch()
     searchDialog.exec();
 }
 
+void MainWindow::openQuickOpen()
+{
+    if (m_currentWorkspace.isEmpty()) {
+        QMessageBox::information(this, "No Workspace", "Please open a workspace first.");
+        return;
+    }
+
+    m_quickOpen->popup();
+}
+
 void MainWindow::createNewNote(const QString &title)
 {
     LinkParser linkParser;
@@ -342,20 +416,22 @@ void MainWindow::createNewNote(const QString &title)
 
     QString filePath = QDir(m_currentWorkspace).filePath(fileName);
 
-    // Create and save the file
+    // Create and save the file, never over an existing one
     QFile file(filePath);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    if (file.open(QIODevice::WriteOnly | QIODevice::NewOnly | QIODevice::Text)) {
         QTextStream out(&file);
         out << content;
         file.close();
 
+        VaultIndex::instance()->addNote(filePath);
+
         // Load the new file in editor
         if (m_editor->loadFile(filePath)) {
-            m_fileTree->refresh();
+            m_fileTree->showFile(filePath);
             m_statusLabel->setText("Created: " + fileName);
         }
     } else {
-        QMessageBox::warning(this, "Error", "Could not create file: " + fileName);
+        QMessageBox::warning(this, "Error", "Could not create file: " + fileName + "\n" + file.errorString());
     }
 }
 
@@ -402,6 +478,8 @@ void MainWindow::initializeVaultSystem()
 void MainWindow::setCurrentVault(const QString &vaultPath)
 {
     m_currentWorkspace = vaultPath;
+    VaultIndex::instance()->setVaultPath(vaultPath);
+    resetSearchIndex(vaultPath);
     m_fileTree->setRootPath(vaultPath);
     m_editor->setWorkspacePath(vaultPath);
 
@@ -412,6 +490,17 @@ void MainWindow::setCurrentVault(const QString &vaultPath)
     m_statusLabel->setText(QString("Vault: %1").arg(vaultName));
 }
 
+void MainWindow::resetSearchIndex(const QString &vaultPath)
+{
+    // Without a watcher the index falls back to walking the vault
+    m_searchIndex.reset(new SearchIndexHandle);
+    m_searchIndex->index.setVaultPath(vaultPath);
+    m_searchIndex->watched = m_vaultWatcher->isWatching();
+    if (!m_searchIndex->watched) {
+        statusBar()->showMessage("Not watching the vault for changes: " + m_vaultWatcher->errorString(), 5000);
+    }
+}
+
 void MainWindow::selectVault()
 {
     VaultDialog dialog(this);
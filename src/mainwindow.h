@@ -7,10 +7,16 @@
 #include <QHBoxLayout>
 #include <QLineEdit>
 #include <QLabel>
+#include <QSharedPointer>
 
 class FileTree;
 class Editor;
 class Search;
+class QuickOpen;
+class LinkGraph;
+class BacklinksPanel;
+class VaultWatcher;
+struct SearchIndexHandle;
 
 class MainWindow : public QMainWindow
 {
@@ -31,6 +37,7 @@ private slots:
     void newDailyNote();
     void saveFile();
     void openSearch();
+    void openQuickOpen();
     void openPreferences();
     void onFontChanged(const QFont &font);
 
@@ -40,14 +47,21 @@ private:
     void setupConnections();
     void initializeVaultSystem();
     void setCurrentVault(const QString &vaultPath);
+    void resetSearchIndex(const QString &vaultPath);
     void createNewNote(const QString &title);
 
     QWidget *m_centralWidget;
     QSplitter *m_mainSplitter;
     QWidget *m_leftPanel;
+    QSplitter *m_editorSplitter;
 
     FileTree *m_fileTree;
     Editor *m_editor;
+    QuickOpen *m_quickOpen;
+    LinkGraph *m_linkGraph;
+    BacklinksPanel *m_backlinksPanel;
+    VaultWatcher *m_vaultWatcher;
+    QSharedPointer<SearchIndexHandle> m_searchIndex;     // Outlives the search dialogs
     QLineEdit *m_searchBox;
     QLabel *m_statusLabel;
 
@@ -0,0 +1,1969 @@
+#include "markdownparser.h"
+#include <QString>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+inline bool isSpaceOrTab(char ch)
+{
+    return ch == ' ' || ch == '\t';
+}
+
+inline bool isWhitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+inline bool isAsciiPunct(char ch)
+{
+    return (ch >= '!' && ch <= '/') || (ch >= ':' && ch <= '@') || (ch >= '[' && ch <= '`')
+        || (ch >= '{' && ch <= '~');
+}
+
+inline bool isAsciiAlpha(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+inline bool isAsciiDigit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+inline bool isAsciiAlnum(char ch)
+{
+    return isAsciiAlpha(ch) || isAsciiDigit(ch);
+}
+
+inline bool isHexDigit(char ch)
+{
+    return isAsciiDigit(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+}
+
+inline char toLower(char ch)
+{
+    return ch >= 'A' && ch <= 'Z' ? char(ch + 32) : ch;
+}
+
+// Characters inline syntax can start with; everything else is plain text
+inline bool isInlineSpecial(char ch)
+{
+    switch (ch) {
+    case '\n': case '\\': case '`': case '*': case '_':
+    case '[': case ']': case '!': case '<': case '&':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Whether [p, end) starts with word (lower case), ignoring case
+bool startsWithCi(const char *p, const char *end, const char *word)
+{
+    for (; *word; ++word, ++p) {
+        if (p == end || toLower(*p) != *word) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool containsCi(const char *p, const char *end, const char *word)
+{
+    const qptrdiff length = qptrdiff(std::strlen(word));
+    for (; end - p >= length; ++p) {
+        if (startsWithCi(p, end, word)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Length up to and with the first marker at or after from, 0 if none
+int lengthThrough(const char *p, const char *from, const char *end, const char *marker)
+{
+    const size_t length = std::strlen(marker);
+    for (const char *s = from; end - s >= qptrdiff(length); ++s) {
+        if (std::memcmp(s, marker, length) == 0) {
+            return int(s + length - p);
+        }
+    }
+    return 0;
+}
+
+// Length of the HTML tag, comment, processing instruction, declaration or
+// CDATA section at p ('<'), 0 if there is none
+int htmlTagLength(const char *p, const char *end)
+{
+    const char *q = p + 1;
+    if (q == end) {
+        return 0;
+    }
+    if (*q == '!') {
+        if (end - q >= 3 && q[1] == '-' && q[2] == '-') {
+            return lengthThrough(p, p + 2, end, "-->");   // "<!-->" counts too
+        }
+        if (end - q >= 8 && std::memcmp(q, "![CDATA[", 8) == 0) {
+            return lengthThrough(p, q + 8, end, "]]>");
+        }
+        if (end - q >= 2 && isAsciiAlpha(q[1])) {
+            return lengthThrough(p, q + 2, end, ">");
+        }
+        return 0;
+    }
+    if (*q == '?') {
+        return lengthThrough(p, q + 1, end, "?>");
+    }
+
+    const bool closing = *q == '/';
+    if (closing) {
+        ++q;
+    }
+    if (q == end || !isAsciiAlpha(*q)) {
+        return 0;
+    }
+    while (q < end && (isAsciiAlnum(*q) || *q == '-')) {
+        ++q;
+    }
+    if (closing) {
+        while (q < end && isWhitespace(*q)) {
+            ++q;
+        }
+        return q < end && *q == '>' ? int(q + 1 - p) : 0;
+    }
+
+    for (;;) {
+        const char *separator = q;
+        while (q < end && isWhitespace(*q)) {
+            ++q;
+        }
+        if (q == end) {
+            return 0;
+        }
+        if (*q == '>') {
+            return int(q + 1 - p);
+        }
+        if (*q == '/') {
+            return q + 1 < end && q[1] == '>' ? int(q + 2 - p) : 0;
+        }
+        if (q == separator || !(isAsciiAlpha(*q) || *q == '_' || *q == ':')) {
+            return 0;
+        }
+        while (q < end && (isAsciiAlnum(*q) || *q == '_' || *q == '.' || *q == ':' || *q == '-')) {
+            ++q;
+        }
+
+        const char *afterName = q;
+        while (q < end && isWhitespace(*q)) {
+            ++q;
+        }
+        if (q == end || *q != '=') {
+            q = afterName;
+            continue;
+        }
+        ++q;
+        while (q < end && isWhitespace(*q)) {
+            ++q;
+        }
+        if (q == end) {
+            return 0;
+        }
+        if (*q == '"' || *q == '\'') {
+            const void *close = std::memchr(q + 1, *q, size_t(end - q - 1));
+            if (!close) {
+                return 0;
+            }
+            q = static_cast<const char *>(close) + 1;
+        } else {
+            const char *value = q;
+            while (q < end && !isWhitespace(*q) && !std::strchr("\"'=<>`", *q)) {
+                ++q;
+            }
+            if (q == value) {
+                return 0;
+            }
+        }
+    }
+}
+
+// Length of the &name;, &#123; or &#x1f; reference at p, 0 if none
+int entityLength(const char *p, const char *end)
+{
+    const char *q = p + 1;
+    if (q < end && *q == '#') {
+        ++q;
+        const bool hex = q < end && (*q == 'x' || *q == 'X');
+        if (hex) {
+            ++q;
+        }
+        const char *digits = q;
+        while (q < end && (hex ? isHexDigit(*q) : isAsciiDigit(*q))) {
+            ++q;
+        }
+        if (q == digits || q - digits > (hex ? 6 : 7)) {
+            return 0;
+        }
+    } else {
+        const char *name = q;
+        while (q < end && isAsciiAlnum(*q)) {
+            ++q;
+        }
+        if (q - name < 2 || q - name > 32 || !isAsciiAlpha(*name)) {
+            return 0;
+        }
+    }
+    return q < end && *q == ';' ? int(q + 1 - p) : 0;
+}
+
+// Length of the <scheme:...> or <user@host> autolink at p, 0 if none
+int autolinkLength(const char *p, const char *end, bool *email)
+{
+    const char *q = p + 1;
+    const char *scheme = q;
+    while (q < end && (isAsciiAlnum(*q) || *q == '+' || *q == '.' || *q == '-')) {
+        ++q;
+    }
+    if (q < end && *q == ':' && q - scheme >= 2 && q - scheme <= 32 && isAsciiAlpha(*scheme)) {
+        ++q;
+        while (q < end && *q != '>' && *q != '<' && uchar(*q) > ' ') {
+            ++q;
+        }
+        if (q < end && *q == '>') {
+            *email = false;
+            return int(q + 1 - p);
+        }
+        return 0;
+    }
+
+    q = p + 1;
+    const char *local = q;
+    while (q < end && *q && (isAsciiAlnum(*q) || std::strchr(".!#$%&'*+/=?^_`{|}~-", *q))) {
+        ++q;
+    }
+    if (q == local || q == end || *q != '@') {
+        return 0;
+    }
+    ++q;
+    for (;;) {
+        const char *label = q;
+        while (q < end && (isAsciiAlnum(*q) || *q == '-')) {
+            ++q;
+        }
+        if (q == label || q - label > 63 || *label == '-' || q[-1] == '-') {
+            return 0;
+        }
+        if (q < end && *q == '.') {
+            ++q;
+            continue;
+        }
+        break;
+    }
+    if (q < end && *q == '>') {
+        *email = true;
+        return int(q + 1 - p);
+    }
+    return 0;
+}
+
+void appendUtf8(QByteArray *out, uint codePoint)
+{
+    if (codePoint == 0 || codePoint > 0x10ffff || (codePoint >= 0xd800 && codePoint <= 0xdfff)) {
+        codePoint = 0xfffd;
+    }
+    if (codePoint < 0x80) {
+        out->append(char(codePoint));
+    } else if (codePoint < 0x800) {
+        out->append(char(0xc0 | (codePoint >> 6)));
+        out->append(char(0x80 | (codePoint & 0x3f)));
+    } else if (codePoint < 0x10000) {
+        out->append(char(0xe0 | (codePoint >> 12)));
+        out->append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        out->append(char(0x80 | (codePoint & 0x3f)));
+    } else {
+        out->append(char(0xf0 | (codePoint >> 18)));
+        out->append(char(0x80 | ((codePoint >> 12) & 0x3f)));
+        out->append(char(0x80 | ((codePoint >> 6) & 0x3f)));
+        out->append(char(0x80 | (codePoint & 0x3f)));
+    }
+}
+
+// Numeric references become the character; named ones stay as they are,
+// which HTML understands
+void appendEntity(QByteArray *out, const char *p, int length)
+{
+    if (length > 3 && p[1] == '#') {
+        const bool hex = p[2] == 'x' || p[2] == 'X';
+        uint codePoint = 0;
+        for (const char *q = p + (hex ? 3 : 2); *q != ';'; ++q) {
+            codePoint = codePoint * (hex ? 16 : 10)
+                + uint(isAsciiDigit(*q) ? *q - '0' : toLower(*q) - 'a' + 10);
+        }
+        appendUtf8(out, codePoint);
+    } else {
+        out->append(p, length);
+    }
+}
+
+void appendEscaped(QByteArray *out, const char *p, int length, bool codeSpan = false)
+{
+    const char *end = p + length;
+    const char *run = p;
+    for (; p < end; ++p) {
+        const char *replacement;
+        switch (*p) {
+        case '&': replacement = "&amp;"; break;
+        case '<': replacement = "&lt;"; break;
+        case '>': replacement = "&gt;"; break;
+        case '"': replacement = "&quot;"; break;
+        case '\n':
+            if (!codeSpan) {
+                continue;
+            }
+            replacement = " ";
+            break;
+        default:
+            continue;
+        }
+        out->append(run, int(p - run));
+        out->append(replacement);
+        run = p + 1;
+    }
+    out->append(run, int(end - run));
+}
+
+// Text events; a numeric reference may decode to a character that needs
+// escaping, named ones are written as they are
+void appendText(QByteArray *out, const char *text, const MarkdownParser::Event &event)
+{
+    const char *p = text + event.text.start;
+    if (!(event.flags & MarkdownParser::Entity) || p[1] != '#') {
+        if (event.flags & MarkdownParser::Entity) {
+            out->append(p, event.text.length);
+        } else {
+            appendEscaped(out, p, event.text.length);
+        }
+        return;
+    }
+    QByteArray decoded;
+    appendEntity(&decoded, p, event.text.length);
+    appendEscaped(out, decoded.constData(), int(decoded.size()));
+}
+
+// Backslash escapes and entities of link destinations, titles and info
+// strings resolved; autolinks have no backslash escapes
+QByteArray unescaped(const char *p, int length, bool escapes = true)
+{
+    QByteArray result;
+    result.reserve(length);
+    const char *end = p + length;
+    while (p < end) {
+        if (escapes && *p == '\\' && p + 1 < end && isAsciiPunct(p[1])) {
+            result.append(p[1]);
+            p += 2;
+        } else if (*p == '&' && p + 1 < end && p[1] == '#' && entityLength(p, end)) {
+            const int entity = entityLength(p, end);
+            appendEntity(&result, p, entity);
+            p += entity;
+        } else {
+            result.append(*p++);
+        }
+    }
+    return result;
+}
+
+// Link labels match case-insensitively, with runs of whitespace as one
+// space; empty if the label has no other characters
+QByteArray normalizedLabel(const char *p, int length)
+{
+    return QString::fromUtf8(p, length).simplified().toCaseFolded().toUtf8();
+}
+
+// Destinations are percent-encoded where URLs may not carry a character
+void appendHref(QByteArray *out, const QByteArray &url)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (char ch : url) {
+        if (isAsciiAlnum(ch) || (ch && std::strchr("-_.!~*'();/?:@=+$,%#", ch))) {
+            if (ch == '\'') {
+                out->append("&#x27;");
+            } else {
+                out->append(ch);
+            }
+        } else if (ch == '&') {
+            out->append("&amp;");
+        } else {
+            out->append('%');
+            out->append(hex[uchar(ch) >> 4]);
+            out->append(hex[uchar(ch) & 0xf]);
+        }
+    }
+}
+
+const char *const BlockTags[] = {
+    "address", "article", "aside", "base", "basefont", "blockquote", "body", "caption", "center",
+    "col", "colgroup", "dd", "details", "dialog", "dir", "div", "dl", "dt", "fieldset",
+    "figcaption", "figure", "footer", "form", "frame", "frameset", "h1", "h2", "h3", "h4", "h5",
+    "h6", "head", "header", "hr", "html", "iframe", "legend", "li", "link", "main", "menu",
+    "menuitem", "nav", "noframes", "ol", "optgroup", "option", "p", "param", "search", "section",
+    "summary", "table", "tbody", "td", "tfoot", "th", "thead", "title", "tr", "track", "ul",
+};
+
+const char *const RawTags[] = {"pre", "script", "style", "textarea"};
+
+} // namespace
+
+void MarkdownParser::parse(const char *utf8, int size)
+{
+    m_source = utf8;
+    m_size = size;
+    m_events.clear();
+    m_text.clear();
+    m_events.reserve(size / 16 + 16);
+    m_text.reserve(size + 64);
+    m_containers.clear();
+    m_leaf = NoLeaf;
+    m_lines.clear();
+    m_definitions.clear();
+    m_inlineBlocks.clear();
+    m_lineMap.clear();
+
+    int lineStart = 0;
+    while (lineStart < size) {
+        const void *newline = std::memchr(utf8 + lineStart, '\n', size_t(size - lineStart));
+        int lineEnd = newline ? int(static_cast<const char *>(newline) - utf8) : size;
+        const int next = newline ? lineEnd + 1 : size;
+        if (lineEnd > lineStart && utf8[lineEnd - 1] == '\r') {
+            --lineEnd;
+        }
+        addLine(lineStart, lineEnd);
+        lineStart = next;
+    }
+    closeUnmatched(0);
+
+    // Every definition is known now; inlines go between the Enter and Exit
+    // events of their blocks
+    m_blockEvents.swap(m_events);
+    m_events.clear();
+    m_events.reserve(m_blockEvents.size() + size / 16);
+    int next = 0;
+    for (const InlineBlock &block : std::as_const(m_inlineBlocks)) {
+        while (next <= block.event) {
+            m_events.append(m_blockEvents.at(next++));
+        }
+        m_mapStart = block.mapStart;
+        m_mapEnd = block.mapEnd;
+        parseInlines(block.start, block.end);
+    }
+    while (next < m_blockEvents.size()) {
+        m_events.append(m_blockEvents.at(next++));
+    }
+}
+
+void MarkdownParser::addLine(int lineStart, int lineEnd)
+{
+    // A list item that goes on after a blank line no longer ends in one;
+    // ">" alone is blank inside its block quote
+    const bool blank = processLine(lineStart, lineEnd);
+    for (Container &container : m_containers) {
+        container.end = lineEnd;
+        if (!blank) {
+            container.blank = false;
+        }
+    }
+}
+
+bool MarkdownParser::processLine(int lineStart, int lineEnd)
+{
+    int pos = lineStart;
+    int column = 0;
+
+    // Which open containers the line continues
+    const int open = m_containers.size();
+    int matched = 0;
+    for (; matched < open; ++matched) {
+        const Container &container = m_containers.at(matched);
+        int nsColumn = column;
+        const int ns = skipSpaces(pos, lineEnd, &nsColumn);
+        const int indent = nsColumn - column;
+        const bool blank = ns == lineEnd;
+
+        if (container.kind == BlockQuote) {
+            if (indent > 3 || blank || m_source[ns] != '>') {
+                break;
+            }
+            pos = ns + 1;
+            column = nsColumn + 1;
+            if (pos < lineEnd && isSpaceOrTab(m_source[pos])) {
+                column += m_source[pos] == '\t' ? 4 - column % 4 : 1;
+                ++pos;
+            }
+        } else if (container.kind == ListItem) {
+            if (blank) {
+                // An item can start with at most one blank line
+                if (container.emptyStart) {
+                    break;
+                }
+                pos = ns;
+                column = nsColumn;
+            } else if (indent >= container.width) {
+                pos = skipColumns(pos, lineEnd, &column, container.width);
+            } else {
+                break;
+            }
+        }
+        // Lists are continued by their items
+    }
+    const bool allMatched = matched == open;
+
+    // Code and HTML blocks take their lines as they come
+    if (allMatched && m_leaf == FencedCodeLeaf) {
+        int nsColumn = column;
+        const int ns = skipSpaces(pos, lineEnd, &nsColumn);
+        if (nsColumn - column <= 3 && isClosingFence(ns, lineEnd)) {
+            m_leafEnd = lineEnd;
+            closeLeaf();
+            return false;
+        }
+        pos = skipColumns(pos, lineEnd, &column, m_fenceIndent);
+        m_lines.append({pos, lineEnd - pos});
+        m_leafEnd = lineEnd;
+        return false;
+    }
+    if (allMatched && m_leaf == HtmlLeaf) {
+        if (m_htmlType >= 6 && isBlank(pos, lineEnd)) {
+            closeLeaf();
+        } else {
+            m_lines.append({pos, lineEnd - pos});
+            m_leafEnd = lineEnd;
+            if (htmlBlockEnds(pos, lineEnd)) {
+                closeLeaf();
+            }
+            return false;
+        }
+    }
+
+    // New blocks, containers first
+    bool opened = false;
+    for (;;) {
+        int nsColumn = column;
+        const int ns = skipSpaces(pos, lineEnd, &nsColumn);
+        const int indent = nsColumn - column;
+        if (ns == lineEnd) {
+            break;
+        }
+        // Only lines that would continue a paragraph are kept from
+        // interrupting it by some blocks; lazy ones are not
+        const bool inParagraph = m_leaf == ParagraphLeaf && !opened;
+        const bool interrupts = inParagraph && allMatched;
+
+        if (indent >= 4) {
+            if (inParagraph) {
+                break;  // Continuation text
+            }
+            if (m_leaf == IndentedCodeLeaf && allMatched && !opened) {
+                pos = skipColumns(pos, lineEnd, &column, 4);
+                m_lines.append({pos, lineEnd - pos});
+                m_leafEnd = lineEnd;
+                return false;
+            }
+            closeUnmatched(matched);
+            openLeaf(IndentedCodeLeaf, pos);
+            pos = skipColumns(pos, lineEnd, &column, 4);
+            m_lines.append({pos, lineEnd - pos});
+            m_leafEnd = lineEnd;
+            return false;
+        }
+
+        const char ch = m_source[ns];
+        if (ch == '>') {
+            closeUnmatched(matched);
+            openContainer(BlockQuote, ns);
+            pos = ns + 1;
+            column = nsColumn + 1;
+            if (pos < lineEnd && isSpaceOrTab(m_source[pos])) {
+                column += m_source[pos] == '\t' ? 4 - column % 4 : 1;
+                ++pos;
+            }
+            matched = m_containers.size();
+            opened = true;
+            continue;
+        }
+
+        if (ch == '#') {
+            const int level = atxLevel(ns, lineEnd);
+            if (level) {
+                closeUnmatched(matched);
+                addHeading(ns, lineEnd, level);
+                return false;
+            }
+        }
+
+        if (ch == '`' || ch == '~') {
+            const int length = fenceLength(ns, lineEnd);
+            if (length) {
+                closeUnmatched(matched);
+                openLeaf(FencedCodeLeaf, ns);
+                m_fenceChar = ch;
+                m_fenceLength = length;
+                m_fenceIndent = indent;
+                int infoStart = ns + length;
+                while (infoStart < lineEnd && isSpaceOrTab(m_source[infoStart])) {
+                    ++infoStart;
+                }
+                int infoEnd = lineEnd;
+                while (infoEnd > infoStart && isSpaceOrTab(m_source[infoEnd - 1])) {
+                    --infoEnd;
+                }
+                m_info = {infoStart, infoEnd - infoStart};
+                m_leafEnd = lineEnd;
+                return false;
+            }
+        }
+
+        if (ch == '<') {
+            const int type = htmlBlockStart(ns, lineEnd, interrupts);
+            if (type) {
+                closeUnmatched(matched);
+                openLeaf(HtmlLeaf, pos);
+                m_htmlType = type;
+                m_lines.append({pos, lineEnd - pos});
+                m_leafEnd = lineEnd;
+                if (htmlBlockEnds(ns + 1, lineEnd)) {
+                    closeLeaf();
+                }
+                return false;
+            }
+        }
+
+        if (interrupts && (ch == '=' || ch == '-')) {
+            const int level = setextLevel(ns, lineEnd);
+            if (level && !takeDefinitions()) {
+                // The paragraph held only definitions, the line is no underline
+                m_leaf = NoLeaf;
+                m_lines.clear();
+                continue;
+            }
+            if (level) {
+                const Span source = {m_lines.first().start, lineEnd - m_lines.first().start};
+                addInlineBlock(Heading, level, source);
+                m_leaf = NoLeaf;
+                m_lines.clear();
+                return false;
+            }
+        }
+
+        if ((ch == '*' || ch == '-' || ch == '_') && isThematicBreak(ns, lineEnd)) {
+            closeUnmatched(matched);
+            addChild(ThematicBreak);
+            Event event;
+            event.type = Leaf;
+            event.kind = ThematicBreak;
+            event.source = {ns, lineEnd - ns};
+            m_events.append(event);
+            return false;
+        }
+
+        ListMarker marker;
+        if (listMarker(ns, lineEnd, nsColumn, indent, interrupts, &marker)) {
+            closeUnmatched(matched);
+            addListItem(marker, ns);
+            pos = marker.contentPos;
+            column = marker.contentColumn;
+            matched = m_containers.size();
+            opened = true;
+            continue;
+        }
+        break;
+    }
+
+    int nsColumn = column;
+    const int ns = skipSpaces(pos, lineEnd, &nsColumn);
+    if (ns == lineEnd) {
+        // Blank lines stay in indented code, trailing ones are dropped later
+        if (!opened && allMatched && m_leaf == IndentedCodeLeaf) {
+            pos = skipColumns(pos, lineEnd, &column, 4);
+            m_lines.append({pos, lineEnd - pos});
+            return true;
+        }
+        closeUnmatched(matched);
+        if (!opened && !m_containers.isEmpty()) {
+            // An empty item ends here, its list still sees the blank line
+            Container &last = m_containers.last();
+            if (last.kind == ListItem) {
+                last.blank = true;
+            } else if (last.kind == List) {
+                last.lastItemBlank = true;
+            }
+        }
+        return true;
+    }
+
+    // Paragraph continuation, lazy if not all containers matched
+    if (m_leaf == ParagraphLeaf && !opened) {
+        m_lines.append({ns, lineEnd - ns});
+        m_leafEnd = lineEnd;
+        return false;
+    }
+    closeUnmatched(matched);
+    openLeaf(ParagraphLeaf, ns);
+    m_lines.append({ns, lineEnd - ns});
+    m_leafEnd = lineEnd;
+    return false;
+}
+
+int MarkdownParser::skipSpaces(int pos, int lineEnd, int *column) const
+{
+    for (; pos < lineEnd; ++pos) {
+        if (m_source[pos] == ' ') {
+            ++*column;
+        } else if (m_source[pos] == '\t') {
+            *column += 4 - *column % 4;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// Up to columns of indentation; a tab reaching past them is taken whole
+int MarkdownParser::skipColumns(int pos, int lineEnd, int *column, int columns) const
+{
+    const int target = *column + columns;
+    for (; pos < lineEnd && *column < target; ++pos) {
+        if (m_source[pos] == ' ') {
+            ++*column;
+        } else if (m_source[pos] == '\t') {
+            *column += 4 - *column % 4;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+bool MarkdownParser::isBlank(int pos, int lineEnd) const
+{
+    for (; pos < lineEnd; ++pos) {
+        if (!isSpaceOrTab(m_source[pos])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int MarkdownParser::atxLevel(int pos, int lineEnd) const
+{
+    int level = 0;
+    while (pos + level < lineEnd && m_source[pos + level] == '#' && level < 7) {
+        ++level;
+    }
+    if (level > 6 || (pos + level < lineEnd && !isSpaceOrTab(m_source[pos + level]))) {
+        return 0;
+    }
+    return level;
+}
+
+int MarkdownParser::setextLevel(int pos, int lineEnd) const
+{
+    const char ch = m_source[pos];
+    int end = pos;
+    while (end < lineEnd && m_source[end] == ch) {
+        ++end;
+    }
+    if (!isBlank(end, lineEnd)) {
+        return 0;
+    }
+    return ch == '=' ? 1 : 2;
+}
+
+bool MarkdownParser::isThematicBreak(int pos, int lineEnd) const
+{
+    const char ch = m_source[pos];
+    int count = 0;
+    for (; pos < lineEnd; ++pos) {
+        if (m_source[pos] == ch) {
+            ++count;
+        } else if (!isSpaceOrTab(m_source[pos])) {
+            return false;
+        }
+    }
+    return count >= 3;
+}
+
+int MarkdownParser::fenceLength(int pos, int lineEnd) const
+{
+    const char ch = m_source[pos];
+    int length = 0;
+    while (pos + length < lineEnd && m_source[pos + length] == ch) {
+        ++length;
+    }
+    if (length < 3) {
+        return 0;
+    }
+    // Backtick fences would read as code spans with one in the info string
+    if (ch == '`' && std::memchr(m_source + pos + length, '`', size_t(lineEnd - pos - length))) {
+        return 0;
+    }
+    return length;
+}
+
+bool MarkdownParser::isClosingFence(int pos, int lineEnd) const
+{
+    int length = 0;
+    while (pos + length < lineEnd && m_source[pos + length] == m_fenceChar) {
+        ++length;
+    }
+    return length >= m_fenceLength && isBlank(pos + length, lineEnd);
+}
+
+// The kind of HTML block (1 to 7, see the spec) starting at pos, 0 if none
+int MarkdownParser::htmlBlockStart(int pos, int lineEnd, bool interrupts) const
+{
+    const char *p = m_source + pos;
+    const char *end = m_source + lineEnd;
+    auto endsTag = [&](const char *q) {
+        return q == end || isSpaceOrTab(*q) || *q == '>' || (*q == '/' && q + 1 < end && q[1] == '>');
+    };
+
+    for (const char *tag : RawTags) {
+        const char *q = p + 1 + std::strlen(tag);
+        if (startsWithCi(p + 1, end, tag) && (q == end || isSpaceOrTab(*q) || *q == '>')) {
+            return 1;
+        }
+    }
+    if (startsWithCi(p, end, "<!--")) {
+        return 2;
+    }
+    if (startsWithCi(p, end, "<?")) {
+        return 3;
+    }
+    if (end - p >= 3 && p[1] == '!' && isAsciiAlpha(p[2])) {
+        return 4;
+    }
+    if (startsWithCi(p, end, "<![cdata[")) {
+        return 5;
+    }
+
+    const char *name = p + 1 < end && p[1] == '/' ? p + 2 : p + 1;
+    for (const char *tag : BlockTags) {
+        if (startsWithCi(name, end, tag) && endsTag(name + std::strlen(tag))) {
+            return 6;
+        }
+    }
+
+    // Any complete tag alone on its line, but not in the middle of a paragraph
+    const int length = htmlTagLength(p, end);
+    if (!interrupts && length && isBlank(pos + length, lineEnd)) {
+        for (const char *tag : RawTags) {
+            if (startsWithCi(p + 1, end, tag)) {
+                return 0;
+            }
+        }
+        return 7;
+    }
+    return 0;
+}
+
+bool MarkdownParser::htmlBlockEnds(int pos, int lineEnd) const
+{
+    const char *p = m_source + pos;
+    const char *end = m_source + lineEnd;
+    switch (m_htmlType) {
+    case 1:
+        return containsCi(p, end, "</pre>") || containsCi(p, end, "</script>")
+            || containsCi(p, end, "</style>") || containsCi(p, end, "</textarea>");
+    case 2:
+        return containsCi(p, end, "-->");
+    case 3:
+        return containsCi(p, end, "?>");
+    case 4:
+        return std::memchr(p, '>', size_t(end - p)) != nullptr;
+    case 5:
+        return containsCi(p, end, "]]>");
+    default:
+        return false;   // Ends before a blank line
+    }
+}
+
+bool MarkdownParser::listMarker(int pos, int lineEnd, int column, int indent, bool interrupts,
+                                ListMarker *marker) const
+{
+    int p = pos;
+    const char ch = m_source[p];
+    if (ch == '-' || ch == '+' || ch == '*') {
+        marker->marker = ch;
+        ++p;
+    } else if (isAsciiDigit(ch)) {
+        int number = 0;
+        while (p < lineEnd && isAsciiDigit(m_source[p]) && p - pos < 9) {
+            number = number * 10 + (m_source[p++] - '0');
+        }
+        if (p == lineEnd || (m_source[p] != '.' && m_source[p] != ')')) {
+            return false;
+        }
+        marker->marker = m_source[p++];
+        marker->ordered = true;
+        marker->number = number;
+    } else {
+        return false;
+    }
+    if (p < lineEnd && !isSpaceOrTab(m_source[p])) {
+        return false;
+    }
+
+    const int markerColumn = column + (p - pos);
+    int contentColumn = markerColumn;
+    const int content = skipSpaces(p, lineEnd, &contentColumn);
+    const bool blank = content == lineEnd;
+    marker->blank = blank;
+    if (interrupts && (blank || (marker->ordered && marker->number != 1))) {
+        return false;   // Only some items may interrupt a paragraph
+    }
+
+    // Content indented by five or more is indented code after one space
+    const int spaces = contentColumn - markerColumn;
+    if (blank || spaces > 4) {
+        marker->width = indent + (p - pos) + 1;
+        marker->contentColumn = markerColumn;
+        marker->contentPos = blank ? content : skipColumns(p, lineEnd, &marker->contentColumn, 1);
+        if (blank) {
+            marker->contentColumn = contentColumn;
+        }
+    } else {
+        marker->width = indent + (p - pos) + spaces;
+        marker->contentPos = content;
+        marker->contentColumn = contentColumn;
+    }
+    return true;
+}
+
+// Lists only hold items; a list item's first child after a blank line
+// makes its list loose
+void MarkdownParser::addChild(Kind kind)
+{
+    if (!m_containers.isEmpty() && m_containers.last().kind == List && kind != ListItem) {
+        closeContainer();
+    }
+    if (!m_containers.isEmpty() && m_containers.last().kind == ListItem) {
+        Container &item = m_containers.last();
+        if (item.blank) {
+            m_containers[m_containers.size() - 2].loose = true;
+        }
+        item.emptyStart = false;
+    }
+}
+
+void MarkdownParser::openContainer(Kind kind, int start)
+{
+    addChild(kind);
+
+    Container container;
+    container.kind = kind;
+    container.event = m_events.size();
+    container.end = start;
+    m_containers.append(container);
+
+    Event event;
+    event.type = Enter;
+    event.kind = kind;
+    event.source = {start, 0};
+    m_events.append(event);
+}
+
+void MarkdownParser::addListItem(const ListMarker &marker, int start)
+{
+    const bool continues = !m_containers.isEmpty() && m_containers.last().kind == List
+        && m_containers.last().marker == marker.marker;
+    if (continues) {
+        Container &list = m_containers.last();
+        if (list.lastItemBlank) {
+            list.loose = true;
+        }
+    } else {
+        openContainer(List, start);
+        Container &list = m_containers.last();
+        list.marker = marker.marker;
+        list.nextNumber = marker.number;
+        Event &event = m_events[list.event];
+        event.flags = marker.ordered ? Ordered : 0;
+        event.number = marker.number;
+    }
+
+    const int number = m_containers.last().nextNumber++;
+    openContainer(ListItem, start);
+    Container &item = m_containers.last();
+    item.width = marker.width;
+    item.emptyStart = marker.blank;
+    Event &event = m_events[item.event];
+    event.flags = marker.ordered ? Ordered : 0;
+    event.number = marker.ordered ? number : 0;
+}
+
+void MarkdownParser::closeContainer()
+{
+    const Container container = m_containers.takeLast();
+    Event &enter = m_events[container.event];
+    enter.source.length = qMax(0, container.end - enter.source.start);
+    if (container.kind == List && !container.loose) {
+        enter.flags |= Tight;
+    }
+    Event exit = enter;
+    exit.type = Exit;
+    m_events.append(exit);
+
+    if (m_containers.isEmpty()) {
+        return;
+    }
+    Container &parent = m_containers.last();
+    if (container.kind == ListItem) {
+        parent.lastItemBlank = container.blank;
+    } else if (container.kind == List && parent.kind == ListItem && container.lastItemBlank) {
+        parent.blank = true;    // Ends in a blank line as well
+    }
+}
+
+void MarkdownParser::closeUnmatched(int matched)
+{
+    closeLeaf();
+    while (m_containers.size() > matched) {
+        closeContainer();
+    }
+}
+
+void MarkdownParser::openLeaf(LeafKind kind, int start)
+{
+    addChild(kind == ParagraphLeaf ? Paragraph : kind == HtmlLeaf ? HtmlBlock : CodeBlock);
+    m_leaf = kind;
+    m_leafStart = start;
+    m_leafEnd = start;
+    m_lines.clear();
+    m_info = Span();
+}
+
+void MarkdownParser::closeLeaf()
+{
+    switch (m_leaf) {
+    case NoLeaf:
+        return;
+    case ParagraphLeaf:
+        if (takeDefinitions()) {
+            const int start = m_lines.first().start;
+            addInlineBlock(Paragraph, 0, {start, m_leafEnd - start});
+        }
+        break;
+    case IndentedCodeLeaf:
+        while (!m_lines.isEmpty() && isBlank(m_lines.last().start, m_lines.last().end())) {
+            m_lines.removeLast();
+        }
+        addLiteralBlock(CodeBlock, Text, {m_leafStart, m_leafEnd - m_leafStart}, Span());
+        break;
+    case FencedCodeLeaf:
+        addLiteralBlock(CodeBlock, Text, {m_leafStart, m_leafEnd - m_leafStart}, m_info);
+        break;
+    case HtmlLeaf:
+        addLiteralBlock(HtmlBlock, Html, {m_leafStart, m_leafEnd - m_leafStart}, Span());
+        break;
+    }
+    m_leaf = NoLeaf;
+    m_lines.clear();
+}
+
+void MarkdownParser::addHeading(int pos, int lineEnd, int level)
+{
+    addChild(Heading);
+
+    // Content without the opening and an optional closing run of '#'
+    int start = pos + level;
+    while (start < lineEnd && isSpaceOrTab(m_source[start])) {
+        ++start;
+    }
+    int end = lineEnd;
+    while (end > start && isSpaceOrTab(m_source[end - 1])) {
+        --end;
+    }
+    int hashes = end;
+    while (hashes > start && m_source[hashes - 1] == '#') {
+        --hashes;
+    }
+    if (hashes == start || (hashes < end && isSpaceOrTab(m_source[hashes - 1]))) {
+        end = hashes;
+        while (end > start && isSpaceOrTab(m_source[end - 1])) {
+            --end;
+        }
+    }
+
+    m_lines.clear();
+    m_lines.append({start, end - start});
+    addInlineBlock(Heading, level, {pos, lineEnd - pos});
+    m_lines.clear();
+}
+
+// A paragraph or heading from m_lines, which start at their first non-blank
+void MarkdownParser::addInlineBlock(Kind kind, int level, Span source)
+{
+    const int base = m_text.size();
+    const int mapStart = m_lineMap.size();
+    for (int i = 0; i < m_lines.size(); ++i) {
+        const Span &line = m_lines.at(i);
+        int length = line.length;
+        if (i == m_lines.size() - 1) {
+            while (length > 0 && isSpaceOrTab(m_source[line.start + length - 1])) {
+                --length;
+            }
+        }
+        if (i > 0) {
+            m_text.append('\n');
+        }
+        m_lineMap.append({int(m_text.size()), line.start});
+        m_text.append(m_source + line.start, length);
+    }
+
+    Event enter;
+    enter.type = Enter;
+    enter.kind = kind;
+    enter.level = quint8(level);
+    enter.source = source;
+    m_inlineBlocks.append({int(m_events.size()), base, int(m_text.size()), mapStart, int(m_lineMap.size())});
+    m_events.append(enter);
+
+    enter.type = Exit;
+    m_events.append(enter);
+}
+
+// Code and HTML blocks: one event per line, the newline included
+void MarkdownParser::addLiteralBlock(Kind blockKind, Kind lineKind, Span source, Span info)
+{
+    Event enter;
+    enter.type = Enter;
+    enter.kind = blockKind;
+    enter.source = source;
+    if (info.length) {
+        enter.text = {int(m_text.size()), info.length};
+        m_text.append(m_source + info.start, info.length);
+    }
+    m_events.append(enter);
+
+    for (const Span &line : std::as_const(m_lines)) {
+        Event event;
+        event.type = Leaf;
+        event.kind = lineKind;
+        event.source = line;
+        event.text = {int(m_text.size()), line.length + 1};
+        m_text.append(m_source + line.start, line.length);
+        m_text.append('\n');
+        m_events.append(event);
+    }
+
+    enter.type = Exit;
+    m_events.append(enter);
+}
+
+// Link reference definitions opening the paragraph in m_lines are taken
+// out of it and remembered; returns whether any of it is left
+bool MarkdownParser::takeDefinitions()
+{
+    if (m_lines.isEmpty() || m_source[m_lines.first().start] != '[') {
+        return !m_lines.isEmpty();
+    }
+
+    // Definitions may span lines: they are read from the lines joined the
+    // way addInlineBlock joins them, and their spans point there
+    const int base = m_text.size();
+    for (int i = 0; i < m_lines.size(); ++i) {
+        if (i > 0) {
+            m_text.append('\n');
+        }
+        m_text.append(m_source + m_lines.at(i).start, m_lines.at(i).length);
+    }
+    const int end = m_text.size();
+    int pos = base;
+    while (pos < end && m_text.at(pos) == '[') {
+        const int next = definition(pos, end);
+        if (!next) {
+            break;
+        }
+        pos = next;
+    }
+
+    const char *text = m_text.constData();
+    const int lines = int(std::count(text + base, text + pos, '\n')) + (pos == end ? 1 : 0);
+    m_text.truncate(pos);
+    m_lines.remove(0, lines);
+    return !m_lines.isEmpty();
+}
+
+// The link reference definition at pos in m_text, up to the end of its
+// last line; returns where the text after it starts, 0 if there is none
+int MarkdownParser::definition(int pos, int end)
+{
+    const char *text = m_text.constData();
+    const int labelEnd = linkLabel(pos, end);
+    if (labelEnd < 0 || labelEnd + 1 >= end || text[labelEnd + 1] != ':') {
+        return 0;
+    }
+    const QByteArray label = normalizedLabel(text + pos + 1, labelEnd - pos - 1);
+    if (label.isEmpty()) {
+        return 0;
+    }
+
+    // Spaces with at most one line ending
+    auto skipWhitespace = [&](int p) {
+        bool newline = false;
+        while (p < end && (isSpaceOrTab(text[p]) || (text[p] == '\n' && !newline))) {
+            newline = newline || text[p] == '\n';
+            ++p;
+        }
+        return p;
+    };
+    // Start of the next line if only spaces are left on this one
+    auto nextLine = [&](int p) {
+        while (p < end && isSpaceOrTab(text[p])) {
+            ++p;
+        }
+        if (p == end) {
+            return end;
+        }
+        return text[p] == '\n' ? p + 1 : 0;
+    };
+    auto add = [&](const Definition &found) {
+        if (!m_definitions.contains(label)) {
+            m_definitions.insert(label, found);     // The first one counts
+        }
+    };
+
+    Definition result;
+    const int urlStart = skipWhitespace(labelEnd + 2);
+    const int afterUrl = linkDestination(urlStart, end, &result.url);
+    if (afterUrl <= urlStart) {
+        return 0;   // Only <> may be empty
+    }
+
+    // The title is separated by whitespace; one that does not end its line
+    // leaves the definition without
+    const int titleStart = skipWhitespace(afterUrl);
+    if (titleStart > afterUrl) {
+        const int afterTitle = linkTitle(titleStart, end, &result.title);
+        const int next = afterTitle > 0 ? nextLine(afterTitle) : 0;
+        if (next) {
+            add(result);
+            return next;
+        }
+    }
+    const int next = nextLine(afterUrl);
+    if (next) {
+        result.title = Span();
+        add(result);
+    }
+    return next;
+}
+
+void MarkdownParser::parseInlines(int start, int end)
+{
+    m_inlines.clear();
+    m_inlines.append(Inline());     // Head of the list
+    m_inlineTail = 0;
+    m_delimiters.clear();
+    m_brackets.clear();
+
+    const char *text = m_text.constData();
+    int pos = start;
+    int textStart = start;          // Of the plain text not yet added
+    auto flush = [&](int upTo) {
+        if (upTo > textStart) {
+            appendInline(Text, Leaf, textStart, upTo - textStart);
+        }
+    };
+
+    while (pos < end) {
+        const char ch = text[pos];
+        if (!isInlineSpecial(ch)) {
+            ++pos;
+            continue;
+        }
+
+        switch (ch) {
+        case '\n': {
+            // Two spaces before the line end make a hard break
+            int trailing = pos;
+            while (trailing > textStart && text[trailing - 1] == ' ') {
+                --trailing;
+            }
+            flush(trailing);
+            appendInline(pos - trailing >= 2 ? HardBreak : SoftBreak, Leaf, pos, 1);
+            textStart = ++pos;
+            break;
+        }
+        case '\\':
+            if (pos + 1 < end && text[pos + 1] == '\n') {
+                flush(pos);
+                appendInline(HardBreak, Leaf, pos, 2);
+                textStart = pos += 2;
+            } else if (pos + 1 < end && isAsciiPunct(text[pos + 1])) {
+                flush(pos);
+                appendInline(Text, Leaf, pos + 1, 1);
+                textStart = pos += 2;
+            } else {
+                ++pos;
+            }
+            break;
+        case '`': {
+            int run = 1;
+            while (pos + run < end && text[pos + run] == '`') {
+                ++run;
+            }
+            // The closing run has the same length
+            int close = pos + run;
+            int closeRun = 0;
+            while (close < end) {
+                const void *tick = std::memchr(text + close, '`', size_t(end - close));
+                if (!tick) {
+                    close = end;
+                    break;
+                }
+                close = int(static_cast<const char *>(tick) - text);
+                closeRun = 1;
+                while (close + closeRun < end && text[close + closeRun] == '`') {
+                    ++closeRun;
+                }
+                if (closeRun == run) {
+                    break;
+                }
+                close += closeRun;
+            }
+            if (close == end) {
+                pos += run;     // Literal backticks
+                break;
+            }
+            flush(pos);
+            int contentStart = pos + run;
+            int contentEnd = close;
+            bool allSpace = true;
+            for (int i = contentStart; i < contentEnd; ++i) {
+                if (text[i] != ' ' && text[i] != '\n') {
+                    allSpace = false;
+                    break;
+                }
+            }
+            if (!allSpace && contentEnd - contentStart >= 2
+                && (text[contentStart] == ' ' || text[contentStart] == '\n')
+                && (text[contentEnd - 1] == ' ' || text[contentEnd - 1] == '\n')) {
+                ++contentStart;
+                --contentEnd;
+            }
+            appendInline(Code, Leaf, contentStart, contentEnd - contentStart);
+            textStart = pos = close + run;
+            break;
+        }
+        case '*':
+        case '_': {
+            int run = 1;
+            while (pos + run < end && text[pos + run] == ch) {
+                ++run;
+            }
+            // Flanking as the spec defines it, non-ASCII counting as letters
+            const char before = pos == start ? '\n' : text[pos - 1];
+            const char after = pos + run == end ? '\n' : text[pos + run];
+            const bool leftFlanking = !isWhitespace(after)
+                && (!isAsciiPunct(after) || isWhitespace(before) || isAsciiPunct(before));
+            const bool rightFlanking = !isWhitespace(before)
+                && (!isAsciiPunct(before) || isWhitespace(after) || isAsciiPunct(after));
+            bool canOpen = leftFlanking;
+            bool canClose = rightFlanking;
+            if (ch == '_') {
+                canOpen = leftFlanking && (!rightFlanking || isAsciiPunct(before));
+                canClose = rightFlanking && (!leftFlanking || isAsciiPunct(after));
+            }
+
+            flush(pos);
+            const int node = appendInline(Text, Leaf, pos, run);
+            if (canOpen || canClose) {
+                m_delimiters.append({node, ch, run, run, canOpen, canClose, false});
+            }
+            textStart = pos += run;
+            break;
+        }
+        case '!':
+            if (pos + 1 < end && text[pos + 1] == '[') {
+                flush(pos);
+                const int node = appendInline(Text, Leaf, pos, 2);
+                if (!m_brackets.isEmpty()) {
+                    m_brackets.last().bracketAfter = true;
+                }
+                m_brackets.append({node, int(m_delimiters.size()), true, true, false});
+                textStart = pos += 2;
+            } else {
+                ++pos;
+            }
+            break;
+        case '[': {
+            flush(pos);
+            const int node = appendInline(Text, Leaf, pos, 1);
+            if (!m_brackets.isEmpty()) {
+                m_brackets.last().bracketAfter = true;
+            }
+            m_brackets.append({node, int(m_delimiters.size()), false, true, false});
+            textStart = ++pos;
+            break;
+        }
+        case ']':
+            flush(pos);
+            textStart = pos = closeBracket(pos, end);
+            break;
+        case '<': {
+            bool email = false;
+            int length = autolinkLength(text + pos, text + end, &email);
+            if (length) {
+                flush(pos);
+                const int enter = appendInline(Link, Enter, pos, 1);
+                m_inlines[enter].url = {pos + 1, length - 2};
+                m_inlines[enter].flags = Autolink | (email ? Email : 0);
+                appendInline(Text, Leaf, pos + 1, length - 2);
+                const int exit = appendInline(Link, Exit, pos + length - 1, 1);
+                m_inlines[exit].url = m_inlines[enter].url;
+                m_inlines[exit].flags = m_inlines[enter].flags;
+                textStart = pos += length;
+                break;
+            }
+            length = htmlTagLength(text + pos, text + end);
+            if (length) {
+                flush(pos);
+                appendInline(Html, Leaf, pos, length);
+                textStart = pos += length;
+                break;
+            }
+            ++pos;
+            break;
+        }
+        case '&': {
+            const int length = entityLength(text + pos, text + end);
+            if (length) {
+                flush(pos);
+                const int node = appendInline(Text, Leaf, pos, length);
+                m_inlines[node].flags = Entity;
+                textStart = pos += length;
+            } else {
+                ++pos;
+            }
+            break;
+        }
+        }
+    }
+    flush(end);
+    processEmphasis(0);
+
+    for (int i = m_inlines.at(0).next; i != -1; i = m_inlines.at(i).next) {
+        const Inline &node = m_inlines.at(i);
+        if (node.type == Leaf && node.kind == Text && node.length == 0) {
+            continue;   // A delimiter run used up by emphasis
+        }
+        Event event;
+        event.type = node.type;
+        event.kind = node.kind;
+        event.flags = node.flags;
+        event.source = sourceSpan(node.start, node.length);
+        if (node.type == Leaf) {
+            event.text = {node.start, node.length};
+        }
+        event.url = node.url;
+        event.title = node.title;
+        m_events.append(event);
+    }
+}
+
+int MarkdownParser::appendInline(Kind kind, Type type, int start, int length)
+{
+    return insertInline(m_inlineTail, kind, type, start, length);
+}
+
+int MarkdownParser::insertInline(int after, Kind kind, Type type, int start, int length)
+{
+    Inline node;
+    node.kind = kind;
+    node.type = type;
+    node.start = start;
+    node.length = length;
+    node.prev = after;
+    node.next = m_inlines.at(after).next;
+    const int index = m_inlines.size();
+    m_inlines.append(node);
+    m_inlines[after].next = index;
+    if (node.next != -1) {
+        m_inlines[node.next].prev = index;
+    } else {
+        m_inlineTail = index;
+    }
+    return index;
+}
+
+void MarkdownParser::unlinkInline(int node)
+{
+    const Inline &inline_ = m_inlines.at(node);
+    m_inlines[inline_.prev].next = inline_.next;
+    if (inline_.next != -1) {
+        m_inlines[inline_.next].prev = inline_.prev;
+    } else {
+        m_inlineTail = inline_.prev;
+    }
+}
+
+// A ']' at pos: a link or image if an open bracket and a (destination
+// "title") or a defined label follow, literal text otherwise
+int MarkdownParser::closeBracket(int pos, int end)
+{
+    if (m_brackets.isEmpty()) {
+        appendInline(Text, Leaf, pos, 1);
+        return pos + 1;
+    }
+    const Bracket bracket = m_brackets.takeLast();
+    if (!bracket.active) {
+        appendInline(Text, Leaf, pos, 1);
+        return pos + 1;
+    }
+    Span url;
+    Span title;
+    int after = 0;
+    bool found = pos + 1 < end && m_text.at(pos + 1) == '(' && linkTarget(pos + 2, end, &url, &title, &after);
+    if (!found && !m_definitions.isEmpty()) {
+        // [text][label], or [text][] and [text] with the text as the label
+        const char *text = m_text.constData();
+        const int close = pos + 1 < end && text[pos + 1] == '[' ? linkLabel(pos + 1, end) : -1;
+        QByteArray label;
+        after = pos + 1;
+        if (close >= 0) {
+            label = normalizedLabel(text + pos + 2, close - pos - 2);
+            after = close + 1;
+        }
+        if (label.isEmpty() && !bracket.bracketAfter) {
+            const int textStart = m_inlines.at(bracket.node).start + (bracket.image ? 2 : 1);
+            label = normalizedLabel(text + textStart, pos - textStart);
+        }
+        const auto definition = m_definitions.constFind(label);
+        if (!label.isEmpty() && definition != m_definitions.constEnd()) {
+            url = definition->url;
+            title = definition->title;
+            found = true;
+        }
+    }
+    if (!found) {
+        appendInline(Text, Leaf, pos, 1);
+        return pos + 1;
+    }
+
+    const Kind kind = bracket.image ? Image : Link;
+    Inline &opener = m_inlines[bracket.node];
+    opener.kind = kind;
+    opener.type = Enter;
+    opener.url = url;
+    opener.title = title;
+    processEmphasis(bracket.delimiterBottom);
+
+    const int exit = appendInline(kind, Exit, pos, after - pos);
+    m_inlines[exit].url = url;
+    m_inlines[exit].title = title;
+
+    // No links in links
+    if (!bracket.image) {
+        for (Bracket &open : m_brackets) {
+            if (!open.image) {
+                open.active = false;
+            }
+        }
+    }
+    return after;
+}
+
+// The destination and optional title of an inline link from pos, just
+// after its '('
+bool MarkdownParser::linkTarget(int pos, int end, Span *url, Span *title, int *after) const
+{
+    const char *text = m_text.constData();
+    auto skipWhitespace = [&](int p) {
+        while (p < end && isWhitespace(text[p])) {
+            ++p;
+        }
+        return p;
+    };
+
+    int p = linkDestination(skipWhitespace(pos), end, url);
+    if (p < 0) {
+        return false;
+    }
+
+    const int beforeTitle = p;
+    p = skipWhitespace(p);
+    *title = Span();
+    if (p > beforeTitle) {
+        const int afterTitle = linkTitle(p, end, title);
+        if (afterTitle > 0) {
+            p = skipWhitespace(afterTitle);
+        }
+    }
+    if (p >= end || text[p] != ')') {
+        return false;
+    }
+    *after = p + 1;
+    return true;
+}
+
+// The <destination> or raw destination at pos; returns where it ends, -1
+// if there is none
+int MarkdownParser::linkDestination(int pos, int end, Span *url) const
+{
+    const char *text = m_text.constData();
+    int p = pos;
+    if (p < end && text[p] == '<') {
+        const int start = p + 1;
+        for (p = start; p < end && text[p] != '>'; ++p) {
+            if (text[p] == '\n' || text[p] == '<') {
+                return -1;
+            }
+            if (text[p] == '\\' && p + 1 < end) {
+                ++p;
+            }
+        }
+        if (p == end) {
+            return -1;
+        }
+        *url = {start, p - start};
+        return p + 1;
+    }
+
+    int depth = 0;
+    for (; p < end; ++p) {
+        const char ch = text[p];
+        if (ch == '\\' && p + 1 < end && isAsciiPunct(text[p + 1])) {
+            ++p;
+        } else if (ch == '(') {
+            if (++depth > 32) {
+                return -1;
+            }
+        } else if (ch == ')') {
+            if (depth == 0) {
+                break;
+            }
+            --depth;
+        } else if (uchar(ch) <= ' ') {
+            break;
+        }
+    }
+    if (depth != 0) {
+        return -1;
+    }
+    *url = {pos, p - pos};
+    return p;
+}
+
+// The "title", 'title' or (title) at pos; returns where it ends, -1 if
+// there is none
+int MarkdownParser::linkTitle(int pos, int end, Span *title) const
+{
+    const char *text = m_text.constData();
+    if (pos >= end || (text[pos] != '"' && text[pos] != '\'' && text[pos] != '(')) {
+        return -1;
+    }
+    const char close = text[pos] == '(' ? ')' : text[pos];
+    int p = pos + 1;
+    for (; p < end && text[p] != close; ++p) {
+        if (text[p] == '\\' && p + 1 < end) {
+            ++p;
+        } else if (close == ')' && text[p] == '(') {
+            return -1;
+        }
+    }
+    if (p == end) {
+        return -1;
+    }
+    *title = {pos + 1, p - pos - 1};
+    return p + 1;
+}
+
+// The ']' closing the link label opened at pos, -1 if there is none:
+// brackets inside are escaped, the label is at most 999 characters
+int MarkdownParser::linkLabel(int pos, int end) const
+{
+    const char *text = m_text.constData();
+    for (int p = pos + 1; p < end && p - pos <= 1000; ++p) {
+        if (text[p] == '\\' && p + 1 < end && isAsciiPunct(text[p + 1])) {
+            ++p;
+        } else if (text[p] == '[') {
+            return -1;
+        } else if (text[p] == ']') {
+            return p;
+        }
+    }
+    return -1;
+}
+
+// Matches emphasis delimiters above bottom, innermost first, as the
+// spec's "process emphasis" procedure does
+void MarkdownParser::processEmphasis(int bottom)
+{
+    // Lowest opener worth looking at, by closer character, length mod 3
+    // and whether the closer can open
+    int openersBottom[2][3][2];
+    for (auto &byChar : openersBottom) {
+        for (auto &byLength : byChar) {
+            byLength[0] = byLength[1] = bottom;
+        }
+    }
+
+    int closer = bottom;
+    while (closer < m_delimiters.size()) {
+        const Delimiter &close = m_delimiters.at(closer);
+        if (close.removed || !close.canClose) {
+            ++closer;
+            continue;
+        }
+        int &lowest = openersBottom[close.ch == '_'][close.original % 3][close.canOpen];
+
+        int opener = closer - 1;
+        for (; opener >= lowest; --opener) {
+            const Delimiter &open = m_delimiters.at(opener);
+            if (open.removed || open.ch != close.ch || !open.canOpen) {
+                continue;
+            }
+            // The rule of three keeps "*foo**bar*" from pairing the wrong runs
+            const bool oddMatch = (open.canClose || close.canOpen)
+                && (open.original + close.original) % 3 == 0
+                && !(open.original % 3 == 0 && close.original % 3 == 0);
+            if (!oddMatch) {
+                break;
+            }
+        }
+
+        if (opener < lowest) {
+            lowest = closer;
+            if (!close.canOpen) {
+                m_delimiters[closer].removed = true;
+            }
+            ++closer;
+            continue;
+        }
+
+        Delimiter &open = m_delimiters[opener];
+        Delimiter &shut = m_delimiters[closer];
+        const int use = open.count >= 2 && shut.count >= 2 ? 2 : 1;
+        const Kind kind = use == 2 ? Strong : Emphasis;
+        open.count -= use;
+        shut.count -= use;
+
+        // The opener keeps its first characters, the closer its last
+        m_inlines[open.node].length -= use;
+        const int closeStart = m_inlines.at(shut.node).start;
+        m_inlines[shut.node].start += use;
+        m_inlines[shut.node].length -= use;
+        insertInline(open.node, kind, Enter, m_inlines.at(open.node).start + open.count, use);
+        insertInline(m_inlines.at(shut.node).prev, kind, Exit, closeStart, use);
+
+        for (int i = opener + 1; i < closer; ++i) {
+            m_delimiters[i].removed = true;
+        }
+        if (open.count == 0) {
+            unlinkInline(open.node);
+            open.removed = true;
+        }
+        if (shut.count == 0) {
+            unlinkInline(shut.node);
+            shut.removed = true;
+            ++closer;
+        }
+    }
+    m_delimiters.resize(bottom);
+}
+
+int MarkdownParser::sourceOffset(int textOffset) const
+{
+    const auto begin = m_lineMap.cbegin() + m_mapStart;
+    auto line = std::upper_bound(begin, m_lineMap.cbegin() + m_mapEnd, textOffset,
+                                 [](int offset, const LineMap &map) { return offset < map.textStart; });
+    if (line != begin) {
+        --line;
+    }
+    return line->sourceStart + (textOffset - line->textStart);
+}
+
+MarkdownParser::Span MarkdownParser::sourceSpan(int start, int length) const
+{
+    Span span;
+    span.start = sourceOffset(start);
+    span.length = length > 0 ? sourceOffset(start + length - 1) + 1 - span.start : 0;
+    return span;
+}
+
+QByteArray MarkdownParser::toHtml() const
+{
+    QByteArray html;
+    html.reserve(m_text.size() + m_text.size() / 4 + 64);
+    const char *text = m_text.constData();
+    auto newline = [&]() {
+        if (!html.isEmpty() && !html.endsWith('\n')) {
+            html.append('\n');
+        }
+    };
+
+    QVector<bool> tight;            // Of the open lists
+    QVector<Kind> blocks;           // Open block quotes and list items
+    int imageDepth = 0;             // Images write their content as alt text
+
+    for (const Event &event : m_events) {
+        const bool entering = event.type == Enter;
+        if (imageDepth > 0) {
+            if (event.kind == Image) {
+                imageDepth += entering ? 1 : -1;
+            }
+            if (imageDepth > 0) {
+                if (event.kind == Text) {
+                    appendText(&html, text, event);
+                } else if (event.kind == Code) {
+                    appendEscaped(&html, text + event.text.start, event.text.length);
+                } else if (event.kind == SoftBreak || event.kind == HardBreak) {
+                    html.append('\n');
+                }
+                continue;
+            }
+            html.append('"');
+            if (event.title.length) {
+                html.append(" title=\"");
+                const QByteArray title = unescaped(text + event.title.start, event.title.length);
+                appendEscaped(&html, title.constData(), title.size());
+                html.append('"');
+            }
+            html.append(" />");
+            continue;
+        }
+
+        switch (event.kind) {
+        case BlockQuote:
+            newline();
+            if (entering) {
+                html.append("<blockquote>\n");
+                blocks.append(BlockQuote);
+            } else {
+                html.append("</blockquote>\n");
+                blocks.removeLast();
+            }
+            break;
+        case List: {
+            const bool ordered = event.flags & Ordered;
+            newline();
+            if (entering) {
+                if (ordered && event.number != 1) {
+                    html.append("<ol start=\"" + QByteArray::number(event.number) + "\">\n");
+                } else {
+                    html.append(ordered ? "<ol>\n" : "<ul>\n");
+                }
+                tight.append((event.flags & Tight) != 0);
+            } else {
+                html.append(ordered ? "</ol>\n" : "</ul>\n");
+                tight.removeLast();
+            }
+            break;
+        }
+        case ListItem:
+            if (entering) {
+                newline();
+                html.append("<li>");
+                blocks.append(ListItem);
+            } else {
+                html.append("</li>\n");
+                blocks.removeLast();
+            }
+            break;
+        case Paragraph:
+            if (!blocks.isEmpty() && blocks.last() == ListItem && tight.last()) {
+                break;
+            }
+            if (entering) {
+                newline();
+                html.append("<p>");
+            } else {
+                html.append("</p>\n");
+            }
+            break;
+        case Heading:
+            if (entering) {
+                newline();
+                html.append("<h" + QByteArray::number(event.level) + '>');
+            } else {
+                html.append("</h" + QByteArray::number(event.level) + ">\n");
+            }
+            break;
+        case CodeBlock:
+            if (entering) {
+                newline();
+                html.append("<pre><code");
+                if (event.text.length) {
+                    const QByteArray info = unescaped(text + event.text.start, event.text.length);
+                    qsizetype word = 0;
+                    while (word < info.size() && !isWhitespace(info.at(word))) {
+                        ++word;
+                    }
+                    html.append(" class=\"language-");
+                    appendEscaped(&html, info.constData(), int(word));
+                    html.append('"');
+                }
+                html.append('>');
+            } else {
+                html.append("</code></pre>\n");
+            }
+            break;
+        case HtmlBlock:
+            newline();
+            break;
+        case ThematicBreak:
+            newline();
+            html.append("<hr />\n");
+            break;
+        case Text:
+            appendText(&html, text, event);
+            break;
+        case SoftBreak:
+            html.append('\n');
+            break;
+        case HardBreak:
+            html.append("<br />\n");
+            break;
+        case Code:
+            html.append("<code>");
+            appendEscaped(&html, text + event.text.start, event.text.length, true);
+            html.append("</code>");
+            break;
+        case Emphasis:
+            html.append(entering ? "<em>" : "</em>");
+            break;
+        case Strong:
+            html.append(entering ? "<strong>" : "</strong>");
+            break;
+        case Link:
+            if (entering) {
+                html.append("<a href=\"");
+                if (event.flags & Email) {
+                    html.append("mailto:");
+                }
+                appendHref(&html, unescaped(text + event.url.start, event.url.length, !(event.flags & Autolink)));
+                html.append('"');
+                if (event.title.length) {
+                    html.append(" title=\"");
+                    const QByteArray title = unescaped(text + event.title.start, event.title.length);
+                    appendEscaped(&html, title.constData(), int(title.size()));
+                    html.append('"');
+                }
+                html.append('>');
+            } else {
+                html.append("</a>");
+            }
+            break;
+        case Image:
+            html.append("<img src=\"");
+            appendHref(&html, unescaped(text + event.url.start, event.url.length));
+            html.append("\" alt=\"");
+            imageDepth = 1;
+            break;
+        case Html:
+            html.append(text + event.text.start, event.text.length);
+            break;
+        }
+    }
+    return html;
+}
\ No newline at end of file
@@ -0,0 +1,249 @@
+#ifndef MARKDOWNPARSER_H
+#define MARKDOWNPARSER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+// Single-pass CommonMark parser producing a flat event stream.
+//
+// Blocks are recognised line by line against a stack of open containers
+// (block quotes, lists, list items), the way the CommonMark spec describes
+// it. Link reference definitions are taken out of paragraphs as they
+// close; since a link may come before its definition, inlines are parsed
+// at the end of the document, with the spec's delimiter stack for
+// emphasis and links, and spliced into their blocks. The result is one
+// vector of Enter/Exit/Leaf events in document order. Text is not copied
+// per node: events hold spans into text(), one buffer with the content of
+// every leaf block, container prefixes (block quote markers, list item
+// indentation) removed, and spans into the parsed source, so a renderer
+// can map anything back to the lines it came from.
+//
+// Named entities are passed through undecoded, and link labels are folded
+// with simple case folding only. Sources are UTF-8 and, as spans are int,
+// below 2 GB.
+class MarkdownParser
+{
+public:
+    enum Kind : quint8 {
+        // Blocks
+        BlockQuote,
+        List,
+        ListItem,
+        Paragraph,
+        Heading,
+        CodeBlock,
+        HtmlBlock,
+        ThematicBreak,
+        // Inlines
+        Text,
+        SoftBreak,
+        HardBreak,
+        Code,
+        Emphasis,
+        Strong,
+        Link,
+        Image,
+        Html
+    };
+
+    enum Type : quint8 {
+        Enter,
+        Exit,
+        Leaf        // ThematicBreak, Text, SoftBreak, HardBreak, Code and Html
+    };
+
+    enum Flag : quint8 {
+        Ordered = 0x1,      // List, ListItem
+        Tight = 0x2,        // List: its items' paragraphs go without <p>
+        Email = 0x4,        // Link: a <user@host> autolink
+        Entity = 0x8,       // Text: an entity reference like &amp;
+        Autolink = 0x10     // Link: <scheme:...> or <user@host>, url taken literally
+    };
+
+    struct Span {
+        int start = 0;
+        int length = 0;
+
+        int end() const { return start + length; }
+    };
+
+    struct Event {
+        Type type = Leaf;
+        Kind kind = Text;
+        quint8 flags = 0;
+        quint8 level = 0;   // Heading level
+        int number = 0;     // Start of an ordered list, number of its items
+        Span source;        // Blocks: all their lines; inlines: their markup or text
+        Span text;          // In text(): leaf content, code block info string
+        Span url;           // In text(): link and image destination
+        Span title;         // In text(): link and image title
+    };
+
+    // Buffers are kept between calls, parsing many small documents with one
+    // parser allocates next to nothing
+    void parse(const char *utf8, int size);
+    void parse(const QByteArray &utf8) { parse(utf8.constData(), int(utf8.size())); }
+
+    const QVector<Event> &events() const { return m_events; }
+    const QByteArray &text() const { return m_text; }
+    QByteArray textOf(const Span &span) const { return m_text.mid(span.start, span.length); }
+
+    // The parsed document as HTML, written the way the CommonMark reference
+    // implementation writes it
+    QByteArray toHtml() const;
+
+private:
+    enum LeafKind {
+        NoLeaf,
+        ParagraphLeaf,
+        IndentedCodeLeaf,
+        FencedCodeLeaf,
+        HtmlLeaf
+    };
+
+    struct Container {
+        Kind kind;
+        int event = 0;              // Its Enter event
+        int width = 0;              // List item: columns its content is indented by
+        char marker = 0;            // List: bullet or the '.' or ')' after numbers
+        int nextNumber = 0;         // Ordered list
+        bool loose = false;         // List
+        bool lastItemBlank = false; // List: its last closed item ended blank
+        bool blank = false;         // List item: the line before was blank
+        bool emptyStart = false;    // List item: nothing after the marker yet
+        int end = 0;                // Source offset its last line ends at
+    };
+
+    struct ListMarker {
+        char marker = 0;
+        bool ordered = false;
+        int number = 0;
+        int width = 0;              // Marker, its indentation and the spaces after it
+        bool blank = false;         // Nothing after the marker
+        int contentPos = 0;
+        int contentColumn = 0;
+    };
+
+    // Inlines are built as a linked list, emphasis is inserted around runs
+    // once its delimiters are matched
+    struct Inline {
+        Kind kind = Text;
+        Type type = Leaf;
+        quint8 flags = 0;
+        int start = 0;              // In m_text
+        int length = 0;
+        Span url;
+        Span title;
+        int prev = -1;
+        int next = -1;
+    };
+
+    struct Delimiter {
+        int node;
+        char ch;
+        int count;
+        int original;
+        bool canOpen;
+        bool canClose;
+        bool removed;
+    };
+
+    struct Bracket {
+        int node;
+        int delimiterBottom;
+        bool image;
+        bool active;
+        bool bracketAfter;          // Another bracket opened after it
+    };
+
+    // Spans in m_text
+    struct Definition {
+        Span url;
+        Span title;
+    };
+
+    // A paragraph or heading whose inlines are parsed at the end
+    struct InlineBlock {
+        int event;                  // Its Enter event
+        int start;                  // Its text in m_text
+        int end;
+        int mapStart;               // Its lines in m_lineMap
+        int mapEnd;
+    };
+
+    struct LineMap {
+        int textStart;
+        int sourceStart;
+    };
+
+    void addLine(int lineStart, int lineEnd);
+    bool processLine(int lineStart, int lineEnd);   // Whether it is blank inside its containers
+    int skipSpaces(int pos, int lineEnd, int *column) const;
+    int skipColumns(int pos, int lineEnd, int *column, int columns) const;
+    bool isBlank(int pos, int lineEnd) const;
+
+    int atxLevel(int pos, int lineEnd) const;
+    int setextLevel(int pos, int lineEnd) const;
+    bool isThematicBreak(int pos, int lineEnd) const;
+    int fenceLength(int pos, int lineEnd) const;
+    bool isClosingFence(int pos, int lineEnd) const;
+    int htmlBlockStart(int pos, int lineEnd, bool interrupts) const;
+    bool htmlBlockEnds(int pos, int lineEnd) const;
+    bool listMarker(int pos, int lineEnd, int column, int indent, bool interrupts, ListMarker *marker) const;
+
+    void addChild(Kind kind);
+    void openContainer(Kind kind, int start);
+    void addListItem(const ListMarker &marker, int start);
+    void closeContainer();
+    void closeUnmatched(int matched);
+    void openLeaf(LeafKind kind, int start);
+    void closeLeaf();
+    void addHeading(int pos, int lineEnd, int level);
+    void addInlineBlock(Kind kind, int level, Span source);
+    void addLiteralBlock(Kind blockKind, Kind lineKind, Span source, Span info);
+    bool takeDefinitions();
+    int definition(int pos, int end);
+
+    void parseInlines(int start, int end);
+    int appendInline(Kind kind, Type type, int start, int length);
+    int insertInline(int after, Kind kind, Type type, int start, int length);
+    void unlinkInline(int node);
+    int closeBracket(int pos, int end);
+    bool linkTarget(int pos, int end, Span *url, Span *title, int *after) const;
+    int linkDestination(int pos, int end, Span *url) const;
+    int linkTitle(int pos, int end, Span *title) const;
+    int linkLabel(int pos, int end) const;
+    void processEmphasis(int bottom);
+    int sourceOffset(int textOffset) const;
+    Span sourceSpan(int start, int length) const;
+
+    const char *m_source = nullptr;
+    int m_size = 0;
+    QVector<Event> m_events;
+    QByteArray m_text;
+
+    QVector<Container> m_containers;
+    LeafKind m_leaf = NoLeaf;
+    QVector<Span> m_lines;          // Of the open leaf, in the source
+    int m_leafStart = 0;
+    int m_leafEnd = 0;
+    char m_fenceChar = 0;
+    int m_fenceLength = 0;
+    int m_fenceIndent = 0;
+    Span m_info;
+    int m_htmlType = 0;
+
+    QHash<QByteArray, Definition> m_definitions;   // By normalized label
+    QVector<InlineBlock> m_inlineBlocks;
+    QVector<Event> m_blockEvents;   // Without inlines, while they are added
+    QVector<LineMap> m_lineMap;     // Of every inline block
+    int m_mapStart = 0;             // Of the block whose inlines are parsed
+    int m_mapEnd = 0;
+    QVector<Inline> m_inlines;
+    int m_inlineTail = 0;
+    QVector<Delimiter> m_delimiters;
+    QVector<Bracket> m_brackets;
+};
+
+#endif // MARKDOWNPARSER_H
\ No newline at end of file
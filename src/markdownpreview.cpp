@@ -0,0 +1,587 @@
+#include "markdownpreview.h"
+#include "markdownparser.h"
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QMutex>
+#include <QPalette>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextLength>
+#include <QThreadPool>
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+bool isBlank(const QString &line)
+{
+    for (QChar ch : line) {
+        if (!ch.isSpace()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Length of the ``` or ~~~ run opening a fence line (up to three spaces
+// in), 0 if the line is no fence
+int fenceLength(const QString &line, QChar *fenceChar)
+{
+    int i = 0;
+    while (i < line.size() && i < 3 && line.at(i) == QLatin1Char(' ')) {
+        ++i;
+    }
+    if (i >= line.size() || (line.at(i) != QLatin1Char('`') && line.at(i) != QLatin1Char('~'))) {
+        return 0;
+    }
+    const QChar ch = line.at(i);
+    int length = 0;
+    while (i + length < line.size() && line.at(i + length) == ch) {
+        ++length;
+    }
+    if (length < 3) {
+        return 0;
+    }
+    *fenceChar = ch;
+    return length;
+}
+
+size_t textHash(const QStringList &lines)
+{
+    size_t hash = lines.size();
+    for (const QString &line : lines) {
+        hash = qHash(line, hash);
+    }
+    return hash;
+}
+
+} // namespace
+
+struct MarkdownPreview::Receiver {
+    QMutex lock;
+    MarkdownPreview *preview = nullptr;
+
+    void deliver(const QSharedPointer<Job> &job)
+    {
+        QMutexLocker locker(&lock);
+        if (!preview) {
+            return;
+        }
+        MarkdownPreview *target = preview;
+        QMetaObject::invokeMethod(target, [target, job]() {
+            target->finishJob(job);
+        }, Qt::QueuedConnection);
+    }
+};
+
+MarkdownPreview::MarkdownPreview(QTextDocument *source, QTextDocument *preview, QObject *parent)
+    : QObject(parent), m_source(source), m_preview(preview), m_receiver(new Receiver)
+{
+    m_receiver->preview = this;
+    m_preview->setUndoRedoEnabled(false);
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(100);
+    connect(&m_timer, &QTimer::timeout, this, &MarkdownPreview::startJob);
+    connect(m_source, &QTextDocument::contentsChange, this, &MarkdownPreview::onContentsChange);
+}
+
+MarkdownPreview::~MarkdownPreview()
+{
+    QMutexLocker locker(&m_receiver->lock);
+    m_receiver->preview = nullptr;
+}
+
+void MarkdownPreview::setEnabled(bool enabled)
+{
+    if (enabled == m_enabled) {
+        return;
+    }
+    m_enabled = enabled;
+    if (m_enabled) {
+        rebuild();
+    } else {
+        // Edits are not followed while hidden, a running job is dropped
+        ++m_revision;
+        m_jobReset = true;
+        m_timer.stop();
+        m_blocks.clear();
+    }
+}
+
+void MarkdownPreview::rebuild()
+{
+    ++m_revision;
+    m_dirtyAll = true;
+    m_jobReset = true;
+    m_timer.stop();
+    startJob();
+}
+
+void MarkdownPreview::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    if (!m_enabled) {
+        return;
+    }
+
+    // Lines before the first changed one and after the last keep their
+    // text, whatever else changes until the next job
+    const int lineCount = m_source->blockCount();
+    const QTextBlock first = m_source->findBlock(position);
+    const QTextBlock last = m_source->findBlock(position + charsAdded);
+    const int firstLine = first.isValid() ? first.blockNumber() : lineCount - 1;
+    const int lastLine = qMax(firstLine, last.isValid() ? last.blockNumber() : lineCount - 1);
+    m_dirtyFirst = qMin(m_dirtyFirst, firstLine);
+    m_dirtyTail = qMin(m_dirtyTail, lineCount - 1 - lastLine);
+    m_jobDirtyFirst = qMin(m_jobDirtyFirst, firstLine);
+    m_jobDirtyTail = qMin(m_jobDirtyTail, lineCount - 1 - lastLine);
+    ++m_revision;
+
+    // Not restarted by further edits, so typing cannot hold the preview back
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void MarkdownPreview::startJob()
+{
+    if (!m_enabled || m_busy || (!m_dirtyAll && m_dirtyFirst == INT_MAX)) {
+        return;     // A running job starts the next one when it is done
+    }
+
+    // Changed lines, in new line numbers; the line count tells how many
+    // old lines they replaced
+    const int lineCount = m_source->blockCount();
+    const int lineDelta = lineCount - m_lineCount;
+    const int firstLine = qMin(m_dirtyFirst, lineCount - 1);
+    const int lastLine = qMax(firstLine, lineCount - 1 - m_dirtyTail);
+
+    // The block before joins in when the first line of a block changed,
+    // which may now continue it
+    int oldFirst = 0;
+    int startLine = 0;
+    bool all = m_dirtyAll;
+    while (!all && oldFirst < m_blocks.size() && startLine + m_blocks[oldFirst].lines <= firstLine) {
+        startLine += m_blocks[oldFirst].lines;
+        ++oldFirst;
+    }
+    if (!all && (oldFirst == m_blocks.size() || (startLine == firstLine && oldFirst > 0))) {
+        if (oldFirst == 0) {
+            all = true;
+        } else {
+            --oldFirst;
+            startLine -= m_blocks[oldFirst].lines;
+        }
+    }
+
+    QSharedPointer<Job> job(new Job);
+    job->revision = m_revision;
+    job->lineCount = lineCount;
+    if (all) {
+        job->oldFirst = 0;
+        job->oldLast = split(0, 0, INT_MAX, 0, &job->blocks, &job->texts);
+    } else {
+        job->oldFirst = oldFirst;
+        job->oldLast = split(startLine, oldFirst, lastLine + 1, lineDelta, &job->blocks, &job->texts);
+    }
+
+    // Blocks that came out the same at either end stay as rendered
+    auto same = [](const Block &a, const Block &b) { return a.lines == b.lines && a.hash == b.hash; };
+    int first = 0;
+    int last = job->blocks.size();
+    while (first < last && job->oldFirst < job->oldLast && same(m_blocks[job->oldFirst], job->blocks[first])) {
+        ++first;
+        ++job->oldFirst;
+    }
+    while (first < last && job->oldFirst < job->oldLast && same(m_blocks[job->oldLast - 1], job->blocks[last - 1])) {
+        --last;
+        --job->oldLast;
+    }
+    job->blocks = job->blocks.mid(first, last - first);
+    job->texts = job->texts.mid(first, last - first);
+    job->linkColor = QPalette().color(QPalette::Link);
+
+    m_busy = true;
+    m_jobDirtyFirst = INT_MAX;
+    m_jobDirtyTail = INT_MAX;
+    m_jobReset = false;
+    QSharedPointer<Receiver> receiver = m_receiver;
+    QThreadPool::globalInstance()->start([job, receiver]() {
+        MarkdownParser parser;
+        job->rendered.reserve(job->texts.size());
+        for (const QStringList &lines : job->texts) {
+            job->rendered.append(render(&parser, lines, job->linkColor));
+        }
+        receiver->deliver(job);
+    });
+}
+
+void MarkdownPreview::finishJob(const QSharedPointer<Job> &job)
+{
+    m_busy = false;
+    if (job->revision == m_revision) {
+        m_dirtyFirst = INT_MAX;
+        m_dirtyTail = INT_MAX;
+    } else if (m_enabled && isCurrent(*job)) {
+        // Edited meanwhile, but elsewhere: the preview shows the snapshot,
+        // and only the lines changed since then stay dirty
+        m_dirtyFirst = m_jobDirtyFirst;
+        m_dirtyTail = m_jobDirtyTail;
+    } else {
+        // The rendered lines changed; they stay dirty for the next job
+        if (m_enabled && !m_timer.isActive()) {
+            startJob();
+        }
+        return;
+    }
+
+    m_dirtyAll = false;
+    m_lineCount = job->lineCount;
+    replace(*job);
+    if (m_dirtyFirst != INT_MAX && !m_timer.isActive()) {
+        startJob();
+    }
+}
+
+// Whether the source lines a job rendered still hold the text it rendered,
+// after the edits made since its snapshot
+bool MarkdownPreview::isCurrent(const Job &job) const
+{
+    if (m_jobReset) {
+        return false;
+    }
+
+    // In snapshot line numbers; m_blocks does not change while a job runs
+    int first = 0;
+    for (int i = 0; i < job.oldFirst; ++i) {
+        first += m_blocks[i].lines;
+    }
+    int end = first;
+    for (const Block &block : job.blocks) {
+        end += block.lines;
+    }
+
+    // Lines before the edits keep their numbers, the ones after them shift
+    int line = 0;
+    if (end <= m_jobDirtyFirst) {
+        line = first;
+    } else if (first >= job.lineCount - m_jobDirtyTail) {
+        line = first + m_source->blockCount() - job.lineCount;
+    } else {
+        return false;
+    }
+
+    QTextBlock source = m_source->findBlockByNumber(line);
+    for (const Block &block : job.blocks) {
+        QStringList text;
+        for (int i = 0; i < block.lines && source.isValid(); ++i) {
+            text.append(source.text());
+            source = source.next();
+        }
+        if (textHash(text) != block.hash) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int MarkdownPreview::split(int firstLine, int oldFirst, int syncLine, int lineDelta,
+                           QVector<Block> *blocks, QVector<QStringList> *texts) const
+{
+    QTextBlock line = m_source->findBlockByNumber(firstLine);
+    int lineNumber = firstLine;
+    int oldIndex = oldFirst;
+    int oldStart = firstLine;       // Of m_blocks[oldIndex], in old line numbers
+
+    while (line.isValid()) {
+        // A block ends before the first non-blank line after a blank one,
+        // unless a fence is open
+        QStringList text;
+        bool afterBlank = false;
+        int fence = 0;
+        QChar fenceChar;
+        while (line.isValid()) {
+            const QString lineText = line.text();
+            const bool blank = isBlank(lineText);
+            if (!fence && afterBlank && !blank) {
+                break;
+            }
+            text.append(lineText);
+
+            QChar ch;
+            const int length = fenceLength(lineText, &ch);
+            if (!fence && length) {
+                fence = length;
+                fenceChar = ch;
+            } else if (fence && length >= fence && ch == fenceChar) {
+                fence = 0;
+            } else if (!fence && blank) {
+                afterBlank = true;
+            }
+            line = line.next();
+            ++lineNumber;
+        }
+
+        Block block;
+        block.lines = text.size();
+        block.hash = textHash(text);
+        blocks->append(block);
+        texts->append(text);
+
+        // Past the edit, stop as soon as a boundary matches an old one
+        if (lineNumber >= syncLine) {
+            const int oldEnd = lineNumber - lineDelta;
+            while (oldIndex < m_blocks.size() && oldStart < oldEnd) {
+                oldStart += m_blocks[oldIndex].lines;
+                ++oldIndex;
+            }
+            if (oldStart == oldEnd && oldIndex < m_blocks.size()) {
+                return oldIndex;
+            }
+        }
+    }
+    return m_blocks.size();
+}
+
+void MarkdownPreview::replace(const Job &job)
+{
+    const int oldFirst = job.oldFirst;
+    const int oldLast = job.oldLast;
+    m_lastRendered = job.blocks.size();
+    if (job.blocks.isEmpty() && oldFirst == oldLast) {
+        return;
+    }
+
+    int previewStart = 0;
+    for (int i = 0; i < oldFirst; ++i) {
+        previewStart += m_blocks[i].previewBlocks;
+    }
+    int previewCount = 0;
+    for (int i = oldFirst; i < oldLast; ++i) {
+        previewCount += m_blocks[i].previewBlocks;
+    }
+
+    QTextCursor cursor(m_preview);
+    cursor.beginEditBlock();
+
+    if (job.blocks.isEmpty()) {
+        // Blocks went away: remove their lines with one separator
+        const QTextBlock begin = m_preview->findBlockByNumber(previewStart);
+        const QTextBlock end = m_preview->findBlockByNumber(previewStart + previewCount - 1);
+        if (previewStart > 0) {
+            const QTextBlock before = begin.previous();
+            cursor.setPosition(before.position() + before.length() - 1);
+            cursor.setPosition(end.position() + end.length() - 1, QTextCursor::KeepAnchor);
+        } else {
+            cursor.setPosition(begin.position());
+            cursor.setPosition(end.next().position(), QTextCursor::KeepAnchor);
+        }
+        cursor.removeSelectedText();
+    } else {
+        // Leave one empty line where the new blocks go
+        if (m_blocks.isEmpty()) {
+            m_preview->clear();
+            cursor.movePosition(QTextCursor::Start);
+        } else if (previewCount > 0) {
+            const QTextBlock begin = m_preview->findBlockByNumber(previewStart);
+            const QTextBlock end = m_preview->findBlockByNumber(previewStart + previewCount - 1);
+            cursor.setPosition(begin.position());
+            cursor.setPosition(end.position() + end.length() - 1, QTextCursor::KeepAnchor);
+            cursor.removeSelectedText();
+        } else if (previewStart < m_preview->blockCount()) {
+            // The split keeps the following line's format on that line
+            const int position = m_preview->findBlockByNumber(previewStart).position();
+            cursor.setPosition(position);
+            cursor.insertBlock(cursor.blockFormat(), cursor.blockCharFormat());
+            cursor.setPosition(position);
+        } else {
+            cursor.movePosition(QTextCursor::End);
+            cursor.insertBlock();
+        }
+
+        bool firstParagraph = true;
+        for (const QVector<Paragraph> &paragraphs : job.rendered) {
+            for (const Paragraph &paragraph : paragraphs) {
+                if (firstParagraph) {
+                    cursor.setBlockFormat(paragraph.format);
+                    cursor.setBlockCharFormat(QTextCharFormat());
+                    firstParagraph = false;
+                } else {
+                    cursor.insertBlock(paragraph.format, QTextCharFormat());
+                }
+                for (const Paragraph::Span &span : paragraph.spans) {
+                    cursor.insertText(span.text, span.format);
+                }
+            }
+        }
+    }
+
+    cursor.endEditBlock();
+
+    QVector<Block> rendered = job.blocks;
+    for (int i = 0; i < rendered.size(); ++i) {
+        rendered[i].previewBlocks = rendered[i].lines;  // One line each
+    }
+    m_blocks.remove(oldFirst, oldLast - oldFirst);
+    for (int i = 0; i < rendered.size(); ++i) {
+        m_blocks.insert(oldFirst + i, rendered[i]);
+    }
+}
+
+QVector<MarkdownPreview::Paragraph> MarkdownPreview::render(MarkdownParser *parser, const QStringList &lines,
+                                                            const QColor &linkColor)
+{
+    const QByteArray source = lines.join(QLatin1Char('\n')).toUtf8();
+    QVector<int> lineStarts;
+    lineStarts.reserve(lines.size());
+    lineStarts.append(0);
+    for (int i = 0; i < source.size(); ++i) {
+        if (source.at(i) == '\n') {
+            lineStarts.append(i + 1);
+        }
+    }
+    auto lineOf = [&](int offset) {
+        return int(std::upper_bound(lineStarts.cbegin(), lineStarts.cend(), offset) - lineStarts.cbegin()) - 1;
+    };
+
+    parser->parse(source);
+    const QByteArray &text = parser->text();
+    auto textOf = [&](const MarkdownParser::Span &span) {
+        return QString::fromUtf8(text.constData() + span.start, span.length);
+    };
+    auto codeLine = [&](const MarkdownParser::Span &span) {     // Without its newline
+        QString line = textOf(span);
+        if (line.endsWith(QLatin1Char('\n'))) {
+            line.chop(1);
+        }
+        return line;
+    };
+
+    QTextBlockFormat codeBlock;
+    codeBlock.setNonBreakableLines(true);
+    codeBlock.setBackground(QColor(127, 127, 127, 40));    // Reads on light and dark themes
+    QTextCharFormat code;
+    code.setFontFixedPitch(true);
+    code.setFontFamilies({"monospace"});
+
+    // Every source line becomes one line of the preview; events go to the
+    // line their source starts on
+    QVector<Paragraph> paragraphs(lines.size());
+    QVector<QTextCharFormat> formats = {QTextCharFormat()};
+    int indent = 0;     // Block quotes and list items around
+    bool inCode = false;
+    auto setBlockFormat = [&](const MarkdownParser::Span &span, QTextBlockFormat format) {
+        format.setIndent(indent);
+        const int last = lineOf(qMax(span.start, span.end() - 1));
+        for (int line = lineOf(span.start); line <= last; ++line) {
+            paragraphs[line].format = format;
+        }
+    };
+    auto addSpan = [&](const MarkdownParser::Event &event, const QString &spanText, const QTextCharFormat &format) {
+        paragraphs[lineOf(event.source.start)].spans.append({spanText, format});
+    };
+
+    for (const MarkdownParser::Event &event : parser->events()) {
+        const bool entering = event.type != MarkdownParser::Exit;
+        switch (event.kind) {
+        case MarkdownParser::BlockQuote:
+            indent += entering ? 1 : -1;
+            break;
+        case MarkdownParser::List:
+            break;
+        case MarkdownParser::ListItem:
+            if (entering) {
+                const QString marker = event.flags & MarkdownParser::Ordered
+                    ? QString("%1. ").arg(event.number) : QString::fromUtf8("\u2022 ");
+                addSpan(event, marker, formats.last());
+            }
+            indent += entering ? 1 : -1;
+            break;
+        case MarkdownParser::Paragraph:
+            if (entering) {
+                setBlockFormat(event.source, QTextBlockFormat());
+            }
+            break;
+        case MarkdownParser::Heading:
+            if (entering) {
+                // The sizes and margins QTextDocument gives <h1> to <h6>
+                static const int margins[] = {18, 16, 14, 12, 12, 12};
+                const int level = qBound(1, int(event.level), 6);
+                QTextBlockFormat format;
+                format.setHeadingLevel(level);
+                format.setTopMargin(margins[level - 1]);
+                format.setBottomMargin(12);
+                setBlockFormat(event.source, format);
+                QTextCharFormat heading = formats.last();
+                heading.setFontWeight(QFont::Bold);
+                heading.setProperty(QTextFormat::FontSizeAdjustment, qMax(-1, 3 - level));
+                formats.append(heading);
+            } else {
+                formats.removeLast();
+            }
+            break;
+        case MarkdownParser::CodeBlock:
+        case MarkdownParser::HtmlBlock:
+            if (entering) {
+                setBlockFormat(event.source, codeBlock);
+            }
+            inCode = entering;
+            break;
+        case MarkdownParser::ThematicBreak: {
+            QTextBlockFormat rule;
+            rule.setProperty(QTextFormat::BlockTrailingHorizontalRulerWidth,
+                             QTextLength(QTextLength::PercentageLength, 100));
+            setBlockFormat(event.source, rule);
+            break;
+        }
+        case MarkdownParser::Text:
+            if (inCode) {
+                addSpan(event, codeLine(event.text), code);
+            } else {
+                addSpan(event, textOf(event.text), formats.last());
+            }
+            break;
+        case MarkdownParser::Html:
+            if (inCode) {
+                addSpan(event, codeLine(event.text), code);
+            }
+            break;
+        case MarkdownParser::SoftBreak:
+        case MarkdownParser::HardBreak:
+            break;
+        case MarkdownParser::Code: {
+            QTextCharFormat format = formats.last();
+            format.setFontFixedPitch(true);
+            format.setFontFamilies({"monospace"});
+            addSpan(event, textOf(event.text).replace(QLatin1Char('\n'), QLatin1Char(' ')), format);
+            break;
+        }
+        case MarkdownParser::Emphasis:
+        case MarkdownParser::Strong:
+        case MarkdownParser::Link:
+        case MarkdownParser::Image:
+            if (entering) {
+                QTextCharFormat format = formats.last();
+                if (event.kind == MarkdownParser::Emphasis) {
+                    format.setFontItalic(true);
+                } else if (event.kind == MarkdownParser::Strong) {
+                    format.setFontWeight(QFont::Bold);
+                } else {
+                    // Images show their alt text, linked to the image
+                    format.setAnchor(true);
+                    format.setAnchorHref(textOf(event.url));
+                    format.setFontUnderline(true);
+                    format.setForeground(linkColor);
+                    format.setFontItalic(event.kind == MarkdownParser::Image);
+                }
+                formats.append(format);
+            } else {
+                formats.removeLast();
+            }
+            break;
+        }
+    }
+    return paragraphs;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef MARKDOWNPREVIEW_H
+#define MARKDOWNPREVIEW_H
+
+#include <QColor>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QTextBlockFormat>
+#include <QTextCharFormat>
+#include <QTimer>
+#include <QVector>
+#include <climits>
+
+class MarkdownParser;
+class QTextDocument;
+
+// Keeps a rendered copy of a Markdown document up to date edit by edit.
+//
+// The source is split into Markdown blocks: runs of lines up to and with
+// the blank lines after them, with a fenced code block always kept whole.
+// A change (QTextDocument::contentsChange) re-splits the source from the
+// block before the edit until the new block boundaries line up with the
+// old ones again; blocks whose text did not change are kept, and only the
+// rendered lines of the others are replaced in the preview document. Typing
+// costs the blocks it touches, not the note.
+//
+// Rendering runs in the thread pool. An edit only records the lines it
+// touched; at most delay() later the changed blocks are copied out of the
+// source and rendered in the background, with the edits of that interval
+// coalesced into one job. A result that arrives after further edits is
+// still applied when those edits missed the lines it rendered (checked by
+// line range and hash), so continuous typing cannot starve the preview;
+// the next job renders only what changed since its snapshot.
+class MarkdownPreview : public QObject
+{
+    Q_OBJECT
+
+public:
+    MarkdownPreview(QTextDocument *source, QTextDocument *preview, QObject *parent = nullptr);
+    ~MarkdownPreview() override;
+
+    // While disabled edits are ignored; enabling renders the whole source
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+
+    // Longest time an edit waits for the preview, in milliseconds
+    void setDelay(int ms) { m_timer.setInterval(ms); }
+    int delay() const { return m_timer.interval(); }
+
+    // Render the whole source again, in the background
+    void rebuild();
+
+    // Blocks rendered by the last change, for tests and benchmarks
+    int lastRenderedBlocks() const { return m_lastRendered; }
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void startJob();
+
+private:
+    struct Block {
+        int lines = 0;
+        int previewBlocks = 0;  // Blocks of the preview document it renders to
+        size_t hash = 0;        // Of its source text
+    };
+
+    // One block of the preview document
+    struct Paragraph {
+        struct Span {
+            QString text;
+            QTextCharFormat format;
+        };
+        QTextBlockFormat format;
+        QVector<Span> spans;
+    };
+
+    // Blocks replacing m_blocks[oldFirst, oldLast), rendered in the background
+    struct Job {
+        quint64 revision = 0;
+        int lineCount = 0;
+        int oldFirst = 0;
+        int oldLast = 0;
+        QVector<Block> blocks;
+        QVector<QStringList> texts;
+        QVector<QVector<Paragraph>> rendered;
+        QColor linkColor;
+    };
+
+    struct Receiver;
+
+    // Split source lines [firstLine, ...) into blocks until a block ends on
+    // syncLine or later at an old boundary; returns the old block index the
+    // new blocks end at
+    int split(int firstLine, int oldFirst, int syncLine, int lineDelta,
+              QVector<Block> *blocks, QVector<QStringList> *texts) const;
+    void finishJob(const QSharedPointer<Job> &job);
+    bool isCurrent(const Job &job) const;
+    void replace(const Job &job);
+    static QVector<Paragraph> render(MarkdownParser *parser, const QStringList &lines,
+                                     const QColor &linkColor);
+
+    QTextDocument *m_source;
+    QTextDocument *m_preview;
+    bool m_enabled = false;
+    QVector<Block> m_blocks;    // As shown in the preview
+    int m_lineCount = 0;        // Of the source the preview shows
+    int m_lastRendered = 0;
+
+    // Lines changed since then: from m_dirtyFirst on, all but the last
+    // m_dirtyTail; the line count tells how many old lines they replace
+    int m_dirtyFirst = INT_MAX;
+    int m_dirtyTail = INT_MAX;
+    bool m_dirtyAll = false;
+    quint64 m_revision = 0;     // Bumped by every edit and rebuild
+    bool m_busy = false;        // A job is running
+
+    // Lines changed since the running job's snapshot, the same way
+    int m_jobDirtyFirst = INT_MAX;
+    int m_jobDirtyTail = INT_MAX;
+    bool m_jobReset = false;    // Rebuilt or disabled since, its result is dropped
+    QTimer m_timer;
+    QSharedPointer<Receiver> m_receiver;
+};
+
+#endif // MARKDOWNPREVIEW_H
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "markdowntokenizer.h"
+#include <QChar>
+
+namespace {
+
+enum Block {
+    Normal,
+    FencedCode,
+    FrontMatterBlock
+};
+
+// Line state packed into the non-negative int QSyntaxHighlighter keeps:
+// bits 0-1 block, bit 2 '~' fence, bits 3-8 fence length, bit 9 paragraph
+// text, bits 10-17 content column of the open list item, bits 18-21 '>'
+// markers before the open fence
+struct LineState {
+    int block = Normal;
+    bool tildeFence = false;
+    int fenceLength = 0;
+    bool paragraph = false;
+    int listColumn = 0;
+    int quoteDepth = 0;
+
+    explicit LineState(int state)
+    {
+        if (state < 0) {
+            return;
+        }
+        block = state & 0x3;
+        tildeFence = state & 0x4;
+        fenceLength = (state >> 3) & 0x3f;
+        paragraph = state & 0x200;
+        listColumn = (state >> 10) & 0xff;
+        quoteDepth = (state >> 18) & 0xf;
+    }
+
+    int pack() const
+    {
+        return block | (tildeFence ? 0x4 : 0) | (qMin(fenceLength, 0x3f) << 3)
+            | (paragraph ? 0x200 : 0) | (qMin(listColumn, 0xff) << 10) | (qMin(quoteDepth, 0xf) << 18);
+    }
+
+    void closeFence()
+    {
+        block = Normal;
+        tildeFence = false;
+        fenceLength = 0;
+        quoteDepth = 0;
+    }
+};
+
+inline bool isSpace(char16_t ch)
+{
+    return ch == u' ' || ch == u'\t';
+}
+
+// Characters inline markup can start with
+inline bool isInlineStart(char16_t ch)
+{
+    return ch == u'\\' || ch == u'`' || ch == u'[' || ch == u'*' || ch == u'_';
+}
+
+inline bool isWordChar(char16_t ch)
+{
+    return QChar::isLetterOrNumber(ch);
+}
+
+} // namespace
+
+int MarkdownTokenizer::tokenize(QStringView line, int state)
+{
+    m_tokens.clear();   // Keeps its capacity
+    m_text = line.utf16();
+    m_size = int(line.size());
+    LineState s(state);
+
+    if (s.block == FrontMatterBlock) {
+        addToken(0, m_size, FrontMatter);
+        if (isFrontMatterDelimiter(false)) {
+            s.block = Normal;
+        }
+        return s.pack();
+    }
+    if (state < 0 && isFrontMatterDelimiter(true)) {
+        addToken(0, m_size, FrontMatter);
+        s.block = FrontMatterBlock;
+        return s.pack();
+    }
+
+    int column = 0;
+    int pos = skipSpaces(0, &column);
+    if (s.block == FencedCode) {
+        // Inside its block quotes and list item the fence goes on; a line
+        // that leaves them ends it
+        int depth = 0;
+        int codePos = pos;
+        int codeColumn = column;
+        while (depth < s.quoteDepth && codePos < m_size && m_text[codePos] == u'>') {
+            ++depth;
+            ++codeColumn;
+            codePos = skipSpaces(codePos + 1, &codeColumn);
+        }
+        if (depth == s.quoteDepth && (codePos == m_size || codeColumn >= s.listColumn)) {
+            int marker = pos;
+            for (int i = 0; i < depth; ++i) {
+                marker = indexOf(u'>', marker, m_size);
+                addToken(marker++, 1, QuoteMarker);
+            }
+            const int codeStart = depth ? codePos : 0;
+            const char16_t fenceChar = s.tildeFence ? u'~' : u'`';
+            if (codeColumn - qMin(codeColumn, s.listColumn) < 4 && isClosingFence(codePos, fenceChar, s.fenceLength)) {
+                addToken(codeStart, m_size - codeStart, Fence);
+                s.closeFence();
+            } else {
+                addToken(codeStart, m_size - codeStart, CodeBlock);
+            }
+            return s.pack();
+        }
+        s.closeFence();
+    }
+
+    if (pos == m_size) {
+        s.paragraph = false;    // Blank lines end paragraphs, not list items
+        return s.pack();
+    }
+
+    // Lines indented less than the content of the open list item end it,
+    // unless they lazily continue its paragraph
+    const int listColumn = s.listColumn;
+    if (column < s.listColumn) {
+        s.listColumn = 0;
+    }
+    if (column - s.listColumn >= 4 && !s.paragraph) {
+        addToken(0, m_size, CodeBlock);
+        return s.pack();
+    }
+
+    const int textStart = pos;
+    int quoteDepth = 0;
+    while (pos < m_size && m_text[pos] == u'>') {
+        addToken(pos, 1, QuoteMarker);
+        ++quoteDepth;
+        ++column;
+        pos = skipSpaces(pos + 1, &column);
+    }
+    if (pos == m_size) {
+        s.paragraph = false;
+        return s.pack();
+    }
+
+    if (m_text[pos] == u'#') {
+        const int level = runLength(pos, m_size);
+        if (level <= 6 && (pos + level == m_size || isSpace(m_text[pos + level]))) {
+            addToken(0, m_size, Header);
+            scanInlines(pos + level, m_size);
+            s.paragraph = false;
+            return s.pack();
+        }
+    }
+
+    // Before list items, "* * *" is a rule; "---" under a paragraph
+    // underlines a heading, marked up the same way
+    if (isThematicBreak(pos)) {
+        addToken(0, m_size, Fence);
+        s.paragraph = false;
+        return s.pack();
+    }
+
+    // Fences open after the '>' and list markers of their containers; the
+    // marker tokens go after the line-wide one
+    const int markerStart = pos;
+    const int markerEnd = listMarkerEnd(pos);
+    if (markerEnd) {
+        column += markerEnd - pos;
+        const int markerColumn = column;
+        pos = skipSpaces(markerEnd, &column);
+        // Content starts one to four columns after the marker; with more
+        // the item starts with indented code
+        s.listColumn = pos < m_size && column - markerColumn <= 4 ? column : markerColumn + 1;
+    } else if (s.paragraph && pos == textStart) {
+        s.listColumn = listColumn;
+    }
+
+    const int fence = pos < m_size ? fenceLength(pos) : 0;
+    if (fence) {
+        const int fenceStart = quoteDepth ? markerStart : 0;
+        addToken(fenceStart, m_size - fenceStart, Fence);
+        if (markerEnd) {
+            addToken(markerStart, markerEnd - markerStart, ListMarker);
+        }
+        s.block = FencedCode;
+        s.tildeFence = m_text[pos] == u'~';
+        s.fenceLength = fence;
+        s.quoteDepth = quoteDepth;
+        s.paragraph = false;
+        return s.pack();
+    }
+    if (markerEnd) {
+        addToken(markerStart, markerEnd - markerStart, ListMarker);
+    }
+
+    scanInlines(pos, m_size);
+    s.paragraph = true;
+    return s.pack();
+}
+
+void MarkdownTokenizer::addToken(int start, int length, Style style)
+{
+    m_tokens.append({start, length, style});
+}
+
+// Inline markup in [pos, end): emphasis content is scanned for markup of
+// its own, code spans and links are not
+void MarkdownTokenizer::scanInlines(int pos, int end)
+{
+    while (pos < end) {
+        const char16_t ch = m_text[pos];
+        if (!isInlineStart(ch)) {
+            ++pos;
+            continue;
+        }
+
+        switch (ch) {
+        case u'\\':
+            pos += 2;   // Escaped character
+            break;
+
+        case u'`': {
+            const int run = runLength(pos, end);
+            const int spanEnd = codeSpanEnd(pos, run, end);
+            if (spanEnd > 0) {
+                addToken(pos, spanEnd - pos, Code);
+                pos = spanEnd;
+            } else {
+                pos += run;
+            }
+            break;
+        }
+
+        case u'[':
+            if (pos + 1 < end && m_text[pos + 1] == u'[') {
+                const int close = indexOf(u']', pos + 2, end);
+                if (close > pos + 2 && close + 1 < end && m_text[close + 1] == u']') {
+                    addToken(pos, close + 2 - pos, WikiLink);
+                    pos = close + 2;
+                    break;
+                }
+            } else {
+                const int close = indexOf(u']', pos + 1, end);
+                if (close > pos + 1 && close + 1 < end && m_text[close + 1] == u'(') {
+                    const int paren = indexOf(u')', close + 2, end);
+                    if (paren > close + 2) {
+                        addToken(pos, paren + 1 - pos, Link);
+                        pos = paren + 1;
+                        break;
+                    }
+                }
+            }
+            ++pos;
+            break;
+
+        case u'*':
+        case u'_': {
+            const int run = runLength(pos, end);
+            int emphasis = -1;
+            // Underscores inside words (snake_case) are no emphasis
+            if (run <= 2 && (ch == u'*' || pos == 0 || !isWordChar(m_text[pos - 1]))) {
+                emphasis = emphasisEnd(pos, run, end);
+            }
+            if (emphasis > 0) {
+                addToken(pos, emphasis - pos, run == 2 ? Bold : Italic);
+                scanInlines(pos + run, emphasis - run);
+                pos = emphasis;
+            } else {
+                pos += run;
+            }
+            break;
+        }
+        }
+    }
+}
+
+int MarkdownTokenizer::skipSpaces(int pos, int *column) const
+{
+    while (pos < m_size && isSpace(m_text[pos])) {
+        *column = m_text[pos] == u'\t' ? (*column + 4) & ~3 : *column + 1;
+        ++pos;
+    }
+    return pos;
+}
+
+int MarkdownTokenizer::runLength(int pos, int end) const
+{
+    const char16_t ch = m_text[pos];
+    int i = pos + 1;
+    while (i < end && m_text[i] == ch) {
+        ++i;
+    }
+    return i - pos;
+}
+
+int MarkdownTokenizer::indexOf(char16_t ch, int from, int end) const
+{
+    for (int i = from; i < end; ++i) {
+        if (m_text[i] == ch) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Length of the ``` or ~~~ run opening a fence at pos, 0 if there is none
+int MarkdownTokenizer::fenceLength(int pos) const
+{
+    const char16_t ch = m_text[pos];
+    if (ch != u'`' && ch != u'~') {
+        return 0;
+    }
+    const int length = runLength(pos, m_size);
+    if (length < 3) {
+        return 0;
+    }
+    // "```a`b" is a code span; info strings of backtick fences have none
+    if (ch == u'`' && indexOf(u'`', pos + length, m_size) >= 0) {
+        return 0;
+    }
+    return length;
+}
+
+bool MarkdownTokenizer::isClosingFence(int pos, char16_t fenceChar, int length) const
+{
+    if (pos == m_size || m_text[pos] != fenceChar) {
+        return false;
+    }
+    const int run = runLength(pos, m_size);
+    if (run < length) {
+        return false;
+    }
+    int column = 0;
+    return skipSpaces(pos + run, &column) == m_size;
+}
+
+bool MarkdownTokenizer::isThematicBreak(int pos) const
+{
+    const char16_t ch = m_text[pos];
+    if (ch != u'-' && ch != u'*' && ch != u'_') {
+        return false;
+    }
+    int count = 0;
+    for (int i = pos; i < m_size; ++i) {
+        if (m_text[i] == ch) {
+            ++count;
+        } else if (!isSpace(m_text[i])) {
+            return false;
+        }
+    }
+    return count >= 3;
+}
+
+// "---" opens front matter on the first line; "---" or "..." closes it
+bool MarkdownTokenizer::isFrontMatterDelimiter(bool opening) const
+{
+    int end = m_size;
+    while (end > 0 && isSpace(m_text[end - 1])) {
+        --end;
+    }
+    if (end != 3) {
+        return false;
+    }
+    const char16_t ch = m_text[0];
+    return (ch == u'-' || (!opening && ch == u'.')) && m_text[1] == ch && m_text[2] == ch;
+}
+
+// End of the bullet or "1." / "1)" at pos when a space or the line end
+// follows it, 0 otherwise
+int MarkdownTokenizer::listMarkerEnd(int pos) const
+{
+    int end = pos;
+    const char16_t ch = m_text[pos];
+    if (ch == u'-' || ch == u'+' || ch == u'*') {
+        end = pos + 1;
+    } else {
+        while (end < m_size && end - pos < 9 && m_text[end] >= u'0' && m_text[end] <= u'9') {
+            ++end;
+        }
+        if (end == pos || end == m_size || (m_text[end] != u'.' && m_text[end] != u')')) {
+            return 0;
+        }
+        ++end;
+    }
+    return end == m_size || isSpace(m_text[end]) ? end : 0;
+}
+
+// End of the code span opened by the run backticks at pos: the next run
+// of the same length; -1 if there is none
+int MarkdownTokenizer::codeSpanEnd(int pos, int run, int end) const
+{
+    int i = pos + run;
+    while (i < end) {
+        if (m_text[i] != u'`') {
+            ++i;
+            continue;
+        }
+        const int length = runLength(i, end);
+        if (length == run) {
+            return i + length;
+        }
+        i += length;
+    }
+    return -1;
+}
+
+// End of "*text*" or "**text**" (or with '_') opened by the run at pos:
+// text without the delimiter character, not starting or ending in a space
+int MarkdownTokenizer::emphasisEnd(int pos, int run, int end) const
+{
+    const char16_t ch = m_text[pos];
+    const int content = pos + run;
+    if (content >= end || isSpace(m_text[content])) {
+        return -1;
+    }
+    const int close = indexOf(ch, content, end);
+    if (close < 0 || isSpace(m_text[close - 1]) || runLength(close, end) < run) {
+        return -1;
+    }
+    const int after = close + run;
+    if (ch == u'_' && after < end && isWordChar(m_text[after])) {
+        return -1;
+    }
+    return after;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef MARKDOWNTOKENIZER_H
+#define MARKDOWNTOKENIZER_H
+
+#include <QStringView>
+#include <QVector>
+
+// Line-by-line Markdown scanner behind the editor's syntax highlighting.
+//
+// Each line is scanned once, left to right, without regular expressions.
+// What a line means can depend on the lines before it (inside a fenced
+// code block, also one in a block quote or list item, in the front matter,
+// continuing a list item), so tokenize()
+// takes the state the previous line ended in and returns the state for
+// the next one: the int QSyntaxHighlighter keeps per block, -1 for the
+// first line. Tokens are spans into the line, kept in a buffer reused from
+// line to line, so scanning allocates nothing per token.
+class MarkdownTokenizer
+{
+public:
+    enum Style : quint8 {
+        Header,         // Whole "# Heading" line
+        Bold,
+        Italic,
+        Code,           // `code span`
+        Link,           // [text](url)
+        WikiLink,       // [[Note]]
+        CodeBlock,      // Fenced or indented code, whole lines
+        Fence,          // ``` and ~~~ lines, thematic breaks
+        FrontMatter,    // YAML block opening the note, with its --- lines
+        ListMarker,     // "-", "*", "+", "1." or "1)" starting a list item
+        QuoteMarker,    // ">"
+        StyleCount
+    };
+
+    struct Token {
+        int start;
+        int length;
+        Style style;
+    };
+
+    // Scan one line (without its terminator); tokens() holds the result
+    // until the next call. Line-wide tokens come before the inline ones
+    // inside them.
+    int tokenize(QStringView line, int state);
+    const QVector<Token> &tokens() const { return m_tokens; }
+
+private:
+    void addToken(int start, int length, Style style);
+    void scanInlines(int pos, int end);
+    int skipSpaces(int pos, int *column) const;
+    int runLength(int pos, int end) const;
+    int indexOf(char16_t ch, int from, int end) const;
+    int fenceLength(int pos) const;
+    bool isClosingFence(int pos, char16_t fenceChar, int length) const;
+    bool isThematicBreak(int pos) const;
+    bool isFrontMatterDelimiter(bool opening) const;
+    int listMarkerEnd(int pos) const;
+    int codeSpanEnd(int pos, int run, int end) const;
+    int emphasisEnd(int pos, int run, int end) const;
+
+    const char16_t *m_text = nullptr;
+    int m_size = 0;
+    QVector<Token> m_tokens;
+};
+
+#endif // MARKDOWNTOKENIZER_H
\ No newline at end of file
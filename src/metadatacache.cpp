@@ -0,0 +1,405 @@
+#include "metadatacache.h"
+#include "linkparser.h"
+#include "linktokenizer.h"
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QTimeZone>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const quint32 CacheMagic = 0x43564d46; // "FMVC" in little-endian byte order
+
+// Section layout: FileHeader, Record[recordCount], StringRef[stringCount],
+// quint32 listItems[itemCount], char16_t chars[charCount]. Everything is in
+// native byte order; a file from a machine of the other order fails the
+// magic check and is rebuilt.
+struct FileHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 recordCount;
+    quint32 stringCount;
+    quint32 itemCount;
+    quint32 reserved;
+    quint64 charCount;
+};
+
+quint64 contentHash(const char *data, qsizetype size)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (qsizetype i = 0; i < size; ++i) {
+        hash ^= uchar(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool isBlank(char ch)
+{
+    return ch == ' ' || ch == '\t';
+}
+
+// ATX headings ("# Text" up to "###### Text") outside fenced code blocks
+void readHeadings(const char *data, qsizetype size, QStringList *headings)
+{
+    char fence = 0;
+    qsizetype start = 0;
+    if (size >= 3 && std::memcmp(data, "\xef\xbb\xbf", 3) == 0) {
+        start = 3;
+    }
+
+    while (start < size) {
+        const void *newline = std::memchr(data + start, '\n', size_t(size - start));
+        const qsizetype next = newline ? static_cast<const char *>(newline) - data + 1 : size;
+        qsizetype end = newline ? next - 1 : size;
+        if (end > start && data[end - 1] == '\r') {
+            --end;
+        }
+
+        qsizetype i = start;
+        while (i < end && i - start < 4 && data[i] == ' ') {
+            ++i;
+        }
+        if (i - start >= 4 || i == end) {
+            start = next;
+            continue;
+        }
+
+        const char ch = data[i];
+        if ((ch == '`' || ch == '~') && end - i >= 3 && data[i + 1] == ch && data[i + 2] == ch) {
+            if (!fence) {
+                fence = ch;
+            } else if (fence == ch) {
+                fence = 0;
+            }
+        } else if (!fence && ch == '#') {
+            qsizetype textStart = i;
+            while (textStart < end && data[textStart] == '#') {
+                ++textStart;
+            }
+            const int level = int(textStart - i);
+            if (level <= 6 && (textStart == end || isBlank(data[textStart]))) {
+                qsizetype textEnd = end;
+                while (textStart < textEnd && isBlank(data[textStart])) {
+                    ++textStart;
+                }
+                while (textEnd > textStart && isBlank(data[textEnd - 1])) {
+                    --textEnd;
+                }
+
+                // An optional closing run of '#', "## Text ##"
+                qsizetype close = textEnd;
+                while (close > textStart && data[close - 1] == '#') {
+                    --close;
+                }
+                if (close == textStart || isBlank(data[close - 1])) {
+                    textEnd = close;
+                    while (textEnd > textStart && isBlank(data[textEnd - 1])) {
+                        --textEnd;
+                    }
+                }
+
+                if (textEnd > textStart) {
+                    headings->append(QString(level, QLatin1Char('#')) + QLatin1Char(' ')
+                                     + QString::fromUtf8(data + textStart, textEnd - textStart));
+                }
+            }
+        }
+        start = next;
+    }
+}
+
+} // namespace
+
+struct MetadataCache::StringRef {
+    quint32 offset;     // In chars
+    quint32 length;
+};
+
+struct MetadataCache::Record {
+    qint64 mtime;
+    qint64 size;
+    quint64 hash;
+    quint32 path;           // String index
+    quint32 headerTitle;
+    quint32 headerZettelId;
+    quint32 firstHeading;   // Range in listItems
+    quint32 headingCount;
+    quint32 firstLink;
+    quint32 linkCount;
+    quint32 reserved;
+};
+
+MetadataCache::MetadataCache(const QString &vaultPath)
+    : m_vaultPath(vaultPath)
+{
+}
+
+MetadataCache::~MetadataCache()
+{
+    close();
+}
+
+QString MetadataCache::cacheFilePath() const
+{
+    return QDir(m_vaultPath).filePath(".formica/cache.bin");
+}
+
+bool MetadataCache::open()
+{
+    close();
+
+    m_file.setFileName(cacheFilePath());
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(FileHeader))) {
+        close();
+        return false;
+    }
+    m_map = m_file.map(0, m_file.size());
+    if (!m_map) {
+        close();
+        return false;
+    }
+
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(m_map);
+    if (header->magic != CacheMagic || header->version != FormatVersion) {
+        close();
+        return false; // Stale format, rewritten after the next scan
+    }
+
+    const quint64 recordBytes = quint64(header->recordCount) * sizeof(Record);
+    const quint64 stringBytes = quint64(header->stringCount) * sizeof(StringRef);
+    const quint64 itemBytes = quint64(header->itemCount) * sizeof(quint32);
+    if (header->charCount > quint64(m_file.size())
+        || sizeof(FileHeader) + recordBytes + stringBytes + itemBytes + header->charCount * 2
+               != quint64(m_file.size())) {
+        close();
+        return false;
+    }
+
+    const uchar *pos = m_map + sizeof(FileHeader);
+    m_records = reinterpret_cast<const Record *>(pos);
+    m_strings = reinterpret_cast<const StringRef *>(pos + recordBytes);
+    m_items = reinterpret_cast<const quint32 *>(pos + recordBytes + stringBytes);
+    m_chars = reinterpret_cast<const char16_t *>(pos + recordBytes + stringBytes + itemBytes);
+    m_stringCount = header->stringCount;
+
+    // Check every reference once, lookups then index without checks
+    bool corrupt = false;
+    for (quint32 i = 0; i < m_stringCount && !corrupt; ++i) {
+        corrupt = quint64(m_strings[i].offset) + m_strings[i].length > header->charCount;
+    }
+    for (quint32 i = 0; i < header->itemCount && !corrupt; ++i) {
+        corrupt = m_items[i] >= m_stringCount;
+    }
+
+    m_paths.reserve(header->recordCount);
+    for (quint32 i = 0; i < header->recordCount && !corrupt; ++i) {
+        const Record &record = m_records[i];
+        corrupt = record.path >= m_stringCount || record.headerTitle >= m_stringCount
+                  || record.headerZettelId >= m_stringCount
+                  || quint64(record.firstHeading) + record.headingCount > header->itemCount
+                  || quint64(record.firstLink) + record.linkCount > header->itemCount;
+        if (!corrupt) {
+            const StringRef &path = m_strings[record.path];
+            const QStringView view(m_chars + path.offset, path.length);
+            corrupt = view.isEmpty() || m_paths.contains(view);
+            m_paths.insert(view, i);
+        }
+    }
+
+    if (corrupt) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MetadataCache::close()
+{
+    m_paths.clear();
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+    }
+    m_file.close();
+    m_map = nullptr;
+    m_records = nullptr;
+    m_strings = nullptr;
+    m_items = nullptr;
+    m_chars = nullptr;
+    m_stringCount = 0;
+}
+
+bool MetadataCache::find(const QString &relPath, qint64 mtime, qint64 size, Entry *entry) const
+{
+    auto found = m_paths.constFind(QStringView(relPath));
+    if (found == m_paths.constEnd()) {
+        return false;
+    }
+
+    const Record &record = m_records[*found];
+    if (record.mtime != mtime || record.size != size) {
+        return false;
+    }
+
+    entry->mtime = record.mtime;
+    entry->size = record.size;
+    entry->hash = record.hash;
+    entry->headerTitle = string(record.headerTitle);
+    entry->headerZettelId = string(record.headerZettelId);
+    entry->headings = strings(record.firstHeading, record.headingCount);
+    entry->links = strings(record.firstLink, record.linkCount);
+    return true;
+}
+
+bool MetadataCache::save(const QVector<QPair<QString, Entry>> &entries)
+{
+    // The mapping would keep the old file busy on some platforms
+    close();
+
+    // Strings are stored once, links repeat across many notes
+    QVector<Record> records;
+    QVector<StringRef> refs;
+    QVector<quint32> items;
+    QString chars;
+    QHash<QString, quint32> stringIds;
+    records.reserve(entries.size());
+
+    auto intern = [&](const QString &text) {
+        auto found = stringIds.constFind(text);
+        if (found != stringIds.constEnd()) {
+            return *found;
+        }
+        const quint32 id = refs.size();
+        refs.append(StringRef{quint32(chars.size()), quint32(text.size())});
+        chars += text;
+        stringIds.insert(text, id);
+        return id;
+    };
+    auto appendList = [&](const QStringList &list, quint32 *first, quint32 *count) {
+        *first = items.size();
+        *count = list.size();
+        for (const QString &text : list) {
+            items.append(intern(text));
+        }
+    };
+
+    for (const auto &pair : entries) {
+        const Entry &entry = pair.second;
+        Record record = {};
+        record.mtime = entry.mtime;
+        record.size = entry.size;
+        record.hash = entry.hash;
+        record.path = intern(pair.first);
+        record.headerTitle = intern(entry.headerTitle);
+        record.headerZettelId = intern(entry.headerZettelId);
+        appendList(entry.headings, &record.firstHeading, &record.headingCount);
+        appendList(entry.links, &record.firstLink, &record.linkCount);
+        records.append(record);
+    }
+    if (quint64(chars.size()) > std::numeric_limits<quint32>::max()) {
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(cacheFilePath()).absolutePath());
+
+    QSaveFile file(cacheFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    FileHeader header = {};
+    header.magic = CacheMagic;
+    header.version = FormatVersion;
+    header.recordCount = records.size();
+    header.stringCount = refs.size();
+    header.itemCount = items.size();
+    header.charCount = chars.size();
+
+    const qint64 total = sizeof(header) + records.size() * sizeof(Record) + refs.size() * sizeof(StringRef)
+                         + items.size() * sizeof(quint32) + chars.size() * 2;
+    qint64 written = file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    written += file.write(reinterpret_cast<const char *>(records.constData()), records.size() * sizeof(Record));
+    written += file.write(reinterpret_cast<const char *>(refs.constData()), refs.size() * sizeof(StringRef));
+    written += file.write(reinterpret_cast<const char *>(items.constData()), items.size() * sizeof(quint32));
+    written += file.write(reinterpret_cast<const char *>(chars.constData()), chars.size() * 2);
+
+    if (written != total) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool MetadataCache::readEntry(const QString &filePath, Entry *entry)
+{
+    *entry = Entry();
+
+    // Stat before reading: a write in between leaves a newer mtime on disk,
+    // so the entry is read again next time instead of trusted
+    const QFileInfo info(filePath);
+    entry->mtime = modificationTime(info);
+    entry->size = info.size();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray content = file.readAll();
+    parseContent(content.constData(), content.size(), entry);
+    return true;
+}
+
+void MetadataCache::parseContent(const char *data, qsizetype size, Entry *entry)
+{
+    entry->hash = contentHash(data, size);
+
+    const LinkTokenizer::Header header = LinkTokenizer::header(data, size);
+    if (header.title.isValid()) {
+        entry->headerTitle = QString::fromUtf8(data + header.title.start, header.title.length);
+    }
+    if (header.zettelId.isValid()) {
+        entry->headerZettelId = QString::fromLatin1(data + header.zettelId.start, header.zettelId.length);
+    }
+
+    readHeadings(data, size, &entry->headings);
+
+    // Only link targets are decoded, the rest stays bytes
+    LinkTokenizer tokenizer(data, size);
+    LinkTokenizer::Link link;
+    while (tokenizer.next(&link)) {
+        const QString key = LinkParser::normalizeTitle(
+            QString::fromUtf8(data + link.target.start, link.target.length));
+        if (!key.isEmpty() && !entry->links.contains(key)) {
+            entry->links.append(key);
+        }
+    }
+}
+
+qint64 MetadataCache::modificationTime(const QFileInfo &info)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    // Skips the local time conversion, which adds up over a large vault
+    return info.lastModified(QTimeZone::UTC).toMSecsSinceEpoch();
+#else
+    return info.lastModified().toMSecsSinceEpoch();
+#endif
+}
+
+QString MetadataCache::string(quint32 index) const
+{
+    const StringRef &ref = m_strings[index];
+    return QString(reinterpret_cast<const QChar *>(m_chars + ref.offset), ref.length);
+}
+
+QStringList MetadataCache::strings(quint32 first, quint32 count) const
+{
+    QStringList result;
+    result.reserve(count);
+    for (quint32 i = first; i < first + count; ++i) {
+        result.append(string(m_items[i]));
+    }
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVector>
+
+// What the notes of a vault say about themselves, kept across sessions.
+//
+// <vault>/.formica/cache.bin holds one entry per note: modification time,
+// size and content hash, the first-line header, the headings and the
+// outgoing links. The file is memory-mapped and its strings are stored as
+// UTF-16, so opening it costs a bounds check and a path table; an entry is
+// trusted as long as the note's modification time and size match, which
+// turns a cold start into a walk of stat calls instead of a read of every
+// note.
+class MetadataCache
+{
+public:
+    struct Entry {
+        qint64 mtime = 0;
+        qint64 size = -1;
+        quint64 hash = 0;           // FNV-1a of the content
+        QString headerTitle;        // First line when it is a "# Header"
+        QString headerZettelId;     // Zettel id the first line starts with
+        QStringList headings;       // "## Text", in order, outside code fences
+        QStringList links;          // Normalized [[link]] targets, each once
+    };
+
+    explicit MetadataCache(const QString &vaultPath);
+    ~MetadataCache();
+
+    QString cacheFilePath() const;
+
+    // Map the cache file. Returns false (and finds nothing) if it is
+    // missing, was written by another format version or is corrupt.
+    bool open();
+    void close();
+    int entryCount() const { return m_paths.size(); }
+
+    // The stored entry of relPath, if the file still has this modification
+    // time and size
+    bool find(const QString &relPath, qint64 mtime, qint64 size, Entry *entry) const;
+
+    // Replace the cache file with these (relative path, entry) pairs
+    bool save(const QVector<QPair<QString, Entry>> &entries);
+
+    // Read a note's metadata from disk; false if it cannot be opened
+    static bool readEntry(const QString &filePath, Entry *entry);
+    // Fill in what the content says (all but mtime and size)
+    static void parseContent(const char *data, qsizetype size, Entry *entry);
+    // Milliseconds since the epoch, as stored in entries
+    static qint64 modificationTime(const QFileInfo &info);
+
+    static const quint32 FormatVersion = 1;
+
+private:
+    struct StringRef;
+    struct Record;
+
+    QString string(quint32 index) const;
+    QStringList strings(quint32 first, quint32 count) const;
+
+    QString m_vaultPath;
+    QFile m_file;
+    const uchar *m_map = nullptr;
+    const Record *m_records = nullptr;
+    const StringRef *m_strings = nullptr;
+    const quint32 *m_items = nullptr;       // String indexes of the lists
+    const char16_t *m_chars = nullptr;
+    quint32 m_stringCount = 0;
+    QHash<QStringView, quint32> m_paths;    // Views into the mapping -> record
+};
+
+#endif // METADATACACHE_H
\ No newline at end of file
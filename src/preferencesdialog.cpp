@@ -122,6 +122,18 @@ void PreferencesDialog::setupEditorTab()
     optionsLayout->addWidget(m_lineWrappingCheckBox);
     optionsLayout->addWidget(m_showLineNumbersCheckBox);
 
+    // Preview delay
+    auto *delayLayout = new QHBoxLayout;
+    delayLayout->addWidget(new QLabel("Preview Delay:"));
+    m_previewDelaySpinBox = new QSpinBox;
+    m_previewDelaySpinBox->setRange(0, 2000);
+    m_previewDelaySpinBox->setSingleStep(50);
+    m_previewDelaySpinBox->setSuffix(" ms");
+    m_previewDelaySpinBox->setToolTip("Longest time the preview lags behind typing");
+    delayLayout->addWidget(m_previewDelaySpinBox);
+    delayLayout->addStretch();
+    optionsLayout->addLayout(delayLayout);
+
     layout->addWidget(optionsGroup);
     layout->addStretch();
 
@@ -155,6 +167,7 @@ void PreferencesDialog::loadCurrentSettings()
     // Load editor options
     m_lineWrappingCheckBox->setChecked(settings->lineWrapping());
     m_showLineNumbersCheckBox->setChecked(settings->showLineNumbers());
+    m_previewDelaySpinBox->setValue(settings->previewDelay());
 
     updateFontSample();
 }
@@ -180,6 +193,7 @@ void PreferencesDialog::applySettings()
     // Apply editor options
     settings->setLineWrapping(m_lineWrappingCheckBox->isChecked());
     settings->setShowLineNumbers(m_showLineNumbersCheckBox->isChecked());
+    settings->setPreviewDelay(m_previewDelaySpinBox->value());
 }
 
 void PreferencesDialog::resetToDefaults()
@@ -190,6 +204,7 @@ void PreferencesDialog::resetToDefaults()
     m_fontSizeSpinBox->setValue(12);
     m_lineWrappingCheckBox->setChecked(true);
     m_showLineNumbersCheckBox->setChecked(false);
+    m_previewDelaySpinBox->setValue(100);
 
     updateFontSample();
 }
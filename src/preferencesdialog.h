@@ -48,6 +48,7 @@ private:
     QLabel *m_fontSampleLabel;
     QCheckBox *m_lineWrappingCheckBox;
     QCheckBox *m_showLineNumbersCheckBox;
+    QSpinBox *m_previewDelaySpinBox;
 
     // Dialog buttons
     QPushButton *m_okButton;
@@ -0,0 +1,146 @@
+#include "quickopen.h"
+#include "vaultindex.h"
+#include <QKeyEvent>
+#include <QElapsedTimer>
+#include <QFileInfo>
+
+QuickOpen::QuickOpen(VaultIndex *index, QWidget *parent)
+    : QDialog(parent), m_index(index)
+{
+    setupUI();
+    rebuild();
+
+    connect(m_input, &QLineEdit::textChanged, this, &QuickOpen::updateResults);
+    connect(m_results, &QListWidget::itemActivated, this, &QuickOpen::onItemActivated);
+
+    connect(m_index, &VaultIndex::reset, this, &QuickOpen::rebuild);
+    connect(m_index, &VaultIndex::noteAdded, this, &QuickOpen::onNoteAdded);
+    connect(m_index, &VaultIndex::noteChanged, this, &QuickOpen::onNoteAdded);
+    connect(m_index, &VaultIndex::noteRenamed, this, &QuickOpen::onNoteAdded);
+    connect(m_index, &VaultIndex::noteRemoved, this, &QuickOpen::onNoteRemoved);
+
+    setWindowTitle("Quick Open");
+    resize(600, 400);
+}
+
+void QuickOpen::setupUI()
+{
+    auto *layout = new QVBoxLayout(this);
+
+    m_input = new QLineEdit;
+    m_input->setPlaceholderText("Go to note...");
+    m_input->installEventFilter(this);
+
+    m_results = new QListWidget;
+    m_results->setUniformItemSizes(true);
+    m_results->setFocusPolicy(Qt::NoFocus);
+
+    m_statusLabel = new QLabel;
+
+    layout->addWidget(m_input);
+    layout->addWidget(m_results);
+    layout->addWidget(m_statusLabel);
+}
+
+void QuickOpen::popup()
+{
+    m_input->clear();
+    updateResults();
+    show();
+    raise();
+    activateWindow();
+    m_input->setFocus();
+}
+
+bool QuickOpen::eventFilter(QObject *watched, QEvent *event)
+{
+    // Arrow keys move through the results while the input keeps focus
+    if (watched == m_input && event->type() == QEvent::KeyPress) {
+        auto *keyEvent = static_cast<QKeyEvent *>(event);
+        int row = m_results->currentRow();
+        switch (keyEvent->key()) {
+        case Qt::Key_Down:
+            m_results->setCurrentRow(qMin(row + 1, m_results->count() - 1));
+            return true;
+        case Qt::Key_Up:
+            m_results->setCurrentRow(qMax(row - 1, 0));
+            return true;
+        case Qt::Key_Return:
+        case Qt::Key_Enter:
+            if (m_results->currentItem()) {
+                onItemActivated(m_results->currentItem());
+            }
+            return true;
+        default:
+            break;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+void QuickOpen::updateResults()
+{
+    QElapsedTimer timer;
+    timer.start();
+    const auto matches = m_matcher.find(m_input->text(), ResultLimit);
+    const double ms = timer.nsecsElapsed() / 1e6;
+
+    m_results->clear();
+    for (const auto &match : matches) {
+        const VaultIndex::Note &note = m_index->note(match.id);
+        const QString folder = QFileInfo(note.path).path();
+
+        QString label = note.zettelId.isEmpty() || note.title == note.zettelId
+                            ? note.title
+                            : note.zettelId + "  " + note.title;
+        if (folder != ".") {
+            label += "    " + folder;
+        }
+
+        auto *item = new QListWidgetItem(label, m_results);
+        item->setData(Qt::UserRole, match.id);
+        item->setToolTip(note.path);
+    }
+    m_results->setCurrentRow(0);
+
+    m_statusLabel->setText(QString("%1 of %2 notes (%3 ms)")
+                               .arg(matches.size()).arg(m_matcher.size()).arg(ms, 0, 'f', 2));
+}
+
+void QuickOpen::onItemActivated(QListWidgetItem *item)
+{
+    const QString filePath = m_index->absolutePath(item->data(Qt::UserRole).toUInt());
+    if (!filePath.isEmpty()) {
+        emit noteSelected(filePath);
+    }
+    accept();
+}
+
+void QuickOpen::rebuild()
+{
+    m_matcher.clear();
+    for (int noteId = 0; noteId < m_index->idCount(); ++noteId) {
+        if (m_index->isLive(noteId)) {
+            m_matcher.insert(noteId, VaultIndex::pathWithoutSuffix(m_index->note(noteId).path));
+        }
+    }
+    if (isVisible()) {
+        updateResults();
+    }
+}
+
+void QuickOpen::onNoteAdded(quint32 noteId)
+{
+    m_matcher.insert(noteId, VaultIndex::pathWithoutSuffix(m_index->note(noteId).path));
+    if (isVisible()) {
+        updateResults();
+    }
+}
+
+void QuickOpen::onNoteRemoved(quint32 noteId)
+{
+    m_matcher.remove(noteId);
+    if (isVisible()) {
+        updateResults();
+    }
+}
\ No newline at end of file
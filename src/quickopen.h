@@ -0,0 +1,52 @@
+#ifndef QUICKOPEN_H
+#define QUICKOPEN_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QLabel>
+#include <QVBoxLayout>
+#include "fuzzymatcher.h"
+
+class VaultIndex;
+
+// Ctrl+P note switcher: fuzzy matches the paths of all notes in the vault
+// as you type. The matcher follows the vault index, so the palette is
+// ready the moment it opens.
+class QuickOpen : public QDialog
+{
+    Q_OBJECT
+
+public:
+    static const int ResultLimit = 50;
+
+    explicit QuickOpen(VaultIndex *index, QWidget *parent = nullptr);
+
+    // Clear the input and show the palette
+    void popup();
+
+signals:
+    void noteSelected(const QString &filePath);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void updateResults();
+    void onItemActivated(QListWidgetItem *item);
+    void rebuild();
+    void onNoteAdded(quint32 noteId);
+    void onNoteRemoved(quint32 noteId);
+
+private:
+    void setupUI();
+
+    VaultIndex *m_index;
+    FuzzyMatcher m_matcher;
+
+    QLineEdit *m_input;
+    QListWidget *m_results;
+    QLabel *m_statusLabel;
+};
+
+#endif // QUICKOPEN_H
\ No newline at end of file
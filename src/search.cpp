@@ -1,16 +1,14 @@
 #include "search.h"
-#include <QDir>
-#include <QDirIterator>
-#include <QFile>
-#include <QTextStream>
-#include <QFileInfo>
+#include "searchjob.h"
+#include "searchresultmodel.h"
 #include <QKeyEvent>
-#include <QApplication>
 
 Search::Search(const QString &workspacePath, QWidget *parent)
-    : QDialog(parent), m_workspacePath(workspacePath)
+    : QDialog(parent), m_workspacePath(workspacePath),
+      m_index(new SearchIndexHandle), m_job(nullptr)
 {
     setupUI();
+    m_index->index.setVaultPath(workspacePath);
 
     m_searchTimer = new QTimer(this);
     m_searchTimer->setSingleShot(true);
@@ -18,8 +16,9 @@ Search::Search(const QString &workspacePath, QWidget *parent)
 
     connect(m_searchTimer, &QTimer::timeout, this, &Search::onSearchTimerTimeout);
     connect(m_searchEdit, &QLineEdit::textChanged, this, &Search::onSearchTextChanged);
-    connect(m_resultsList, &QListWidget::itemDoubleClicked, this, &Search::onResultDoubleClicked);
+    connect(m_resultsList, &QListView::doubleClicked, this, &Search::onResultDoubleClicked);
     connect(m_searchButton, &QPushButton::clicked, this, &Search::performSearch);
+    connect(m_modeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &Search::performSearch);
 
     setWindowTitle("Search in Files");
     resize(600, 400);
@@ -36,11 +35,24 @@ void Search::setupUI()
     m_searchButton = new QPushButton("Search");
     m_searchButton->setDefault(true);
 
+    m_modeCombo = new QComboBox;
+    m_modeCombo->addItem("Text", SearchJob::Substring);
+    m_modeCombo->addItem("Query", SearchJob::Query);
+    m_modeCombo->addItem("Regular expression", SearchJob::Regex);
+    m_modeCombo->addItem("Ranked", SearchJob::Ranked);
+    m_modeCombo->setToolTip("Text matches literally; Query understands AND, OR, NOT, \"phrases\" and title:, tag:, path:, id:\n"
+                            "Ranked shows the most relevant notes first, with their best lines");
+
     searchLayout->addWidget(m_searchEdit);
+    searchLayout->addWidget(m_modeCombo);
     searchLayout->addWidget(m_searchButton);
 
-    // Results list
-    m_resultsList = new QListWidget;
+    // Results list, rows are formatted only when they become visible
+    m_resultsModel = new SearchResultModel(this);
+    m_resultsList = new QListView;
+    m_resultsList->setModel(m_resultsModel);
+    m_resultsList->setUniformItemSizes(true);
+    m_resultsList->setEditTriggers(QAbstractItemView::NoEditTriggers);
     m_resultsList->setAlternatingRowColors(true);
 
     // Status label
@@ -56,15 +68,36 @@ void Search::setupUI()
 void Search::setWorkspacePath(const QString &path)
 {
     m_workspacePath = path;
+
+    // Running jobs keep the old index alive until they notice the cancel
+    cancelSearch();
+    m_index.reset(new SearchIndexHandle);
+    m_index->index.setVaultPath(path);
+}
+
+void Search::setIndex(const QSharedPointer<SearchIndexHandle> &index)
+{
+    cancelSearch();
+    m_index = index;
+}
+
+void Search::cancelSearch()
+{
+    if (m_job) {
+        m_job->cancel();
+        m_job->deleteLater();
+        m_job = nullptr;
+    }
 }
 
 void Search::onSearchTextChanged()
 {
     m_searchTimer->stop();
+    cancelSearch();
     if (!m_searchEdit->text().isEmpty()) {
         m_searchTimer->start();
     } else {
-        m_resultsList->clear();
+        m_resultsModel->clear();
         m_statusLabel->setText("Enter search text to begin");
     }
 }
@@ -81,99 +114,71 @@ void Search::performSearch()
         return;
     }
 
-    m_resultsList->clear();
-    m_statusLabel->setText("Searching...");
-
-    QApplication::processEvents(); // Update UI
+    cancelSearch();
 
-    auto results = FileSearcher::searchInFiles(m_workspacePath, searchText);
+    m_resultsModel->clear();
 
-    m_resultsList->clear();
-    for (const auto &result : results) {
-        auto *item = new QListWidgetItem(result.displayText);
-        item->setData(Qt::UserRole, result.filePath);
-        item->setData(Qt::UserRole + 1, result.lineNumber);
-        m_resultsList->addItem(item);
-    }
-
-    if (results.isEmpty()) {
-        m_statusLabel->setText(QString("No results found for '%1'").arg(searchText));
-    } else {
-        m_statusLabel->setText(QString("Found %1 results").arg(results.size()));
+    auto mode = SearchJob::Mode(m_modeCombo->currentData().toInt());
+    if (mode == SearchJob::Query) {
+        SearchQuery query(searchText);
+        if (!query.isValid()) {
+            m_statusLabel->setText(QString("Invalid query: %1").arg(query.errorString()));
+            return;
+        }
+    } else if (mode == SearchJob::Regex) {
+        QRegularExpression regex(searchText);
+        if (!regex.isValid()) {
+            m_statusLabel->setText(QString("Invalid regular expression: %1").arg(regex.errorString()));
+            return;
+        }
     }
-}
 
-void Search::onResultDoubleClicked(QListWidgetItem *item)
-{
-    if (!item) return;
-
-    QString filePath = item->data(Qt::UserRole).toString();
-    int lineNumber = item->data(Qt::UserRole + 1).toInt();
+    m_statusLabel->setText("Searching...");
 
-    emit fileSelected(filePath, lineNumber);
-    accept();
+    m_job = new SearchJob(m_index, searchText, mode, this);
+    connect(m_job, &SearchJob::resultsReady, this, &Search::onJobResults);
+    connect(m_job, &SearchJob::finished, this, &Search::onJobFinished);
+    m_job->start();
 }
 
-// FileSearcher implementation
-
-QList<Search::SearchResult> FileSearcher::searchInFiles(const QString &directory, const QString &searchText)
+void Search::onJobResults(const QList<SearchHits> &batch)
 {
-    QList<Search::SearchResult> allResults;
-
-    QDirIterator it(directory,
-                    QStringList() << "*.md" << "*.markdown" << "*.txt",
-                    QDir::Files,
-                    QDirIterator::Subdirectories);
-
-    while (it.hasNext()) {
-        QString filePath = it.next();
-        if (isTextFile(filePath)) {
-            auto fileResults = searchInSingleFile(filePath, searchText);
-            allResults.append(fileResults);
-        }
+    if (sender() != m_job) {
+        return;
     }
 
-    return allResults;
+    m_resultsModel->appendHits(batch);
+    m_statusLabel->setText(QString("Searching... %1 results so far").arg(m_resultsModel->rowCount()));
 }
 
-bool FileSearcher::isTextFile(const QString &filePath)
+void Search::onJobFinished()
 {
-    QFileInfo info(filePath);
-    QString suffix = info.suffix().toLower();
-    return suffix == "md" || suffix == "markdown" || suffix == "txt";
-}
-
-QList<Search::SearchResult> FileSearcher::searchInSingleFile(const QString &filePath, const QString &searchText)
-{
-    QList<Search::SearchResult> results;
-
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return results;
+    if (sender() != m_job) {
+        return;
     }
 
-    QTextStream in(&file);
-    int lineNumber = 1;
-    QString line;
-
-    while (in.readLineInto(&line)) {
-        if (line.contains(searchText, Qt::CaseInsensitive)) {
-            Search::SearchResult result;
-            result.filePath = filePath;
-            result.lineNumber = lineNumber;
-            result.lineText = line.trimmed();
+    QString searchText = m_job->searchText();
+    m_job->deleteLater();
+    m_job = nullptr;
 
-            QFileInfo fileInfo(filePath);
-            result.displayText = QString("%1:%2: %3")
-                .arg(fileInfo.fileName())
-                .arg(lineNumber)
-                .arg(line.trimmed());
-
-            results.append(result);
-        }
-        lineNumber++;
+    int resultCount = m_resultsModel->rowCount();
+    if (resultCount == 0) {
+        m_statusLabel->setText(QString("No results found for '%1'").arg(searchText));
+    } else if (m_modeCombo->currentData().toInt() == SearchJob::Ranked) {
+        m_statusLabel->setText(QString("Showing the best lines of the %1 most relevant notes")
+                               .arg(m_resultsModel->fileCount()));
+    } else {
+        m_statusLabel->setText(QString("Found %1 results").arg(resultCount));
     }
-
-    return results;
 }
 
+void Search::onResultDoubleClicked(const QModelIndex &index)
+{
+    if (!index.isValid()) return;
+
+    QString filePath = index.data(SearchResultModel::FilePathRole).toString();
+    int lineNumber = index.data(SearchResultModel::LineNumberRole).toInt();
+
+    emit fileSelected(filePath, lineNumber);
+    accept();
+}
\ No newline at end of file
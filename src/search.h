@@ -4,12 +4,19 @@
 #include <QWidget>
 #include <QDialog>
 #include <QLineEdit>
-#include <QListWidget>
+#include <QListView>
 #include <QLabel>
 #include <QPushButton>
+#include <QComboBox>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QTimer>
+#include <QSharedPointer>
+#include "filesearcher.h"
+
+struct SearchIndexHandle;
+class SearchJob;
+class SearchResultModel;
 
 class Search : public QDialog
 {
@@ -19,6 +26,8 @@ public:
     explicit Search(const QString &workspacePath, QWidget *parent = nullptr);
 
     void setWorkspacePath(const QString &path);
+    // Search an index kept by someone else, e.g. one a vault watcher feeds
+    void setIndex(const QSharedPointer<SearchIndexHandle> &index);
 
 signals:
     void fileSelected(const QString &filePath, int line = -1);
@@ -26,42 +35,28 @@ signals:
 private slots:
     void onSearchTextChanged();
     void onSearchTimerTimeout();
-    void onResultDoubleClicked(QListWidgetItem *item);
+    void onResultDoubleClicked(const QModelIndex &index);
     void performSearch();
+    void onJobResults(const QList<SearchHits> &batch);
+    void onJobFinished();
 
 private:
     void setupUI();
+    void cancelSearch();
     void searchInFile(const QString &filePath, const QString &searchText);
     void addSearchResult(const QString &filePath, int lineNumber, const QString &lineText);
 
     QLineEdit *m_searchEdit;
-    QListWidget *m_resultsList;
+    QListView *m_resultsList;
+    SearchResultModel *m_resultsModel;
     QLabel *m_statusLabel;
     QPushButton *m_searchButton;
+    QComboBox *m_modeCombo;
 
     QTimer *m_searchTimer;
     QString m_workspacePath;
-
-public:
-    struct SearchResult {
-        QString filePath;
-        int lineNumber;
-        QString lineText;
-        QString displayText;
-    };
-};
-
-// Helper class for file content search
-class FileSearcher : public QObject
-{
-    Q_OBJECT
-
-public:
-    static QList<Search::SearchResult> searchInFiles(const QString &directory, const QString &searchText);
-
-private:
-    static bool isTextFile(const QString &filePath);
-    static QList<Search::SearchResult> searchInSingleFile(const QString &filePath, const QString &searchText);
+    QSharedPointer<SearchIndexHandle> m_index;
+    SearchJob *m_job;
 };
 
 #endif // SEARCH_H
\ No newline at end of file
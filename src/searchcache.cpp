@@ -0,0 +1,82 @@
+#include "searchcache.h"
+
+SearchCache::SearchCache(int maxHits)
+    : m_entries(maxHits)
+{
+}
+
+QString SearchCache::key(int mode, const QString &text)
+{
+    return QString::number(mode) + QLatin1Char('\n') + text;
+}
+
+bool SearchCache::lookup(int mode, const QString &text, quint64 generation, QList<SearchHits> *results) const
+{
+    // object() also marks the entry as recently used
+    Entry *entry = m_entries.object(key(mode, text));
+    if (!entry || entry->generation != generation) {
+        return false;
+    }
+
+    *results = entry->results;
+    return true;
+}
+
+bool SearchCache::lookupNarrowing(int mode, const QString &text, quint64 generation, QString *cachedText,
+                                  QList<SearchHits> *results) const
+{
+    QString best;
+    bool found = false;
+
+    const auto keys = m_entries.keys();
+    for (const QString &k : keys) {
+        const Entry *entry = m_entries.object(k);
+        if (entry->mode != mode || entry->generation != generation) {
+            continue;
+        }
+        if (entry->text.size() < text.size() && entry->text.size() >= best.size() && text.contains(entry->text)) {
+            best = entry->text;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    *cachedText = best;
+    *results = m_entries.object(key(mode, best))->results;
+    return true;
+}
+
+void SearchCache::insert(int mode, const QString &text, quint64 generation, const QList<SearchHits> &results)
+{
+    // Entries of older generations can never be served again. Newer ones
+    // are there when a job planned before an index update finishes late;
+    // then it is its results that are outdated.
+    const auto keys = m_entries.keys();
+    for (const QString &k : keys) {
+        const quint64 entryGeneration = m_entries.object(k)->generation;
+        if (entryGeneration > generation) {
+            return;
+        }
+        if (entryGeneration < generation) {
+            m_entries.remove(k);
+        }
+    }
+
+    qsizetype hits = 1;
+    for (const auto &fileHits : results) {
+        hits += fileHits.hits.size();
+    }
+    if (hits > m_entries.maxCost()) {
+        return;
+    }
+
+    m_entries.insert(key(mode, text), new Entry{mode, text, generation, results}, hits);
+}
+
+void SearchCache::clear()
+{
+    m_entries.clear();
+}
\ No newline at end of file
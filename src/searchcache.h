@@ -0,0 +1,47 @@
+#ifndef SEARCHCACHE_H
+#define SEARCHCACHE_H
+
+#include <QString>
+#include <QList>
+#include <QCache>
+#include "filesearcher.h"
+
+// Results of recent searches for search-as-you-type.
+//
+// Entries are keyed on the search mode and the normalized query, and tagged
+// with the index generation they were computed at. The generation changes
+// whenever any note is added, changed or removed, so an entry can never be
+// served for a different vault state; older entries are dropped on the next
+// insert. Size is bounded by the total number of hits held.
+class SearchCache
+{
+public:
+    explicit SearchCache(int maxHits = 200000);
+
+    bool lookup(int mode, const QString &text, quint64 generation, QList<SearchHits> *results) const;
+
+    // The entry of the same mode whose text is the longest proper substring
+    // of text. For substring search its hits are a superset of the hits of
+    // text, so only they need to be filtered again.
+    bool lookupNarrowing(int mode, const QString &text, quint64 generation, QString *cachedText,
+                         QList<SearchHits> *results) const;
+
+    void insert(int mode, const QString &text, quint64 generation, const QList<SearchHits> &results);
+    void clear();
+
+    int maxHits() const { return int(m_entries.maxCost()); }
+
+private:
+    struct Entry {
+        int mode;
+        QString text;
+        quint64 generation;
+        QList<SearchHits> results;
+    };
+
+    static QString key(int mode, const QString &text);
+
+    mutable QCache<QString, Entry> m_entries;
+};
+
+#endif // SEARCHCACHE_H
\ No newline at end of file
@@ -0,0 +1,1083 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QSet>
+#include <QRegularExpression>
+#include <QDirIterator>
+#include <QFile>
+#include <QThread>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QHash>
+#include <functional>
+#include "bulkreader.h"
+#include "filesearcher.h"
+#include "fuzzymatcher.h"
+#include "indexpipeline.h"
+#include "linkgraph.h"
+#include "linktokenizer.h"
+#include "markdownparser.h"
+#include "markdowntokenizer.h"
+#include "searchindex.h"
+#include "searchquery.h"
+#include "vaultindex.h"
+#include "vaultwalker.h"
+#include "vaultwatcher.h"
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// formica-search: headless search over a vault, for scripts, cron jobs and
+// benchmarks. Uses the same index as the application.
+
+namespace {
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+void openIndex(SearchIndex *index, bool rebuild, double *elapsedMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!rebuild) {
+        index->load();
+    }
+    if (index->update() && !index->save()) {
+        err() << "warning: could not write " << index->indexFilePath() << Qt::endl;
+    }
+
+    if (elapsedMs) {
+        *elapsedMs = timer.nsecsElapsed() / 1e6;
+    }
+}
+
+struct Timing {
+    double bestMs = 0;
+    double averageMs = 0;
+};
+
+// Runs fn repeat times, returning the result of the last run
+template <typename Result>
+Result timeRuns(int repeat, Timing *timing, const std::function<Result()> &fn)
+{
+    Result result;
+    double total = 0;
+    for (int i = 0; i < repeat; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        result = fn();
+        double ms = timer.nsecsElapsed() / 1e6;
+        total += ms;
+        timing->bestMs = i == 0 ? ms : qMin(timing->bestMs, ms);
+    }
+    timing->averageMs = total / repeat;
+    return result;
+}
+
+// Per-stage counters of an index build: items and MB per second of the
+// build's wall time, and how busy the stage's threads were
+void printStages(const IndexPipeline::Stats &stats)
+{
+    const double seconds = qMax<qint64>(stats.elapsedNs, 1) / 1e9;
+    err() << QString("%1 %2 %3 %4 %5 %6 %7")
+                 .arg(QString("stage"), -9).arg(QString("threads"), 7).arg(QString("items"), 8)
+                 .arg(QString("items/s"), 10).arg(QString("MB/s"), 8)
+                 .arg(QString("busy ms"), 10).arg(QString("wait ms"), 10)
+          << Qt::endl;
+
+    auto printStage = [&](const QString &name, const IndexPipeline::Stage &stage, double stageSeconds) {
+        err() << QString("%1 %2 %3 %4 %5 %6 %7")
+                     .arg(name, -9).arg(stage.threads, 7).arg(stage.items, 8)
+                     .arg(stage.items / stageSeconds, 10, 'f', 0)
+                     .arg(stage.bytes / stageSeconds / (1024 * 1024), 8, 'f', 1)
+                     .arg(stage.busyNs / 1e6, 10, 'f', 1).arg(stage.waitNs / 1e6, 10, 'f', 1)
+              << Qt::endl;
+    };
+    printStage("discover", stats.discover, qMax<qint64>(stats.discover.busyNs, 1) / 1e9);
+    printStage("read", stats.read, seconds);
+    printStage("parse", stats.parse, seconds);
+    printStage("merge", stats.merge, seconds);
+    err() << QString("pipeline %1 ms, paused %2 ms")
+                 .arg(stats.elapsedNs / 1e6, 0, 'f', 1).arg(stats.pausedNs / 1e6, 0, 'f', 1)
+          << Qt::endl;
+}
+
+int countNotes(const QList<SearchResult> &results)
+{
+    QSet<QString> files;
+    for (const auto &result : results) {
+        files.insert(result.filePath);
+    }
+    return files.size();
+}
+
+void printBenchRow(const QString &name, const QList<SearchResult> &results, const Timing &timing)
+{
+    out() << QString("%1 %2 %3 %4 %5")
+                 .arg(name, -10)
+                 .arg(results.size(), 8)
+                 .arg(countNotes(results), 7)
+                 .arg(timing.bestMs, 10, 'f', 2)
+                 .arg(timing.averageMs, 10, 'f', 2)
+          << Qt::endl;
+}
+
+int runQuery(const QCommandLineParser &parser, const QString &vault, const QString &text)
+{
+    SearchIndex index(vault);
+    double indexMs = 0;
+    openIndex(&index, false, &indexMs);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<SearchResult> results;
+    if (parser.isSet("regex")) {
+        QRegularExpression regex(text, QRegularExpression::CaseInsensitiveOption);
+        if (!regex.isValid()) {
+            err() << "Invalid regular expression: " << regex.errorString() << Qt::endl;
+            return 2;
+        }
+        results = FileSearcher::searchRegex(index, regex);
+    } else if (parser.isSet("ranked")) {
+        int limit = parser.isSet("limit") ? parser.value("limit").toInt() : FileSearcher::RankedLimit;
+        results = FileSearcher::searchRanked(index, text, limit);
+    } else if (parser.isSet("query")) {
+        SearchQuery query(text);
+        if (!query.isValid()) {
+            err() << "Invalid query: " << query.errorString() << Qt::endl;
+            return 2;
+        }
+        if (parser.isSet("explain")) {
+            err() << query.explain(index);
+        }
+        results = FileSearcher::searchQuery(index, query);
+    } else {
+        results = FileSearcher::searchIndex(index, text);
+    }
+
+    double queryMs = timer.nsecsElapsed() / 1e6;
+
+    if (parser.isSet("count")) {
+        out() << results.size() << Qt::endl;
+    } else {
+        QDir root(vault);
+        int limit = parser.isSet("limit") && !parser.isSet("ranked") ? parser.value("limit").toInt() : -1;
+        for (qsizetype i = 0; i < results.size() && (limit < 0 || i < limit); ++i) {
+            const auto &result = results[i];
+            out() << root.relativeFilePath(result.filePath) << ':' << result.lineNumber << ": "
+                  << result.lineText << '\n';
+        }
+        out().flush();
+    }
+
+    if (parser.isSet("time")) {
+        err() << QString("index %1 ms, query %2 ms, %3 results")
+                     .arg(indexMs, 0, 'f', 2).arg(queryMs, 0, 'f', 2).arg(results.size())
+              << Qt::endl;
+    }
+
+    return results.isEmpty() ? 1 : 0;
+}
+
+int runIndex(const QCommandLineParser &parser, const QString &action, const QString &vault)
+{
+    SearchIndex index(vault);
+
+    if (action == "build") {
+        double ms = 0;
+        openIndex(&index, parser.isSet("rebuild"), &ms);
+        out() << QString("Indexed %1 notes in %2 ms").arg(index.noteCount()).arg(ms, 0, 'f', 1) << Qt::endl;
+        if (parser.isSet("time")) {
+            printStages(index.buildStats());
+        }
+        return 0;
+    }
+
+    if (action == "info") {
+        QElapsedTimer timer;
+        timer.start();
+        bool loaded = index.load();
+        double loadMs = timer.nsecsElapsed() / 1e6;
+
+        out() << "Index file:   " << index.indexFilePath() << '\n';
+        if (!loaded) {
+            out() << "Status:       missing, stale or corrupt (run 'index build')" << Qt::endl;
+            return 1;
+        }
+        out() << "Format:       " << SearchIndex::FormatVersion << '\n'
+              << "Size:         " << QFileInfo(index.indexFilePath()).size() << " bytes\n"
+              << "Notes:        " << index.noteCount() << '\n'
+              << "Terms:        " << index.termCount() << '\n'
+              << "Trigrams:     " << index.trigramCount() << '\n'
+              << "Load time:    " << QString::number(loadMs, 'f', 2) << " ms\n"
+              << "Out of date:  " << (index.update() ? "yes" : "no") << Qt::endl;
+        return 0;
+    }
+
+    err() << "Unknown index action: " << action << " (expected build or info)" << Qt::endl;
+    return 2;
+}
+
+// Times every strategy that can answer text on the same vault
+int runBench(const QCommandLineParser &parser, const QString &vault, const QString &text)
+{
+    int repeat = qMax(1, parser.value("repeat").toInt());
+
+    SearchIndex index(vault);
+    double indexMs = 0;
+    openIndex(&index, parser.isSet("rebuild"), &indexMs);
+
+    out() << QString("%1 notes, %2 terms, %3 trigrams, index ready in %4 ms, %5 runs each")
+                 .arg(index.noteCount()).arg(index.termCount()).arg(index.trigramCount())
+                 .arg(indexMs, 0, 'f', 1).arg(repeat)
+          << Qt::endl;
+    out() << QString("%1 %2 %3 %4 %5")
+                 .arg(QString("strategy"), -10).arg(QString("hits"), 8).arg(QString("notes"), 7)
+                 .arg(QString("best ms"), 10).arg(QString("avg ms"), 10)
+          << Qt::endl;
+
+    typedef QList<SearchResult> Results;
+    Timing timing;
+
+    if (parser.isSet("regex")) {
+        QRegularExpression regex(text, QRegularExpression::CaseInsensitiveOption);
+        if (!regex.isValid()) {
+            err() << "Invalid regular expression: " << regex.errorString() << Qt::endl;
+            return 2;
+        }
+        regex.optimize();
+
+        Results results = timeRuns<Results>(repeat, &timing, [&]() {
+            Results all;
+            const QStringList paths = index.notePaths();
+            for (const QString &path : paths) {
+                QStringList lineTexts;
+                auto hits = FileSearcher::matchRegexInSingleFile(path, regex, &lineTexts);
+                for (qsizetype i = 0; i < hits.size(); ++i) {
+                    all.append(SearchResult{path, hits[i].lineNumber, lineTexts[i]});
+                }
+            }
+            return all;
+        });
+        printBenchRow("scan", results, timing);
+
+        results = timeRuns<Results>(repeat, &timing, [&]() { return FileSearcher::searchRegex(index, regex); });
+        printBenchRow("trigram", results, timing);
+        return 0;
+    }
+
+    Results results = timeRuns<Results>(repeat, &timing, [&]() { return FileSearcher::scanFiles(vault, text); });
+    printBenchRow("scan", results, timing);
+
+    if (parser.isSet("query")) {
+        SearchQuery query(text);
+        if (!query.isValid()) {
+            err() << "Invalid query: " << query.errorString() << Qt::endl;
+            return 2;
+        }
+        out() << "(scan matches the literal text; plan evaluates the query)" << Qt::endl;
+        results = timeRuns<Results>(repeat, &timing, [&]() { return FileSearcher::searchQuery(index, query); });
+        printBenchRow("plan", results, timing);
+        out() << query.explain(index);
+        return 0;
+    }
+
+    results = timeRuns<Results>(repeat, &timing, [&]() { return FileSearcher::searchIndex(index, text); });
+    printBenchRow("index", results, timing);
+
+    results = timeRuns<Results>(repeat, &timing, [&]() {
+        Results all;
+        QVector<quint32> notes;
+        if (!index.candidateNotes(text, &notes)) {
+            return FileSearcher::scanFiles(vault, text);
+        }
+        for (quint32 noteId : notes) {
+            all.append(FileSearcher::searchInSingleFile(index.notePath(noteId), text));
+        }
+        return all;
+    });
+    printBenchRow("trigram", results, timing);
+
+    results = timeRuns<Results>(repeat, &timing, [&]() { return FileSearcher::searchRanked(index, text); });
+    printBenchRow("ranked", results, timing);
+
+    return 0;
+}
+
+// Quick-open matching, as the Ctrl+P palette does it
+int runOpen(const QCommandLineParser &parser, const QString &vault, const QString &pattern)
+{
+    QElapsedTimer timer;
+    timer.start();
+    VaultIndex index;
+    index.setVaultPathNow(vault);
+
+    FuzzyMatcher matcher;
+    for (int noteId = 0; noteId < index.idCount(); ++noteId) {
+        if (index.isLive(noteId)) {
+            matcher.insert(noteId, VaultIndex::pathWithoutSuffix(index.note(noteId).path));
+        }
+    }
+    double loadMs = timer.nsecsElapsed() / 1e6;
+
+    int limit = parser.isSet("limit") ? parser.value("limit").toInt() : 50;
+    int repeat = parser.isSet("time") ? qMax(1, parser.value("repeat").toInt()) : 1;
+    Timing timing;
+    const auto matches = timeRuns<QVector<FuzzyMatcher::Match>>(repeat, &timing, [&]() {
+        return matcher.find(pattern, limit);
+    });
+
+    if (parser.isSet("count")) {
+        out() << matches.size() << Qt::endl;
+    } else {
+        for (const auto &match : matches) {
+            out() << QString("%1 ").arg(match.score, 5) << index.note(match.id).path << '\n';
+        }
+        out().flush();
+    }
+
+    if (parser.isSet("time")) {
+        err() << QString("%1 notes listed in %2 ms, match best %3 ms, avg %4 ms")
+                     .arg(matcher.size()).arg(loadMs, 0, 'f', 2)
+                     .arg(timing.bestMs, 0, 'f', 3).arg(timing.averageMs, 0, 'f', 3)
+              << Qt::endl;
+    }
+
+    return matches.isEmpty() ? 1 : 0;
+}
+
+// Backlinks, outgoing and unresolved links of one note, from the link graph
+int runLinks(const QCommandLineParser &parser, const QString &vault, const QString &note)
+{
+    QElapsedTimer timer;
+    timer.start();
+    VaultIndex index;
+    index.setVaultPathNow(vault);
+    LinkGraph graph(&index);
+    graph.rebuildNow();
+    double buildMs = timer.nsecsElapsed() / 1e6;
+
+    int noteId = index.noteId(note);
+    if (noteId < 0) {
+        noteId = index.resolveLink(note);
+    }
+    if (noteId < 0) {
+        err() << "No note " << note << " in " << vault << Qt::endl;
+        return 1;
+    }
+
+    int repeat = parser.isSet("time") ? qMax(1, parser.value("repeat").toInt()) : 1;
+    Timing timing;
+    const auto backlinks = timeRuns<QVector<quint32>>(repeat, &timing, [&]() {
+        return graph.backlinks(noteId);
+    });
+
+    out() << "Backlinks:\n";
+    for (quint32 source : backlinks) {
+        out() << "  " << index.note(source).path << '\n';
+    }
+    out() << "Links:\n";
+    for (quint32 target : graph.outgoingLinks(noteId)) {
+        out() << "  " << index.note(target).path << '\n';
+    }
+    for (const QString &key : graph.unresolvedLinks(noteId)) {
+        out() << "  [[" << key << "]] (missing)\n";
+    }
+    out().flush();
+
+    if (parser.isSet("time")) {
+        err() << QString("%1 notes, %2 links, graph built in %3 ms, backlinks best %4 us, avg %5 us")
+                     .arg(index.noteCount()).arg(graph.linkCount()).arg(buildMs, 0, 'f', 1)
+                     .arg(timing.bestMs * 1000, 0, 'f', 1).arg(timing.averageMs * 1000, 0, 'f', 1)
+              << Qt::endl;
+    }
+    return 0;
+}
+
+// Keeps the vault index, link graph and search index current while notes
+// change on disk, printing each batch as it is applied. Runs until killed.
+int runWatch(const QCommandLineParser &parser, const QString &vault)
+{
+    VaultIndex index;
+    index.setVaultPathNow(vault);
+    LinkGraph graph(&index);
+    graph.rebuildNow();
+    SearchIndex searchIndex;
+    searchIndex.setVaultPath(vault);
+    openIndex(&searchIndex, parser.isSet("rebuild"), nullptr);
+
+    VaultWatcher watcher(&index);
+    if (!watcher.isWatching()) {
+        err() << "Cannot watch " << vault << ": " << watcher.errorString() << Qt::endl;
+        return 1;
+    }
+
+    double searchMs = 0;
+    QObject::connect(&watcher, &VaultWatcher::notesChanged, [&](const QStringList &paths) {
+        QElapsedTimer timer;
+        timer.start();
+        if (searchIndex.updateNotes(paths) && !searchIndex.save()) {
+            err() << "warning: could not write " << searchIndex.indexFilePath() << Qt::endl;
+        }
+        searchMs = timer.nsecsElapsed() / 1e6;
+        for (const QString &path : paths) {
+            out() << "  " << path << '\n';
+        }
+    });
+    QObject::connect(&watcher, &VaultWatcher::rescanned, [&]() {
+        QElapsedTimer timer;
+        timer.start();
+        openIndex(&searchIndex, false, nullptr);
+        searchMs = timer.nsecsElapsed() / 1e6;
+    });
+    // The vault index walks in the background, its reset ends the rescan
+    QObject::connect(&index, &VaultIndex::reset, [&]() {
+        out() << "  (rescanned " << index.noteCount() << " notes)" << Qt::endl;
+    });
+    QObject::connect(&watcher, &VaultWatcher::batchApplied, [&]() {
+        const VaultWatcher::Stats &stats = watcher.stats();
+        out() << QString("%1 notes, queue %2, lag %3 ms (max %4 ms), %5 batches, %6 events, %7 links")
+                     .arg(stats.lastBatchSize).arg(watcher.queueDepth())
+                     .arg(stats.lastLagMs).arg(stats.maxLagMs)
+                     .arg(stats.batches).arg(stats.events).arg(graph.linkCount());
+        if (parser.isSet("time")) {
+            out() << QString(", search index %1 ms").arg(searchMs, 0, 'f', 1);
+        }
+        out() << Qt::endl;
+    });
+
+    err() << "Watching " << index.noteCount() << " notes in " << vault << Qt::endl;
+    return QCoreApplication::exec();
+}
+
+// Synthetic note text: prose with [[title]], [[id|title]] links, stray
+// brackets and an id header every few lines
+QByteArray linkBenchText(qsizetype size)
+{
+    static const char *const lines[] = {
+        "Ordinary prose without any links, long enough to be a typical line of a note.\n",
+        "See [[1a2]] and [[Another note]] for the background.\n",
+        "An [[12b3|aliased link]] in the middle of a sentence, [array] [[not closed\n",
+        "Plain text, a bracket [x] and a list item - done\n",
+        "# 4c1 Heading with an id\n",
+        "Several links: [[a]], [[b c]], [[ d | e ]] and [[unicode \xc3\xa9t\xc3\xa9]].\n",
+    };
+
+    QByteArray text;
+    text.reserve(size + 128);
+    int line = 0;
+    while (text.size() < size) {
+        text.append(lines[line++ % int(sizeof(lines) / sizeof(lines[0]))]);
+    }
+    return text;
+}
+
+// Wiki-link throughput of the tokenizer against the former regex
+int runLinkBench(const QCommandLineParser &parser, const QString &sizeText)
+{
+    bool ok = true;
+    const qsizetype totalMb = sizeText.isEmpty() ? 1024 : sizeText.toLongLong(&ok);
+    if (!ok || totalMb <= 0) {
+        err() << "Invalid size: " << sizeText << Qt::endl;
+        return 2;
+    }
+
+    // The same chunk is scanned until totalMb have gone through
+    const qsizetype chunkMb = qMin<qsizetype>(totalMb, 64);
+    const QByteArray utf8 = linkBenchText(chunkMb * 1024 * 1024);
+    const QString utf16 = QString::fromUtf8(utf8);
+    const qsizetype passes = (totalMb + chunkMb - 1) / chunkMb;
+    const double mb = double(utf8.size()) * passes / (1024 * 1024);
+    int repeat = qMax(1, parser.value("repeat").toInt());
+
+    out() << QString("%1 MB of text (%2 MB chunk x %3), %4 runs each")
+                 .arg(mb, 0, 'f', 0).arg(chunkMb).arg(passes).arg(repeat)
+          << Qt::endl;
+    out() << QString("%1 %2 %3 %4")
+                 .arg(QString("scanner"), -10).arg(QString("links"), 12)
+                 .arg(QString("best MB/s"), 10).arg(QString("avg MB/s"), 10)
+          << Qt::endl;
+
+    auto printRow = [&](const QString &name, qint64 links, const Timing &timing) {
+        out() << QString("%1 %2 %3 %4")
+                     .arg(name, -10).arg(links, 12)
+                     .arg(mb * 1000 / timing.bestMs, 10, 'f', 0)
+                     .arg(mb * 1000 / timing.averageMs, 10, 'f', 0)
+              << Qt::endl;
+    };
+
+    Timing timing;
+    QRegularExpression regex(R"(\[\[([^\]]+)\]\])");
+    regex.optimize();
+    const qint64 regexLinks = timeRuns<qint64>(repeat, &timing, [&]() {
+        qint64 links = 0;
+        for (qsizetype pass = 0; pass < passes; ++pass) {
+            QRegularExpressionMatchIterator it = regex.globalMatch(utf16);
+            while (it.hasNext()) {
+                links += it.next().capturedLength(1) > 0;
+            }
+        }
+        return links;
+    });
+    printRow("regex", regexLinks, timing);
+
+    auto tokenize = [&](auto makeTokenizer) {
+        qint64 links = 0;
+        for (qsizetype pass = 0; pass < passes; ++pass) {
+            LinkTokenizer tokenizer = makeTokenizer();
+            LinkTokenizer::Link link;
+            while (tokenizer.next(&link)) {
+                ++links;
+            }
+        }
+        return links;
+    };
+
+    const qint64 utf16Links = timeRuns<qint64>(repeat, &timing, [&]() {
+        return tokenize([&]() { return LinkTokenizer(utf16.constData(), utf16.size()); });
+    });
+    printRow("utf-16", utf16Links, timing);
+
+    const qint64 utf8Links = timeRuns<qint64>(repeat, &timing, [&]() {
+        return tokenize([&]() { return LinkTokenizer(utf8.constData(), utf8.size()); });
+    });
+    printRow("utf-8", utf8Links, timing);
+
+    if (utf16Links != regexLinks || utf8Links != regexLinks) {
+        err() << "Link counts differ" << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Synthetic Markdown: headings, paragraphs with emphasis, code spans and
+// links, lists, block quotes and fenced code
+QByteArray markdownBenchText(qsizetype size)
+{
+    static const char *const blocks[] = {
+        "# 4c1 Heading with an id\n\n",
+        "Ordinary prose with **strong** and *emphasised* words, `inline code` and a\n"
+        "[link](https://example.org/page \"title\") spread over two lines.\n\n",
+        "- First item with [[a wiki link]]\n- Second item, *nested **emphasis***\n"
+        "  1. Ordered child\n  2. Another child\n\n",
+        "> A quoted paragraph\n> over two lines with `code`.\n\n",
+        "```cpp\nint main()\n{\n    return 0;\n}\n```\n\n",
+        "> Quoted code:\n>\n> ```sh\n> make -j8\n> ```\n\n",
+        "1. ```bash\n   ls -la\n   ```\n2. Then\n   - ```\n     nested\n     ```\n\n",
+        "## Subheading\n\nA line with stray * stars_ and <span>inline html</span>, 3 < 4 & 5.\n\n",
+    };
+
+    QByteArray text;
+    text.reserve(size + 256);
+    int block = 0;
+    while (text.size() < size) {
+        text.append(blocks[block++ % int(sizeof(blocks) / sizeof(blocks[0]))]);
+    }
+    return text;
+}
+
+// Markdown to HTML throughput of the parser against the regex chain the
+// editor preview used before it
+int runMarkdownBench(const QCommandLineParser &parser, const QString &sizeText)
+{
+    bool ok = true;
+    const qsizetype totalMb = sizeText.isEmpty() ? 64 : sizeText.toLongLong(&ok);
+    if (!ok || totalMb <= 0) {
+        err() << "Invalid size: " << sizeText << Qt::endl;
+        return 2;
+    }
+
+    // Note-sized documents, converted one by one like the preview does
+    const QByteArray chunk = markdownBenchText(64 * 1024);
+    const QString chunk16 = QString::fromUtf8(chunk);
+    const qsizetype passes = qMax<qsizetype>(1, totalMb * 1024 * 1024 / chunk.size());
+    const double mb = double(chunk.size()) * passes / (1024 * 1024);
+    int repeat = qMax(1, parser.value("repeat").toInt());
+
+    out() << QString("%1 MB of Markdown (%2 KB document x %3), %4 runs each")
+                 .arg(mb, 0, 'f', 0).arg(chunk.size() / 1024).arg(passes).arg(repeat)
+          << Qt::endl;
+    out() << QString("%1 %2 %3 %4")
+                 .arg(QString("converter"), -10).arg(QString("html KB"), 12)
+                 .arg(QString("best MB/s"), 10).arg(QString("avg MB/s"), 10)
+          << Qt::endl;
+
+    auto printRow = [&](const QString &name, qint64 bytes, const Timing &timing) {
+        out() << QString("%1 %2 %3 %4")
+                     .arg(name, -10).arg(bytes / 1024, 12)
+                     .arg(mb * 1000 / timing.bestMs, 10, 'f', 1)
+                     .arg(mb * 1000 / timing.averageMs, 10, 'f', 1)
+              << Qt::endl;
+    };
+
+    Timing timing;
+    const QRegularExpression h3("^### (.+)$", QRegularExpression::MultilineOption);
+    const QRegularExpression h2("^## (.+)$", QRegularExpression::MultilineOption);
+    const QRegularExpression h1("^# (.+)$", QRegularExpression::MultilineOption);
+    const QRegularExpression strong("\\*\\*(.+?)\\*\\*");
+    const QRegularExpression em("\\*(.+?)\\*");
+    const QRegularExpression fence("```([\\s\\S]*?)```");
+    const QRegularExpression code("`(.+?)`");
+    const QRegularExpression link("\\[(.+?)\\]\\((.+?)\\)");
+    const qint64 regexBytes = timeRuns<qint64>(repeat, &timing, [&]() {
+        qint64 bytes = 0;
+        for (qsizetype pass = 0; pass < passes; ++pass) {
+            QString html = chunk16;
+            html.replace(h3, "<h3>\\1</h3>");
+            html.replace(h2, "<h2>\\1</h2>");
+            html.replace(h1, "<h1>\\1</h1>");
+            html.replace(strong, "<strong>\\1</strong>");
+            html.replace(em, "<em>\\1</em>");
+            html.replace(fence, "<pre><code>\\1</code></pre>");
+            html.replace(code, "<code>\\1</code>");
+            html.replace(link, "<a href=\"\\2\">\\1</a>");
+            html.replace("\n", "<br>");
+            bytes += html.size();
+        }
+        return bytes;
+    });
+    printRow("regex", regexBytes, timing);
+
+    MarkdownParser markdown;
+    const qint64 parseEvents = timeRuns<qint64>(repeat, &timing, [&]() {
+        qint64 events = 0;
+        for (qsizetype pass = 0; pass < passes; ++pass) {
+            markdown.parse(chunk);
+            events += markdown.events().size();
+        }
+        return events;
+    });
+    out() << QString("%1 %2 %3 %4")
+                 .arg(QString("parse"), -10).arg(QString("%1 ev").arg(parseEvents / passes), 12)
+                 .arg(mb * 1000 / timing.bestMs, 10, 'f', 1)
+                 .arg(mb * 1000 / timing.averageMs, 10, 'f', 1)
+          << Qt::endl;
+
+    const qint64 parserBytes = timeRuns<qint64>(repeat, &timing, [&]() {
+        qint64 bytes = 0;
+        for (qsizetype pass = 0; pass < passes; ++pass) {
+            markdown.parse(chunk);
+            bytes += markdown.toHtml().size();
+        }
+        return bytes;
+    });
+    printRow("parser", parserBytes, timing);
+    return 0;
+}
+
+// Whole-document highlighting of a note split into lines, the way
+// QSyntaxHighlighter::rehighlight sees it: the editor's former rule loop
+// (six regular expressions per line) against the stateful tokenizer.
+// Spans are only counted; applying formats costs both the same.
+int runHighlightBench(const QCommandLineParser &parser, const QString &sizeText)
+{
+    bool ok = true;
+    const qsizetype sizeMb = sizeText.isEmpty() ? 10 : sizeText.toLongLong(&ok);
+    if (!ok || sizeMb <= 0) {
+        err() << "Invalid size: " << sizeText << Qt::endl;
+        return 2;
+    }
+
+    const QByteArray utf8 = "---\ntitle: Bench\ntags: [a, b]\n---\n" + markdownBenchText(sizeMb * 1024 * 1024);
+    const QStringList lines = QString::fromUtf8(utf8).split(QLatin1Char('\n'));
+    const double mb = double(utf8.size()) / (1024 * 1024);
+    int repeat = qMax(1, parser.value("repeat").toInt());
+
+    out() << QString("%1 MB note, %2 lines, %3 runs each").arg(mb, 0, 'f', 1).arg(lines.size()).arg(repeat)
+          << Qt::endl;
+    out() << QString("%1 %2 %3 %4 %5")
+                 .arg(QString("highlighter"), -12).arg(QString("spans"), 10)
+                 .arg(QString("best ms"), 10).arg(QString("avg ms"), 10).arg(QString("MB/s"), 8)
+          << Qt::endl;
+
+    auto printRow = [&](const QString &name, qint64 spans, const Timing &timing) {
+        out() << QString("%1 %2 %3 %4 %5")
+                     .arg(name, -12).arg(spans, 10)
+                     .arg(timing.bestMs, 10, 'f', 1).arg(timing.averageMs, 10, 'f', 1)
+                     .arg(mb * 1000 / timing.bestMs, 8, 'f', 1)
+              << Qt::endl;
+    };
+
+    Timing timing;
+    const QRegularExpression rules[] = {
+        QRegularExpression("^#{1,6}\\s.*"),
+        QRegularExpression("\\*\\*([^*]+)\\*\\*"),
+        QRegularExpression("\\*([^*]+)\\*"),
+        QRegularExpression("`([^`]+)`"),
+        QRegularExpression("\\[([^]]+)\\]\\(([^)]+)\\)"),
+        QRegularExpression("\\[\\[([^\\]]+)\\]\\]"),
+    };
+    const qint64 ruleSpans = timeRuns<qint64>(repeat, &timing, [&]() {
+        qint64 spans = 0;
+        for (const QString &line : lines) {
+            for (const QRegularExpression &rule : rules) {
+                QRegularExpressionMatchIterator it = rule.globalMatch(line);
+                while (it.hasNext()) {
+                    spans += it.next().capturedLength() > 0;
+                }
+            }
+        }
+        return spans;
+    });
+    printRow("rules", ruleSpans, timing);
+
+    MarkdownTokenizer tokenizer;
+    const qint64 tokenizerSpans = timeRuns<qint64>(repeat, &timing, [&]() {
+        qint64 spans = 0;
+        int state = -1;
+        for (const QString &line : lines) {
+            state = tokenizer.tokenize(line, state);
+            spans += tokenizer.tokens().size();
+        }
+        return spans;
+    });
+    printRow("tokenizer", tokenizerSpans, timing);
+    return 0;
+}
+
+// Runs CommonMark examples through the parser, per section: the ones in
+// testdata/commonmark.json, or spec.json from https://spec.commonmark.org
+int runMarkdownCheck(const QString &specPath)
+{
+    QFile file(specPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err() << "Cannot open " << specPath << Qt::endl;
+        return 2;
+    }
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isArray()) {
+        err() << specPath << ": " << error.errorString() << Qt::endl;
+        return 2;
+    }
+
+    struct Section {
+        int passed = 0;
+        int total = 0;
+        QStringList failed;
+    };
+    QStringList order;      // Of the spec
+    QHash<QString, Section> sections;
+    MarkdownParser markdown;
+    int passed = 0;
+    int total = 0;
+    for (const QJsonValue &value : document.array()) {
+        const QJsonObject example = value.toObject();
+        const QString name = example.value("section").toString();
+        if (!sections.contains(name)) {
+            order.append(name);
+        }
+        Section &section = sections[name];
+        markdown.parse(example.value("markdown").toString().toUtf8());
+        const bool ok = markdown.toHtml() == example.value("html").toString().toUtf8();
+        section.passed += ok;
+        ++section.total;
+        if (!ok) {
+            section.failed.append(QString::number(example.value("example").toInt()));
+        }
+        passed += ok;
+        ++total;
+    }
+
+    for (const QString &name : order) {
+        const Section &section = sections[name];
+        out() << QString("%1 %2/%3").arg(name, -40).arg(section.passed, 4).arg(section.total, -4);
+        if (!section.failed.isEmpty()) {
+            out() << "  failed: " << section.failed.join(' ');
+        }
+        out() << Qt::endl;
+    }
+    out() << QString("%1 %2/%3").arg(QString("total"), -40).arg(passed, 4).arg(total) << Qt::endl;
+    return passed == total ? 0 : 1;
+}
+
+// Directory walking: QDirIterator against the native walker, names only
+// and with the stat the indexes need. Point it at a local vault and at one
+// on a network mount; the page cache makes later runs of either faster.
+int runWalkBench(const QCommandLineParser &parser, const QString &dirPath)
+{
+    if (!QFileInfo(dirPath).isDir()) {
+        err() << "No directory " << dirPath << Qt::endl;
+        return 2;
+    }
+    int repeat = qMax(1, parser.value("repeat").toInt());
+    int threads = parser.isSet("threads") ? qMax(1, parser.value("threads").toInt()) : QThread::idealThreadCount();
+
+    out() << QString("%1, %2 runs each, %3 threads").arg(dirPath).arg(repeat).arg(threads) << Qt::endl;
+    out() << QString("%1 %2 %3 %4")
+                 .arg(QString("walker"), -16).arg(QString("files"), 8)
+                 .arg(QString("best ms"), 10).arg(QString("avg ms"), 10)
+          << Qt::endl;
+
+    auto printRow = [&](const QString &name, int files, const Timing &timing) {
+        out() << QString("%1 %2 %3 %4")
+                     .arg(name, -16).arg(files, 8)
+                     .arg(timing.bestMs, 10, 'f', 2).arg(timing.averageMs, 10, 'f', 2)
+              << Qt::endl;
+    };
+
+    auto iterate = [&](bool stat) {
+        int files = 0;
+        QDirIterator it(dirPath, QStringList() << "*.md" << "*.markdown" << "*.txt",
+                        QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            if (stat) {
+                // What the indexes ask for
+                it.fileInfo().size();
+                it.fileInfo().lastModified();
+            }
+            ++files;
+        }
+        return files;
+    };
+
+    // Same rules as QDirIterator, without the vault's ignore file
+    auto walk = [&](VaultWalker::Options options) {
+        VaultWalker walker(dirPath, options);
+        walker.setIgnorePatterns({});
+        walker.setThreadCount(threads);
+        return int(walker.walk().size());
+    };
+
+    Timing timing;
+    const int iteratorFiles = timeRuns<int>(repeat, &timing, [&]() { return iterate(false); });
+    printRow("qdiriterator", iteratorFiles, timing);
+    const int iteratorStatFiles = timeRuns<int>(repeat, &timing, [&]() { return iterate(true); });
+    printRow("qdiriterator+stat", iteratorStatFiles, timing);
+
+    const QVector<QPair<QString, VaultWalker::Options>> walkers = {
+        {"native", VaultWalker::NoOptions},
+        {"native+stat", VaultWalker::Stat},
+        {"parallel", VaultWalker::Parallel},
+        {"parallel+stat", VaultWalker::Parallel | VaultWalker::Stat},
+    };
+    bool same = true;
+    for (const auto &walker : walkers) {
+        const int files = timeRuns<int>(repeat, &timing, [&]() { return walk(walker.second); });
+        printRow(walker.first, files, timing);
+        same = same && files == iteratorFiles;
+    }
+
+    if (!same) {
+        err() << "File counts differ" << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Whole-vault reading: one QFile at a time against the bulk reader's
+// backends. With --cold each file is dropped from the page cache before
+// every run, which only works for files nobody has dirty pages in.
+int runReadBench(const QCommandLineParser &parser, const QString &vaultPath)
+{
+    if (!QFileInfo(vaultPath).isDir()) {
+        err() << "No directory " << vaultPath << Qt::endl;
+        return 2;
+    }
+    int repeat = qMax(1, parser.value("repeat").toInt());
+    bool cold = parser.isSet("cold");
+
+    QDir root(vaultPath);
+    VaultWalker walker(vaultPath);
+    QStringList filePaths;
+    for (const VaultWalker::Entry &file : walker.walk()) {
+        filePaths.append(root.filePath(file.relPath));
+    }
+
+    auto evict = [&]() {
+#ifdef Q_OS_UNIX
+        for (const QString &filePath : std::as_const(filePaths)) {
+            const int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0) {
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+                ::close(fd);
+            }
+        }
+#endif
+    };
+
+    // Like timeRuns(), with the eviction left out of the timings
+    auto measure = [&](const std::function<qint64()> &fn, Timing *timing) {
+        qint64 bytes = 0;
+        double total = 0;
+        for (int i = 0; i < repeat; ++i) {
+            if (cold) {
+                evict();
+            }
+            QElapsedTimer timer;
+            timer.start();
+            bytes = fn();
+            double ms = timer.nsecsElapsed() / 1e6;
+            total += ms;
+            timing->bestMs = i == 0 ? ms : qMin(timing->bestMs, ms);
+        }
+        timing->averageMs = total / repeat;
+        return bytes;
+    };
+
+    out() << QString("%1, %2 notes, %3 runs each, %4 cache%5")
+                 .arg(vaultPath).arg(filePaths.size()).arg(repeat)
+                 .arg(cold ? "cold" : "warm")
+                 .arg(BulkReader::hasIoUring() ? "" : ", no io_uring")
+          << Qt::endl;
+    out() << QString("%1 %2 %3 %4 %5")
+                 .arg(QString("reader"), -12).arg(QString("best ms"), 10).arg(QString("avg ms"), 10)
+                 .arg(QString("files/s"), 10).arg(QString("MB/s"), 10)
+          << Qt::endl;
+
+    auto printRow = [&](const QString &name, qint64 bytes, const Timing &timing) {
+        const double seconds = qMax(timing.bestMs, 0.001) / 1000;
+        out() << QString("%1 %2 %3 %4 %5")
+                     .arg(name, -12)
+                     .arg(timing.bestMs, 10, 'f', 2).arg(timing.averageMs, 10, 'f', 2)
+                     .arg(filePaths.size() / seconds, 10, 'f', 0)
+                     .arg(bytes / seconds / (1024 * 1024), 10, 'f', 1)
+              << Qt::endl;
+    };
+
+    Timing timing;
+    const qint64 sequentialBytes = measure([&]() {
+        qint64 bytes = 0;
+        for (const QString &filePath : std::as_const(filePaths)) {
+            QFile file(filePath);
+            if (file.open(QIODevice::ReadOnly)) {
+                bytes += file.readAll().size();
+            }
+        }
+        return bytes;
+    }, &timing);
+    printRow("qfile", sequentialBytes, timing);
+
+    QVector<BulkReader::Backend> backends = {BulkReader::Threads};
+    if (BulkReader::hasIoUring()) {
+        backends.append(BulkReader::IoUring);
+    }
+    bool same = true;
+    for (BulkReader::Backend backend : backends) {
+        const qint64 bytes = measure([&]() {
+            qint64 total = 0;
+            BulkReader reader(backend);
+            reader.start(filePaths);
+            BulkReader::File file;
+            while (reader.next(&file)) {
+                total += file.data.size();
+                reader.recycle(std::move(file.data));
+            }
+            return total;
+        }, &timing);
+        printRow(BulkReader::backendName(backend), bytes, timing);
+        same = same && bytes == sequentialBytes;
+    }
+
+    if (!same) {
+        err() << "Byte counts differ" << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("formica-search");
+    app.setApplicationVersion("1.0.0");
+    app.setOrganizationName("Formica Project");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Search a Formica vault without the GUI.\n\n"
+        "Commands:\n"
+        "  query <vault> <text>   Print matching lines as path:line: text\n"
+        "  index build <vault>    Create or refresh the vault's search index\n"
+        "  index info <vault>     Show index statistics\n"
+        "  bench <vault> <text>   Time the scan, index, trigram, plan and ranked strategies\n"
+        "  open <vault> <text>    Fuzzy match note paths like the quick-open palette\n"
+        "  links <vault> <note>   Backlinks and links of a note (path, zettel id or title)\n"
+        "  watch <vault>          Follow changes on disk and keep the indexes current\n"
+        "  linkbench [size-mb]    Wiki-link scanning throughput, regex against tokenizer\n"
+        "  mdbench [size-mb]      Markdown to HTML throughput, regex chain against parser\n"
+        "  mdcheck <spec.json>    Run the CommonMark spec examples through the parser\n"
+        "  hlbench [size-mb]      Rehighlighting a note, regex rules against tokenizer\n"
+        "  walkbench <dir>        Directory walking, QDirIterator against the native walker\n"
+        "  readbench <vault>      Reading every note, QFile against the bulk reader");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command", "query, index, bench, open, links, watch, linkbench, mdbench, mdcheck, hlbench, walkbench or readbench");
+    parser.addOptions({
+        {{"r", "regex"}, "Treat text as a regular expression."},
+        {{"R", "ranked"}, "Rank notes by relevance (BM25)."},
+        {{"q", "query"}, "Use the query language (AND/OR/NOT, \"phrases\", fields); text is literal otherwise."},
+        {{"n", "limit"}, "Print at most <n> results (notes when ranked).", "n"},
+        {{"c", "count"}, "Print only the number of results."},
+        {{"t", "time"}, "Print timings to stderr."},
+        {"explain", "Print the query plan to stderr."},
+        {"rebuild", "Ignore the stored index and build it from scratch."},
+        {"repeat", "Runs per strategy for bench, linkbench, mdbench, hlbench, walkbench, readbench and timed open (default 5).", "n", "5"},
+        {"threads", "Threads for the parallel walker in walkbench.", "n"},
+        {"cold", "Drop the notes from the page cache before each readbench run."},
+    });
+    parser.process(app);
+
+    const QStringList args = parser.positionalArguments();
+    const QString command = args.value(0);
+
+    if (command == "query" && args.size() >= 3) {
+        return runQuery(parser, args[1], args.mid(2).join(' '));
+    }
+    if (command == "index" && args.size() == 3) {
+        return runIndex(parser, args[1], args[2]);
+    }
+    if (command == "bench" && args.size() >= 3) {
+        return runBench(parser, args[1], args.mid(2).join(' '));
+    }
+    if (command == "open" && args.size() >= 3) {
+        return runOpen(parser, args[1], args.mid(2).join(' '));
+    }
+    if (command == "links" && args.size() >= 3) {
+        return runLinks(parser, args[1], args.mid(2).join(' '));
+    }
+    if (command == "watch" && args.size() == 2) {
+        return runWatch(parser, args[1]);
+    }
+    if (command == "linkbench" && args.size() <= 2) {
+        return runLinkBench(parser, args.value(1));
+    }
+    if (command == "mdbench" && args.size() <= 2) {
+        return runMarkdownBench(parser, args.value(1));
+    }
+    if (command == "mdcheck" && args.size() == 2) {
+        return runMarkdownCheck(args[1]);
+    }
+    if (command == "hlbench" && args.size() <= 2) {
+        return runHighlightBench(parser, args.value(1));
+    }
+
+    if (command == "walkbench" && args.size() == 2) {
+        return runWalkBench(parser, args[1]);
+    }
+    if (command == "readbench" && args.size() == 2) {
+        return runReadBench(parser, args[1]);
+    }
+
+    err() << parser.helpText();
+    return 2;
+}
\ No newline at end of file
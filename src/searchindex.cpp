@@ -0,0 +1,848 @@
+#include "searchindex.h"
+#include "indexpipeline.h"
+#include "linkparser.h"
+#include "vaultwalker.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+namespace {
+
+const quint32 IndexMagic = 0x464d5349; // "FMSI"
+
+// BM25 parameters, the usual defaults
+const double Bm25K1 = 1.2;
+const double Bm25B = 0.75;
+const double TitleBoost = 3.0; // A title occurrence weighs like three lines
+
+bool postingLess(const SearchIndex::Posting &a, const SearchIndex::Posting &b)
+{
+    return a.noteId < b.noteId || (a.noteId == b.noteId && a.line < b.line);
+}
+
+bool postingEqual(const SearchIndex::Posting &a, const SearchIndex::Posting &b)
+{
+    return a.noteId == b.noteId && a.line == b.line;
+}
+
+// Lines present in both sorted lists
+QVector<SearchIndex::Posting> intersectLines(const QVector<SearchIndex::Posting> &a,
+                                             const QVector<SearchIndex::Posting> &b)
+{
+    QVector<SearchIndex::Posting> result;
+    qsizetype i = 0;
+    qsizetype j = 0;
+    while (i < a.size() && j < b.size()) {
+        if (postingLess(a[i], b[j])) {
+            ++i;
+        } else if (postingLess(b[j], a[i])) {
+            ++j;
+        } else {
+            result.append(a[i]);
+            ++i;
+            ++j;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+SearchIndex::SearchIndex(const QString &vaultPath)
+    : m_vaultPath(vaultPath), m_totalLength(0), m_generation(0), m_dirty(false)
+{
+}
+
+void SearchIndex::setVaultPath(const QString &path)
+{
+    if (m_vaultPath == path) {
+        return;
+    }
+
+    clear();
+    m_vaultPath = path;
+}
+
+QString SearchIndex::indexFilePath() const
+{
+    return QDir(m_vaultPath).filePath(".formica/search.idx");
+}
+
+void SearchIndex::clear()
+{
+    m_notes.clear();
+    m_noteIds.clear();
+    m_freeIds.clear();
+    m_postings.clear();
+    m_titlePostings.clear();
+    m_trigrams.clear();
+    m_totalLength = 0;
+    m_dirty = false;
+    ++m_generation;
+}
+
+bool SearchIndex::load()
+{
+    clear();
+
+    QFile file(indexFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != IndexMagic || version != FormatVersion) {
+        return false; // Stale format, rebuilt by the next update()
+    }
+
+    quint32 noteCount = 0;
+    in >> noteCount;
+    if (in.status() != QDataStream::Ok || noteCount > quint64(file.size())) {
+        return false;
+    }
+
+    LinkParser parser;
+    m_notes.resize(noteCount);
+    for (quint32 id = 0; id < noteCount; ++id) {
+        Note &note = m_notes[id];
+        in >> note.path >> note.mtime >> note.size >> note.length;
+        if (note.path.isEmpty()) {
+            m_freeIds.append(id);
+        } else {
+            m_noteIds.insert(note.path, id);
+            m_totalLength += note.length;
+            indexTitle(id, parser);
+        }
+    }
+
+    quint32 termCount = 0;
+    in >> termCount;
+
+    bool corrupt = in.status() != QDataStream::Ok;
+    for (quint32 t = 0; t < termCount && !corrupt; ++t) {
+        QString term;
+        quint32 count = 0;
+        in >> term >> count;
+
+        // Each posting takes 12 bytes, reject counts the file cannot hold
+        if (in.status() != QDataStream::Ok || term.isEmpty()
+            || count == 0 || qint64(count) > (file.size() - file.pos()) / 12) {
+            corrupt = true;
+            break;
+        }
+
+        QVector<Posting> list(count);
+        for (quint32 i = 0; i < count; ++i) {
+            Posting &p = list[i];
+            in >> p.noteId >> p.line >> p.offset;
+            if (p.noteId >= noteCount || m_notes[p.noteId].path.isEmpty()
+                || (i > 0 && !postingLess(list[i - 1], p))) {
+                corrupt = true;
+                break;
+            }
+            if (i == 0 || list[i - 1].noteId != p.noteId) {
+                m_notes[p.noteId].terms.append(term);
+            }
+        }
+        m_postings.insert(term, list);
+    }
+
+    if (!corrupt && !m_trigrams.load(in, noteCount)) {
+        corrupt = true;
+    }
+
+    if (corrupt || in.status() != QDataStream::Ok || !in.atEnd()) {
+        clear();
+        return false;
+    }
+
+    ++m_generation;
+    return true;
+}
+
+bool SearchIndex::save()
+{
+    QDir().mkpath(QFileInfo(indexFilePath()).absolutePath());
+
+    QSaveFile file(indexFilePath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << IndexMagic << FormatVersion << quint32(m_notes.size());
+    for (const Note &note : m_notes) {
+        out << note.path << note.mtime << note.size << note.length;
+    }
+
+    out << quint32(m_postings.size());
+    for (auto it = m_postings.cbegin(); it != m_postings.cend(); ++it) {
+        out << it.key() << quint32(it.value().size());
+        for (const Posting &p : it.value()) {
+            out << p.noteId << p.line << p.offset;
+        }
+    }
+
+    m_trigrams.save(out);
+
+    if (out.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+bool SearchIndex::update()
+{
+    if (m_vaultPath.isEmpty()) {
+        return false;
+    }
+
+    QSet<QString> seen;
+    QVector<quint32> stale;     // Notes whose postings have to go
+    QVector<quint32> toIndex;   // Notes to (re)read
+
+    QElapsedTimer timer;
+    timer.start();
+    VaultWalker walker(m_vaultPath, VaultWalker::Stat | VaultWalker::Parallel);
+    const QVector<VaultWalker::Entry> files = walker.walk();
+    m_ignore = walker.ignoreMatcher();
+    for (const VaultWalker::Entry &file : files) {
+        seen.insert(file.relPath);
+        checkNote(file.relPath, file.mtime, file.size, &stale, &toIndex);
+    }
+
+    // Notes that disappeared from disk
+    QVector<quint32> removed;
+    for (auto idIt = m_noteIds.begin(); idIt != m_noteIds.end();) {
+        if (!seen.contains(idIt.key())) {
+            removed.append(idIt.value());
+            stale.append(idIt.value());
+            idIt = m_noteIds.erase(idIt);
+        } else {
+            ++idIt;
+        }
+    }
+    IndexPipeline::Stage discover;
+    discover.items = files.size();
+    discover.busyNs = timer.nsecsElapsed();
+    discover.threads = QThread::idealThreadCount();
+
+    const bool changed = reindex(stale, toIndex, removed);
+    m_buildStats.discover = discover;
+    return changed;
+}
+
+bool SearchIndex::updateNotes(const QStringList &relPaths)
+{
+    if (m_vaultPath.isEmpty()) {
+        return false;
+    }
+
+    QDir root(m_vaultPath);
+    QVector<quint32> stale;
+    QVector<quint32> toIndex;
+    QVector<quint32> removed;
+    QSet<QString> seen;
+
+    for (const QString &relPath : relPaths) {
+        if (relPath.isEmpty() || seen.contains(relPath)) {
+            continue;
+        }
+        seen.insert(relPath);
+
+        const QFileInfo info(root.filePath(relPath));
+        if (info.isFile() && !m_ignore.isIgnored(relPath)) {
+            checkNote(relPath, info.lastModified().toMSecsSinceEpoch(), info.size(), &stale, &toIndex);
+            continue;
+        }
+
+        auto found = m_noteIds.find(relPath);
+        if (found != m_noteIds.end()) {
+            removed.append(found.value());
+            stale.append(found.value());
+            m_noteIds.erase(found);
+        }
+    }
+
+    return reindex(stale, toIndex, removed);
+}
+
+void SearchIndex::checkNote(const QString &relPath, qint64 mtime, qint64 size,
+                            QVector<quint32> *stale, QVector<quint32> *toIndex)
+{
+    auto found = m_noteIds.constFind(relPath);
+    if (found != m_noteIds.constEnd()) {
+        Note &note = m_notes[*found];
+        if (note.mtime == mtime && note.size == size) {
+            return;
+        }
+        note.mtime = mtime;
+        note.size = size;
+        stale->append(*found);
+        toIndex->append(*found);
+        return;
+    }
+
+    quint32 noteId;
+    if (!m_freeIds.isEmpty()) {
+        noteId = m_freeIds.takeLast();
+    } else {
+        noteId = m_notes.size();
+        m_notes.append(Note());
+    }
+
+    Note &note = m_notes[noteId];
+    note.path = relPath;
+    note.mtime = mtime;
+    note.size = size;
+    m_noteIds.insert(relPath, noteId);
+    toIndex->append(noteId);
+}
+
+bool SearchIndex::reindex(const QVector<quint32> &stale, const QVector<quint32> &toIndex,
+                          const QVector<quint32> &removed)
+{
+    m_buildStats = IndexPipeline::Stats();
+    if (stale.isEmpty() && toIndex.isEmpty()) {
+        return false;
+    }
+
+    QDir root(m_vaultPath);
+    removePostings(stale);
+
+    for (quint32 noteId : removed) {
+        m_notes[noteId] = Note();
+        m_freeIds.append(noteId);
+    }
+
+    QStringList filePaths;
+    filePaths.reserve(toIndex.size());
+    for (quint32 noteId : toIndex) {
+        filePaths.append(root.filePath(m_notes[noteId].path));
+    }
+
+    // Notes are tokenized on worker threads and merged here, in whatever
+    // order they finish; posting lists stay sorted either way
+    QVector<ParsedNote> parsed(toIndex.size());
+    ParsedNote *results = parsed.data();     // No detaching on worker threads
+    LinkParser parser;
+    IndexPipeline pipeline;
+    pipeline.run(filePaths,
+                 [&](int index, const QByteArray &data, bool ok) {
+                     if (ok) {
+                         parseNote(toIndex[index], data, &results[index]);
+                     }
+                 },
+                 [&](int index) {
+                     const quint32 noteId = toIndex[index];
+                     if (results[index].read) {
+                         mergeNote(noteId, results[index]);
+                     } else {
+                         // Unread notes match no file, so the next update
+                         // tries them again
+                         m_notes[noteId].mtime = -1;
+                         m_notes[noteId].size = -1;
+                     }
+                     results[index] = ParsedNote();
+                     indexTitle(noteId, parser);
+                 });
+    m_buildStats = pipeline.stats();
+
+    m_dirty = true;
+    ++m_generation;
+    return true;
+}
+
+void SearchIndex::parseNote(quint32 noteId, const QByteArray &data, ParsedNote *parsed)
+{
+    parsed->read = true;
+    parsed->trigrams = TrigramIndex::noteTrigrams(data);
+    QHash<QString, QVector<Posting>> &notePostings = parsed->postings;
+
+    quint32 length = 0;
+    quint32 line = 1;
+    qsizetype start = 0;
+    while (start <= data.size()) {
+        qsizetype end = data.indexOf('\n', start);
+        if (end < 0) {
+            end = data.size();
+        }
+
+        const QString text = QString::fromUtf8(data.constData() + start, end - start);
+        const QStringList terms = tokenize(text);
+        length += terms.size();
+        for (const QString &term : terms) {
+            QVector<Posting> &list = notePostings[term];
+            if (list.isEmpty() || list.last().line != line) {
+                list.append(Posting{noteId, line, quint32(start)});
+            }
+        }
+
+        if (text.contains(QLatin1Char('#'))) {
+            const QStringList lineTags = tags(text);
+            for (const QString &tag : lineTags) {
+                QVector<Posting> &list = notePostings[QLatin1Char('#') + tag];
+                if (list.isEmpty() || list.last().line != line) {
+                    list.append(Posting{noteId, line, quint32(start)});
+                }
+            }
+        }
+
+        if (end == data.size()) {
+            break;
+        }
+        start = end + 1;
+        ++line;
+    }
+
+    parsed->length = length;
+}
+
+void SearchIndex::mergeNote(quint32 noteId, const ParsedNote &parsed)
+{
+    m_trigrams.addNote(noteId, parsed.trigrams);
+
+    const QHash<QString, QVector<Posting>> &notePostings = parsed.postings;
+    Note &note = m_notes[noteId];
+    note.length = parsed.length;
+    note.terms.clear();
+    note.terms.reserve(notePostings.size());
+    m_totalLength += parsed.length;
+
+    for (auto it = notePostings.cbegin(); it != notePostings.cend(); ++it) {
+        note.terms.append(it.key());
+
+        // Keep every posting list ordered by note id
+        QVector<Posting> &list = m_postings[it.key()];
+        auto pos = std::lower_bound(list.begin(), list.end(), noteId,
+                                    [](const Posting &p, quint32 id) { return p.noteId < id; });
+        qsizetype index = pos - list.begin();
+        list.insert(index, it.value().size(), Posting());
+        std::copy(it.value().cbegin(), it.value().cend(), list.begin() + index);
+    }
+}
+
+void SearchIndex::indexTitle(quint32 noteId, LinkParser &parser)
+{
+    Note &note = m_notes[noteId];
+
+    // "1a2 Some title.md" is titled "Some title", other notes by file name
+    const QString baseName = QFileInfo(note.path).completeBaseName();
+    const ZettelId zettel = parser.parseZettelId(baseName);
+    note.titleTerms = tokenize(zettel.isValid && !zettel.title.isEmpty() ? zettel.title : baseName);
+    note.zettelId = zettel.isValid ? zettel.id : QString();
+    note.titleTerms.removeDuplicates();
+
+    for (const QString &term : note.titleTerms) {
+        QVector<quint32> &list = m_titlePostings[term];
+        auto pos = std::lower_bound(list.begin(), list.end(), noteId);
+        if (pos == list.end() || *pos != noteId) {
+            list.insert(pos - list.begin(), noteId);
+        }
+    }
+}
+
+void SearchIndex::removePostings(const QVector<quint32> &noteIds)
+{
+    QSet<quint32> ids;
+    QSet<QString> terms;
+    for (quint32 noteId : noteIds) {
+        Note &note = m_notes[noteId];
+        ids.insert(noteId);
+        for (const QString &term : note.terms) {
+            terms.insert(term);
+        }
+        note.terms.clear();
+
+        for (const QString &term : note.titleTerms) {
+            auto it = m_titlePostings.find(term);
+            if (it == m_titlePostings.end()) {
+                continue;
+            }
+            it->removeOne(noteId);
+            if (it->isEmpty()) {
+                m_titlePostings.erase(it);
+            }
+        }
+        note.titleTerms.clear();
+
+        m_totalLength -= note.length;
+        note.length = 0;
+    }
+
+    m_trigrams.removeNotes(ids);
+
+    for (const QString &term : terms) {
+        auto it = m_postings.find(term);
+        if (it == m_postings.end()) {
+            continue;
+        }
+
+        QVector<Posting> &list = it.value();
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [&ids](const Posting &p) { return ids.contains(p.noteId); }),
+                   list.end());
+        if (list.isEmpty()) {
+            m_postings.erase(it);
+        }
+    }
+}
+
+bool SearchIndex::candidateLines(const QString &text, QVector<Posting> *lines) const
+{
+    const QString folded = text.toCaseFolded();
+
+    // A token touching a non-word character in the query must end (or start)
+    // at a term boundary in the note; tokens inside the query are whole terms.
+    struct Token {
+        QString text;
+        MatchMode mode;
+    };
+    QVector<Token> tokens;
+
+    qsizetype start = -1;
+    for (qsizetype i = 0; i <= folded.size(); ++i) {
+        if (i < folded.size() && isWordChar(folded.at(i))) {
+            if (start < 0) {
+                start = i;
+            }
+            continue;
+        }
+        if (start < 0) {
+            continue;
+        }
+
+        bool boundedBefore = start > 0;
+        bool boundedAfter = i < folded.size();
+        MatchMode mode = MatchInfix;
+        if (boundedBefore && boundedAfter) {
+            mode = MatchExact;
+        } else if (boundedBefore) {
+            mode = MatchPrefix;
+        } else if (boundedAfter) {
+            mode = MatchSuffix;
+        }
+        tokens.append(Token{folded.mid(start, i - start), mode});
+        start = -1;
+    }
+
+    if (tokens.isEmpty()) {
+        return false;
+    }
+
+    // Cheapest lookups first so the intersection shrinks early
+    std::stable_sort(tokens.begin(), tokens.end(),
+                     [](const Token &a, const Token &b) { return a.mode < b.mode; });
+
+    QVector<Posting> result = postingsMatching(tokens.first().text, tokens.first().mode);
+    for (qsizetype i = 1; i < tokens.size() && !result.isEmpty(); ++i) {
+        result = intersectLines(result, postingsMatching(tokens[i].text, tokens[i].mode));
+    }
+
+    *lines = result;
+    return true;
+}
+
+QVector<SearchIndex::Posting> SearchIndex::postingsMatching(const QString &token, MatchMode mode) const
+{
+    if (mode == MatchExact) {
+        return m_postings.value(token);
+    }
+
+    QVector<Posting> result;
+    int listCount = 0;
+
+    if (mode == MatchPrefix) {
+        for (auto it = m_postings.lowerBound(token); it != m_postings.cend() && it.key().startsWith(token); ++it) {
+            result.append(it.value());
+            ++listCount;
+        }
+    } else {
+        for (auto it = m_postings.cbegin(); it != m_postings.cend(); ++it) {
+            bool matches = mode == MatchSuffix ? it.key().endsWith(token) : it.key().contains(token);
+            if (matches) {
+                result.append(it.value());
+                ++listCount;
+            }
+        }
+    }
+
+    // Several terms can share a line
+    if (listCount > 1) {
+        std::sort(result.begin(), result.end(), postingLess);
+        result.erase(std::unique(result.begin(), result.end(), postingEqual), result.end());
+    }
+
+    return result;
+}
+
+QVector<SearchIndex::RankedNote> SearchIndex::rank(const QString &text, int limit, int linesPerNote) const
+{
+    QVector<RankedNote> ranked;
+
+    QStringList terms = tokenize(text);
+    terms.removeDuplicates();
+    if (terms.isEmpty() || m_noteIds.isEmpty() || limit <= 0) {
+        return ranked;
+    }
+
+    const double noteCount = m_noteIds.size();
+    const double averageLength = qMax(1.0, double(m_totalLength) / noteCount);
+
+    QHash<quint32, double> scores;
+    const QVector<Posting> noBody;
+    const QVector<quint32> noTitle;
+
+    for (const QString &term : terms) {
+        auto bodyIt = m_postings.constFind(term);
+        auto titleIt = m_titlePostings.constFind(term);
+        const QVector<Posting> &body = bodyIt != m_postings.cend() ? *bodyIt : noBody;
+        const QVector<quint32> &title = titleIt != m_titlePostings.cend() ? *titleIt : noTitle;
+        if (body.isEmpty() && title.isEmpty()) {
+            continue;
+        }
+
+        // Both lists are ordered by note, one merge gives the frequency per
+        // note and the number of notes for the idf
+        struct NoteFrequency {
+            quint32 noteId;
+            double frequency;
+        };
+        QVector<NoteFrequency> frequencies;
+
+        qsizetype b = 0;
+        qsizetype t = 0;
+        while (b < body.size() || t < title.size()) {
+            quint32 noteId = b < body.size() ? body[b].noteId : title[t];
+            if (t < title.size() && title[t] < noteId) {
+                noteId = title[t];
+            }
+
+            double frequency = 0;
+            while (b < body.size() && body[b].noteId == noteId) {
+                frequency += 1;
+                ++b;
+            }
+            if (t < title.size() && title[t] == noteId) {
+                frequency += TitleBoost;
+                ++t;
+            }
+            frequencies.append(NoteFrequency{noteId, frequency});
+        }
+
+        const double documentFrequency = frequencies.size();
+        const double idf = std::log(1.0 + (noteCount - documentFrequency + 0.5) / (documentFrequency + 0.5));
+
+        for (const auto &entry : frequencies) {
+            const double length = m_notes[entry.noteId].length;
+            const double norm = Bm25K1 * (1.0 - Bm25B + Bm25B * length / averageLength);
+            scores[entry.noteId] += idf * entry.frequency * (Bm25K1 + 1.0) / (entry.frequency + norm);
+        }
+    }
+
+    // Bounded min-heap keeps the best limit notes
+    typedef std::pair<double, quint32> Scored;
+    std::priority_queue<Scored, std::vector<Scored>, std::greater<Scored>> best;
+    for (auto it = scores.cbegin(); it != scores.cend(); ++it) {
+        if (int(best.size()) < limit) {
+            best.push(Scored(it.value(), it.key()));
+        } else if (it.value() > best.top().first) {
+            best.pop();
+            best.push(Scored(it.value(), it.key()));
+        }
+    }
+
+    ranked.resize(best.size());
+    for (qsizetype i = ranked.size() - 1; i >= 0; --i) {
+        ranked[i] = RankedNote{best.top().second, best.top().first, {}};
+        best.pop();
+    }
+
+    // Best lines of the winners only: the ones with the most query terms
+    for (RankedNote &note : ranked) {
+        QMap<quint32, QPair<quint32, int>> lineHits; // Line -> offset, terms
+        for (const QString &term : terms) {
+            auto it = m_postings.constFind(term);
+            if (it == m_postings.cend()) {
+                continue;
+            }
+            auto range = std::equal_range(it->cbegin(), it->cend(), Posting{note.noteId, 0, 0},
+                                          [](const Posting &a, const Posting &b) { return a.noteId < b.noteId; });
+            for (auto p = range.first; p != range.second; ++p) {
+                auto &entry = lineHits[p->line];
+                entry.first = p->offset;
+                ++entry.second;
+            }
+        }
+
+        for (auto it = lineHits.cbegin(); it != lineHits.cend(); ++it) {
+            note.lines.append(Posting{note.noteId, it.key(), it.value().first});
+        }
+        std::stable_sort(note.lines.begin(), note.lines.end(), [&lineHits](const Posting &a, const Posting &b) {
+            return lineHits.value(a.line).second > lineHits.value(b.line).second;
+        });
+        if (note.lines.size() > linesPerNote) {
+            note.lines.resize(linesPerNote);
+        } else if (note.lines.isEmpty()) {
+            note.lines.append(Posting{note.noteId, 1, 0}); // Matched on the title only
+        }
+    }
+
+    return ranked;
+}
+
+QVector<SearchIndex::Posting> SearchIndex::postings(const QString &term, bool prefix) const
+{
+    return postingsMatching(term, prefix ? MatchPrefix : MatchExact);
+}
+
+qsizetype SearchIndex::postingCount(const QString &term, bool prefix) const
+{
+    if (!prefix) {
+        auto it = m_postings.constFind(term);
+        return it != m_postings.cend() ? it->size() : 0;
+    }
+
+    qsizetype count = 0;
+    for (auto it = m_postings.lowerBound(term); it != m_postings.cend() && it.key().startsWith(term); ++it) {
+        count += it->size();
+    }
+    return count;
+}
+
+QVector<quint32> SearchIndex::titleNotes(const QString &term, bool prefix) const
+{
+    if (!prefix) {
+        return m_titlePostings.value(term);
+    }
+
+    QVector<quint32> result;
+    int listCount = 0;
+    for (auto it = m_titlePostings.lowerBound(term); it != m_titlePostings.cend() && it.key().startsWith(term); ++it) {
+        result.append(it.value());
+        ++listCount;
+    }
+    if (listCount > 1) {
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+    return result;
+}
+
+qsizetype SearchIndex::titleNoteCount(const QString &term, bool prefix) const
+{
+    qsizetype count = 0;
+    for (auto it = m_titlePostings.lowerBound(term); it != m_titlePostings.cend(); ++it) {
+        if (prefix ? !it.key().startsWith(term) : it.key() != term) {
+            break;
+        }
+        count += it->size();
+    }
+    return count;
+}
+
+bool SearchIndex::candidateNotes(const QString &text, QVector<quint32> *notes) const
+{
+    return m_trigrams.candidateNotes(text, notes);
+}
+
+bool SearchIndex::candidateNotes(const QRegularExpression &regex, QVector<quint32> *notes) const
+{
+    return m_trigrams.candidateNotes(regex, notes);
+}
+
+QString SearchIndex::notePath(quint32 noteId) const
+{
+    if (noteId >= quint32(m_notes.size())) {
+        return QString();
+    }
+    return QDir(m_vaultPath).filePath(m_notes[noteId].path);
+}
+
+QStringList SearchIndex::notePaths() const
+{
+    QStringList paths;
+    paths.reserve(m_noteIds.size());
+
+    QDir root(m_vaultPath);
+    for (const Note &note : m_notes) {
+        if (!note.path.isEmpty()) {
+            paths.append(root.filePath(note.path));
+        }
+    }
+    return paths;
+}
+
+bool SearchIndex::isWordChar(QChar c)
+{
+    return c.isLetterOrNumber() || c.isMark() || c == QLatin1Char('_');
+}
+
+QStringList SearchIndex::tokenize(const QString &text)
+{
+    QStringList terms;
+    const QString folded = text.toCaseFolded();
+
+    qsizetype start = -1;
+    for (qsizetype i = 0; i <= folded.size(); ++i) {
+        if (i < folded.size() && isWordChar(folded.at(i))) {
+            if (start < 0) {
+                start = i;
+            }
+        } else if (start >= 0) {
+            terms.append(folded.mid(start, i - start));
+            start = -1;
+        }
+    }
+
+    return terms;
+}
+
+QStringList SearchIndex::tags(const QString &line)
+{
+    QStringList result;
+
+    // "#tag" at the start of the line or after a space; "# Heading" and
+    // "##" are not tags
+    for (qsizetype i = line.indexOf(QLatin1Char('#')); i >= 0; i = line.indexOf(QLatin1Char('#'), i + 1)) {
+        if (i > 0 && !line.at(i - 1).isSpace()) {
+            continue;
+        }
+
+        qsizetype end = i + 1;
+        while (end < line.size()
+               && (isWordChar(line.at(end)) || line.at(end) == QLatin1Char('-') || line.at(end) == QLatin1Char('/'))) {
+            ++end;
+        }
+        if (end > i + 1 && isWordChar(line.at(i + 1))) {
+            result.append(line.mid(i + 1, end - i - 1).toCaseFolded());
+        }
+        i = end - 1;
+    }
+
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <QRegularExpression>
+#include "indexpipeline.h"
+#include "trigramindex.h"
+#include "vaultwalker.h"
+
+class LinkParser;
+
+// Persistent inverted index over the notes of a vault.
+//
+// Maps case-folded word terms to the lines they occur on; #tags are stored
+// as terms with their leading '#'. The index lives in
+// <vault>/.formica/search.idx and is refreshed incrementally by comparing the
+// modification time and size of every note with the stored values. A trigram
+// index alongside it narrows searches that do not line up with whole terms.
+class SearchIndex
+{
+public:
+    struct Posting {
+        quint32 noteId;
+        quint32 line;        // 1-based line number
+        quint32 offset;      // Byte offset of the line start in the file
+    };
+
+    struct Note {
+        QString path;        // Relative to the vault root, empty if free
+        qint64 mtime = 0;
+        qint64 size = 0;
+        quint32 length = 0;       // Number of terms in the body
+        QStringList terms;        // Distinct terms, used to drop stale postings
+        QStringList titleTerms;   // Distinct terms of the title, not stored
+        QString zettelId;         // From the file name, not stored
+    };
+
+    struct RankedNote {
+        quint32 noteId;
+        double score;
+        QVector<Posting> lines;   // Best matching lines, best first
+    };
+
+    explicit SearchIndex(const QString &vaultPath = QString());
+
+    void setVaultPath(const QString &path);
+    QString vaultPath() const { return m_vaultPath; }
+    QString indexFilePath() const;
+
+    // Load from disk. Returns false (and leaves the index empty) if the file
+    // is missing, was written by another format version or is corrupt.
+    bool load();
+    bool save();
+
+    // Bring the index in sync with the files on disk. Returns true if any
+    // note was added, changed or removed.
+    bool update();
+    // The same for just these notes (relative paths), e.g. the ones a file
+    // watcher reported; notes that no longer exist, or that the ignore
+    // rules read by the last update() leave out, are dropped
+    bool updateNotes(const QStringList &relPaths);
+    void clear();
+
+    bool isDirty() const { return m_dirty; }
+
+    // Changes whenever the indexed content may have changed (load, clear or
+    // an update that found changed notes); never repeats for one object.
+    quint64 generation() const { return m_generation; }
+    int noteCount() const { return m_noteIds.size(); }
+    int termCount() const { return m_postings.size(); }
+    // Stage counters of the last update() or updateNotes(); only discovery is
+    // counted when no note had changed
+    const IndexPipeline::Stats &buildStats() const { return m_buildStats; }
+
+    // Collect the lines that may contain text (case-insensitive), sorted by
+    // note and line. Returns false if text has no indexable terms, in which
+    // case the caller has to fall back to scanning the files.
+    bool candidateLines(const QString &text, QVector<Posting> *lines) const;
+
+    // The limit notes with the highest BM25 score for the terms of text,
+    // best first. The title (zettel title or file name) counts as a boosted
+    // field; term frequencies are counted in lines, as stored in the index.
+    QVector<RankedNote> rank(const QString &text, int limit, int linesPerNote = 3) const;
+
+    // Sorted ids of the notes that may match, from the trigram index. Returns
+    // false if the query yields no trigrams and every note has to be scanned.
+    bool candidateNotes(const QString &text, QVector<quint32> *notes) const;
+    bool candidateNotes(const QRegularExpression &regex, QVector<quint32> *notes) const;
+    int trigramCount() const { return m_trigrams.trigramCount(); }
+
+    // Building blocks for query plans. Posting lists are sorted by note and
+    // line, title lists by note; counts are cheap estimates of their size.
+    QVector<Posting> postings(const QString &term, bool prefix = false) const;
+    qsizetype postingCount(const QString &term, bool prefix = false) const;
+    QVector<quint32> titleNotes(const QString &term, bool prefix = false) const;
+    qsizetype titleNoteCount(const QString &term, bool prefix = false) const;
+
+    // Indexed by note id; free ids have an empty path
+    const QVector<Note> &notes() const { return m_notes; }
+
+    QString notePath(quint32 noteId) const;
+    QStringList notePaths() const;
+
+    static bool isWordChar(QChar c);
+    static QStringList tokenize(const QString &text);
+    static QStringList tags(const QString &line);   // Case-folded, without '#'
+
+
+    static const quint32 FormatVersion = 4;
+
+private:
+    enum MatchMode { MatchExact, MatchPrefix, MatchSuffix, MatchInfix };
+
+    // What the parse stage of an update makes of a note's content
+    struct ParsedNote {
+        bool read = false;
+        QVector<TrigramIndex::Trigram> trigrams;
+        QHash<QString, QVector<Posting>> postings;
+        quint32 length = 0;
+    };
+
+    QVector<Posting> postingsMatching(const QString &token, MatchMode mode) const;
+    void checkNote(const QString &relPath, qint64 mtime, qint64 size,
+                   QVector<quint32> *stale, QVector<quint32> *toIndex);
+    bool reindex(const QVector<quint32> &stale, const QVector<quint32> &toIndex,
+                 const QVector<quint32> &removed);
+    static void parseNote(quint32 noteId, const QByteArray &data, ParsedNote *parsed);
+    void mergeNote(quint32 noteId, const ParsedNote &parsed);
+    void indexTitle(quint32 noteId, LinkParser &parser);
+    void removePostings(const QVector<quint32> &noteIds);
+
+    QString m_vaultPath;
+    QVector<Note> m_notes;
+    QHash<QString, quint32> m_noteIds;   // Relative path -> note id
+    QVector<quint32> m_freeIds;
+    QMap<QString, QVector<Posting>> m_postings;
+    QMap<QString, QVector<quint32>> m_titlePostings;    // Sorted note ids
+    TrigramIndex m_trigrams;
+    VaultWalker::IgnoreMatcher m_ignore;    // Of the last walk
+    IndexPipeline::Stats m_buildStats;
+    quint64 m_totalLength;
+    quint64 m_generation;
+    bool m_dirty;
+};
+
+#endif // SEARCHINDEX_H
\ No newline at end of file
@@ -0,0 +1,429 @@
+#include "searchjob.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThreadPool>
+#include <QMutexLocker>
+#include <QMetaObject>
+#include <atomic>
+
+namespace {
+
+const int BatchSize = 256;          // Hits per delivery once results are flowing
+const int BatchIntervalMs = 40;     // Upper bound on how long hits are held back
+
+// Cache key text; queries that differ only in ways the search ignores share it
+QString normalizedText(SearchJob::Mode mode, const QString &text)
+{
+    switch (mode) {
+    case SearchJob::Substring:
+        return text.toCaseFolded();
+    case SearchJob::Ranked: {
+        QStringList terms = SearchIndex::tokenize(text);
+        terms.removeDuplicates();
+        terms.sort();
+        return terms.join(QLatin1Char(' '));
+    }
+    case SearchJob::Query:
+        return text.simplified();
+    default:
+        return text;
+    }
+}
+
+struct FileTask {
+    QString path;
+    QVector<SearchIndex::Posting> lines; // Empty when the whole file is scanned
+};
+
+// Stamped before reading: a file changing later never matches the stamp
+SearchHits stampedHits(const QString &path)
+{
+    const QFileInfo info(path);
+    SearchHits fileHits;
+    fileHits.filePath = path;
+    fileHits.size = info.size();
+    fileHits.mtime = info.lastModified().toMSecsSinceEpoch();
+    return fileHits;
+}
+
+} // namespace
+
+void SearchIndexHandle::touch(const QStringList &relPaths)
+{
+    QMutexLocker locker(&touchedLock);
+    for (const QString &relPath : relPaths) {
+        touched.insert(relPath);
+    }
+}
+
+void SearchIndexHandle::invalidate()
+{
+    QMutexLocker locker(&touchedLock);
+    touched.clear();
+    walkNeeded = true;
+}
+
+struct SearchJob::State {
+    QSharedPointer<SearchIndexHandle> index;
+    QString searchText;
+    Mode mode = Substring;
+    QRegularExpression regex;
+    SearchQuery query;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> firstDelivered{false};
+    std::atomic<int> nextFile{0};
+    std::atomic<int> activeWorkers{0};
+
+    QVector<FileTask> files;
+
+    // Everything delivered, kept for the cache unless it grows too big
+    quint64 generation = 0;
+    QString cacheText;
+    QMutex resultsLock;
+    QList<SearchHits> collected;
+    qsizetype collectedHits = 0;
+    bool cacheable = true;
+
+    QMutex receiverLock;
+    SearchJob *receiver = nullptr;
+
+    static void plan(const QSharedPointer<State> &state);
+    static void work(const QSharedPointer<State> &state);
+
+    void selectFiles(SearchIndexHandle &handle);
+    bool refine(SearchIndexHandle &handle);
+    void collect(const QList<SearchHits> &batch);
+    void complete();
+    void deliver(const QList<SearchHits> &batch);
+    void finish();
+};
+
+// Files to read for a query that is not answered from the cache
+void SearchJob::State::selectFiles(SearchIndexHandle &handle)
+{
+    QVector<SearchIndex::Posting> lines;
+    QVector<quint32> notes;
+    if (mode == Ranked) {
+        // Scoring only reads index statistics, the files are not opened
+        const auto ranked = handle.index.rank(searchText, FileSearcher::RankedLimit);
+        for (const auto &note : ranked) {
+            files.append(FileTask{handle.index.notePath(note.noteId), note.lines});
+        }
+    } else if (mode == Query) {
+        // Phrases are verified while planning, the rest are index lookups
+        const auto matches = query.execute(handle.index);
+        for (const auto &match : matches) {
+            files.append(FileTask{handle.index.notePath(match.noteId), match.lines});
+        }
+    } else if (mode == Regex) {
+        if (!handle.index.candidateNotes(regex, &notes)) {
+            const QStringList paths = handle.index.notePaths();
+            for (const QString &path : paths) {
+                files.append(FileTask{path, {}});
+            }
+        }
+    } else if (handle.index.candidateLines(searchText, &lines)) {
+        qsizetype first = 0;
+        while (first < lines.size()) {
+            qsizetype last = first;
+            while (last < lines.size() && lines[last].noteId == lines[first].noteId) {
+                ++last;
+            }
+            files.append(FileTask{handle.index.notePath(lines[first].noteId), lines.mid(first, last - first)});
+            first = last;
+        }
+    } else if (!handle.index.candidateNotes(searchText, &notes)) {
+        const QStringList paths = handle.index.notePaths();
+        for (const QString &path : paths) {
+            files.append(FileTask{path, {}});
+        }
+    }
+
+    // Notes the trigram index could not rule out
+    for (quint32 noteId : notes) {
+        files.append(FileTask{handle.index.notePath(noteId), {}});
+    }
+}
+
+// A substring search that extends a cached one ("zett" -> "zettel") only
+// has to check the lines that matched before
+bool SearchJob::State::refine(SearchIndexHandle &handle)
+{
+    if (mode != Substring) {
+        return false;
+    }
+
+    QString cachedText;
+    QList<SearchHits> previous;
+    if (!handle.cache.lookupNarrowing(mode, cacheText, generation, &cachedText, &previous)) {
+        return false;
+    }
+
+    for (const auto &fileHits : previous) {
+        QVector<SearchIndex::Posting> lines;
+        lines.reserve(fileHits.hits.size());
+        for (const auto &hit : fileHits.hits) {
+            lines.append(SearchIndex::Posting{0, quint32(hit.lineNumber), quint32(hit.start)});
+        }
+        files.append(FileTask{fileHits.filePath, lines});
+    }
+    return true;
+}
+
+void SearchJob::State::plan(const QSharedPointer<State> &state)
+{
+    QList<SearchHits> cached;
+    bool fromCache = false;
+    {
+        QMutexLocker locker(&state->index->lock);
+        if (state->cancelled) {
+            return;
+        }
+
+        SearchIndexHandle &handle = *state->index;
+        if (!handle.loaded) {
+            handle.index.load();
+            handle.loaded = true;
+        }
+
+        QStringList touched;
+        bool watched;
+        bool walkNeeded;
+        {
+            QMutexLocker touchedLocker(&handle.touchedLock);
+            touched = handle.touched.values();
+            handle.touched.clear();
+            watched = handle.watched;
+            walkNeeded = handle.walkNeeded;
+            handle.walkNeeded = false;
+        }
+
+        // A watched index is walked once, then kept current note by note.
+        // Without a watcher every search walks it (stat only, changed notes
+        // are read), so the cache below never answers for an older vault.
+        bool changed = false;
+        if (!handle.walked || walkNeeded || !watched) {
+            changed = handle.index.update();
+            handle.walked = true;
+        } else if (!touched.isEmpty()) {
+            changed = handle.index.updateNotes(touched);
+        }
+        if (changed) {
+            handle.index.save();
+        }
+
+        if (state->cancelled) {
+            return;
+        }
+
+        state->generation = handle.index.generation();
+        state->cacheText = normalizedText(state->mode, state->searchText);
+        if (handle.cache.lookup(state->mode, state->cacheText, state->generation, &cached)) {
+            fromCache = true;
+        } else if (!state->refine(handle)) {
+            state->selectFiles(handle);
+        }
+    }
+
+    if (fromCache) {
+        if (!cached.isEmpty()) {
+            state->deliver(cached);
+        }
+        state->finish();
+        return;
+    }
+
+    if (state->files.isEmpty()) {
+        state->complete();
+        return;
+    }
+
+    // Ranked notes are few and must keep their order, no workers needed
+    if (state->mode == Ranked) {
+        QList<SearchHits> batch;
+        for (const FileTask &task : state->files) {
+            if (state->cancelled) {
+                return;
+            }
+            SearchHits fileHits = stampedHits(task.path);
+            fileHits.hits = FileSearcher::linesAt(task.path, task.lines);
+            if (!fileHits.hits.isEmpty()) {
+                batch.append(fileHits);
+            }
+        }
+        state->collect(batch);
+        state->deliver(batch);
+        state->complete();
+        return;
+    }
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    int workers = qBound(1, pool->maxThreadCount(), int(state->files.size()));
+
+    state->activeWorkers = workers;
+    for (int i = 0; i < workers; ++i) {
+        pool->start([state]() { work(state); });
+    }
+}
+
+void SearchJob::State::work(const QSharedPointer<State> &state)
+{
+    const QRegularExpression regex = state->regex;
+    QList<SearchHits> batch;
+    int batchHits = 0;
+    QElapsedTimer sinceFlush;
+    sinceFlush.start();
+
+    while (!state->cancelled) {
+        int fileIndex = state->nextFile.fetch_add(1);
+        if (fileIndex >= state->files.size()) {
+            break;
+        }
+
+        const FileTask &task = state->files.at(fileIndex);
+        SearchHits fileHits = stampedHits(task.path);
+        if (state->mode == Regex) {
+            fileHits.hits = FileSearcher::matchRegexInSingleFile(task.path, regex);
+        } else if (state->mode == Query) {
+            fileHits.hits = FileSearcher::linesAt(task.path, task.lines);
+        } else if (task.lines.isEmpty()) {
+            fileHits.hits = FileSearcher::matchInSingleFile(task.path, state->searchText);
+        } else {
+            fileHits.hits = FileSearcher::matchInLines(task.path, state->searchText, task.lines);
+        }
+
+        if (!fileHits.hits.isEmpty()) {
+            batchHits += fileHits.hits.size();
+            batch.append(fileHits);
+        }
+
+        // The first hit goes out right away, later ones are grouped
+        if (!batch.isEmpty()
+            && (!state->firstDelivered || batchHits >= BatchSize
+                || sinceFlush.elapsed() >= BatchIntervalMs)) {
+            state->firstDelivered = true;
+            state->collect(batch);
+            state->deliver(batch);
+            batch.clear();
+            batchHits = 0;
+            sinceFlush.restart();
+        }
+    }
+
+    if (!batch.isEmpty()) {
+        state->collect(batch);
+        state->deliver(batch);
+    }
+
+    if (state->activeWorkers.fetch_sub(1) == 1) {
+        state->complete();
+    }
+}
+
+void SearchJob::State::collect(const QList<SearchHits> &batch)
+{
+    QMutexLocker locker(&resultsLock);
+    if (!cacheable) {
+        return;
+    }
+
+    for (const auto &fileHits : batch) {
+        collectedHits += fileHits.hits.size();
+    }
+    if (collectedHits > index->cache.maxHits()) {
+        // Too big to keep, later keystrokes search again
+        cacheable = false;
+        collected.clear();
+        return;
+    }
+    collected.append(batch);
+}
+
+void SearchJob::State::complete()
+{
+    if (cancelled) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&resultsLock);
+        if (cacheable) {
+            QMutexLocker indexLocker(&index->lock);
+            index->cache.insert(mode, cacheText, generation, collected);
+        }
+    }
+
+    finish();
+}
+
+void SearchJob::State::deliver(const QList<SearchHits> &batch)
+{
+    QMutexLocker locker(&receiverLock);
+    if (!receiver || cancelled) {
+        return;
+    }
+
+    // Queued to the job's thread; dropped by Qt if the job is deleted first
+    SearchJob *job = receiver;
+    QMetaObject::invokeMethod(job, [job, batch]() {
+        if (!job->isCancelled()) {
+            emit job->resultsReady(batch);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void SearchJob::State::finish()
+{
+    QMutexLocker locker(&receiverLock);
+    if (!receiver || cancelled) {
+        return;
+    }
+
+    SearchJob *job = receiver;
+    QMetaObject::invokeMethod(job, [job]() {
+        if (!job->isCancelled()) {
+            emit job->finished();
+        }
+    }, Qt::QueuedConnection);
+}
+
+SearchJob::SearchJob(const QSharedPointer<SearchIndexHandle> &index, const QString &searchText,
+                     Mode mode, QObject *parent)
+    : QObject(parent), m_searchText(searchText), m_state(new State)
+{
+    m_state->index = index;
+    m_state->searchText = searchText;
+    m_state->mode = mode;
+    if (mode == Regex) {
+        m_state->regex = QRegularExpression(searchText, QRegularExpression::CaseInsensitiveOption);
+        m_state->regex.optimize();
+    } else if (mode == Query) {
+        m_state->query = SearchQuery(searchText);
+    }
+    m_state->receiver = this;
+}
+
+SearchJob::~SearchJob()
+{
+    cancel();
+
+    QMutexLocker locker(&m_state->receiverLock);
+    m_state->receiver = nullptr;
+}
+
+void SearchJob::start()
+{
+    QSharedPointer<State> state = m_state;
+    QThreadPool::globalInstance()->start([state]() { State::plan(state); });
+}
+
+void SearchJob::cancel()
+{
+    m_state->cancelled = true;
+}
+
+bool SearchJob::isCancelled() const
+{
+    return m_state->cancelled;
+}
\ No newline at end of file
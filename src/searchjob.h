@@ -0,0 +1,78 @@
+#ifndef SEARCHJOB_H
+#define SEARCHJOB_H
+
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QSet>
+#include "filesearcher.h"
+#include "searchindex.h"
+#include "searchcache.h"
+
+// Index shared between the search dialog and the jobs it starts. Jobs can
+// outlive the dialog, so the index is reference counted and locked.
+//
+// When a vault watcher feeds it, the notes it reports are refreshed by the
+// next search instead of walking the whole vault on every search. They
+// have a lock of their own so reporting never waits for a running update.
+struct SearchIndexHandle {
+    QMutex lock;
+    SearchIndex index;
+    bool loaded = false;
+    bool walked = false;
+    SearchCache cache;
+
+    QMutex touchedLock;
+    QSet<QString> touched;      // Relative paths reported since the last search
+    bool watched = false;
+    bool walkNeeded = false;    // Events were lost, walk the vault once more
+
+    void touch(const QStringList &relPaths);
+    void invalidate();
+};
+
+// One query running on the global thread pool.
+//
+// Planning (index refresh and candidate lookup) runs on a pool thread, then
+// the candidate files are handed out to workers one at a time. Hits are
+// delivered in batches through resultsReady() as soon as they are found.
+// Finished results are cached per index generation; a repeated query is
+// answered from the cache and a substring query that extends a cached one
+// only re-checks the lines that matched before.
+// Cancelling only sets a flag; workers stop at the next file and nothing
+// more is delivered, so the job can be dropped without waiting.
+class SearchJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        Substring,  // Case-insensitive plain text
+        Regex,      // Case-insensitive regular expression, matched per line
+        Ranked,     // Best notes by relevance, delivered in order in one batch
+        Query       // SearchQuery syntax: AND/OR/NOT, phrases and fields
+    };
+
+    SearchJob(const QSharedPointer<SearchIndexHandle> &index, const QString &searchText,
+              Mode mode = Substring, QObject *parent = nullptr);
+    ~SearchJob() override;
+
+    void start();
+    void cancel();
+    bool isCancelled() const;
+
+    QString searchText() const { return m_searchText; }
+
+signals:
+    void resultsReady(const QList<SearchHits> &batch);
+    void finished();
+
+private:
+    struct State;
+
+    QString m_searchText;
+    QSharedPointer<State> m_state;
+};
+
+#endif // SEARCHJOB_H
\ No newline at end of file
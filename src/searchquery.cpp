@@ -0,0 +1,646 @@
+#include "searchquery.h"
+#include "filesearcher.h"
+#include <QHash>
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+const qsizetype PhraseVerifyCost = 8; // Reading a line weighs like this many postings
+
+bool isOperator(const QString &word)
+{
+    return word == QLatin1String("AND") || word == QLatin1String("OR") || word == QLatin1String("NOT");
+}
+
+bool isField(const QString &name)
+{
+    return name == QLatin1String("path") || name == QLatin1String("title")
+        || name == QLatin1String("id") || name == QLatin1String("tag");
+}
+
+bool isWholeTerm(const QString &word)
+{
+    for (QChar c : word) {
+        if (!SearchIndex::isWordChar(c)) {
+            return false;
+        }
+    }
+    return !word.isEmpty();
+}
+
+// Distinct notes of a posting list sorted by note
+QVector<quint32> notesOf(const QVector<SearchIndex::Posting> &postings)
+{
+    QVector<quint32> notes;
+    for (const auto &p : postings) {
+        if (notes.isEmpty() || notes.last() != p.noteId) {
+            notes.append(p.noteId);
+        }
+    }
+    return notes;
+}
+
+// Intersection of sorted lists. Each element of the shorter list is looked up
+// in the longer one by exponential then binary search from the last hit,
+// which is close to linear for similar sizes and logarithmic for skewed ones.
+QVector<quint32> gallopIntersect(const QVector<quint32> &x, const QVector<quint32> &y)
+{
+    const QVector<quint32> &a = x.size() <= y.size() ? x : y;
+    const QVector<quint32> &b = x.size() <= y.size() ? y : x;
+
+    QVector<quint32> result;
+    qsizetype pos = 0;
+    for (quint32 value : a) {
+        qsizetype bound = 1;
+        while (pos + bound < b.size() && b[pos + bound] < value) {
+            bound *= 2;
+        }
+        auto first = b.cbegin() + pos + bound / 2;
+        auto last = b.cbegin() + qMin(pos + bound + 1, b.size());
+        auto it = std::lower_bound(first, last, value);
+
+        pos = it - b.cbegin();
+        if (pos == b.size()) {
+            break;
+        }
+        if (*it == value) {
+            result.append(value);
+            ++pos;
+        }
+    }
+    return result;
+}
+
+QVector<quint32> unite(const QVector<quint32> &a, const QVector<quint32> &b)
+{
+    QVector<quint32> result;
+    std::set_union(a.cbegin(), a.cend(), b.cbegin(), b.cend(), std::back_inserter(result));
+    return result;
+}
+
+QVector<quint32> subtract(const QVector<quint32> &a, const QVector<quint32> &b)
+{
+    QVector<quint32> result;
+    std::set_difference(a.cbegin(), a.cend(), b.cbegin(), b.cend(), std::back_inserter(result));
+    return result;
+}
+
+bool containsNote(const QVector<quint32> &notes, quint32 noteId)
+{
+    return std::binary_search(notes.cbegin(), notes.cend(), noteId);
+}
+
+} // namespace
+
+// Evaluation state of one execute() or explain() call
+struct SearchQuery::Plan {
+    const SearchIndex &index;
+    QVector<quint32> all;                                       // Live notes
+    QHash<const Node *, QVector<SearchIndex::Posting>> phraseLines;
+
+    explicit Plan(const SearchIndex &searchIndex);
+
+    qsizetype cost(const Node &node) const;
+    QVector<const Node *> executionOrder(const Node &node) const;
+    QVector<quint32> evaluate(const Node &node, const QVector<quint32> *within);
+    QVector<quint32> evaluatePhrase(const Node &node, const QVector<quint32> *within);
+    void collectLines(const Node &node, bool positive, const QVector<quint32> &notes,
+                      QHash<quint32, QVector<SearchIndex::Posting>> *lines) const;
+    void describe(const Node &node, int depth, QString *out) const;
+};
+
+SearchQuery::Plan::Plan(const SearchIndex &searchIndex)
+    : index(searchIndex)
+{
+    const auto &notes = index.notes();
+    for (qsizetype id = 0; id < notes.size(); ++id) {
+        if (!notes[id].path.isEmpty()) {
+            all.append(quint32(id));
+        }
+    }
+}
+
+qsizetype SearchQuery::Plan::cost(const Node &node) const
+{
+    switch (node.type) {
+    case Node::Term:
+        return index.postingCount(node.text, node.prefix);
+    case Node::Tag:
+        return index.postingCount(QLatin1Char('#') + node.text, node.prefix);
+    case Node::Title:
+        return index.titleNoteCount(node.text, node.prefix);
+    case Node::Id:
+    case Node::Path:
+        return all.size();
+    case Node::Phrase: {
+        // Bounded by its rarest word, every candidate line is read back
+        const QStringList terms = SearchIndex::tokenize(node.text);
+        qsizetype estimate = all.size();
+        for (const QString &term : terms) {
+            estimate = qMin(estimate, index.postingCount(term, true));
+        }
+        return estimate * PhraseVerifyCost;
+    }
+    case Node::And: {
+        qsizetype smallest = -1;
+        for (const Node &child : node.children) {
+            if (child.type != Node::Not) {
+                qsizetype c = cost(child);
+                smallest = smallest < 0 ? c : qMin(smallest, c);
+            }
+        }
+        return smallest < 0 ? all.size() : smallest;
+    }
+    case Node::Or: {
+        qsizetype total = 0;
+        for (const Node &child : node.children) {
+            total += cost(child);
+        }
+        return total;
+    }
+    case Node::Not:
+        return all.size();
+    }
+    return all.size();
+}
+
+// Children of an AND: positive ones cheapest first, then the negations
+QVector<const SearchQuery::Node *> SearchQuery::Plan::executionOrder(const Node &node) const
+{
+    QVector<QPair<qsizetype, const Node *>> positive;
+    QVector<const Node *> order;
+    for (const Node &child : node.children) {
+        if (child.type == Node::Not) {
+            continue;
+        }
+        positive.append(qMakePair(cost(child), &child));
+    }
+    std::stable_sort(positive.begin(), positive.end(),
+                     [](const QPair<qsizetype, const Node *> &a, const QPair<qsizetype, const Node *> &b) {
+                         return a.first < b.first;
+                     });
+    for (const auto &entry : positive) {
+        order.append(entry.second);
+    }
+    for (const Node &child : node.children) {
+        if (child.type == Node::Not) {
+            order.append(&child);
+        }
+    }
+    return order;
+}
+
+// Notes matching node. Callers only use the part of the result inside
+// within (if given), so the expensive steps may skip the notes outside.
+QVector<quint32> SearchQuery::Plan::evaluate(const Node &node, const QVector<quint32> *within)
+{
+    switch (node.type) {
+    case Node::Term:
+        return notesOf(index.postings(node.text, node.prefix));
+    case Node::Tag:
+        return notesOf(index.postings(QLatin1Char('#') + node.text, node.prefix));
+    case Node::Title:
+        return index.titleNotes(node.text, node.prefix);
+    case Node::Id:
+    case Node::Path: {
+        QVector<quint32> result;
+        const auto &notes = index.notes();
+        for (quint32 id : within ? *within : all) {
+            const SearchIndex::Note &note = notes[id];
+            bool matches;
+            if (node.type == Node::Path) {
+                matches = note.path.contains(node.text, Qt::CaseInsensitive);
+            } else if (node.prefix) {
+                matches = note.zettelId.startsWith(node.text, Qt::CaseInsensitive);
+            } else {
+                matches = note.zettelId.compare(node.text, Qt::CaseInsensitive) == 0;
+            }
+            if (matches) {
+                result.append(id);
+            }
+        }
+        return result;
+    }
+    case Node::Phrase:
+        return evaluatePhrase(node, within);
+    case Node::And: {
+        QVector<quint32> result = within ? *within : all;
+        bool first = !within;
+        for (const Node *child : executionOrder(node)) {
+            if (result.isEmpty()) {
+                break;
+            }
+            if (child->type == Node::Not) {
+                result = subtract(result, evaluate(child->children.first(), &result));
+            } else if (first) {
+                result = evaluate(*child, nullptr);
+            } else {
+                result = gallopIntersect(result, evaluate(*child, &result));
+            }
+            first = false;
+        }
+        return result;
+    }
+    case Node::Or: {
+        QVector<quint32> result;
+        for (const Node &child : node.children) {
+            result = unite(result, evaluate(child, within));
+        }
+        return result;
+    }
+    case Node::Not: {
+        const QVector<quint32> &base = within ? *within : all;
+        return subtract(base, evaluate(node.children.first(), &base));
+    }
+    }
+    return QVector<quint32>();
+}
+
+QVector<quint32> SearchQuery::Plan::evaluatePhrase(const Node &node, const QVector<quint32> *within)
+{
+    QVector<SearchIndex::Posting> lines;
+    QVector<quint32> candidates;
+    const bool haveLines = index.candidateLines(node.text, &lines);
+    if (haveLines) {
+        candidates = notesOf(lines);
+    } else if (!index.candidateNotes(node.text, &candidates)) {
+        candidates = all;
+    }
+    if (within) {
+        candidates = gallopIntersect(candidates, *within);
+    }
+
+    QVector<quint32> result;
+    QVector<SearchIndex::Posting> &verified = phraseLines[&node];
+    verified.clear();
+
+    for (quint32 noteId : candidates) {
+        const QString filePath = index.notePath(noteId);
+        QVector<TextScanner::Hit> hits;
+        if (haveLines) {
+            auto range = std::equal_range(lines.cbegin(), lines.cend(), SearchIndex::Posting{noteId, 0, 0},
+                                          [](const SearchIndex::Posting &a, const SearchIndex::Posting &b) {
+                                              return a.noteId < b.noteId;
+                                          });
+            hits = FileSearcher::matchInLines(filePath, node.text, QVector<SearchIndex::Posting>(range.first, range.second));
+        } else {
+            hits = FileSearcher::matchInSingleFile(filePath, node.text);
+        }
+
+        if (!hits.isEmpty()) {
+            result.append(noteId);
+            for (const auto &hit : hits) {
+                verified.append(SearchIndex::Posting{noteId, quint32(hit.lineNumber), quint32(hit.start)});
+            }
+        }
+    }
+
+    return result;
+}
+
+void SearchQuery::Plan::collectLines(const Node &node, bool positive, const QVector<quint32> &notes,
+                                     QHash<quint32, QVector<SearchIndex::Posting>> *lines) const
+{
+    switch (node.type) {
+    case Node::Term:
+    case Node::Tag:
+        if (positive) {
+            const QString term = node.type == Node::Tag ? QLatin1Char('#') + node.text : node.text;
+            const auto postings = index.postings(term, node.prefix);
+            for (const auto &p : postings) {
+                if (containsNote(notes, p.noteId)) {
+                    (*lines)[p.noteId].append(p);
+                }
+            }
+        }
+        break;
+    case Node::Phrase:
+        if (positive) {
+            for (const auto &p : phraseLines.value(&node)) {
+                if (containsNote(notes, p.noteId)) {
+                    (*lines)[p.noteId].append(p);
+                }
+            }
+        }
+        break;
+    case Node::And:
+    case Node::Or:
+        for (const Node &child : node.children) {
+            collectLines(child, positive, notes, lines);
+        }
+        break;
+    case Node::Not:
+        collectLines(node.children.first(), !positive, notes, lines);
+        break;
+    default:
+        break;
+    }
+}
+
+void SearchQuery::Plan::describe(const Node &node, int depth, QString *out) const
+{
+    static const char *const names[] = { "term", "phrase", "title", "tag", "id", "path", "AND", "OR", "NOT" };
+
+    QString line = QString(depth * 2, QLatin1Char(' ')) + QLatin1String(names[node.type]);
+    if (!node.text.isEmpty()) {
+        line += QString(" \"%1%2\"").arg(node.text, node.prefix ? QStringLiteral("*") : QString());
+    }
+    line += QString("  cost %1\n").arg(cost(node));
+    out->append(line);
+
+    if (node.type == Node::And) {
+        for (const Node *child : executionOrder(node)) {
+            describe(*child, depth + 1, out);
+        }
+    } else {
+        for (const Node &child : node.children) {
+            describe(child, depth + 1, out);
+        }
+    }
+}
+
+SearchQuery::SearchQuery(const QString &text)
+    : m_text(text)
+{
+    tokenize();
+    if (!m_error.isEmpty() || peek().type == Token::End) {
+        return;
+    }
+
+    if (parseOr(&m_root) && peek().type != Token::End) {
+        m_error = peek().type == Token::Close ? QString("Unexpected ')'")
+                                              : QString("Unexpected '%1'").arg(peek().text);
+    }
+}
+
+void SearchQuery::tokenize()
+{
+    const QString &text = m_text;
+    qsizetype i = 0;
+
+    while (i < text.size()) {
+        QChar c = text.at(i);
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == QLatin1Char('(') || c == QLatin1Char(')')) {
+            m_tokens.append(Token{c == QLatin1Char('(') ? Token::Open : Token::Close, QString(c), QString()});
+            ++i;
+        } else if (c == QLatin1Char('-') && i + 1 < text.size() && !text.at(i + 1).isSpace()) {
+            m_tokens.append(Token{Token::Minus, QStringLiteral("-"), QString()});
+            ++i;
+        } else if (c == QLatin1Char('"')) {
+            qsizetype end = text.indexOf(QLatin1Char('"'), i + 1);
+            if (end < 0) {
+                m_error = "Missing closing quote";
+                return;
+            }
+            m_tokens.append(Token{Token::Quoted, text.mid(i + 1, end - i - 1), QString()});
+            i = end + 1;
+        } else {
+            qsizetype end = i;
+            while (end < text.size() && !text.at(end).isSpace() && text.at(end) != QLatin1Char('(')
+                   && text.at(end) != QLatin1Char(')') && text.at(end) != QLatin1Char('"')) {
+                ++end;
+            }
+            QString word = text.mid(i, end - i);
+            i = end;
+
+            // field:value or field:"quoted value"
+            qsizetype colon = word.indexOf(QLatin1Char(':'));
+            QString field = colon > 0 ? word.left(colon) : QString();
+            if (isField(field)) {
+                QString value = word.mid(colon + 1);
+                if (value.isEmpty() && i < text.size() && text.at(i) == QLatin1Char('"')) {
+                    qsizetype close = text.indexOf(QLatin1Char('"'), i + 1);
+                    if (close < 0) {
+                        m_error = "Missing closing quote";
+                        return;
+                    }
+                    m_tokens.append(Token{Token::Quoted, text.mid(i + 1, close - i - 1), field});
+                    i = close + 1;
+                } else {
+                    m_tokens.append(Token{Token::Word, value, field});
+                }
+                continue;
+            }
+
+            m_tokens.append(Token{Token::Word, word, QString()});
+        }
+    }
+
+    m_tokens.append(Token{Token::End, QString(), QString()});
+}
+
+bool SearchQuery::parseOr(Node *node)
+{
+    Node first;
+    if (!parseAnd(&first)) {
+        return false;
+    }
+
+    if (!(peek().type == Token::Word && peek().field.isEmpty() && peek().text == QLatin1String("OR"))) {
+        *node = first;
+        return true;
+    }
+
+    node->type = Node::Or;
+    node->children.append(first);
+    while (peek().type == Token::Word && peek().field.isEmpty() && peek().text == QLatin1String("OR")) {
+        ++m_pos;
+        Node next;
+        if (!parseAnd(&next)) {
+            return false;
+        }
+        node->children.append(next);
+    }
+    return true;
+}
+
+bool SearchQuery::parseAnd(Node *node)
+{
+    Node first;
+    if (!parseUnary(&first)) {
+        return false;
+    }
+
+    QVector<Node> children;
+    children.append(first);
+    forever {
+        const Token &token = peek();
+        if (token.type == Token::End || token.type == Token::Close
+            || (token.type == Token::Word && token.field.isEmpty() && token.text == QLatin1String("OR"))) {
+            break;
+        }
+        if (token.type == Token::Word && token.field.isEmpty() && token.text == QLatin1String("AND")) {
+            ++m_pos;
+        }
+
+        Node next;
+        if (!parseUnary(&next)) {
+            return false;
+        }
+        children.append(next);
+    }
+
+    if (children.size() == 1) {
+        *node = first;
+    } else {
+        node->type = Node::And;
+        node->children = children;
+    }
+    return true;
+}
+
+bool SearchQuery::parseUnary(Node *node)
+{
+    const Token &token = peek();
+    if (token.type == Token::Minus
+        || (token.type == Token::Word && token.field.isEmpty() && token.text == QLatin1String("NOT"))) {
+        ++m_pos;
+        Node child;
+        if (!parseUnary(&child)) {
+            return false;
+        }
+        node->type = Node::Not;
+        node->children.append(child);
+        return true;
+    }
+    return parsePrimary(node);
+}
+
+bool SearchQuery::parsePrimary(Node *node)
+{
+    const Token token = peek();
+    switch (token.type) {
+    case Token::Open:
+        ++m_pos;
+        if (!parseOr(node)) {
+            return false;
+        }
+        if (peek().type != Token::Close) {
+            m_error = "Missing ')'";
+            return false;
+        }
+        ++m_pos;
+        return true;
+    case Token::Quoted:
+        ++m_pos;
+        return makeLeaf(token.field, token.text, true, node);
+    case Token::Word:
+        if (token.field.isEmpty() && isOperator(token.text)) {
+            m_error = QString("'%1' needs a term on both sides").arg(token.text);
+            return false;
+        }
+        ++m_pos;
+        return makeLeaf(token.field, token.text, false, node);
+    case Token::Close:
+        m_error = "Unexpected ')'";
+        return false;
+    default:
+        m_error = "Missing search term";
+        return false;
+    }
+}
+
+bool SearchQuery::makeLeaf(const QString &field, const QString &value, bool quoted, Node *node)
+{
+    QString text = value;
+    bool prefix = !quoted && text.size() > 1 && text.endsWith(QLatin1Char('*'));
+    if (prefix) {
+        text.chop(1);
+    }
+
+    if (text.isEmpty()) {
+        m_error = field.isEmpty() ? QString("Empty phrase") : QString("Missing value for %1:").arg(field);
+        return false;
+    }
+
+    if (field == QLatin1String("path")) {
+        node->type = Node::Path;
+        node->text = text;
+    } else if (field == QLatin1String("id")) {
+        node->type = Node::Id;
+        node->text = text;
+        node->prefix = prefix;
+    } else if (field == QLatin1String("tag")) {
+        if (text.startsWith(QLatin1Char('#'))) {
+            text.remove(0, 1);
+        }
+        node->type = Node::Tag;
+        node->text = text.toCaseFolded();
+        node->prefix = prefix;
+    } else if (field == QLatin1String("title")) {
+        const QStringList terms = SearchIndex::tokenize(text);
+        if (terms.isEmpty()) {
+            m_error = QString("No words in title:%1").arg(value);
+            return false;
+        }
+        if (terms.size() == 1) {
+            node->type = Node::Title;
+            node->text = terms.first();
+            node->prefix = prefix;
+        } else {
+            node->type = Node::And;
+            for (qsizetype i = 0; i < terms.size(); ++i) {
+                Node term;
+                term.type = Node::Title;
+                term.text = terms[i];
+                term.prefix = prefix && i == terms.size() - 1;
+                node->children.append(term);
+            }
+        }
+    } else if (!quoted && isWholeTerm(text)) {
+        node->type = Node::Term;
+        node->text = text.toCaseFolded();
+        node->prefix = prefix;
+    } else {
+        // Several words or punctuation, matched as text
+        node->type = Node::Phrase;
+        node->text = quoted ? value : value.trimmed();
+    }
+    return true;
+}
+
+QVector<SearchQuery::Match> SearchQuery::execute(const SearchIndex &index) const
+{
+    QVector<Match> matches;
+    if (!isValid()) {
+        return matches;
+    }
+
+    Plan plan(index);
+    const QVector<quint32> notes = plan.evaluate(m_root, nullptr);
+
+    QHash<quint32, QVector<SearchIndex::Posting>> lines;
+    plan.collectLines(m_root, true, notes, &lines);
+
+    matches.reserve(notes.size());
+    for (quint32 noteId : notes) {
+        QVector<SearchIndex::Posting> noteLines = lines.value(noteId);
+        std::sort(noteLines.begin(), noteLines.end(),
+                  [](const SearchIndex::Posting &a, const SearchIndex::Posting &b) { return a.line < b.line; });
+        noteLines.erase(std::unique(noteLines.begin(), noteLines.end(),
+                                    [](const SearchIndex::Posting &a, const SearchIndex::Posting &b) {
+                                        return a.line == b.line;
+                                    }),
+                        noteLines.end());
+        if (noteLines.isEmpty()) {
+            noteLines.append(SearchIndex::Posting{noteId, 1, 0}); // Matched on title, id or path
+        }
+        matches.append(Match{noteId, noteLines});
+    }
+
+    return matches;
+}
+
+QString SearchQuery::explain(const SearchIndex &index) const
+{
+    if (!isValid()) {
+        return m_error;
+    }
+
+    QString out;
+    Plan(index).describe(m_root, 0, &out);
+    return out;
+}
\ No newline at end of file
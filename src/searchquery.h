@@ -0,0 +1,82 @@
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "searchindex.h"
+
+// Structured search query.
+//
+//   zettel AND (index OR graph) -draft "exact phrase" title:intro id:1a* tag:todo path:daily/
+//
+// Words match whole terms ("zett*" for a prefix), quoted phrases match text
+// within a line, juxtaposition means AND, and NOT or a leading '-' negates.
+// The parsed tree is compiled into a plan that evaluates the cheapest
+// posting lists first and intersects them by galloping.
+class SearchQuery
+{
+public:
+    struct Node {
+        enum Type {
+            Term,       // Whole term in the body, optionally a prefix
+            Phrase,     // Case-insensitive text within one line
+            Title,      // Term of the note title
+            Tag,        // #tag in the body
+            Id,         // Zettel id of the note
+            Path,       // Text within the note's relative path
+            And,
+            Or,
+            Not
+        };
+
+        Type type = Term;
+        QString text;           // Case-folded for Term, Title and Tag
+        bool prefix = false;
+        QVector<Node> children;
+    };
+
+    struct Match {
+        quint32 noteId;
+        QVector<SearchIndex::Posting> lines;    // Lines of the positive terms
+    };
+
+    explicit SearchQuery(const QString &text = QString());
+
+    bool isValid() const { return m_error.isEmpty() && !m_text.trimmed().isEmpty(); }
+    QString errorString() const { return m_error; }
+    QString text() const { return m_text; }
+    const Node &root() const { return m_root; }
+
+    // Matching notes in id order. Phrases are verified against the files.
+    QVector<Match> execute(const SearchIndex &index) const;
+
+    // The plan as indented text with the estimated cost of each step
+    QString explain(const SearchIndex &index) const;
+
+private:
+    struct Token {
+        enum Type { Word, Quoted, Open, Close, Minus, End };
+        Type type;
+        QString text;
+        QString field;          // "title" for title:..., empty otherwise
+    };
+
+    struct Plan;
+
+    void tokenize();
+    bool parseOr(Node *node);
+    bool parseAnd(Node *node);
+    bool parseUnary(Node *node);
+    bool parsePrimary(Node *node);
+    bool makeLeaf(const QString &field, const QString &value, bool quoted, Node *node);
+    const Token &peek() const { return m_tokens.at(m_pos); }
+
+    QString m_text;
+    QString m_error;
+    Node m_root;
+    QVector<Token> m_tokens;
+    int m_pos = 0;
+};
+
+#endif // SEARCHQUERY_H
\ No newline at end of file
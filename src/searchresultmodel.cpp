@@ -0,0 +1,146 @@
+#include "searchresultmodel.h"
+#include <QFileInfo>
+#include <QDateTime>
+
+namespace {
+
+const int DisplayCacheRows = 2000;
+const qint64 MaxDisplayBytes = 4096; // Very long lines are cut for display
+
+} // namespace
+
+SearchResultModel::SearchResultModel(QObject *parent)
+    : QAbstractListModel(parent), m_displayCache(DisplayCacheRows), m_openFile(-1)
+{
+}
+
+int SearchResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_hits.size());
+}
+
+QVariant SearchResultModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_hits.size()) {
+        return QVariant();
+    }
+
+    const Hit &hit = m_hits.at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        if (QString *cached = m_displayCache.object(index.row())) {
+            return *cached;
+        }
+
+        QString text;
+        if (!lineText(hit, &text)) {
+            text = QStringLiteral("(changed since the search)");
+        }
+        QString display = QString("%1:%2: %3")
+            .arg(m_fileNames.at(hit.fileIndex))
+            .arg(hit.lineNumber)
+            .arg(text);
+        m_displayCache.insert(index.row(), new QString(display));
+        return display;
+    }
+    case Qt::ToolTipRole:
+    case FilePathRole:
+        return m_files.at(hit.fileIndex);
+    case LineNumberRole:
+        return int(hit.lineNumber);
+    default:
+        return QVariant();
+    }
+}
+
+void SearchResultModel::appendHits(const QList<SearchHits> &batch)
+{
+    int added = 0;
+    for (const auto &fileHits : batch) {
+        added += fileHits.hits.size();
+    }
+    if (added == 0) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), m_hits.size(), m_hits.size() + added - 1);
+
+    for (const auto &fileHits : batch) {
+        auto found = m_fileIndexes.constFind(fileHits.filePath);
+        quint32 fileIndex;
+        if (found != m_fileIndexes.constEnd()) {
+            fileIndex = *found;
+        } else {
+            fileIndex = m_files.size();
+            m_files.append(fileHits.filePath);
+            m_fileNames.append(QFileInfo(fileHits.filePath).fileName());
+            m_fileStamps.append(FileStamp{fileHits.size, fileHits.mtime});
+            m_fileIndexes.insert(fileHits.filePath, fileIndex);
+        }
+
+        for (const auto &hit : fileHits.hits) {
+            m_hits.append(Hit{fileIndex, quint32(hit.lineNumber), quint32(hit.start), quint32(hit.length)});
+        }
+    }
+
+    endInsertRows();
+}
+
+void SearchResultModel::clear()
+{
+    beginResetModel();
+    m_files.clear();
+    m_fileNames.clear();
+    m_fileStamps.clear();
+    m_fileIndexes.clear();
+    m_hits.clear();
+    m_hits.squeeze();
+    m_displayCache.clear();
+    m_file.close();
+    m_openFile = -1;
+    endResetModel();
+}
+
+// False when the note changed since it was searched; its spans may point
+// anywhere now. Checked per row, as the note can change while it is open.
+bool SearchResultModel::lineText(const Hit &hit, QString *text) const
+{
+    const QString &filePath = m_files.at(hit.fileIndex);
+    const FileStamp &stamp = m_fileStamps.at(hit.fileIndex);
+    const QFileInfo info(filePath);
+    if (info.size() != stamp.size || info.lastModified().toMSecsSinceEpoch() != stamp.mtime) {
+        return false;
+    }
+
+    // Rows of the same note are usually next to each other, keep it open
+    if (m_openFile != qint64(hit.fileIndex)) {
+        m_file.close();
+        m_file.setFileName(filePath);
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            m_openFile = -1;
+            return true;
+        }
+        m_openFile = hit.fileIndex;
+    }
+
+    if (!m_file.seek(hit.offset)) {
+        return true;
+    }
+
+    QByteArray raw = m_file.read(qMin<qint64>(hit.length, MaxDisplayBytes));
+    if (hit.length > MaxDisplayBytes && !raw.isEmpty()) {
+        // Cut before a multi-byte character the limit splits
+        int lead = raw.size() - 1;
+        while (lead > 0 && raw.size() - lead < 4 && (uchar(raw.at(lead)) & 0xc0) == 0x80) {
+            --lead;
+        }
+        const uchar ch = raw.at(lead);
+        const int length = ch >= 0xf0 ? 4 : ch >= 0xe0 ? 3 : ch >= 0xc0 ? 2 : 1;
+        if (lead + length > raw.size()) {
+            raw.truncate(lead);
+        }
+    }
+    *text = QString::fromUtf8(raw).trimmed();
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef SEARCHRESULTMODEL_H
+#define SEARCHRESULTMODEL_H
+
+#include <QAbstractListModel>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QCache>
+#include <QFile>
+#include "filesearcher.h"
+
+// List model over search hits stored as 16-byte records (file index, line,
+// byte span). The line text is read back from the note and formatted only
+// when a view asks for a row, and a small cache keeps scrolling cheap. Rows
+// of notes changed since the search are shown as such, not with whatever
+// their old spans cover now.
+class SearchResultModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        FilePathRole = Qt::UserRole,
+        LineNumberRole
+    };
+
+    explicit SearchResultModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void appendHits(const QList<SearchHits> &batch);
+    int fileCount() const { return m_files.size(); }
+    void clear();
+
+private:
+    struct Hit {
+        quint32 fileIndex;
+        quint32 lineNumber;
+        quint32 offset;
+        quint32 length;
+    };
+
+    struct FileStamp {
+        qint64 size;
+        qint64 mtime;
+    };
+
+    bool lineText(const Hit &hit, QString *text) const;
+
+    QStringList m_files;
+    QStringList m_fileNames;
+    QVector<FileStamp> m_fileStamps;
+    QHash<QString, quint32> m_fileIndexes;
+    QVector<Hit> m_hits;
+
+    mutable QCache<int, QString> m_displayCache;
+    mutable QFile m_file;
+    mutable qint64 m_openFile;
+};
+
+#endif // SEARCHRESULTMODEL_H
\ No newline at end of file
@@ -12,6 +12,7 @@ Settings::Settings(QObject *parent)
     , m_currentTheme(LightTheme)
     , m_lineWrapping(true)
     , m_showLineNumbers(false)
+    , m_previewDelay(100)
 {
     // Set default font
     m_editorFont = QFont("Courier", 12);
@@ -43,6 +44,7 @@ void Settings::loadSettings()
     // Load editor settings
     m_lineWrapping = m_settings->value("editor/lineWrapping", true).toBool();
     m_showLineNumbers = m_settings->value("editor/showLineNumbers", false).toBool();
+    m_previewDelay = m_settings->value("editor/previewDelay", 100).toInt();
 }
 
 void Settings::saveSettings()
@@ -52,6 +54,7 @@ void Settings::saveSettings()
     m_settings->setValue("font/size", m_editorFont.pointSize());
     m_settings->setValue("editor/lineWrapping", m_lineWrapping);
     m_settings->setValue("editor/showLineNumbers", m_showLineNumbers);
+    m_settings->setValue("editor/previewDelay", m_previewDelay);
     m_settings->sync();
 }
 
@@ -138,6 +141,20 @@ void Settings::setShowLineNumbers(bool enabled)
     }
 }
 
+int Settings::previewDelay() const
+{
+    return m_previewDelay;
+}
+
+void Settings::setPreviewDelay(int ms)
+{
+    if (m_previewDelay != ms) {
+        m_previewDelay = ms;
+        saveSettings();
+        emit previewDelayChanged(ms);
+    }
+}
+
 QColor Settings::backgroundColor() const
 {
     switch (m_currentTheme) {
@@ -40,6 +40,10 @@ public:
     bool showLineNumbers() const;
     void setShowLineNumbers(bool enabled);
 
+    // Longest time the Markdown preview lags behind typing, in milliseconds
+    int previewDelay() const;
+    void setPreviewDelay(int ms);
+
     // Colors for current theme
     QColor backgroundColor() const;
     QColor textColor() const;
@@ -52,6 +56,7 @@ public:
 signals:
     void themeChanged(Theme newTheme);
     void fontChanged(const QFont &newFont);
+    void previewDelayChanged(int ms);
 
 private:
     explicit Settings(QObject *parent = nullptr);
@@ -65,6 +70,7 @@ private:
     QFont m_editorFont;
     bool m_lineWrapping;
     bool m_showLineNumbers;
+    int m_previewDelay;
 
     static Settings *s_instance;
 };
@@ -0,0 +1,296 @@
+#include "textscanner.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TEXTSCANNER_HAVE_AVX2_DISPATCH
+#endif
+
+namespace {
+
+inline char foldAscii(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+inline char upperAscii(char c)
+{
+    return (c >= 'a' && c <= 'z') ? char(c - ('a' - 'A')) : c;
+}
+
+inline bool equalsFolded(const char *data, const char *pattern, qsizetype length)
+{
+    for (qsizetype i = 0; i < length; ++i) {
+        if (foldAscii(data[i]) != pattern[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+qsizetype findScalar(const char *data, qsizetype size, qsizetype from,
+                     const char *pattern, qsizetype length)
+{
+    const char first = pattern[0];
+    const char last = pattern[length - 1];
+
+    for (qsizetype i = from; i + length <= size; ++i) {
+        if (foldAscii(data[i]) == first && foldAscii(data[i + length - 1]) == last
+            && equalsFolded(data + i, pattern, length)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if defined(__SSE2__)
+qsizetype findSse2(const char *data, qsizetype size, qsizetype from,
+                   const char *pattern, qsizetype length)
+{
+    const __m128i firstLower = _mm_set1_epi8(pattern[0]);
+    const __m128i firstUpper = _mm_set1_epi8(upperAscii(pattern[0]));
+    const __m128i lastLower = _mm_set1_epi8(pattern[length - 1]);
+    const __m128i lastUpper = _mm_set1_epi8(upperAscii(pattern[length - 1]));
+
+    qsizetype i = from;
+    for (; i + length - 1 + 16 <= size; i += 16) {
+        const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + length - 1));
+
+        const __m128i headHit = _mm_or_si128(_mm_cmpeq_epi8(head, firstLower), _mm_cmpeq_epi8(head, firstUpper));
+        const __m128i tailHit = _mm_or_si128(_mm_cmpeq_epi8(tail, lastLower), _mm_cmpeq_epi8(tail, lastUpper));
+
+        quint32 mask = quint32(_mm_movemask_epi8(_mm_and_si128(headHit, tailHit)));
+        while (mask) {
+            qsizetype pos = i + qCountTrailingZeroBits(mask);
+            if (equalsFolded(data + pos, pattern, length)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return findScalar(data, size, i, pattern, length);
+}
+#endif
+
+#if defined(TEXTSCANNER_HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+qsizetype findAvx2(const char *data, qsizetype size, qsizetype from,
+                   const char *pattern, qsizetype length)
+{
+    const __m256i firstLower = _mm256_set1_epi8(pattern[0]);
+    const __m256i firstUpper = _mm256_set1_epi8(upperAscii(pattern[0]));
+    const __m256i lastLower = _mm256_set1_epi8(pattern[length - 1]);
+    const __m256i lastUpper = _mm256_set1_epi8(upperAscii(pattern[length - 1]));
+
+    qsizetype i = from;
+    for (; i + length - 1 + 32 <= size; i += 32) {
+        const __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + length - 1));
+
+        const __m256i headHit = _mm256_or_si256(_mm256_cmpeq_epi8(head, firstLower),
+                                                _mm256_cmpeq_epi8(head, firstUpper));
+        const __m256i tailHit = _mm256_or_si256(_mm256_cmpeq_epi8(tail, lastLower),
+                                                _mm256_cmpeq_epi8(tail, lastUpper));
+
+        quint32 mask = quint32(_mm256_movemask_epi8(_mm256_and_si256(headHit, tailHit)));
+        while (mask) {
+            qsizetype pos = i + qCountTrailingZeroBits(mask);
+            if (equalsFolded(data + pos, pattern, length)) {
+                return pos;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return findScalar(data, size, i, pattern, length);
+}
+
+bool cpuHasAvx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+bool containsSequence(const char *data, qsizetype size, const char *sequence, qsizetype length)
+{
+    const char *end = data + size;
+    const char *p = data;
+    while (end - p >= length) {
+        p = static_cast<const char *>(std::memchr(p, sequence[0], size_t(end - p - length + 1)));
+        if (!p) {
+            return false;
+        }
+        if (std::memcmp(p, sequence, size_t(length)) == 0) {
+            return true;
+        }
+        ++p;
+    }
+    return false;
+}
+
+int countNewlines(const char *data, qsizetype size)
+{
+    int count = 0;
+    const char *end = data + size;
+    const char *p = data;
+    while (p < end && (p = static_cast<const char *>(std::memchr(p, '\n', size_t(end - p))))) {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+} // namespace
+
+TextScanner::TextScanner(const QString &needle)
+    : m_needle(needle), m_exact(true), m_unicodeFolds(false)
+{
+    // Longest run of ASCII characters becomes the byte-level anchor
+    qsizetype bestStart = 0;
+    qsizetype bestLength = 0;
+    qsizetype runStart = 0;
+    for (qsizetype i = 0; i <= needle.size(); ++i) {
+        if (i < needle.size() && needle.at(i).unicode() < 0x80) {
+            continue;
+        }
+        if (i - runStart > bestLength) {
+            bestStart = runStart;
+            bestLength = i - runStart;
+        }
+        runStart = i + 1;
+    }
+
+    m_exact = bestLength == needle.size();
+    m_anchor = needle.mid(bestStart, bestLength).toLatin1().toLower();
+
+    // KELVIN SIGN and LATIN SMALL LETTER LONG S fold to 'k' and 's'
+    m_unicodeFolds = m_anchor.contains('k') || m_anchor.contains('s');
+}
+
+bool TextScanner::scan(const char *data, qsizetype size, QVector<Hit> *hits) const
+{
+    if (m_unicodeFolds
+        && (containsSequence(data, size, "\xE2\x84\xAA", 3) || containsSequence(data, size, "\xC5\xBF", 2))) {
+        return false;
+    }
+
+    // A UTF-8 byte order mark is not part of the first line
+    qsizetype pos = 0;
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        pos = 3;
+    }
+
+    int lineNumber = 1;
+    qsizetype counted = pos;
+
+    while (pos < size) {
+        qsizetype candidate = pos;
+        if (!m_anchor.isEmpty()) {
+            candidate = findFolded(data, size, pos, m_anchor);
+            if (candidate < 0) {
+                break;
+            }
+        }
+
+        lineNumber += countNewlines(data + counted, candidate - counted);
+
+        // pos is always at a line start, so the backwards walk stops there
+        qsizetype start = candidate;
+        while (start > pos && data[start - 1] != '\n') {
+            --start;
+        }
+
+        const char *newline = static_cast<const char *>(std::memchr(data + candidate, '\n', size_t(size - candidate)));
+        qsizetype end = newline ? newline - data : size;
+
+        qsizetype length = end - start;
+        if (length > 0 && data[start + length - 1] == '\r') {
+            --length;
+        }
+
+        if (matchesLine(data + start, length)) {
+            hits->append(Hit{lineNumber, start, length});
+        }
+
+        pos = end + 1;
+        counted = pos;
+        ++lineNumber;
+    }
+
+    return true;
+}
+
+void TextScanner::scanDecoded(const char *data, qsizetype size, QVector<Hit> *hits) const
+{
+    qsizetype pos = 0;
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        pos = 3;
+    }
+
+    int lineNumber = 1;
+    while (pos < size) {
+        const char *newline = static_cast<const char *>(std::memchr(data + pos, '\n', size_t(size - pos)));
+        qsizetype end = newline ? newline - data : size;
+
+        qsizetype length = end - pos;
+        if (length > 0 && data[pos + length - 1] == '\r') {
+            --length;
+        }
+
+        if (QString::fromUtf8(data + pos, length).contains(m_needle, Qt::CaseInsensitive)) {
+            hits->append(Hit{lineNumber, pos, length});
+        }
+
+        pos = end + 1;
+        ++lineNumber;
+    }
+}
+
+bool TextScanner::matchesLine(const char *line, qsizetype length) const
+{
+    if (m_exact && !m_anchor.isEmpty()) {
+        return true; // Confirmed by the byte comparison
+    }
+    return QString::fromUtf8(line, length).contains(m_needle, Qt::CaseInsensitive);
+}
+
+qsizetype TextScanner::findFolded(const char *data, qsizetype size, qsizetype from,
+                                  const QByteArray &pattern)
+{
+    const qsizetype length = pattern.size();
+    if (length == 0) {
+        return from <= size ? from : -1;
+    }
+    if (size - from < length) {
+        return -1;
+    }
+
+#if defined(TEXTSCANNER_HAVE_AVX2_DISPATCH)
+    if (cpuHasAvx2()) {
+        return findAvx2(data, size, from, pattern.constData(), length);
+    }
+#endif
+#if defined(__SSE2__)
+    return findSse2(data, size, from, pattern.constData(), length);
+#else
+    return findScalar(data, size, from, pattern.constData(), length);
+#endif
+}
+
+bool TextScanner::hasNonAscii(const char *data, qsizetype size)
+{
+    for (qsizetype i = 0; i < size; ++i) {
+        if (uchar(data[i]) & 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
\ No newline at end of file
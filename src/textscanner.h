@@ -0,0 +1,54 @@
+#ifndef TEXTSCANNER_H
+#define TEXTSCANNER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+// Case-insensitive line matcher working directly on UTF-8 bytes.
+//
+// The scanner looks for an ASCII "anchor" taken from the needle with a
+// vectorized first/last byte filter (AVX2 or SSE2 when available, scalar
+// otherwise). Only confirmed hits get their line number counted and, when
+// the needle is not plain ASCII, their line decoded for the final
+// QString::contains check. Results are identical to decoding every line and
+// calling QString::contains(needle, Qt::CaseInsensitive).
+class TextScanner
+{
+public:
+    struct Hit {
+        int lineNumber;      // 1-based
+        qsizetype start;     // Byte offset of the line
+        qsizetype length;    // Line length without the line terminator
+    };
+
+    explicit TextScanner(const QString &needle);
+
+    // Appends one hit per matching line. Returns false if the buffer holds
+    // characters whose case folding the byte filter cannot see (e.g. KELVIN
+    // SIGN folding to 'k'); the caller then has to use the decoded path.
+    bool scan(const char *data, qsizetype size, QVector<Hit> *hits) const;
+
+    // Decodes every line and matches it with QString::contains. Exact for
+    // any input, used when scan() declines a buffer.
+    void scanDecoded(const char *data, qsizetype size, QVector<Hit> *hits) const;
+
+    QString needle() const { return m_needle; }
+
+    // Offset of the next position at or after from where the lowercase ASCII
+    // pattern matches case-insensitively, or -1.
+    static qsizetype findFolded(const char *data, qsizetype size, qsizetype from,
+                                const QByteArray &pattern);
+
+    static bool hasNonAscii(const char *data, qsizetype size);
+
+private:
+    bool matchesLine(const char *line, qsizetype length) const;
+
+    QString m_needle;
+    QByteArray m_anchor;      // Lowercased ASCII run of the needle
+    bool m_exact;             // The anchor is the whole needle
+    bool m_unicodeFolds;      // Needle has letters that non-ASCII characters fold to
+};
+
+#endif // TEXTSCANNER_H
\ No newline at end of file
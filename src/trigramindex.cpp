@@ -0,0 +1,472 @@
+#include "trigramindex.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Posting list of notes that must always be verified
+const TrigramIndex::Trigram UnicodeFoldMarker = 0x01000000;
+
+inline char foldAscii(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+}
+
+bool hasUnicodeFolds(const QByteArray &data)
+{
+    // KELVIN SIGN and LATIN SMALL LETTER LONG S
+    return data.contains("\xE2\x84\xAA") || data.contains("\xC5\xBF");
+}
+
+// Index of the ']' closing the class opened at pattern[open]
+qsizetype skipClass(const QString &pattern, qsizetype open)
+{
+    qsizetype i = open + 1;
+    if (i < pattern.size() && pattern.at(i) == QLatin1Char('^')) {
+        ++i;
+    }
+    if (i < pattern.size() && pattern.at(i) == QLatin1Char(']')) {
+        ++i; // Leading ']' is literal
+    }
+    for (; i < pattern.size(); ++i) {
+        QChar c = pattern.at(i);
+        if (c == QLatin1Char('\\')) {
+            ++i;
+        } else if (c == QLatin1Char(']')) {
+            return i;
+        }
+    }
+    return pattern.size() - 1;
+}
+
+// Index of the ')' closing the group opened at pattern[open]
+qsizetype skipGroup(const QString &pattern, qsizetype open)
+{
+    int depth = 0;
+    for (qsizetype i = open; i < pattern.size(); ++i) {
+        QChar c = pattern.at(i);
+        if (c == QLatin1Char('\\')) {
+            ++i;
+        } else if (c == QLatin1Char('[')) {
+            i = skipClass(pattern, i);
+        } else if (c == QLatin1Char('(')) {
+            ++depth;
+        } else if (c == QLatin1Char(')') && --depth == 0) {
+            return i;
+        }
+    }
+    return pattern.size() - 1;
+}
+
+// Index of the last character belonging to the escape whose letter or digit
+// is at pattern[at], so that e.g. the digits of \x41 are not read as text
+qsizetype skipEscapeArgument(const QString &pattern, qsizetype at)
+{
+    const QChar escaped = pattern.at(at);
+    qsizetype i = at + 1;
+    if (i >= pattern.size()) {
+        return at;
+    }
+
+    const QChar next = pattern.at(i);
+    if (next == QLatin1Char('{') || next == QLatin1Char('<') || next == QLatin1Char('\'')) {
+        const QChar close = next == QLatin1Char('{') ? QLatin1Char('}')
+                          : next == QLatin1Char('<') ? QLatin1Char('>') : QLatin1Char('\'');
+        qsizetype end = pattern.indexOf(close, i + 1);
+        return end < 0 ? pattern.size() - 1 : end;
+    }
+    if (escaped == QLatin1Char('c')) {
+        return i; // Control character
+    }
+
+    qsizetype limit = 0;
+    if (escaped == QLatin1Char('x')) {
+        limit = 2;
+    } else if (escaped.isDigit()) {
+        limit = 3; // Back reference or octal
+    } else if (escaped == QLatin1Char('g')) {
+        limit = 3;
+        if (next == QLatin1Char('-') || next == QLatin1Char('+')) {
+            ++i;
+        }
+    }
+
+    qsizetype end = at;
+    while (limit > 0 && i < pattern.size() && pattern.at(i).isLetterOrNumber()) {
+        end = i++;
+        --limit;
+    }
+    return end;
+}
+
+// Whether the pattern turns on extended syntax, where whitespace and '#'
+// lose their literal meaning
+bool usesExtendedSyntax(const QString &pattern)
+{
+    qsizetype i = 0;
+    while ((i = pattern.indexOf(QLatin1String("(?"), i)) >= 0) {
+        for (i += 2; i < pattern.size(); ++i) {
+            QChar c = pattern.at(i);
+            if (c == QLatin1Char('x')) {
+                return true;
+            }
+            if (!c.isLetter() && c != QLatin1Char('-') && c != QLatin1Char('^')) {
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+QVector<quint32> intersectSorted(const QVector<quint32> &a, const QVector<quint32> &b)
+{
+    QVector<quint32> result;
+    std::set_intersection(a.cbegin(), a.cend(), b.cbegin(), b.cend(), std::back_inserter(result));
+    return result;
+}
+
+} // namespace
+
+void TrigramIndex::clear()
+{
+    m_postings.clear();
+    m_noteTrigrams.clear();
+}
+
+QVector<TrigramIndex::Trigram> TrigramIndex::noteTrigrams(const QByteArray &data)
+{
+    QVector<Trigram> trigrams = literalTrigrams(data);
+    if (hasUnicodeFolds(data)) {
+        trigrams.append(UnicodeFoldMarker);
+    }
+    return trigrams;
+}
+
+QVector<TrigramIndex::Trigram> TrigramIndex::literalTrigrams(const QByteArray &text)
+{
+    QVector<Trigram> trigrams;
+    if (text.size() < 3) {
+        return trigrams;
+    }
+    trigrams.reserve(text.size() - 2);
+
+    const char *data = text.constData();
+    for (qsizetype i = 0; i + 2 < text.size(); ++i) {
+        uchar b0 = uchar(foldAscii(data[i]));
+        uchar b1 = uchar(foldAscii(data[i + 1]));
+        uchar b2 = uchar(foldAscii(data[i + 2]));
+        if ((b0 | b1 | b2) & 0x80) {
+            continue;
+        }
+        if (b0 == '\n' || b1 == '\n' || b2 == '\n' || b0 == '\r' || b1 == '\r' || b2 == '\r') {
+            continue;
+        }
+        trigrams.append(Trigram(b0) << 16 | Trigram(b1) << 8 | Trigram(b2));
+    }
+
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+void TrigramIndex::addNote(quint32 noteId, const QByteArray &data)
+{
+    addNote(noteId, noteTrigrams(data));
+}
+
+void TrigramIndex::addNote(quint32 noteId, const QVector<Trigram> &trigrams)
+{
+    if (noteId >= quint32(m_noteTrigrams.size())) {
+        m_noteTrigrams.resize(noteId + 1);
+    }
+    QVector<Trigram> &noteTrigrams = m_noteTrigrams[noteId];
+    if (noteTrigrams.isEmpty()) {
+        noteTrigrams = trigrams;
+    } else {
+        noteTrigrams.append(trigrams);
+        std::sort(noteTrigrams.begin(), noteTrigrams.end());
+        noteTrigrams.erase(std::unique(noteTrigrams.begin(), noteTrigrams.end()), noteTrigrams.end());
+    }
+
+    for (Trigram trigram : trigrams) {
+        QVector<quint32> &notes = m_postings[trigram];
+        if (notes.isEmpty() || notes.last() < noteId) {
+            notes.append(noteId); // Common case while building
+        } else {
+            auto pos = std::lower_bound(notes.begin(), notes.end(), noteId);
+            if (pos == notes.end() || *pos != noteId) {
+                notes.insert(pos - notes.begin(), noteId);
+            }
+        }
+    }
+}
+
+void TrigramIndex::removeNotes(const QSet<quint32> &noteIds)
+{
+    if (noteIds.isEmpty()) {
+        return;
+    }
+
+    // Only the lists of the removed notes' own trigrams are touched
+    QSet<Trigram> touched;
+    for (quint32 noteId : noteIds) {
+        if (noteId >= quint32(m_noteTrigrams.size())) {
+            continue;
+        }
+        for (Trigram trigram : std::as_const(m_noteTrigrams[noteId])) {
+            touched.insert(trigram);
+        }
+        m_noteTrigrams[noteId].clear();
+    }
+
+    for (Trigram trigram : touched) {
+        auto it = m_postings.find(trigram);
+        if (it == m_postings.end()) {
+            continue;
+        }
+
+        QVector<quint32> &notes = it.value();
+        if (noteIds.size() > 8) {
+            notes.erase(std::remove_if(notes.begin(), notes.end(),
+                                       [&noteIds](quint32 id) { return noteIds.contains(id); }),
+                        notes.end());
+        } else {
+            for (quint32 id : noteIds) {
+                auto pos = std::lower_bound(notes.begin(), notes.end(), id);
+                if (pos != notes.end() && *pos == id) {
+                    notes.erase(pos);
+                }
+            }
+        }
+
+        if (notes.isEmpty()) {
+            m_postings.erase(it);
+        }
+    }
+}
+
+bool TrigramIndex::candidateNotes(const QString &text, QVector<quint32> *notes) const
+{
+    QVector<QVector<Trigram>> alternatives;
+    alternatives.append(literalTrigrams(text.toUtf8()));
+    return evaluate(alternatives, notes);
+}
+
+bool TrigramIndex::candidateNotes(const QRegularExpression &regex, QVector<quint32> *notes) const
+{
+    if (regex.patternOptions() & QRegularExpression::ExtendedPatternSyntaxOption) {
+        return false;
+    }
+    return evaluate(regexTrigrams(regex.pattern()), notes);
+}
+
+bool TrigramIndex::evaluate(const QVector<QVector<Trigram>> &alternatives, QVector<quint32> *notes) const
+{
+    if (alternatives.isEmpty()) {
+        return false;
+    }
+
+    QVector<quint32> result;
+    for (const auto &required : alternatives) {
+        if (required.isEmpty()) {
+            return false; // This branch could match anywhere
+        }
+
+        // Intersect the shortest lists first
+        QVector<const QVector<quint32> *> lists;
+        bool missing = false;
+        for (Trigram trigram : required) {
+            auto it = m_postings.constFind(trigram);
+            if (it == m_postings.constEnd()) {
+                missing = true;
+                break;
+            }
+            lists.append(&it.value());
+        }
+        if (missing) {
+            continue;
+        }
+
+        std::sort(lists.begin(), lists.end(),
+                  [](const QVector<quint32> *a, const QVector<quint32> *b) { return a->size() < b->size(); });
+
+        QVector<quint32> matching = *lists.first();
+        for (qsizetype i = 1; i < lists.size() && !matching.isEmpty(); ++i) {
+            matching = intersectSorted(matching, *lists.at(i));
+        }
+        result.append(matching);
+    }
+
+    result.append(m_postings.value(UnicodeFoldMarker));
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+
+    *notes = result;
+    return true;
+}
+
+QVector<QVector<TrigramIndex::Trigram>> TrigramIndex::regexTrigrams(const QString &pattern)
+{
+    QVector<QVector<Trigram>> alternatives;
+    if (usesExtendedSyntax(pattern)) {
+        alternatives.append(QVector<Trigram>());
+        return alternatives;
+    }
+
+    QVector<Trigram> required;
+    QByteArray run; // Current run of adjacent literal characters
+
+    auto flushRun = [&]() {
+        required.append(literalTrigrams(run));
+        run.clear();
+    };
+    auto finishAlternative = [&]() {
+        flushRun();
+        std::sort(required.begin(), required.end());
+        required.erase(std::unique(required.begin(), required.end()), required.end());
+        alternatives.append(required);
+        required.clear();
+    };
+    auto appendLiteral = [&](QChar c) {
+        if (c.unicode() < 0x80) {
+            run.append(char(c.unicode()));
+        } else {
+            flushRun(); // Non-ASCII text is not indexed
+        }
+    };
+
+    for (qsizetype i = 0; i < pattern.size(); ++i) {
+        QChar c = pattern.at(i);
+        switch (c.unicode()) {
+        case '|':
+            finishAlternative();
+            break;
+        case '(':
+            // Groups are opaque: they may hold alternations or be optional
+            flushRun();
+            i = skipGroup(pattern, i);
+            break;
+        case '[':
+            flushRun();
+            i = skipClass(pattern, i);
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case '+':
+            // '+' keeps the atom but it may repeat, so adjacency ends here
+            flushRun();
+            break;
+        case '*':
+        case '?':
+            // The preceding atom is optional
+            if (!run.isEmpty()) {
+                run.chop(1);
+            }
+            flushRun();
+            break;
+        case '{': {
+            qsizetype close = pattern.indexOf(QLatin1Char('}'), i);
+            QString bounds = close > i ? pattern.mid(i + 1, close - i - 1) : QString();
+            bool ok = bounds.startsWith(QLatin1Char(','));
+            int minimum = ok ? 0 : bounds.section(QLatin1Char(','), 0, 0).toInt(&ok);
+            if (!ok) {
+                appendLiteral(c); // Not a quantifier
+                break;
+            }
+            if (minimum == 0 && !run.isEmpty()) {
+                run.chop(1);
+            }
+            flushRun();
+            i = close;
+            break;
+        }
+        case '\\': {
+            if (i + 1 >= pattern.size()) {
+                break;
+            }
+            QChar escaped = pattern.at(++i);
+            if (escaped == QLatin1Char('Q')) {
+                // Quoted literal up to \E
+                qsizetype end = pattern.indexOf(QLatin1String("\\E"), i + 1);
+                if (end < 0) {
+                    end = pattern.size();
+                }
+                for (qsizetype j = i + 1; j < end; ++j) {
+                    appendLiteral(pattern.at(j));
+                }
+                i = end + 1;
+            } else if (escaped.isLetterOrNumber()) {
+                flushRun(); // Character class, anchor or back reference
+                i = skipEscapeArgument(pattern, i);
+            } else {
+                appendLiteral(escaped);
+            }
+            break;
+        }
+        default:
+            appendLiteral(c);
+            break;
+        }
+    }
+
+    finishAlternative();
+    return alternatives;
+}
+
+void TrigramIndex::save(QDataStream &out) const
+{
+    out << quint32(m_postings.size());
+    for (auto it = m_postings.cbegin(); it != m_postings.cend(); ++it) {
+        out << it.key() << quint32(it.value().size());
+        for (quint32 noteId : it.value()) {
+            out << noteId;
+        }
+    }
+}
+
+bool TrigramIndex::load(QDataStream &in, quint32 noteCount)
+{
+    clear();
+
+    quint32 count = 0;
+    in >> count;
+
+    for (quint32 t = 0; t < count && in.status() == QDataStream::Ok; ++t) {
+        Trigram trigram = 0;
+        quint32 size = 0;
+        in >> trigram >> size;
+        if (size == 0 || size > noteCount) {
+            clear();
+            return false;
+        }
+
+        QVector<quint32> notes(size);
+        for (quint32 i = 0; i < size; ++i) {
+            in >> notes[i];
+            if (notes[i] >= noteCount || (i > 0 && notes[i] <= notes[i - 1])) {
+                clear();
+                return false;
+            }
+        }
+        m_postings.insert(trigram, notes);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        clear();
+        return false;
+    }
+
+    // The per-note lists are not saved, they follow from the postings
+    m_noteTrigrams.resize(noteCount);
+    for (auto it = m_postings.cbegin(); it != m_postings.cend(); ++it) {
+        for (quint32 noteId : it.value()) {
+            m_noteTrigrams[noteId].append(it.key());
+        }
+    }
+    for (QVector<Trigram> &trigrams : m_noteTrigrams) {
+        std::sort(trigrams.begin(), trigrams.end());
+    }
+    return true;
+}
\ No newline at end of file
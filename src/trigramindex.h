@@ -0,0 +1,56 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QDataStream>
+#include <QRegularExpression>
+
+// Trigram -> notes index used to narrow substring and regex searches.
+//
+// Trigrams are taken from the raw bytes with ASCII letters lowercased; any
+// trigram with a non-ASCII byte or a line break is left out, which is also
+// what queries do, so a note can only be missed if it really lacks the
+// text. Notes with characters that fold to ASCII letters (KELVIN SIGN,
+// LONG S) are always returned as candidates.
+class TrigramIndex
+{
+public:
+    typedef quint32 Trigram; // b0 << 16 | b1 << 8 | b2
+
+    void clear();
+    void addNote(quint32 noteId, const QByteArray &data);
+    // With trigrams from noteTrigrams(), which can run on another thread
+    void addNote(quint32 noteId, const QVector<Trigram> &trigrams);
+    void removeNotes(const QSet<quint32> &noteIds);
+
+    // Sorted ids of the notes that may contain text (case-insensitive), or
+    // false if the text yields no trigrams and every note is a candidate.
+    bool candidateNotes(const QString &text, QVector<quint32> *notes) const;
+    bool candidateNotes(const QRegularExpression &regex, QVector<quint32> *notes) const;
+
+    int trigramCount() const { return m_postings.size(); }
+
+    // What addNote() stores for a note's content
+    static QVector<Trigram> noteTrigrams(const QByteArray &data);
+    // Sorted, distinct trigrams of a literal
+    static QVector<Trigram> literalTrigrams(const QByteArray &text);
+
+    // Trigrams any match of pattern must contain, as alternatives of
+    // required sets. An empty set means that alternative cannot be narrowed.
+    static QVector<QVector<Trigram>> regexTrigrams(const QString &pattern);
+
+    void save(QDataStream &out) const;
+    bool load(QDataStream &in, quint32 noteCount);
+
+private:
+    bool evaluate(const QVector<QVector<Trigram>> &alternatives, QVector<quint32> *notes) const;
+
+    QHash<Trigram, QVector<quint32>> m_postings; // Sorted note ids
+    QVector<QVector<Trigram>> m_noteTrigrams;    // By note id, so removal only visits its lists
+};
+
+#endif // TRIGRAMINDEX_H
\ No newline at end of file
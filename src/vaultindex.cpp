@@ -0,0 +1,526 @@
+#include "vaultindex.h"
+#include "indexpipeline.h"
+#include "linkparser.h"
+#include "vaultwalker.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QMutexLocker>
+#include <QMetaObject>
+#include <QThreadPool>
+#include <utility>
+
+namespace {
+
+// Quiet period after a change before the metadata cache is written
+const int CacheSaveDelayMs = 5000;
+
+void addKey(QHash<QString, QVector<quint32>> &table, const QString &key, quint32 noteId)
+{
+    if (!key.isEmpty()) {
+        table[key].append(noteId);
+    }
+}
+
+void removeKey(QHash<QString, QVector<quint32>> &table, const QString &key, quint32 noteId)
+{
+    auto found = table.find(key);
+    if (found == table.end()) {
+        return;
+    }
+    found->removeOne(noteId);
+    if (found->isEmpty()) {
+        table.erase(found);
+    }
+}
+
+int firstNote(const QHash<QString, QVector<quint32>> &table, const QString &key)
+{
+    auto found = table.constFind(key);
+    return found == table.constEnd() ? -1 : int(found->first());
+}
+
+} // namespace
+
+// Workers deliver here; cleared when the index goes away first
+struct VaultIndex::Receiver {
+    QMutex lock;
+    VaultIndex *index = nullptr;
+
+    void deliver(const QSharedPointer<Catalogue> &catalogue, bool cacheDirty, quint64 serial)
+    {
+        QMutexLocker locker(&lock);
+        if (!index) {
+            return;
+        }
+        VaultIndex *target = index;
+        QMetaObject::invokeMethod(target, [target, catalogue, cacheDirty, serial]() {
+            target->adoptCatalogue(catalogue, cacheDirty, serial);
+        }, Qt::QueuedConnection);
+    }
+};
+
+VaultIndex *VaultIndex::s_instance = nullptr;
+
+VaultIndex::VaultIndex(QObject *parent)
+    : QObject(parent), m_receiver(new Receiver)
+{
+    m_receiver->index = this;
+
+    m_saveTimer.setSingleShot(true);
+    m_saveTimer.setInterval(CacheSaveDelayMs);
+    connect(&m_saveTimer, &QTimer::timeout, this, &VaultIndex::saveCache);
+}
+
+VaultIndex::~VaultIndex()
+{
+    QMutexLocker locker(&m_receiver->lock);
+    m_receiver->index = nullptr;
+}
+
+VaultIndex *VaultIndex::instance()
+{
+    if (!s_instance) {
+        s_instance = new VaultIndex();
+    }
+    return s_instance;
+}
+
+void VaultIndex::setVaultPath(const QString &path)
+{
+    if (m_cacheDirty) {
+        saveCache();
+    }
+    m_vaultPath = path.isEmpty() ? QString() : QDir::cleanPath(QDir(path).absolutePath());
+
+    // The old vault's notes go now, the new ones once they are read
+    if (!m_catalogueVault.isEmpty()) {
+        m_catalogueVault.clear();
+        publish(Catalogue(), false);
+    }
+    rescan();
+}
+
+void VaultIndex::setVaultPathNow(const QString &path)
+{
+    if (m_cacheDirty) {
+        saveCache();
+    }
+    m_vaultPath = path.isEmpty() ? QString() : QDir::cleanPath(QDir(path).absolutePath());
+    rescanNow();
+}
+
+void VaultIndex::rescan()
+{
+    ++m_serial;
+    m_changedDuringScan.clear();
+    if (m_vaultPath.isEmpty()) {
+        m_scanning = false;
+        m_catalogueVault.clear();
+        publish(Catalogue(), false);
+        return;
+    }
+    m_scanning = true;
+
+    const QString vaultPath = m_vaultPath;
+    const quint64 serial = m_serial;
+    QSharedPointer<Receiver> receiver = m_receiver;
+    QThreadPool::globalInstance()->start([vaultPath, serial, receiver]() {
+        bool cacheDirty = false;
+        QSharedPointer<Catalogue> catalogue(new Catalogue(scan(vaultPath, &cacheDirty)));
+        receiver->deliver(catalogue, cacheDirty, serial);
+    });
+}
+
+void VaultIndex::rescanNow()
+{
+    ++m_serial;
+    m_scanning = false;
+    m_changedDuringScan.clear();
+    bool cacheDirty = false;
+    Catalogue catalogue = scan(m_vaultPath, &cacheDirty);
+    m_catalogueVault = m_vaultPath;
+    publish(std::move(catalogue), cacheDirty);
+}
+
+VaultIndex::Catalogue VaultIndex::scan(const QString &vaultPath, bool *cacheDirty)
+{
+    Catalogue catalogue;
+    *cacheDirty = false;
+    if (vaultPath.isEmpty()) {
+        return catalogue;
+    }
+
+    MetadataCache cache(vaultPath);
+    cache.open();
+
+    // A stat per note; only notes that changed since the cache was
+    // written are read, all of them in one batch
+    LinkParser parser;
+    QDir root(vaultPath);
+    VaultWalker walker(vaultPath, VaultWalker::Stat | VaultWalker::Parallel);
+    const QVector<VaultWalker::Entry> files = walker.walk();
+    catalogue.ignore = walker.ignoreMatcher();
+    QVector<MetadataCache::Entry> contents(files.size());
+    QVector<int> stale;
+    QStringList stalePaths;
+    for (int i = 0; i < files.size(); ++i) {
+        const VaultWalker::Entry &file = files[i];
+        if (!cache.find(file.relPath, file.mtime, file.size, &contents[i])) {
+            stale.append(i);
+            stalePaths.append(root.filePath(file.relPath));
+        }
+    }
+    const int cached = files.size() - stale.size();
+
+    // Changed notes are parsed on worker threads; all notes are
+    // inserted here in path order, so ids do not depend on read order
+    MetadataCache::Entry *results = contents.data();   // No detaching on worker threads
+    int inserted = 0;
+    auto insertUpTo = [&](int end) {
+        for (; inserted < end; ++inserted) {
+            catalogue.insertNote(files[inserted].relPath, results[inserted], parser);
+            results[inserted] = MetadataCache::Entry();
+        }
+    };
+    IndexPipeline pipeline(IndexPipeline::InOrder);
+    pipeline.run(stalePaths,
+                 [&](int index, const QByteArray &data, bool ok) {
+                     // The walker's stat came first, so a write since is caught next time
+                     const int i = stale.at(index);
+                     MetadataCache::Entry &content = results[i];
+                     content.mtime = files[i].mtime;
+                     content.size = files[i].size;
+                     if (ok) {
+                         MetadataCache::parseContent(data.constData(), data.size(), &content);
+                     }
+                 },
+                 [&](int index) { insertUpTo(stale.at(index) + 1); });
+    insertUpTo(files.size());
+
+    // Rewrite it if notes changed, appeared or disappeared
+    *cacheDirty = cached != catalogue.noteIds.size() || cached != cache.entryCount();
+    return catalogue;
+}
+
+void VaultIndex::adoptCatalogue(const QSharedPointer<Catalogue> &catalogue, bool cacheDirty, quint64 serial)
+{
+    if (serial != m_serial) {
+        return;
+    }
+
+    m_scanning = false;
+    const QSet<QString> changed = std::exchange(m_changedDuringScan, QSet<QString>());
+    m_catalogueVault = m_vaultPath;
+    publish(std::move(*catalogue), cacheDirty);
+
+    // Files changed while the walk ran may have been seen before or after
+    // the change; read them once more
+    const QDir root(m_vaultPath);
+    for (const QString &relPath : changed) {
+        const QString filePath = root.filePath(relPath);
+        if (QFileInfo(filePath).isFile()) {
+            addNote(filePath);
+        } else {
+            removeNote(filePath);
+        }
+    }
+}
+
+void VaultIndex::publish(Catalogue &&catalogue, bool cacheDirty)
+{
+    m_catalogue = std::move(catalogue);
+    m_saveTimer.stop();
+    m_cacheDirty = cacheDirty;
+
+    emit reset();
+
+    if (m_cacheDirty) {
+        saveCache();
+    }
+}
+
+void VaultIndex::saveCache()
+{
+    m_saveTimer.stop();
+    // Mid-walk the catalogue is about to be replaced, the walk writes it
+    if (m_vaultPath.isEmpty() || m_scanning) {
+        return;
+    }
+
+    QVector<QPair<QString, MetadataCache::Entry>> entries;
+    entries.reserve(noteCount());
+    for (const Note &note : std::as_const(m_catalogue.notes)) {
+        if (!note.path.isEmpty()) {
+            entries.append(qMakePair(note.path, note.content));
+        }
+    }
+
+    // A failed write only costs the next start some reading
+    MetadataCache cache(m_vaultPath);
+    if (cache.save(entries)) {
+        m_cacheDirty = false;
+    }
+}
+
+void VaultIndex::addNote(const QString &filePath)
+{
+    const QString relPath = relativePath(filePath);
+    if (relPath.isEmpty() || !isNoteFile(relPath)) {
+        return;
+    }
+    noteChangedDuringScan(relPath);
+    if (isIgnored(relPath)) {
+        removeNote(filePath);
+        return;
+    }
+
+    MetadataCache::Entry content;
+    MetadataCache::readEntry(QDir(m_vaultPath).filePath(relPath), &content);
+    cacheChanged();
+
+    auto found = m_catalogue.noteIds.constFind(relPath);
+    if (found != m_catalogue.noteIds.constEnd()) {
+        Note &note = m_catalogue.notes[*found];
+        if (note.content.hash == content.hash && note.content.size == content.size) {
+            // Saved without changes, only the timestamp moved
+            note.content.mtime = content.mtime;
+            return;
+        }
+
+        m_catalogue.updateKeys(*found, false);
+        note.content = content;
+        m_catalogue.updateKeys(*found, true);
+        emit noteChanged(*found);
+        return;
+    }
+
+    LinkParser parser;
+    emit noteAdded(m_catalogue.insertNote(relPath, content, parser));
+}
+
+void VaultIndex::removeNote(const QString &filePath)
+{
+    const QString relPath = relativePath(filePath);
+    noteChangedDuringScan(relPath);
+    auto found = m_catalogue.noteIds.find(relPath);
+    if (found == m_catalogue.noteIds.end()) {
+        return;
+    }
+
+    const quint32 noteId = *found;
+    m_catalogue.noteIds.erase(found);
+    m_catalogue.updateKeys(noteId, false);
+    m_catalogue.notes[noteId] = Note();
+    m_catalogue.freeIds.append(noteId);
+    cacheChanged();
+
+    emit noteRemoved(noteId, relPath);
+}
+
+void VaultIndex::renameNote(const QString &oldPath, const QString &newPath)
+{
+    const QString oldRelPath = relativePath(oldPath);
+    const QString newRelPath = relativePath(newPath);
+    noteChangedDuringScan(oldRelPath);
+    noteChangedDuringScan(newRelPath);
+    auto found = m_catalogue.noteIds.constFind(oldRelPath);
+    if (found == m_catalogue.noteIds.constEnd()) {
+        addNote(newPath);
+        return;
+    }
+    if (newRelPath.isEmpty() || !isNoteFile(newRelPath) || isIgnored(newRelPath)) {
+        removeNote(oldPath);
+        return;
+    }
+
+    const quint32 noteId = *found;
+    m_catalogue.noteIds.remove(oldRelPath);
+    m_catalogue.noteIds.insert(newRelPath, noteId);
+    m_catalogue.updateKeys(noteId, false);
+
+    // The content moved along, only the name-derived fields change
+    LinkParser parser;
+    Note &note = m_catalogue.notes[noteId];
+    note.path = newRelPath;
+    describeNote(note, parser);
+    m_catalogue.updateKeys(noteId, true);
+    cacheChanged();
+
+    emit noteRenamed(noteId, oldRelPath);
+}
+
+int VaultIndex::noteId(const QString &filePath) const
+{
+    return m_catalogue.noteIds.value(relativePath(filePath), -1);
+}
+
+QString VaultIndex::absolutePath(quint32 noteId) const
+{
+    if (!isLive(noteId)) {
+        return QString();
+    }
+    return QDir(m_vaultPath).filePath(m_catalogue.notes[noteId].path);
+}
+
+int VaultIndex::findById(const QString &zettelId) const
+{
+    return firstNote(m_catalogue.byZettelId, zettelId.trimmed());
+}
+
+int VaultIndex::findByTitle(const QString &title) const
+{
+    const QString key = LinkParser::normalizeTitle(title);
+    int noteId = firstNote(m_catalogue.byName, key);
+    return noteId >= 0 ? noteId : firstNote(m_catalogue.byHeader, key);
+}
+
+int VaultIndex::resolveLink(const QString &linkText) const
+{
+    int noteId = findById(linkText);
+    return noteId >= 0 ? noteId : findByTitle(linkText);
+}
+
+QStringList VaultIndex::linkKeys(quint32 noteId) const
+{
+    QStringList result;
+    if (!isLive(noteId)) {
+        return result;
+    }
+
+    const Keys keys = keysOf(m_catalogue.notes[noteId]);
+    for (const QString &key : {keys.fileNameId, keys.headerId, keys.name, keys.header}) {
+        if (!key.isEmpty() && !result.contains(key)) {
+            result.append(key);
+        }
+    }
+    return result;
+}
+
+bool VaultIndex::covers(const QString &workspacePath) const
+{
+    return !m_catalogueVault.isEmpty() && !workspacePath.isEmpty()
+           && QDir::cleanPath(QDir(workspacePath).absolutePath()) == m_catalogueVault;
+}
+
+bool VaultIndex::isNoteFile(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "md" || suffix == "markdown" || suffix == "txt";
+}
+
+QStringList VaultIndex::noteNameFilters()
+{
+    return QStringList() << "*.md" << "*.markdown" << "*.txt";
+}
+
+QString VaultIndex::pathWithoutSuffix(const QString &path)
+{
+    const int dot = path.lastIndexOf(QLatin1Char('.'));
+    const int slash = path.lastIndexOf(QLatin1Char('/'));
+    return dot > slash ? path.left(dot) : path;
+}
+
+QString VaultIndex::relativePath(const QString &filePath) const
+{
+    if (m_vaultPath.isEmpty()) {
+        return QString();
+    }
+    if (QDir::isRelativePath(filePath)) {
+        return QDir::cleanPath(filePath);
+    }
+
+    const QString relPath = QDir(m_vaultPath).relativeFilePath(filePath);
+    if (relPath.startsWith("../") || relPath == "..") {
+        return QString();   // Outside the vault
+    }
+    return relPath;
+}
+
+quint32 VaultIndex::Catalogue::insertNote(const QString &relPath, const MetadataCache::Entry &content,
+                                           LinkParser &parser)
+{
+    quint32 noteId;
+    if (!freeIds.isEmpty()) {
+        noteId = freeIds.takeLast();
+    } else {
+        noteId = notes.size();
+        notes.append(Note());
+    }
+
+    Note &note = notes[noteId];
+    note.path = relPath;
+    describeNote(note, parser);
+    note.content = content;
+    noteIds.insert(relPath, noteId);
+    updateKeys(noteId, true);
+    return noteId;
+}
+
+void VaultIndex::describeNote(Note &note, LinkParser &parser)
+{
+    // "1a2 Some_title.md" is titled "Some title", other notes by file name
+    const QString baseName = QFileInfo(note.path).completeBaseName();
+    const ZettelId zettel = parser.parseZettelId(baseName);
+    note.zettelId = zettel.isValid ? zettel.id : QString();
+    note.title = zettel.isValid && !zettel.title.isEmpty() ? zettel.title : baseName;
+    note.title.replace(QLatin1Char('_'), QLatin1Char(' '));
+}
+
+void VaultIndex::noteChangedDuringScan(const QString &relPath)
+{
+    if (m_scanning && !relPath.isEmpty()) {
+        m_changedDuringScan.insert(relPath);
+    }
+}
+
+void VaultIndex::cacheChanged()
+{
+    m_cacheDirty = true;
+    m_saveTimer.start();
+}
+
+VaultIndex::Keys VaultIndex::keysOf(const Note &note)
+{
+    Keys keys;
+    const QString baseName = QFileInfo(note.path).completeBaseName();
+
+    // "1a2.md" and "1a2 Title.md" answer to [[1a2]], "2024-05-01.md" does not
+    if (!note.zettelId.isEmpty()
+        && (baseName == note.zettelId || baseName.startsWith(note.zettelId + QLatin1Char(' ')))) {
+        keys.fileNameId = note.zettelId;
+    }
+    if (note.content.headerZettelId != keys.fileNameId) {
+        keys.headerId = note.content.headerZettelId;
+    }
+
+    keys.name = LinkParser::normalizeTitle(baseName);
+    if (!note.content.headerTitle.isEmpty()) {
+        keys.header = LinkParser::normalizeTitle(note.content.headerTitle);
+    }
+    return keys;
+}
+
+void VaultIndex::Catalogue::updateKeys(quint32 noteId, bool add)
+{
+    const Keys keys = keysOf(notes[noteId]);
+
+    auto apply = add ? addKey : removeKey;
+    apply(byZettelId, keys.fileNameId, noteId);
+    apply(byZettelId, keys.headerId, noteId);
+    apply(byName, keys.name, noteId);
+    apply(byHeader, keys.header, noteId);
+
+    // Numbering skips the leading id of every file name ("3-Foo.md" holds
+    // 3) even where links don't resolve by it
+    for (const QString &zettelId : {notes[noteId].zettelId, keys.headerId}) {
+        if (zettelId.isEmpty()) {
+            continue;
+        }
+        if (add) {
+            zettelIds.insert(zettelId);
+        } else {
+            zettelIds.remove(zettelId);
+        }
+    }
+}
\ No newline at end of file
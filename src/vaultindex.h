@@ -0,0 +1,167 @@
+#ifndef VAULTINDEX_H
+#define VAULTINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+#include <QTimer>
+#include "metadatacache.h"
+#include "vaultwalker.h"
+#include "zettelidindex.h"
+
+class LinkParser;
+
+// In-memory catalogue of the notes of a vault.
+//
+// Every note gets a small id that stays the same while the note exists
+// (renames keep it), so other indexes can keep plain arrays keyed by it.
+// The catalogue is built by one walk of the vault, on a worker thread, and
+// then kept current through addNote, removeNote and renameNote as files
+// change. A rescan keeps the previous catalogue until the walk is done; a
+// new vault starts empty, and covers() denies it until then. Hash tables
+// from zettel ids and titles to notes resolve [[links]] without touching
+// the disk. What each note's content says (header, headings, links) is
+// kept in the vault's metadata cache, so a walk only reads notes whose
+// modification time or size changed since the last session.
+class VaultIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Note {
+        QString path;        // Relative to the vault root, empty if the id is free
+        QString title;       // Zettel title or file name, '_' shown as spaces
+        QString zettelId;    // From the file name
+        MetadataCache::Entry content;   // From the file itself
+    };
+
+    explicit VaultIndex(QObject *parent = nullptr);
+    ~VaultIndex() override;
+
+    // The index of the vault open in the application
+    static VaultIndex *instance();
+
+    // Switch vaults; the catalogue is empty until the walk of the new one
+    // is done, in the background, or before returning
+    void setVaultPath(const QString &path);
+    void setVaultPathNow(const QString &path);
+    QString vaultPath() const { return m_vaultPath; }
+
+    // Walk the vault again, rereading notes the cache does not vouch for;
+    // reset() is emitted when the new catalogue replaces the old one
+    void rescan();
+    void rescanNow();
+    bool isScanning() const { return m_scanning; }
+    // Write the metadata cache now instead of after the next quiet period
+    void saveCache();
+
+    // Keep the catalogue in sync with a file operation; paths are absolute.
+    // addNote also covers notes that changed on disk.
+    void addNote(const QString &filePath);
+    void removeNote(const QString &filePath);
+    void renameNote(const QString &oldPath, const QString &newPath);
+
+    int noteCount() const { return m_catalogue.noteIds.size(); }
+    // Upper bound of the note ids, including free ones
+    int idCount() const { return m_catalogue.notes.size(); }
+    const Note &note(quint32 noteId) const { return m_catalogue.notes.at(noteId); }
+    bool isLive(quint32 noteId) const
+    {
+        return noteId < quint32(m_catalogue.notes.size()) && !m_catalogue.notes[noteId].path.isEmpty();
+    }
+
+    // Id of the note at filePath (absolute or relative), -1 if unknown
+    int noteId(const QString &filePath) const;
+    QString absolutePath(quint32 noteId) const;
+
+    // Link resolution; -1 if no note matches
+    int findById(const QString &zettelId) const;
+    int findByTitle(const QString &title) const;        // File name, then "# Header"
+    int resolveLink(const QString &linkText) const;     // Zettel id, then title
+
+    // Normalized link texts that may resolve to the note (ids and titles)
+    QStringList linkKeys(quint32 noteId) const;
+
+    // Zettel ids in use, for numbering new notes
+    const ZettelIdIndex &zettelIds() const { return m_catalogue.zettelIds; }
+
+    // Whether walks leave the note at relPath out (.formicaignore, hidden
+    // folders); notes are checked against it however they come in
+    bool isIgnored(const QString &relPath) const { return m_catalogue.ignore.isIgnored(relPath); }
+
+    // Whether this index describes the vault at workspacePath; not before
+    // its first walk is done, callers go to the disk meanwhile
+    bool covers(const QString &workspacePath) const;
+
+    static bool isNoteFile(const QString &filePath);
+    static QStringList noteNameFilters();
+    // "notes/1a2 Some_title.md" -> "notes/1a2 Some_title", what users type to find it
+    static QString pathWithoutSuffix(const QString &path);
+
+signals:
+    // The whole catalogue was replaced (vault switch or finished walk)
+    void reset();
+    void noteAdded(quint32 noteId);
+    void noteChanged(quint32 noteId);
+    void noteRenamed(quint32 noteId, const QString &oldPath);
+    // The note record is already gone when this is emitted
+    void noteRemoved(quint32 noteId, const QString &oldPath);
+
+private:
+    struct Keys {
+        QString fileNameId;
+        QString headerId;
+        QString name;
+        QString header;
+    };
+
+    // Everything a walk produces; built on a worker and swapped in whole
+    struct Catalogue {
+        QVector<Note> notes;                // Indexed by note id
+        QHash<QString, quint32> noteIds;    // Relative path -> note id
+        QVector<quint32> freeIds;
+
+        // Lookup keys -> notes, in the order the notes were added
+        QHash<QString, QVector<quint32>> byZettelId;    // From the file name or first line
+        QHash<QString, QVector<quint32>> byName;        // Normalized file base name
+        QHash<QString, QVector<quint32>> byHeader;      // Normalized "# Header" title
+        ZettelIdIndex zettelIds;
+        VaultWalker::IgnoreMatcher ignore;  // The rules of the walk
+
+        quint32 insertNote(const QString &relPath, const MetadataCache::Entry &content, LinkParser &parser);
+        void updateKeys(quint32 noteId, bool add);
+    };
+
+    struct Receiver;
+
+    // Runs on any thread; cacheDirty tells whether the metadata cache
+    // needs rewriting
+    static Catalogue scan(const QString &vaultPath, bool *cacheDirty);
+    void adoptCatalogue(const QSharedPointer<Catalogue> &catalogue, bool cacheDirty, quint64 serial);
+    void publish(Catalogue &&catalogue, bool cacheDirty);
+    QString relativePath(const QString &filePath) const;
+    void noteChangedDuringScan(const QString &relPath);
+    void cacheChanged();
+    static void describeNote(Note &note, LinkParser &parser);
+    static Keys keysOf(const Note &note);
+
+    QString m_vaultPath;
+    Catalogue m_catalogue;
+    QString m_catalogueVault;   // The vault m_catalogue was walked in, empty before that
+
+    quint64 m_serial = 0;       // Bumped by every walk, older results are dropped
+    bool m_scanning = false;
+    QSet<QString> m_changedDuringScan;  // Relative paths the walk may have missed
+    QSharedPointer<Receiver> m_receiver;
+
+    bool m_cacheDirty = false;
+    QTimer m_saveTimer;         // Batches cache writes while notes change
+
+    static VaultIndex *s_instance;
+};
+
+#endif // VAULTINDEX_H
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "vaulttreemodel.h"
+#include "vaultindex.h"
+#include <QDir>
+#include <QFileIconProvider>
+#include <algorithm>
+
+namespace {
+
+const QIcon &icon(QFileIconProvider::IconType type)
+{
+    static QFileIconProvider provider;
+    static const QIcon folderIcon = provider.icon(QFileIconProvider::Folder);
+    static const QIcon fileIcon = provider.icon(QFileIconProvider::File);
+    return type == QFileIconProvider::Folder ? folderIcon : fileIcon;
+}
+
+QString parentPath(const QString &relPath)
+{
+    const int slash = relPath.lastIndexOf(QLatin1Char('/'));
+    return slash < 0 ? QString() : relPath.left(slash);
+}
+
+QString fileName(const QString &relPath)
+{
+    return relPath.mid(relPath.lastIndexOf(QLatin1Char('/')) + 1);
+}
+
+} // namespace
+
+VaultTreeModel::VaultTreeModel(VaultIndex *index, QObject *parent)
+    : QAbstractItemModel(parent), m_index(index)
+{
+    connect(m_index, &VaultIndex::reset, this, &VaultTreeModel::rebuild);
+    connect(m_index, &VaultIndex::noteAdded, this, &VaultTreeModel::onNoteAdded);
+    connect(m_index, &VaultIndex::noteRenamed, this, &VaultTreeModel::onNoteRenamed);
+    connect(m_index, &VaultIndex::noteRemoved, this, &VaultTreeModel::onNoteRemoved);
+    rebuild();
+}
+
+VaultTreeModel::~VaultTreeModel()
+{
+    delete m_root;
+}
+
+QModelIndex VaultTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent)) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, nodeOf(parent)->children.at(row));
+}
+
+QModelIndex VaultTreeModel::parent(const QModelIndex &child) const
+{
+    if (!child.isValid()) {
+        return QModelIndex();
+    }
+    return indexOfNode(nodeOf(child)->parent);
+}
+
+int VaultTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return 0;
+    }
+    return nodeOf(parent)->fetched;
+}
+
+int VaultTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 1;
+}
+
+bool VaultTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    // Answered without fetching, so folders get their expand arrow
+    const Node *node = nodeOf(parent);
+    return node->noteId < 0 && !node->children.isEmpty();
+}
+
+bool VaultTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    const Node *node = nodeOf(parent);
+    return node->fetched < node->children.size();
+}
+
+void VaultTreeModel::fetchMore(const QModelIndex &parent)
+{
+    Node *node = nodeOf(parent);
+    sortChildren(node);
+
+    const int count = qMin(FetchBatch, int(node->children.size()) - node->fetched);
+    if (count <= 0) {
+        return;
+    }
+    beginInsertRows(parent, node->fetched, node->fetched + count - 1);
+    node->fetched += count;
+    endInsertRows();
+}
+
+QVariant VaultTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    const Node *node = nodeOf(index);
+    switch (role) {
+    case Qt::DisplayRole:
+        return node->name;
+    case Qt::DecorationRole:
+        return icon(node->noteId < 0 ? QFileIconProvider::Folder : QFileIconProvider::File);
+    case Qt::ToolTipRole:
+        return relativePath(node);
+    case FilePathRole:
+        return QDir(m_index->vaultPath()).filePath(relativePath(node));
+    case NoteIdRole:
+        return node->noteId;
+    default:
+        return QVariant();
+    }
+}
+
+bool VaultTreeModel::isDir(const QModelIndex &index) const
+{
+    return nodeOf(index)->noteId < 0;
+}
+
+QString VaultTreeModel::filePath(const QModelIndex &index) const
+{
+    return QDir(m_index->vaultPath()).filePath(relativePath(nodeOf(index)));
+}
+
+QModelIndex VaultTreeModel::indexOf(const QString &filePath)
+{
+    const QString relPath = QDir::cleanPath(QDir(m_index->vaultPath()).relativeFilePath(filePath));
+    if (relPath == QLatin1String("..") || relPath.startsWith(QLatin1String("../"))) {
+        return QModelIndex();
+    }
+
+    const int noteId = m_index->noteId(relPath);
+    Node *node = noteId >= 0 ? m_notes.value(noteId) : m_folders.value(relPath == "." ? QString() : relPath);
+    if (!node) {
+        return QModelIndex();
+    }
+    reveal(node);
+    return indexOfNode(node);
+}
+
+void VaultTreeModel::fetchAll()
+{
+    fetchTree(m_root);
+}
+
+void VaultTreeModel::setFilter(const QString &text)
+{
+    if (text == m_filter) {
+        return;
+    }
+    m_filter = text;
+    rebuild();
+}
+
+void VaultTreeModel::rebuild()
+{
+    beginResetModel();
+    delete m_root;
+    m_root = new Node;
+    m_folders.clear();
+    m_folders.insert(QString(), m_root);
+    m_notes.fill(nullptr, m_index->idCount());
+    m_noteCount = 0;
+
+    // Nothing is sorted yet; folders are sorted as views open them
+    for (int noteId = 0; noteId < m_index->idCount(); ++noteId) {
+        if (m_index->isLive(noteId)) {
+            addNote(noteId);
+        }
+    }
+    endResetModel();
+}
+
+void VaultTreeModel::onNoteAdded(quint32 noteId)
+{
+    addNote(noteId);
+}
+
+void VaultTreeModel::onNoteRenamed(quint32 noteId, const QString &oldPath)
+{
+    Q_UNUSED(oldPath);
+
+    // Remove and insert: the new name may sort elsewhere or in another folder
+    onNoteRemoved(noteId);
+    addNote(noteId);
+}
+
+void VaultTreeModel::onNoteRemoved(quint32 noteId)
+{
+    Node *node = m_notes.value(noteId);
+    if (!node) {
+        return;
+    }
+    m_notes[noteId] = nullptr;
+    --m_noteCount;
+    removeNode(node);
+}
+
+bool VaultTreeModel::lessThan(const Node *a, const Node *b)
+{
+    const bool aIsDir = a->noteId < 0;
+    const bool bIsDir = b->noteId < 0;
+    if (aIsDir != bIsDir) {
+        return aIsDir;
+    }
+    const int order = a->name.compare(b->name, Qt::CaseInsensitive);
+    return order != 0 ? order < 0 : a->name < b->name;
+}
+
+VaultTreeModel::Node *VaultTreeModel::nodeOf(const QModelIndex &index) const
+{
+    return index.isValid() ? static_cast<Node *>(index.internalPointer()) : m_root;
+}
+
+QModelIndex VaultTreeModel::indexOfNode(Node *node) const
+{
+    if (!node || node == m_root) {
+        return QModelIndex();
+    }
+    return createIndex(rowOf(node), 0, node);
+}
+
+int VaultTreeModel::rowOf(const Node *node) const
+{
+    const QVector<Node *> &siblings = node->parent->children;
+    if (!node->parent->sorted) {
+        return siblings.indexOf(const_cast<Node *>(node));
+    }
+    return std::lower_bound(siblings.cbegin(), siblings.cend(), node, lessThan) - siblings.cbegin();
+}
+
+QString VaultTreeModel::relativePath(const Node *node) const
+{
+    QString path = node->name;
+    for (const Node *parent = node->parent; parent && parent != m_root; parent = parent->parent) {
+        path.prepend(parent->name + QLatin1Char('/'));
+    }
+    return path;
+}
+
+bool VaultTreeModel::matches(const QString &relPath) const
+{
+    return m_filter.isEmpty() || fileName(relPath).contains(m_filter, Qt::CaseInsensitive);
+}
+
+void VaultTreeModel::addNote(quint32 noteId)
+{
+    const QString &relPath = m_index->note(noteId).path;
+    if (!matches(relPath)) {
+        return;
+    }
+    if (int(noteId) >= m_notes.size()) {
+        m_notes.resize(noteId + 1);
+    }
+    if (m_notes[noteId]) {
+        return;
+    }
+
+    auto *node = new Node;
+    node->name = fileName(relPath);
+    node->noteId = noteId;
+    m_notes[noteId] = node;
+    ++m_noteCount;
+
+    // Missing folders are built bottom-up and attached last, so views never
+    // see a folder without its note
+    Node *child = node;
+    QString relDir = parentPath(relPath);
+    Node *parent = m_folders.value(relDir);
+    while (!parent) {
+        auto *dir = new Node;
+        dir->name = fileName(relDir);
+        child->parent = dir;
+        dir->children.append(child);
+        m_folders.insert(relDir, dir);
+        child = dir;
+        relDir = parentPath(relDir);
+        parent = m_folders.value(relDir);
+    }
+    insertChild(parent, child);
+}
+
+void VaultTreeModel::insertChild(Node *parent, Node *child)
+{
+    child->parent = parent;
+    if (!parent->sorted) {
+        parent->children.append(child);     // No view has seen these rows yet
+        return;
+    }
+
+    const auto pos = std::lower_bound(parent->children.cbegin(), parent->children.cend(), child, lessThan);
+    const int row = pos - parent->children.cbegin();
+
+    // Rows past the fetched ones stay hidden until the next fetchMore
+    const bool visible = row < parent->fetched || parent->fetched == parent->children.size();
+    if (visible) {
+        beginInsertRows(indexOfNode(parent), row, row);
+    }
+    parent->children.insert(row, child);
+    if (visible) {
+        ++parent->fetched;
+        endInsertRows();
+    }
+}
+
+void VaultTreeModel::removeNode(Node *node)
+{
+    Node *parent = node->parent;
+    const int row = rowOf(node);
+    const bool visible = row < parent->fetched;
+    if (visible) {
+        beginRemoveRows(indexOfNode(parent), row, row);
+    }
+    parent->children.remove(row);
+    if (visible) {
+        --parent->fetched;
+        endRemoveRows();
+    }
+
+    if (node->noteId < 0) {
+        m_folders.remove(relativePath(node));
+    }
+    delete node;
+
+    // Folders only exist while they hold notes
+    if (parent != m_root && parent->children.isEmpty()) {
+        removeNode(parent);
+    }
+}
+
+void VaultTreeModel::sortChildren(Node *node)
+{
+    if (!node->sorted) {
+        std::sort(node->children.begin(), node->children.end(), lessThan);
+        node->sorted = true;
+    }
+}
+
+void VaultTreeModel::reveal(Node *node)
+{
+    if (node == m_root) {
+        return;
+    }
+    Node *parent = node->parent;
+    reveal(parent);
+    sortChildren(parent);
+    while (rowOf(node) >= parent->fetched) {
+        fetchMore(indexOfNode(parent));
+    }
+}
+
+void VaultTreeModel::fetchTree(Node *node)
+{
+    while (node->fetched < node->children.size()) {
+        fetchMore(indexOfNode(node));
+    }
+    for (Node *child : std::as_const(node->children)) {
+        if (child->noteId < 0) {
+            fetchTree(child);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#ifndef VAULTTREEMODEL_H
+#define VAULTTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class VaultIndex;
+
+// Folder tree of the notes of the open vault, for the file browser.
+//
+// Built from the vault index rather than the file system: no directory is
+// listed or watched, and only notes and the folders holding them appear.
+// Views get a folder's rows when they expand it (canFetchMore/fetchMore),
+// FetchBatch at a time, and a folder is only sorted the first time it is
+// opened. Notes added, renamed or removed in the index become single row
+// inserts and removals, so expanded folders and scroll positions survive.
+class VaultTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles {
+        FilePathRole = Qt::UserRole,    // Absolute path
+        NoteIdRole                      // -1 for folders
+    };
+
+    explicit VaultTreeModel(VaultIndex *index, QObject *parent = nullptr);
+    ~VaultTreeModel() override;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    bool isDir(const QModelIndex &index) const;
+    QString filePath(const QModelIndex &index) const;
+
+    // Index of the note or folder at filePath, fetching the folders above
+    // it as needed; invalid if the tree does not show it
+    QModelIndex indexOf(const QString &filePath);
+    // Fetch every folder, for views that expand all of a small tree
+    void fetchAll();
+
+    // Show only notes whose file name contains text (case-insensitive)
+    void setFilter(const QString &text);
+    QString filter() const { return m_filter; }
+    // Notes in the tree, after filtering
+    int noteCount() const { return m_noteCount; }
+
+    static const int FetchBatch = 500;
+
+private slots:
+    void rebuild();
+    void onNoteAdded(quint32 noteId);
+    void onNoteRenamed(quint32 noteId, const QString &oldPath);
+    void onNoteRemoved(quint32 noteId);
+
+private:
+    struct Node {
+        ~Node() { qDeleteAll(children); }
+
+        QString name;
+        Node *parent = nullptr;
+        int noteId = -1;                // -1 for folders
+        QVector<Node *> children;       // Folders first, then by name once sorted
+        int fetched = 0;                // Leading children the views know about
+        bool sorted = false;            // Also: views have seen this folder's rows
+    };
+
+    static bool lessThan(const Node *a, const Node *b);
+
+    Node *nodeOf(const QModelIndex &index) const;
+    QModelIndex indexOfNode(Node *node) const;
+    int rowOf(const Node *node) const;
+    QString relativePath(const Node *node) const;
+    bool matches(const QString &relPath) const;
+
+    void addNote(quint32 noteId);
+    void insertChild(Node *parent, Node *child);
+    void removeNode(Node *node);
+    void sortChildren(Node *node);
+    void reveal(Node *node);
+    void fetchTree(Node *node);
+
+    VaultIndex *m_index;
+    Node *m_root = nullptr;
+    QHash<QString, Node *> m_folders;   // Relative folder path -> node, "" for the root
+    QVector<Node *> m_notes;            // Note id -> node, null if not shown
+    QString m_filter;
+    int m_noteCount = 0;
+};
+
+#endif // VAULTTREEMODEL_H
\ No newline at end of file
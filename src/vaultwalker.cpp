@@ -0,0 +1,417 @@
+#include "vaultwalker.h"
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <memory>
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <QDirIterator>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+const char IgnoreFileName[] = ".formicaignore";
+
+#ifdef Q_OS_UNIX
+
+// Open while tasks for its subdirectories still need it for openat()
+struct DirHandle {
+    explicit DirHandle(int fd) : fd(fd) {}
+    ~DirHandle() { ::close(fd); }
+    DirHandle(const DirHandle &) = delete;
+    DirHandle &operator=(const DirHandle &) = delete;
+
+    int fd;
+};
+
+struct Task {
+    QSharedPointer<DirHandle> parent;   // Null for the root
+    QByteArray name;                    // Relative to parent, the root path for the root
+    QString relDir;                     // Empty for the root, else "a/b/"
+};
+
+qint64 modificationTime(const struct stat &st)
+{
+    // Milliseconds the way QFileInfo::lastModified() counts them
+#ifdef Q_OS_DARWIN
+    return qint64(st.st_mtimespec.tv_sec) * 1000 + st.st_mtimespec.tv_nsec / 1000000;
+#else
+    return qint64(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+#endif
+}
+
+// Calls fn(name, length, type) for every entry of the open directory fd
+template <typename Fn>
+bool listEntries(int fd, Fn fn)
+{
+#ifdef Q_OS_LINUX
+    // No libc wrapper before glibc 2.30; the layout is the kernel's
+    struct LinuxDirent64 {
+        quint64 d_ino;
+        qint64 d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+
+    alignas(LinuxDirent64) char buffer[32 * 1024];
+    for (;;) {
+        const long length = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            return length == 0;
+        }
+        for (long pos = 0; pos < length;) {
+            const auto *entry = reinterpret_cast<const LinuxDirent64 *>(buffer + pos);
+            pos += entry->d_reclen;
+            fn(entry->d_name, std::strlen(entry->d_name), entry->d_type);
+        }
+    }
+#else
+    // fdopendir() takes over the descriptor, openat() still needs ours
+    const int listFd = ::dup(fd);
+    DIR *dir = listFd >= 0 ? ::fdopendir(listFd) : nullptr;
+    if (!dir) {
+        if (listFd >= 0) {
+            ::close(listFd);
+        }
+        return false;
+    }
+    while (const dirent *entry = ::readdir(dir)) {
+        fn(entry->d_name, std::strlen(entry->d_name), entry->d_type);
+    }
+    ::closedir(dir);
+    return true;
+#endif
+}
+
+#endif // Q_OS_UNIX
+
+} // namespace
+
+#ifdef Q_OS_UNIX
+
+// Each worker takes the newest directory from its own queue, depth first,
+// and when that is empty steals the oldest one of another worker, whose
+// subtree is likely the largest left.
+struct VaultWalker::State {
+    struct Worker {
+        QMutex lock;
+        std::deque<Task> tasks;
+        QVector<Entry> entries;     // Only touched by the worker itself
+        int directories = 0;
+        int errors = 0;
+    };
+
+    void work(int index);
+    bool take(int index, Task *task);
+    void push(int index, Task task);
+    void list(int index, Task task);
+    bool hasSuffix(const char *name, size_t length) const;
+
+    QVector<QByteArray> suffixes;       // ".md", lower case
+    IgnoreMatcher ignore;
+    bool wantStat = false;
+    std::unique_ptr<Worker[]> workers;
+    int workerCount = 1;
+    std::atomic<int> pending{0};        // Directories queued or being listed
+};
+
+void VaultWalker::State::work(int index)
+{
+    int idle = 0;
+    Task task;
+    while (pending > 0) {
+        if (!take(index, &task)) {
+            // Others are still listing and may queue more
+            if (++idle < 64) {
+                QThread::yieldCurrentThread();
+            } else {
+                QThread::usleep(200);
+            }
+            continue;
+        }
+        idle = 0;
+        list(index, std::move(task));
+        task = Task();
+        --pending;
+    }
+}
+
+bool VaultWalker::State::take(int index, Task *task)
+{
+    {
+        Worker &own = workers[index];
+        QMutexLocker locker(&own.lock);
+        if (!own.tasks.empty()) {
+            *task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (int i = 1; i < workerCount; ++i) {
+        Worker &other = workers[(index + i) % workerCount];
+        QMutexLocker locker(&other.lock);
+        if (!other.tasks.empty()) {
+            *task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void VaultWalker::State::push(int index, Task task)
+{
+    // Counted before it is visible, so pending never drops to 0 early
+    ++pending;
+    Worker &own = workers[index];
+    QMutexLocker locker(&own.lock);
+    own.tasks.push_back(std::move(task));
+}
+
+void VaultWalker::State::list(int index, Task task)
+{
+    Worker &worker = workers[index];
+    const int fd = task.parent
+        ? ::openat(task.parent->fd, task.name.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW)
+        : ::open(task.name.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    task.parent.reset();
+    if (fd < 0) {
+        ++worker.errors;
+        return;
+    }
+    const auto dir = QSharedPointer<DirHandle>::create(fd);
+    ++worker.directories;
+
+    const bool ok = listEntries(fd, [&](const char *name, size_t length, unsigned char type) {
+        if (name[0] == '.') {
+            return;     // ".", ".." and hidden entries
+        }
+
+        struct stat st;
+        bool haveStat = false;
+        if (type == DT_UNKNOWN) {
+            // Some file systems leave the type out of the listing
+            if (::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                return;
+            }
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+            haveStat = type == DT_REG;
+        }
+
+        if (type == DT_DIR) {
+            const QByteArray dirName(name, int(length));
+            const QString fileName = QFile::decodeName(dirName);
+            const QString relDir = task.relDir + fileName;
+            if (ignore.isEmpty() || !ignore.matches(fileName, relDir, true)) {
+                push(index, Task{dir, dirName, relDir + QLatin1Char('/')});
+            }
+            return;
+        }
+        if (!hasSuffix(name, length)) {
+            return;
+        }
+        if (type == DT_LNK) {
+            // Links to notes count, links to folders are not followed
+            if (::fstatat(fd, name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+                return;
+            }
+            haveStat = true;
+        } else if (type != DT_REG) {
+            return;
+        }
+
+        const QString fileName = QFile::decodeName(QByteArray::fromRawData(name, int(length)));
+        Entry entry;
+        entry.relPath = task.relDir + fileName;
+        if (!ignore.isEmpty() && ignore.matches(fileName, entry.relPath, false)) {
+            return;
+        }
+        if (wantStat && (haveStat || ::fstatat(fd, name, &st, 0) == 0)) {
+            entry.mtime = modificationTime(st);
+            entry.size = st.st_size;
+        }
+        worker.entries.append(entry);
+    });
+    if (!ok) {
+        ++worker.errors;
+    }
+}
+
+bool VaultWalker::State::hasSuffix(const char *name, size_t length) const
+{
+    for (const QByteArray &suffix : suffixes) {
+        const size_t suffixLength = suffix.size();
+        if (length > suffixLength
+            && qstrnicmp(name + length - suffixLength, suffix.constData(), suffixLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif // Q_OS_UNIX
+
+VaultWalker::IgnoreMatcher::IgnoreMatcher(const QStringList &patterns)
+{
+    for (QString pattern : patterns) {
+        pattern = pattern.trimmed();
+        Rule rule;
+        rule.dirsOnly = pattern.endsWith(QLatin1Char('/'));
+        if (rule.dirsOnly) {
+            pattern.chop(1);
+        }
+        // "/drafts" is anchored at the root like "notes/drafts"
+        const bool anchored = pattern.startsWith(QLatin1Char('/'));
+        if (anchored) {
+            pattern.remove(0, 1);
+        }
+        if (pattern.isEmpty()) {
+            continue;
+        }
+        rule.onPath = anchored || pattern.contains(QLatin1Char('/'));
+        rule.pattern.setPattern(QRegularExpression::wildcardToRegularExpression(pattern));
+        m_rules.append(rule);
+    }
+}
+
+bool VaultWalker::IgnoreMatcher::matches(const QString &name, const QString &relPath, bool isDir) const
+{
+    for (const Rule &rule : m_rules) {
+        if (rule.dirsOnly && !isDir) {
+            continue;
+        }
+        if (rule.pattern.match(rule.onPath ? relPath : name).hasMatch()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool VaultWalker::IgnoreMatcher::isIgnored(const QString &relPath) const
+{
+    // Every folder on the way counts, as the walk never enters ignored ones
+    const QStringList parts = relPath.split(QLatin1Char('/'));
+    for (int i = 0; i < parts.size(); ++i) {
+        if (parts[i].startsWith(QLatin1Char('.'))) {
+            return true;
+        }
+        if (!m_rules.isEmpty()
+            && matches(parts[i], parts.mid(0, i + 1).join(QLatin1Char('/')), i + 1 < parts.size())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+VaultWalker::VaultWalker(const QString &rootPath, Options options)
+    : m_rootPath(rootPath), m_options(options),
+      m_suffixes({"md", "markdown", "txt"}),
+      m_ignorePatterns(readIgnoreFile(rootPath)),
+      m_threadCount(QThread::idealThreadCount())
+{
+}
+
+void VaultWalker::setSuffixes(const QStringList &suffixes)
+{
+    m_suffixes = suffixes;
+}
+
+void VaultWalker::setIgnorePatterns(const QStringList &patterns)
+{
+    m_ignorePatterns = patterns;
+}
+
+QVector<VaultWalker::Entry> VaultWalker::walk()
+{
+    m_directoryCount = 0;
+    m_errorCount = 0;
+    QVector<Entry> entries;
+
+#ifdef Q_OS_UNIX
+    auto state = QSharedPointer<State>::create();
+    for (const QString &suffix : std::as_const(m_suffixes)) {
+        state->suffixes.append('.' + suffix.toLower().toUtf8());
+    }
+    state->ignore = ignoreMatcher();
+    state->wantStat = m_options.testFlag(Stat);
+    state->workerCount = m_options.testFlag(Parallel) ? m_threadCount : 1;
+    state->workers.reset(new State::Worker[state->workerCount]);
+    state->pending = 1;
+    state->workers[0].tasks.push_back(Task{{}, QFile::encodeName(m_rootPath), QString()});
+
+    // The calling thread works too; helpers that start late find nothing
+    // left and return, so a busy pool only makes the walk serial
+    for (int i = 1; i < state->workerCount; ++i) {
+        QThreadPool::globalInstance()->start([state, i]() { state->work(i); });
+    }
+    state->work(0);
+
+    for (int i = 0; i < state->workerCount; ++i) {
+        const State::Worker &worker = state->workers[i];
+        entries += worker.entries;
+        m_directoryCount += worker.directories;
+        m_errorCount += worker.errors;
+    }
+#else
+    QStringList filters;
+    for (const QString &suffix : std::as_const(m_suffixes)) {
+        filters.append("*." + suffix);
+    }
+    const IgnoreMatcher ignore = ignoreMatcher();
+    const QDir root(m_rootPath);
+    QDirIterator it(m_rootPath, filters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        Entry entry;
+        entry.relPath = root.relativeFilePath(it.next());
+
+        if (ignore.isIgnored(entry.relPath)) {
+            continue;
+        }
+        if (m_options.testFlag(Stat)) {
+            entry.mtime = it.fileInfo().lastModified().toMSecsSinceEpoch();
+            entry.size = it.fileInfo().size();
+        }
+        entries.append(entry);
+    }
+#endif
+
+    // Parallel walks finish in any order; note ids should not depend on it
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.relPath < b.relPath;
+    });
+    return entries;
+}
+
+QStringList VaultWalker::readIgnoreFile(const QString &rootPath)
+{
+    QStringList patterns;
+    QFile file(QDir(rootPath).filePath(IgnoreFileName));
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return patterns;
+    }
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (!line.isEmpty() && !line.startsWith(QLatin1Char('#'))) {
+            patterns.append(line);
+        }
+    }
+    return patterns;
+}
\ No newline at end of file
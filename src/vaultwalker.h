@@ -0,0 +1,100 @@
+#ifndef VAULTWALKER_H
+#define VAULTWALKER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFlags>
+#include <QRegularExpression>
+
+// Lists the notes under a directory tree, in place of QDirIterator with
+// name filters.
+//
+// On Unix each directory is opened relative to its parent (openat) and
+// read in large chunks (getdents64 on Linux), and the entry type from the
+// listing decides between file and folder, so nothing is stat()ed unless
+// Stat asks for modification times or the file system leaves the type
+// out. Suffixes are checked on the raw name bytes before anything is
+// decoded. With Parallel, subdirectories are listed by several threads
+// that steal queued directories from each other, which hides the latency
+// of network file systems.
+//
+// Hidden entries (.git, .formica, ...) are always skipped, as before, and
+// patterns from the vault's .formicaignore file are left out as well.
+class VaultWalker
+{
+public:
+    struct Entry {
+        QString relPath;        // Relative to the root, '/' separated
+        qint64 mtime = -1;      // Milliseconds since the epoch, with Stat
+        qint64 size = -1;       // With Stat
+    };
+
+    enum Option {
+        NoOptions = 0x0,
+        Stat = 0x1,             // Fill in mtime and size
+        Parallel = 0x2          // List directories on several threads
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    // Compiled ignore patterns, for notes that reach an index without a
+    // walk (watcher events, saves); the rules the walk applies
+    class IgnoreMatcher
+    {
+    public:
+        IgnoreMatcher() = default;
+        explicit IgnoreMatcher(const QStringList &patterns);
+
+        bool isEmpty() const { return m_rules.isEmpty(); }
+        // One entry, by its name and its path from the root
+        bool matches(const QString &name, const QString &relPath, bool isDir) const;
+        // Whether the walk leaves the note at relPath out: it is hidden or
+        // ignored, or a folder on its way is
+        bool isIgnored(const QString &relPath) const;
+
+    private:
+        struct Rule {
+            QRegularExpression pattern;
+            bool onPath = false;        // Matched against the path from the root
+            bool dirsOnly = false;
+        };
+
+        QVector<Rule> m_rules;
+    };
+
+    explicit VaultWalker(const QString &rootPath, Options options = NoOptions);
+
+    // Without the dot, matched case-insensitively; md, markdown and txt by default
+    void setSuffixes(const QStringList &suffixes);
+    // Wildcards on names ("*.draft.md", "archive/"), or on paths from the
+    // root when they contain a '/' elsewhere; a trailing '/' only matches folders
+    void setIgnorePatterns(const QStringList &patterns);
+    QStringList ignorePatterns() const { return m_ignorePatterns; }
+    IgnoreMatcher ignoreMatcher() const { return IgnoreMatcher(m_ignorePatterns); }
+    void setThreadCount(int count) { m_threadCount = qMax(1, count); }
+
+    // The matching files, sorted by path
+    QVector<Entry> walk();
+
+    // Of the last walk
+    int directoryCount() const { return m_directoryCount; }
+    int errorCount() const { return m_errorCount; }
+
+    // Patterns in rootPath/.formicaignore, one per line, '#' starts a comment
+    static QStringList readIgnoreFile(const QString &rootPath);
+
+private:
+    struct State;
+
+    QString m_rootPath;
+    Options m_options;
+    QStringList m_suffixes;
+    QStringList m_ignorePatterns;
+    int m_threadCount;
+    int m_directoryCount = 0;
+    int m_errorCount = 0;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(VaultWalker::Options)
+
+#endif // VAULTWALKER_H
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "vaultwatcher.h"
+#include "vaultindex.h"
+#include <QDir>
+#include <QFileInfo>
+#include <utility>
+
+VaultWatcher::VaultWatcher(VaultIndex *index, QObject *parent)
+    : QObject(parent), m_index(index), m_watcher(FileWatcher::create(this))
+{
+    m_quietTimer.setSingleShot(true);
+    m_quietTimer.setInterval(QuietMs);
+    m_maxDelayTimer.setSingleShot(true);
+    m_maxDelayTimer.setInterval(MaxDelayMs);
+    connect(&m_quietTimer, &QTimer::timeout, this, &VaultWatcher::flush);
+    connect(&m_maxDelayTimer, &QTimer::timeout, this, &VaultWatcher::flush);
+
+    connect(m_watcher, &FileWatcher::eventsReady, this, &VaultWatcher::onEvents);
+    connect(m_index, &VaultIndex::reset, this, &VaultWatcher::onVaultReset);
+    onVaultReset();
+}
+
+int VaultWatcher::queueDepth() const
+{
+    return m_pending.size() + m_renames.size() + m_movedFrom.size();
+}
+
+qint64 VaultWatcher::lagMs() const
+{
+    return m_oldestEvent.isValid() ? m_oldestEvent.elapsed() : 0;
+}
+
+void VaultWatcher::flush()
+{
+    m_quietTimer.stop();
+    m_maxDelayTimer.stop();
+    if (!m_oldestEvent.isValid()) {
+        return;
+    }
+
+    // Notes moved out of the vault
+    for (const QString &relPath : std::as_const(m_movedFrom)) {
+        markChanged(relPath, Removed);
+    }
+    m_movedFrom.clear();
+
+    const QElapsedTimer oldestEvent = m_oldestEvent;
+    const int batchSize = m_pending.size() + m_renames.size();
+    if (m_rescan || batchSize > RescanThreshold) {
+        clearQueue();
+        m_index->rescan();
+        ++m_stats.rescans;
+        emit rescanned();
+    } else {
+        const QDir root(m_vaultPath);
+        QStringList paths;
+
+        // Renames first, later writes refer to the new names
+        for (auto it = m_renames.cbegin(); it != m_renames.cend(); ++it) {
+            const QString newPath = root.filePath(it.key());
+            if (m_index->noteId(it.value()) < 0) {
+                m_index->addNote(newPath);      // Renamed in the application already
+            } else {
+                if (m_index->noteId(it.key()) >= 0) {
+                    m_index->removeNote(newPath);   // Overwritten by the move
+                }
+                m_index->renameNote(root.filePath(it.value()), newPath);
+            }
+            paths << it.value() << it.key();
+        }
+        for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it) {
+            const QString filePath = root.filePath(it.key());
+            if (it.value() == Changed && QFileInfo::exists(filePath)) {
+                m_index->addNote(filePath);
+            } else {
+                m_index->removeNote(filePath);
+            }
+            paths << it.key();
+        }
+
+        clearQueue();
+        emit notesChanged(paths);
+    }
+
+    ++m_stats.batches;
+    m_stats.lastBatchSize = batchSize;
+    m_stats.lastLagMs = oldestEvent.elapsed();
+    m_stats.maxLagMs = qMax(m_stats.maxLagMs, m_stats.lastLagMs);
+    emit batchApplied();
+}
+
+void VaultWatcher::onVaultReset()
+{
+    // The index rescans on its own too; only a new vault needs new watches
+    if (m_index->vaultPath() == m_vaultPath && isWatching()) {
+        return;
+    }
+
+    clearQueue();
+    m_quietTimer.stop();
+    m_maxDelayTimer.stop();
+    m_vaultPath = m_index->vaultPath();
+    if (m_vaultPath.isEmpty()) {
+        m_watcher->stop();
+    } else {
+        m_watcher->watch(m_vaultPath);
+    }
+}
+
+void VaultWatcher::onEvents(const QVector<FileWatcher::Event> &events)
+{
+    for (const FileWatcher::Event &event : events) {
+        ++m_stats.events;
+
+        // Whole directories appearing, moving or going away
+        if (event.kind == FileWatcher::Event::Overflow || event.isDir) {
+            m_rescan = true;
+            continue;
+        }
+
+        const QString relPath = relativePath(event.path);
+        // Notes the walk leaves out are not followed either
+        const bool isNote = !relPath.isEmpty() && VaultIndex::isNoteFile(relPath)
+                            && !m_index->isIgnored(relPath);
+        switch (event.kind) {
+        case FileWatcher::Event::Modified:
+        case FileWatcher::Event::Created:
+            if (isNote) {
+                markChanged(relPath, Changed);
+            }
+            break;
+        case FileWatcher::Event::Removed:
+            if (isNote) {
+                markChanged(relPath, Removed);
+            }
+            break;
+        case FileWatcher::Event::MovedFrom:
+            if (isNote) {
+                m_movedFrom.insert(event.cookie, relPath);
+            }
+            break;
+        case FileWatcher::Event::MovedTo: {
+            // "note.md.tmp" -> "note.md" is how many editors save
+            const QString oldPath = m_movedFrom.take(event.cookie);
+            if (isNote && !oldPath.isEmpty()) {
+                markRenamed(oldPath, relPath);
+            } else if (isNote) {
+                markChanged(relPath, Changed);
+            } else if (!oldPath.isEmpty()) {
+                markChanged(oldPath, Removed);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    if (queueDepth() == 0 && !m_rescan) {
+        return;
+    }
+    if (!m_oldestEvent.isValid()) {
+        m_oldestEvent.start();
+        m_maxDelayTimer.start();
+    }
+    m_quietTimer.start();
+}
+
+QString VaultWatcher::relativePath(const QString &filePath) const
+{
+    const QString prefix = m_vaultPath + QLatin1Char('/');
+    return filePath.startsWith(prefix) ? filePath.mid(prefix.size()) : QString();
+}
+
+void VaultWatcher::markChanged(const QString &relPath, Change change)
+{
+    // Moved here and then deleted: the note under its old name goes
+    if (change == Removed) {
+        const QString oldPath = m_renames.take(relPath);
+        if (!oldPath.isEmpty()) {
+            m_pending.insert(oldPath, Removed);
+        }
+    }
+    m_pending.insert(relPath, change);
+}
+
+void VaultWatcher::markRenamed(const QString &oldPath, const QString &newPath)
+{
+    // "b" -> "c" after "a" -> "b" is "a" -> "c"
+    QString origin = m_renames.take(oldPath);
+    if (origin.isEmpty()) {
+        origin = oldPath;
+    }
+
+    // A note moved onto newPath earlier in the batch is gone now
+    const QString overwritten = m_renames.take(newPath);
+    if (!overwritten.isEmpty()) {
+        m_pending.insert(overwritten, Removed);
+    }
+
+    // Written before the move: read it under the new name
+    const bool written = m_pending.value(oldPath, Removed) == Changed;
+    m_pending.remove(oldPath);
+    m_pending.remove(newPath);
+    if (origin != newPath) {
+        m_renames.insert(newPath, origin);
+    }
+    if (written) {
+        m_pending.insert(newPath, Changed);
+    }
+}
+
+void VaultWatcher::clearQueue()
+{
+    m_pending.clear();
+    m_renames.clear();
+    m_movedFrom.clear();
+    m_rescan = false;
+    m_oldestEvent.invalidate();
+}
\ No newline at end of file
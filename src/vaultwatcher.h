@@ -0,0 +1,91 @@
+#ifndef VAULTWATCHER_H
+#define VAULTWATCHER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
+#include <QTimer>
+#include "filewatcher.h"
+
+class VaultIndex;
+
+// Keeps the vault index in step with changes made outside the application
+// (git pulls, sync tools, other editors).
+//
+// Events from a FileWatcher are coalesced per note: a note written ten
+// times is read once, a rename chain collapses to one rename and a file
+// created and deleted again is dropped. The queue is applied once events
+// stop for QuietMs, or after MaxDelayMs while they keep coming, so a large
+// checkout is handled in a few batches. Directory changes, lost events and
+// batches over RescanThreshold notes make the index rescan instead, which
+// costs a stat per note with the metadata cache. The link graph and the
+// zettel ids follow the index; search indexes follow notesChanged().
+class VaultWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats {
+        quint64 events = 0;         // Raw events received
+        quint64 batches = 0;
+        quint64 rescans = 0;
+        int lastBatchSize = 0;      // Notes the last batch touched
+        qint64 lastLagMs = 0;       // First event to applied, for the last batch
+        qint64 maxLagMs = 0;
+    };
+
+    // Follows the vault of index, from the vault it holds now on
+    explicit VaultWatcher(VaultIndex *index, QObject *parent = nullptr);
+
+    bool isWatching() const { return !m_watcher->rootPath().isEmpty(); }
+    QString errorString() const { return m_watcher->errorString(); }
+
+    // Notes and renames waiting for the next batch
+    int queueDepth() const;
+    // Age of the oldest waiting event, 0 with an empty queue
+    qint64 lagMs() const;
+    const Stats &stats() const { return m_stats; }
+
+    // Apply the queue now
+    void flush();
+
+    static const int QuietMs = 200;
+    static const int MaxDelayMs = 2000;
+    static const int RescanThreshold = 1000;
+
+signals:
+    // Relative paths of the notes a batch added, changed, renamed or removed
+    void notesChanged(const QStringList &paths);
+    // The index was rebuilt from a walk, any note may have changed
+    void rescanned();
+    void batchApplied();
+
+private slots:
+    void onVaultReset();
+    void onEvents(const QVector<FileWatcher::Event> &events);
+
+private:
+    enum Change { Changed, Removed };
+
+    QString relativePath(const QString &filePath) const;
+    void markChanged(const QString &relPath, Change change);
+    void markRenamed(const QString &oldPath, const QString &newPath);
+    void clearQueue();
+
+    VaultIndex *m_index;
+    FileWatcher *m_watcher;
+    QString m_vaultPath;
+
+    QHash<QString, Change> m_pending;       // Relative path -> last change
+    QHash<QString, QString> m_renames;      // New relative path -> old one
+    QHash<quint32, QString> m_movedFrom;    // Cookie -> note moved away
+    bool m_rescan = false;
+
+    QTimer m_quietTimer;
+    QTimer m_maxDelayTimer;
+    QElapsedTimer m_oldestEvent;
+    Stats m_stats;
+};
+
+#endif // VAULTWATCHER_H
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "zettelidindex.h"
+#include <limits>
+
+namespace {
+
+const quint64 MaxValue = std::numeric_limits<quint64>::max();
+
+// Number of segments of an encoded id
+int segmentCount(const QByteArray &key)
+{
+    int count = 0;
+    for (qsizetype pos = 0; pos < key.size(); pos += 1 + quint8(key[pos])) {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+void ZettelIdIndex::insert(const QString &zettelId)
+{
+    const QByteArray key = encode(zettelId);
+    if (!key.isEmpty()) {
+        ++m_ids[key];
+    }
+}
+
+void ZettelIdIndex::remove(const QString &zettelId)
+{
+    auto found = m_ids.find(encode(zettelId));
+    if (found != m_ids.end() && --found.value() <= 0) {
+        m_ids.erase(found);
+    }
+}
+
+bool ZettelIdIndex::contains(const QString &zettelId) const
+{
+    const QByteArray key = encode(zettelId);
+    return !key.isEmpty() && m_ids.contains(key);
+}
+
+quint64 ZettelIdIndex::maxTopLevel() const
+{
+    if (m_ids.isEmpty()) {
+        return 0;
+    }
+
+    // Everything under N sorts before N + 1, so the last id has the highest
+    qsizetype pos = 0;
+    return readSegment(m_ids.lastKey(), &pos);
+}
+
+QString ZettelIdIndex::lastChild(const QString &parentId) const
+{
+    const QByteArray prefix = encode(parentId);
+    if (prefix.isEmpty()) {
+        return QString();
+    }
+
+    // Length bytes are at most 8, so prefix + 0xff is past every descendant
+    auto it = m_ids.lowerBound(prefix + char(0xff));
+    if (it == m_ids.begin()) {
+        return QString();
+    }
+    --it;
+    if (it.key().size() == prefix.size() || !it.key().startsWith(prefix)) {
+        return QString();
+    }
+
+    qsizetype pos = prefix.size();
+    const quint64 child = readSegment(it.key(), &pos);
+    return parentId + segmentText(child, segmentCount(prefix) % 2 == 1);
+}
+
+QString ZettelIdIndex::nextTopLevel() const
+{
+    return QString::number(maxTopLevel() + 1);
+}
+
+QString ZettelIdIndex::nextChild(const QString &parentId) const
+{
+    const QByteArray prefix = encode(parentId);
+    if (prefix.isEmpty()) {
+        return QString();
+    }
+
+    // Children of "1" are letters, children of "1a" numbers
+    const bool letters = segmentCount(prefix) % 2 == 1;
+    const QString last = lastChild(parentId);
+    if (last.isEmpty()) {
+        return parentId + segmentText(1, letters);
+    }
+
+    qsizetype pos = prefix.size();
+    const quint64 value = readSegment(encode(last), &pos);
+    if (value == MaxValue) {
+        return QString();
+    }
+    return parentId + segmentText(value + 1, letters);
+}
+
+QString ZettelIdIndex::nextSibling(const QString &zettelId) const
+{
+    if (encode(zettelId).isEmpty()) {
+        return QString();
+    }
+
+    const QString parentId = parent(zettelId);
+    return parentId.isEmpty() ? nextTopLevel() : nextChild(parentId);
+}
+
+QString ZettelIdIndex::parent(const QString &zettelId)
+{
+    qsizetype end = zettelId.size();
+    if (end == 0) {
+        return QString();
+    }
+
+    // Strip the last run of digits or of letters
+    const bool digits = zettelId[end - 1].isDigit();
+    while (end > 0 && zettelId[end - 1].isDigit() == digits) {
+        --end;
+    }
+    return zettelId.left(end);
+}
+
+QByteArray ZettelIdIndex::encode(const QString &zettelId)
+{
+    QByteArray key;
+    bool digits = true;
+    qsizetype i = 0;
+    while (i < zettelId.size()) {
+        const qsizetype start = i;
+        quint64 value = 0;
+        while (i < zettelId.size()) {
+            const char16_t ch = zettelId[i].unicode();
+            quint64 digit;
+            if (digits && ch >= u'0' && ch <= u'9') {
+                digit = ch - u'0';
+            } else if (!digits && ch >= u'a' && ch <= u'z') {
+                digit = ch - u'a' + 1;      // Bijective: "z" + 1 is "aa"
+            } else {
+                break;
+            }
+
+            const quint64 base = digits ? 10 : 26;
+            if (value > (MaxValue - digit) / base) {
+                return QByteArray();
+            }
+            value = value * base + digit;
+            ++i;
+        }
+
+        if (i == start) {
+            return QByteArray();    // Not a digit or letter where one belongs
+        }
+        appendSegment(&key, value);
+        digits = !digits;
+    }
+    return key;
+}
+
+QString ZettelIdIndex::decode(const QByteArray &key)
+{
+    QString zettelId;
+    bool letters = false;
+    qsizetype pos = 0;
+    while (pos < key.size()) {
+        zettelId += segmentText(readSegment(key, &pos), letters);
+        letters = !letters;
+    }
+    return zettelId;
+}
+
+void ZettelIdIndex::appendSegment(QByteArray *key, quint64 value)
+{
+    // Shortest big-endian form, so longer means larger
+    char bytes[8];
+    int length = 0;
+    do {
+        bytes[7 - length++] = char(value & 0xff);
+        value >>= 8;
+    } while (value != 0);
+
+    key->append(char(length));
+    key->append(bytes + 8 - length, length);
+}
+
+quint64 ZettelIdIndex::readSegment(const QByteArray &key, qsizetype *pos)
+{
+    const int length = quint8(key[*pos]);
+    quint64 value = 0;
+    for (int i = 1; i <= length; ++i) {
+        value = (value << 8) | quint8(key[*pos + i]);
+    }
+    *pos += 1 + length;
+    return value;
+}
+
+QString ZettelIdIndex::segmentText(quint64 value, bool letters)
+{
+    if (!letters) {
+        return QString::number(value);
+    }
+
+    QString text;
+    while (value > 0) {
+        --value;
+        text.prepend(QChar(u'a' + char16_t(value % 26)));
+        value /= 26;
+    }
+    return text;
+}
\ No newline at end of file
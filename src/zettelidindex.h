@@ -0,0 +1,56 @@
+#ifndef ZETTELIDINDEX_H
+#define ZETTELIDINDEX_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+// Ordered set of the zettel ids in use.
+//
+// Ids are stored in a binary encoding whose byte order is the zettelkasten
+// order: every segment ("1", "a", "12", "ab") becomes a length byte and its
+// value in big-endian bytes, so "1" < "1a" < "1a1" < "1b" < "2" < "10"
+// compare as plain bytes, and a note's descendants sort directly after it.
+// That turns "last child of 1a" or "highest top-level number" into a single
+// ordered lookup instead of a scan of every id.
+class ZettelIdIndex
+{
+public:
+    void clear() { m_ids.clear(); }
+    // Ids are reference counted, two notes may claim the same one
+    void insert(const QString &zettelId);
+    void remove(const QString &zettelId);
+    bool contains(const QString &zettelId) const;
+    bool isEmpty() const { return m_ids.isEmpty(); }
+    int size() const { return m_ids.size(); }
+
+    // Highest top-level number, 0 if there are none
+    quint64 maxTopLevel() const;
+    // Last direct child of parentId ("1a" -> "1a3"), empty if it has none
+    QString lastChild(const QString &parentId) const;
+
+    // The id after the highest top-level one ("1" in an empty vault)
+    QString nextTopLevel() const;
+    // The id after the last direct child of parentId ("1" -> "1c" when
+    // "1b" is the last); empty if parentId is not a valid id
+    QString nextChild(const QString &parentId) const;
+    // The id after the last sibling of zettelId
+    QString nextSibling(const QString &zettelId) const;
+
+    // "1a2" -> "1a", "1" -> ""
+    static QString parent(const QString &zettelId);
+
+    // Empty if zettelId is not a valid id or a segment is out of range
+    static QByteArray encode(const QString &zettelId);
+    static QString decode(const QByteArray &key);
+
+private:
+    static void appendSegment(QByteArray *key, quint64 value);
+    static quint64 readSegment(const QByteArray &key, qsizetype *pos);
+    static QString segmentText(quint64 value, bool letters);
+
+    QMap<QByteArray, int> m_ids;    // Encoded id -> number of notes
+};
+
+#endif // ZETTELIDINDEX_H
\ No newline at end of file